@@ -9,7 +9,9 @@
 #include "mathicgb/F4Reducer.hpp"
 #include "mathicgb/Scanner.hpp"
 #include "mathicgb/MathicIO.hpp"
+#include "mathicgb/MappedFile.hpp"
 #include "mathicgb/Reducer.hpp"
+#include "mathicgb/F4Trace.hpp"
 #include <fstream>
 #include <iostream>
 
@@ -33,9 +35,35 @@ GBAction::GBAction():
   mSPairGroupSize(
     "sPairGroupSize",
     "Specifies how many S-pair to reduce at one time. A value of 0 "
-    "indicates to use an appropriate default.",
+    "indicates to use an appropriate default. For a matrix-based reducer "
+    "the default is no longer 100000. It is now chosen from the time spent "
+    "on the previous matrices, unless adaptiveGroupSize is off.",
     0),
 
+  mAdaptiveGroupSize(
+    "adaptiveGroupSize",
+    "If using a matrix-based reducer and sPairGroupSize is 0, choose how "
+    "many S-pairs to reduce at one time from the time spent per non-zero "
+    "entry of the previous matrices. Otherwise reduce 100000 S-pairs at "
+    "one time, which used to be the default.",
+    true),
+
+  mMatrixMemoryBudget(
+    "matrixMemoryBudget",
+    "If using a matrix-based reducer and sPairGroupSize is 0, choose how "
+    "many S-pairs to reduce at one time so that each matrix is expected to "
+    "use at most this many megabytes of memory. A value of 0 indicates "
+    "no limit.",
+    0),
+
+  mSparseAccumulatorDensity(
+    "sparseAccumulatorDensity",
+    "If using a matrix-based reducer, rows of matrices with fewer than this "
+    "many non-zero entries per million entries are reduced with a sparse "
+    "accumulator instead of a dense row. The result is the same either way, "
+    "only the time it takes changes.",
+    2000),
+
   mMinMatrixToStore(
     "storeMatrices",
     "If using a matrix-based reducer, store the matrices that are generated in "
@@ -51,6 +79,34 @@ GBAction::GBAction():
     false
   ),
 
+  mRecordTrace(
+    "recordTrace",
+    "Record which S-pairs were useful in each step into the file X.trace "
+    "where X is the project name. Use this with the F4 reducer to be able "
+    "to replay the computation modulo other primes.",
+    false
+  ),
+
+  mReplayTrace(
+    "replayTrace",
+    "Replay the computation recorded in the file X.trace where X is the "
+    "project name instead of choosing S-pairs. The computation stops with "
+    "an error if it does not follow the trace, which happens for an "
+    "unlucky prime.",
+    false
+  ),
+
+  mPipeline(
+    "pipeline",
+    "Start building the matrix for the next group of S-pairs while the "
+    "current group is being reduced, and convert the reduced rows to "
+    "polynomials in parallel. The next group is chosen before the "
+    "polynomials from the current group are inserted. Only relevant to the "
+    "classic Buchberger algorithm with the F4 reducer and it has no effect "
+    "when recording or replaying a trace.",
+    false
+  ),
+
    mParams(1, 1)
 {}
 
@@ -68,14 +124,14 @@ void GBAction::performAction() {
 
   // read input
   const std::string inputBasisFile = projectName + ".ideal";
-  std::ifstream inputFile(inputBasisFile.c_str());
-  if (inputFile.fail())
+  InputFile inputFile;
+  if (!inputFile.open(inputBasisFile))
     mic::reportError("Could not read input file \"" + inputBasisFile + '\n');
+  auto& in = inputFile.scanner();
 
-  Scanner in(inputFile);
   auto p = MathicIO<>().readRing(true, in);
   auto& ring = *p.first;
-  auto basis = MathicIO<>().readBasis(ring, mModule.value(), in);
+  auto basis = MathicIO<>().readBasisParallel(ring, mModule.value(), in);
 
   // run algorithm
   const auto reducerType = Reducer::reducerType(mGBParams.mReducer.value());
@@ -94,6 +150,11 @@ void GBAction::performAction() {
     );     
     reducer = std::move(f4Reducer);
   }
+  reducer->setMatrixMemoryBudget
+    (static_cast<size_t>(mMatrixMemoryBudget.value()) * 1024 * 1024);
+  reducer->setAdaptiveSetSize(mAdaptiveGroupSize.value());
+  reducer->setSparseAccumulatorDensity
+    (mSparseAccumulatorDensity.value() / 1000000.0);
 
   ClassicGBAlgParams params;
   params.reducer = reducer.get();
@@ -108,6 +169,22 @@ void GBAction::performAction() {
   params.useAutoTailReduction = mAutoTailReduce.value();
   params.callback = nullptr;
 
+  F4Trace trace;
+  const std::string traceFile = projectName + ".trace";
+  if (mRecordTrace.value() && mReplayTrace.value())
+    mic::reportError("Cannot both record and replay a trace.");
+  if (mReplayTrace.value()) {
+    std::ifstream traceIn(traceFile.c_str());
+    if (traceIn.fail())
+      mic::reportError("Could not read trace file \"" + traceFile + '\n');
+    Scanner traceScanner(traceIn);
+    trace.read(traceScanner);
+  }
+  params.trace =
+    mRecordTrace.value() || mReplayTrace.value() ? &trace : nullptr;
+  params.replayTrace = mReplayTrace.value();
+  params.pipeline = mPipeline.value();
+
   const auto gb = mModule.value() ?
     computeModuleGBClassicAlg(std::move(basis), params) :
     computeGBClassicAlg(std::move(basis), params);
@@ -116,6 +193,10 @@ void GBAction::performAction() {
     std::ofstream out(projectName + ".gb");
     MathicIO<>().writeBasis(gb, mModule.value(), out);
   }
+  if (mRecordTrace.value()) {
+    std::ofstream out(traceFile);
+    trace.write(out);
+  }
 }
 
 const char* GBAction::staticName() {
@@ -143,8 +224,14 @@ void GBAction::pushBackParameters(
   parameters.push_back(&mAutoTailReduce);
   parameters.push_back(&mAutoTopReduce);
   parameters.push_back(&mSPairGroupSize);
+  parameters.push_back(&mAdaptiveGroupSize);
+  parameters.push_back(&mMatrixMemoryBudget);
+  parameters.push_back(&mSparseAccumulatorDensity);
   parameters.push_back(&mMinMatrixToStore);
   parameters.push_back(&mModule);
+  parameters.push_back(&mRecordTrace);
+  parameters.push_back(&mReplayTrace);
+  parameters.push_back(&mPipeline);
 }
 
 MATHICGB_NAMESPACE_END
@@ -36,8 +36,14 @@ private:
   mathic::BoolParameter mAutoTopReduce;
   //mic::IntegerParameter mTermOrder;
   mathic::IntegerParameter mSPairGroupSize;
+  mathic::BoolParameter mAdaptiveGroupSize;
+  mathic::IntegerParameter mMatrixMemoryBudget;
+  mathic::IntegerParameter mSparseAccumulatorDensity;
   mathic::IntegerParameter mMinMatrixToStore;
   mic::BoolParameter mModule;
+  mic::BoolParameter mRecordTrace;
+  mic::BoolParameter mReplayTrace;
+  mic::BoolParameter mPipeline;
 };
 
 MATHICGB_NAMESPACE_END
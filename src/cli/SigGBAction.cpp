@@ -8,6 +8,7 @@
 #include "mathicgb/io-util.hpp"
 #include "mathicgb/Scanner.hpp"
 #include "mathicgb/MathicIO.hpp"
+#include "mathicgb/MappedFile.hpp"
 #include <fstream>
 #include <iostream>
 
@@ -32,6 +33,14 @@ SigGBAction::SigGBAction():
     "S-spairs quickly based on signature.",
     true),
 
+  mSignatureSetSize(
+    "signatureSetSize",
+    "Specifies how many S-pair signatures of the same degree to reduce at "
+    "one time. Reducers that are not matrix-based reduce the signatures "
+    "of a set in parallel. A value of 0 indicates to use an appropriate "
+    "default.",
+    0),
+
   mParams(1, 1)
 {}
 
@@ -48,16 +57,16 @@ void SigGBAction::performAction() {
 
   // read input file
   const std::string inputBasisFile = mParams.inputFileNameStem(0) + ".ideal";
-  std::ifstream inputFile(inputBasisFile.c_str());
-  if (inputFile.fail())
+  InputFile inputFile;
+  if (!inputFile.open(inputBasisFile))
     mic::reportError("Could not read input file \"" + inputBasisFile + '\n');
+  auto& in = inputFile.scanner();
 
 
-  Scanner in(inputFile);
   auto p = MathicIO<>().readRing(true, in);
   auto& ring = *p.first;
   auto& processor = p.second;
-  auto basis = MathicIO<>().readBasis(ring, false, in);
+  auto basis = MathicIO<>().readBasisParallel(ring, false, in);
   if (processor.schreyering())
     processor.setSchreyerMultipliers(basis);
 
@@ -74,6 +83,7 @@ void SigGBAction::performAction() {
     mGBParams.mSPairQueue.value());
   alg.setBreakAfter(mGBParams.mBreakAfter.value());
   alg.setPrintInterval(mGBParams.mPrintInterval.value());
+  alg.setSignatureSetSize(mSignatureSetSize.value());
   alg.computeGrobnerBasis();
 
   // print statistics
@@ -128,6 +138,7 @@ void SigGBAction::pushBackParameters(
   parameters.push_back(&mUseSingularCriterionEarly);
   parameters.push_back(&mPostponeKoszul);
   parameters.push_back(&mUseBaseDivisors);
+  parameters.push_back(&mSignatureSetSize);
 }
 
 MATHICGB_NAMESPACE_END
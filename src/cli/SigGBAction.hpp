@@ -34,6 +34,7 @@ private:
   mic::BoolParameter mUseSingularCriterionEarly;
   mic::BoolParameter mPostponeKoszul;
   mic::BoolParameter mUseBaseDivisors;
+  mic::IntegerParameter mSignatureSetSize;
 };
 
 MATHICGB_NAMESPACE_END
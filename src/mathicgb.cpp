@@ -359,6 +359,8 @@ struct GroebnerConfiguration::Pimpl {
     mSchreyering(true),
     mReducer(DefaultReducer),
     mMaxSPairGroupSize(0),
+    mMatrixMemoryBudget(0),
+    mAdaptiveSPairGroupSize(true),
     mMaxThreadCount(0),
     mLogging(),
     mCallbackData(0),
@@ -411,6 +413,8 @@ struct GroebnerConfiguration::Pimpl {
   bool mSchreyering;
   Reducer mReducer;
   unsigned int mMaxSPairGroupSize;
+  size_t mMatrixMemoryBudget;
+  bool mAdaptiveSPairGroupSize;
   unsigned int mMaxThreadCount;
   std::string mLogging;
   void* mCallbackData;
@@ -425,11 +429,13 @@ GroebnerConfiguration::GroebnerConfiguration(
 ):
   mPimpl(new Pimpl(modulus, varCount, comCount))
 {
-  if (modulus > std::numeric_limits<unsigned short>::max()) {
+  // F4 uses 32 bit scalars for moduli that do not fit in 16 bits and
+  // coefficients are stored as long, which can be a signed 32 bit type.
+  if (modulus > static_cast<Coefficient>(std::numeric_limits<int32>::max())) {
     MATHICGB_ASSERT_NO_ASSUME(false);
     std::ostringstream str;
     str << "Modulus " << modulus
-      << " is too large. MathicGB only supports 16 bit moduli.";
+      << " is too large. MathicGB only supports moduli less than 2^31.";
     mathic::reportError(str.str());
   }
   if (!isPrime(modulus)) {
@@ -581,6 +587,22 @@ uint32 GroebnerConfiguration::maxSPairGroupSize() const {
   return mPimpl->mMaxSPairGroupSize;
 }
 
+void GroebnerConfiguration::setMatrixMemoryBudget(size_t bytes) {
+  mPimpl->mMatrixMemoryBudget = bytes;
+}
+
+size_t GroebnerConfiguration::matrixMemoryBudget() const {
+  return mPimpl->mMatrixMemoryBudget;
+}
+
+void GroebnerConfiguration::setAdaptiveSPairGroupSize(bool value) {
+  mPimpl->mAdaptiveSPairGroupSize = value;
+}
+
+bool GroebnerConfiguration::adaptiveSPairGroupSize() const {
+  return mPimpl->mAdaptiveSPairGroupSize;
+}
+
 void GroebnerConfiguration::setMaxThreadCount(unsigned int maxThreadCount) {
   mPimpl->mMaxThreadCount = maxThreadCount;
 }
@@ -950,6 +972,8 @@ namespace mgbi {
       break;
     }
     const auto reducer = Reducer::makeReducer(reducerType, ring);
+    reducer->setMatrixMemoryBudget(conf.matrixMemoryBudget());
+    reducer->setAdaptiveSetSize(conf.adaptiveSPairGroupSize());
     CallbackAdapter callback(
       PimplOf()(conf).mCallbackData,
       PimplOf()(conf).mCallback
@@ -967,6 +991,9 @@ namespace mgbi {
     params.useAutoTopReduction = true;
     params.useAutoTailReduction = false;
     params.callback = nullptr;
+    params.trace = nullptr;
+    params.replayTrace = false;
+    params.pipeline = false;
     if (!callback.isNull())
       params.callback = [&callback](){return callback();};
 
@@ -76,8 +76,8 @@ namespace mgb { // Part of the public interface of MathicGB
 
     /// A configuration in a module over a polynomial ring with varCount
     /// variables and the coefficients are from the finite field with
-    /// modulus elements. modulus must be a prime. The module has the basis
-    /// e_0, ..., e_k where k is componentCount - 1.
+    /// modulus elements. modulus must be a prime less than 2^31. The module
+    /// has the basis e_0, ..., e_k where k is componentCount - 1.
     GroebnerConfiguration(
       Coefficient modulus,
       VarIndex varCount,
@@ -245,6 +245,22 @@ namespace mgb { // Part of the public interface of MathicGB
     void setMaxSPairGroupSize(unsigned int size);
     unsigned int maxSPairGroupSize() const;
 
+    /// Sets the approximate maximum number of bytes that a single matrix
+    /// of an F4 reducer may use. The library then chooses the number of
+    /// S-pairs to reduce at one time so that it expects the matrix to fit.
+    /// This only applies when maxSPairGroupSize() is 0. A value of 0
+    /// indicates no limit, which is the default value.
+    void setMatrixMemoryBudget(size_t bytes);
+    size_t matrixMemoryBudget() const;
+
+    /// Sets whether an F4 reducer chooses the number of S-pairs to reduce
+    /// at one time from the time it spent on its previous matrices. If
+    /// not, it reduces 100000 S-pairs at one time, which used to be the
+    /// default. This only applies when maxSPairGroupSize() is 0. The
+    /// default value is true.
+    void setAdaptiveSPairGroupSize(bool value);
+    bool adaptiveSPairGroupSize() const;
+
     /// Sets the maximum number of threads to use. May use fewer threads.
     /// A value of 0 indicates to let the library decide this value for
     /// itself, which is also the default value.
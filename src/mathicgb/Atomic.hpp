@@ -30,6 +30,17 @@ namespace AtomicInternal {
   /// http://goo.gl/U8xTK .
   template<class T>
   void seqCstStore(const T value, T& ref);
+
+  /// Sets ref to desired if ref equals expected, as one atomic operation
+  /// that is also a full memory barrier. Returns the value of ref before
+  /// the operation, so the operation succeeded if that equals expected.
+  template<class T>
+  T compareAndSwap(T& ref, const T expected, const T desired);
+
+  /// Adds value to ref as one atomic operation that is also a full memory
+  /// barrier. Returns the value of ref before the addition.
+  template<class T>
+  T fetchAndAdd(T& ref, const T value);
 }
 
 #if defined(_MSC_VER) && defined(MATHICGB_USE_CUSTOM_ATOMIC_X86_X64)
@@ -44,6 +55,15 @@ namespace AtomicInternal {
     static void store(const T value, T& ref) {
       _InterlockedExchange((volatile LONG*)&ref, (LONG)value);
     }
+
+    static T compareAndSwap(T& ref, const T expected, const T desired) {
+      return (T)_InterlockedCompareExchange
+        ((volatile LONG*)&ref, (LONG)desired, (LONG)expected);
+    }
+
+    static T fetchAndAdd(T& ref, const T value) {
+      return (T)_InterlockedExchangeAdd((volatile LONG*)&ref, (LONG)value);
+    }
   };
 #endif
 #ifdef MATHICGB_USE_CUSTOM_ATOMIC_8BYTE
@@ -51,6 +71,16 @@ namespace AtomicInternal {
     static void store(const T value, T& ref) {
       _InterlockedExchange64((volatile _LONGLONG*)&ref, (_LONGLONG)value);
     }
+
+    static T compareAndSwap(T& ref, const T expected, const T desired) {
+      return (T)_InterlockedCompareExchange64
+        ((volatile _LONGLONG*)&ref, (_LONGLONG)desired, (_LONGLONG)expected);
+    }
+
+    static T fetchAndAdd(T& ref, const T value) {
+      return (T)_InterlockedExchangeAdd64
+        ((volatile _LONGLONG*)&ref, (_LONGLONG)value);
+    }
   };
 #endif
 
@@ -60,6 +90,16 @@ namespace AtomicInternal {
   inline void cpuReadWriteMemoryBarrier() {MemoryBarrier();}
   template<class T>
   void seqCstStore(const T value, T& ref) {SeqCst<T>::store(value, ref);}
+
+  template<class T>
+  T compareAndSwap(T& ref, const T expected, const T desired) {
+    return SeqCst<T>::compareAndSwap(ref, expected, desired);
+  }
+
+  template<class T>
+  T fetchAndAdd(T& ref, const T value) {
+    return SeqCst<T>::fetchAndAdd(ref, value);
+  }
 }
 #endif
 
@@ -87,6 +127,17 @@ namespace AtomicInternal {
     const auto ptr = static_cast<volatile T*>(&ref);
     while (!__sync_bool_compare_and_swap(ptr, *ptr, value)) {}
   }    
+
+  template<class T>
+  T compareAndSwap(T& ref, const T expected, const T desired) {
+    return __sync_val_compare_and_swap
+      (static_cast<volatile T*>(&ref), expected, desired);
+  }
+
+  template<class T>
+  T fetchAndAdd(T& ref, const T value) {
+    return __sync_fetch_and_add(static_cast<volatile T*>(&ref), value);
+  }
 }
 #endif
 
@@ -105,6 +156,31 @@ namespace AtomicInternal {
     T load(const std::memory_order) const {return mValue;}
     void store(const T value, const std::memory_order order) {mValue = value;}
 
+    bool compare_exchange_weak(
+      T& expected,
+      const T desired,
+      const std::memory_order
+    ) {
+      if (mValue != expected) {
+        expected = mValue;
+        return false;
+      }
+      mValue = desired;
+      return true;
+    }
+
+    T fetch_add(const T value, const std::memory_order) {
+      const auto old = mValue;
+      mValue += value;
+      return old;
+    }
+
+    T fetch_sub(const T value, const std::memory_order) {
+      const auto old = mValue;
+      mValue -= value;
+      return old;
+    }
+
   private:
     T mValue;
   };
@@ -327,6 +403,31 @@ namespace AtomicInternal {
       }
     }
 
+    /// A locked instruction is a full memory barrier on x86 and x64, so
+    /// the memory order does not matter here.
+    MATHICGB_INLINE
+    bool compare_exchange_weak(
+      T& expected,
+      const T desired,
+      const std::memory_order
+    ) {
+      const auto old = compareAndSwap(mValue, expected, desired);
+      if (old == expected)
+        return true;
+      expected = old;
+      return false;
+    }
+
+    MATHICGB_INLINE
+    T fetch_add(const T value, const std::memory_order) {
+      return fetchAndAdd(mValue, value);
+    }
+
+    MATHICGB_INLINE
+    T fetch_sub(const T value, const std::memory_order) {
+      return fetchAndAdd(mValue, static_cast<T>(0 - value));
+    }
+
   private:
     T mValue;
   };
@@ -382,6 +483,40 @@ public:
     mValue.store(value, order);
   }
 
+  /// Stores desired if the current value equals expected. Otherwise
+  /// expected is set to the current value. Returns true if desired was
+  /// stored. As for std::atomic, this can fail spuriously, so call it in a
+  /// loop.
+  MATHICGB_INLINE
+  bool compare_exchange_weak(
+    T& expected,
+    const T desired,
+    const std::memory_order order = std::memory_order_seq_cst
+  ) {
+    MATHICGB_ASSERT(debugAligned());
+    return mValue.compare_exchange_weak(expected, desired, order);
+  }
+
+  /// Adds value and returns the value from before the addition.
+  MATHICGB_INLINE
+  T fetch_add(
+    const T value,
+    const std::memory_order order = std::memory_order_seq_cst
+  ) {
+    MATHICGB_ASSERT(debugAligned());
+    return mValue.fetch_add(value, order);
+  }
+
+  /// Subtracts value and returns the value from before the subtraction.
+  MATHICGB_INLINE
+  T fetch_sub(
+    const T value,
+    const std::memory_order order = std::memory_order_seq_cst
+  ) {
+    MATHICGB_ASSERT(debugAligned());
+    return mValue.fetch_sub(value, order);
+  }
+
 private:
   Atomic(const Atomic<T>&); // not available
   void operator=(const Atomic<T>&); // not available
@@ -9,7 +9,9 @@
 #include "Basis.hpp"
 #include "LogDomain.hpp"
 #include "MathicIO.hpp"
+#include "F4Trace.hpp"
 #include <iostream>
+#include <algorithm>
 #include <mathic.h>
 #include <memory>
 #include <vector>
@@ -88,17 +90,61 @@ public:
     mCallback = std::move(callback);
   }
 
+  /// If trace is not null, then the computation is recorded into *trace,
+  /// or if replay is true, the computation follows *trace instead of
+  /// choosing S-pairs.
+  void setTrace(F4Trace* trace, bool replay) {
+    mTrace = trace;
+    mReplayTrace = trace != nullptr && replay;
+  }
+
+  /// If value is true, then the next group of S-pairs is taken from the
+  /// S-pair queue before the current group is reduced, so that the reducer
+  /// can start on the next group while it reduces the current group. This
+  /// does not apply when recording or replaying a trace.
+  void setPipeline(bool value) {
+    mPipeline = value;
+  }
+
 private:
   std::function<bool(void)> mCallback;
+  F4Trace* mTrace;
+  bool mReplayTrace;
+  bool mPipeline;
   unsigned int mBreakAfter;
   unsigned int mPrintInterval;
-  unsigned int mSPairGroupSize;
+  unsigned int mSPairGroupSize; // 0 means ask the reducer at each step
   bool mUseAutoTopReduction;
   bool mUseAutoTailReduction;
 
   // Perform a step of the algorithm.
   void step();
 
+  // Returns mSPairGroupSize, or the preferred set size of the reducer if
+  // mSPairGroupSize is 0.
+  unsigned int sPairGroupSize() const;
+
+  // Takes the next group of at most sPairGroupSize() S-pairs from the
+  // S-pair queue. Sets w to the negative of the degree of their lcm's.
+  std::vector<std::pair<size_t, size_t>> popSPairGroup(exponent& w);
+
+  // Perform the step of the algorithm that step describes. Throws
+  // F4TraceMismatch if the outcome is not what the trace says.
+  void replayStep(const F4Trace::Step& step);
+
+  // Sorts polynomials from the reducer to get deterministic behavior.
+  void sortReduced(std::vector<std::unique_ptr<Poly>>& reduced) const;
+
+  // Returns the sorted lead monomials of polys in the format of F4Trace.
+  std::vector<F4Trace::Exponents> sortedLeads(
+    const std::vector<std::unique_ptr<Poly>>& polys
+  ) const;
+
+  // Forms the S-pairs of basis element newGen, unless replaying a trace,
+  // and appends the basis elements that newGen makes non-minimal to
+  // toRetire.
+  void addPairsAssumeAutoReduce(size_t newGen, std::vector<size_t>& toRetire);
+
   void autoTailReduce();
 
   void insertReducedPoly(std::unique_ptr<Poly> poly);
@@ -110,6 +156,12 @@ private:
   Reducer& mReducer;
   PolyBasis mBasis;
   SPairs mSPairs;
+
+  // With pipelining, the S-pairs that the reducer has been told will be
+  // reduced in the next step and the negative degree of their lcm's.
+  std::vector<std::pair<size_t, size_t>> mNextSPairGroup;
+  exponent mNextSPairGroupW;
+
   mic::Timer mTimer;
   unsigned long long mSPolyReductionCount;
 };
@@ -122,9 +174,12 @@ ClassicGBAlg::ClassicGBAlg(
   size_t queueType
 ):
   mCallback(nullptr),
+  mTrace(nullptr),
+  mReplayTrace(false),
+  mPipeline(false),
   mBreakAfter(0),
   mPrintInterval(0),
-  mSPairGroupSize(reducer.preferredSetSize()),
+  mSPairGroupSize(0),
   mUseAutoTopReduction(true),
   mUseAutoTailReduction(false),
   mRing(*basis.getPolyRing()),
@@ -136,6 +191,7 @@ ClassicGBAlg::ClassicGBAlg(
     )->make(preferSparseReducers, true)
   ),
   mSPairs(mBasis, preferSparseReducers),
+  mNextSPairGroupW(0),
   mSPolyReductionCount(0)
 {
   // Reduce and insert the generators of the ideal into the starting basis
@@ -147,10 +203,13 @@ ClassicGBAlg::ClassicGBAlg(
 }
 
 void ClassicGBAlg::setSPairGroupSize(unsigned int groupSize) {
-  if (groupSize == 0)
-    groupSize = mReducer.preferredSetSize();
-  else
-    mSPairGroupSize = groupSize;
+  mSPairGroupSize = groupSize;
+}
+
+unsigned int ClassicGBAlg::sPairGroupSize() const {
+  // The preferred set size of a reducer can change as the computation
+  // progresses, so it is asked again at each step.
+  return mSPairGroupSize != 0 ? mSPairGroupSize : mReducer.preferredSetSize();
 }
 
 void ClassicGBAlg::insertPolys(
@@ -168,7 +227,8 @@ void ClassicGBAlg::insertPolys(
       }
 
       mBasis.insert(std::move(*it));
-      mSPairs.addPairs(mBasis.size() - 1);
+      if (!mReplayTrace)
+        mSPairs.addPairs(mBasis.size() - 1);
     }
     polynomials.clear();
     return;
@@ -203,7 +263,7 @@ void ClassicGBAlg::insertPolys(
         };
         mBasis.insert(std::move(*it));
         MATHICGB_ASSERT(toRetire.empty());
-        mSPairs.addPairsAssumeAutoReduce(mBasis.size() - 1, toRetire);
+        addPairsAssumeAutoReduce(mBasis.size() - 1, toRetire);
         for (auto r = toRetire.begin(); r != toRetire.end(); ++r)
           toReduce.push_back(mBasis.retire(*r));
         toRetire.clear();
@@ -224,6 +284,36 @@ void ClassicGBAlg::insertPolys(
   MATHICGB_ASSERT(toReduce.empty());
 }
 
+void ClassicGBAlg::addPairsAssumeAutoReduce(
+  const size_t newGen,
+  std::vector<size_t>& toRetire
+) {
+  if (!mReplayTrace) {
+    mSPairs.addPairsAssumeAutoReduce(newGen, toRetire);
+    return;
+  }
+
+  // A replay takes the S-pairs from the trace, so all that is needed is
+  // the basis elements whose lead terms newGen divides.
+  class RecordIndexes : public MonoLookup::EntryOutput {
+  public:
+    RecordIndexes(size_t newGen, std::vector<size_t>& indexes):
+      mNewGen(newGen), mIndexes(indexes) {}
+
+    virtual bool proceed(size_t index) {
+      if (index != mNewGen)
+        mIndexes.push_back(index);
+      return true;
+    }
+
+  private:
+    const size_t mNewGen;
+    std::vector<size_t>& mIndexes;
+  };
+  RecordIndexes indexes(newGen, toRetire);
+  mBasis.monoLookup().multiples(mBasis.leadMono(newGen), indexes);
+}
+
 void ClassicGBAlg::insertReducedPoly(
   std::unique_ptr<Poly> polyToInsert
 ) {
@@ -250,7 +340,8 @@ void ClassicGBAlg::insertReducedPoly(
   if (!mUseAutoTopReduction) {
     size_t const newGen = mBasis.size();
     mBasis.insert(std::move(polyToInsert));
-    mSPairs.addPairs(newGen);
+    if (!mReplayTrace)
+      mSPairs.addPairs(newGen);
     return;
   }
 
@@ -292,7 +383,7 @@ void ClassicGBAlg::insertReducedPoly(
       // form S-pairs and retire basis elements that become top reducible.
       const size_t newGen = mBasis.size() - 1;
       MATHICGB_ASSERT(toRetireAndReduce.empty());
-      mSPairs.addPairsAssumeAutoReduce(newGen, toRetireAndReduce);
+      addPairsAssumeAutoReduce(newGen, toRetireAndReduce);
       for (std::vector<size_t>::const_iterator it = toRetireAndReduce.begin();
         it != toRetireAndReduce.end(); ++it) {
         toReduce.push_back(0); // allocate space in vector before .release()
@@ -317,11 +408,24 @@ void ClassicGBAlg::computeGrobnerBasis() {
   if (mUseAutoTailReduction)
     autoTailReduce();
 
-  while (!mSPairs.empty()) {
+  if (mReplayTrace && mTrace->varCount() != mRing.varCount())
+    throw F4TraceMismatch("F4 trace is for a different number of variables.");
+  if (mTrace != nullptr && !mReplayTrace)
+    *mTrace = F4Trace(mRing.varCount());
+
+  size_t replayedSteps = 0;
+  while (
+    mReplayTrace ?
+      replayedSteps < mTrace->stepCount() :
+      !mSPairs.empty() || !mNextSPairGroup.empty()
+  ) {
     if (mCallback != nullptr && !mCallback())
       break;
 
-    step();
+    if (mReplayTrace)
+      replayStep(mTrace->step(replayedSteps++));
+    else
+      step();
     if (mBreakAfter != 0 && mBasis.size() > mBreakAfter) {
       std::cerr
         << "Stopping Grobner basis computation due to reaching limit of "
@@ -343,14 +447,78 @@ void ClassicGBAlg::computeGrobnerBasis() {
 }
 
 void ClassicGBAlg::step() {
-  MATHICGB_ASSERT(!mSPairs.empty());
+  MATHICGB_ASSERT(!mSPairs.empty() || !mNextSPairGroup.empty());
   if (tracingLevel > 30)
     std::cerr << "Determining next S-pair" << std::endl;
 
-  MATHICGB_ASSERT(mSPairGroupSize >= 1);
+  const bool pipeline = mPipeline && mTrace == nullptr;
   std::vector<std::pair<size_t, size_t> > spairGroup;
   exponent w = 0;
-  for (unsigned int i = 0; i < mSPairGroupSize; ++i) {
+  if (!mNextSPairGroup.empty()) {
+    spairGroup = std::move(mNextSPairGroup);
+    mNextSPairGroup.clear();
+    w = mNextSPairGroupW;
+
+    // The previous step may have retired basis elements of these S-pairs.
+    // Such S-pairs would have been removed from the queue.
+    const auto retired = [&](const std::pair<size_t, size_t>& p) {
+      return mBasis.retired(p.first) || mBasis.retired(p.second);
+    };
+    spairGroup.erase(
+      std::remove_if(spairGroup.begin(), spairGroup.end(), retired),
+      spairGroup.end()
+    );
+  } else
+    spairGroup = popSPairGroup(w);
+  if (spairGroup.empty())
+    return; // no more s-pairs
+  std::vector<std::unique_ptr<Poly>> reduced;
+
+  // w is the negative of the degree of the lcm's of the chosen spairs
+  MATHICGB_LOG(SPairDegree) <<
+    spairGroup.size() << " pairs in degree " << -w << std::endl;
+
+  if (pipeline) {
+    // The next group is taken before this group is inserted, so it does
+    // not get any S-pairs of this group's polynomials. That changes the
+    // order in which S-pairs are reduced, which is fine for Buchberger's
+    // algorithm.
+    mNextSPairGroup = popSPairGroup(mNextSPairGroupW);
+    mReducer.classicReduceSPolySetPipelined
+      (spairGroup, mNextSPairGroup, mBasis, reduced);
+  } else if (mTrace == nullptr)
+    mReducer.classicReduceSPolySet(spairGroup, mBasis, reduced);
+  else {
+    // Only the useful S-pairs go into the trace.
+    mReducer.classicReduceSPolySetAndFindUseful(spairGroup, mBasis, reduced);
+  }
+  sortReduced(reduced);
+
+  // A step that produces no polynomials leaves the basis unchanged, so it
+  // does not need to be replayed.
+  const bool record = mTrace != nullptr && !reduced.empty();
+  F4Trace::Step traceStep;
+  if (record) {
+    traceStep.sPairs = std::move(spairGroup);
+    traceStep.leads = sortedLeads(reduced);
+  }
+
+  insertPolys(reduced);
+  if (record) {
+    traceStep.basisSize = mBasis.size();
+    mTrace->addStep(std::move(traceStep));
+  }
+  if (mUseAutoTailReduction)
+    autoTailReduce();
+}
+
+auto ClassicGBAlg::popSPairGroup(
+  exponent& w
+) -> std::vector<std::pair<size_t, size_t>> {
+  const auto groupSize = sPairGroupSize();
+  MATHICGB_ASSERT(groupSize >= 1);
+  std::vector<std::pair<size_t, size_t>> spairGroup;
+  for (unsigned int i = 0; i < groupSize; ++i) {
     auto p = mSPairs.pop(w);
     if (p.first == static_cast<size_t>(-1)) {
       MATHICGB_ASSERT(p.second == static_cast<size_t>(-1));
@@ -363,15 +531,52 @@ void ClassicGBAlg::step() {
     
     spairGroup.push_back(p);
   }
-  if (spairGroup.empty())
-    return; // no more s-pairs
+  return spairGroup;
+}
+
+void ClassicGBAlg::replayStep(const F4Trace::Step& step) {
+  const auto isBasisElement = [&](size_t index) {
+    return index < mBasis.size() && !mBasis.retired(index);
+  };
+  for (const auto& spair : step.sPairs) {
+    if (!isBasisElement(spair.first) || !isBasisElement(spair.second))
+      throw F4TraceMismatch("F4 trace has an S-pair of a basis element "
+        "that is not in the basis.");
+  }
+
+  auto spairGroup = step.sPairs;
   std::vector<std::unique_ptr<Poly>> reduced;
+  if (!spairGroup.empty())
+    mReducer.classicReduceSPolySet(spairGroup, mBasis, reduced);
+  if (sortedLeads(reduced) != step.leads)
+    throw F4TraceMismatch("Replayed step gave other lead terms than in the "
+      "F4 trace, so the prime is unlucky.");
+  sortReduced(reduced);
 
-  // w is the negative of the degree of the lcm's of the chosen spairs
-  MATHICGB_LOG(SPairDegree) <<
-    spairGroup.size() << " pairs in degree " << -w << std::endl;
+  insertPolys(reduced);
+  if (mBasis.size() != step.basisSize)
+    throw F4TraceMismatch("Replayed step gave a basis of another size than "
+      "in the F4 trace, so the prime is unlucky.");
+  if (mUseAutoTailReduction)
+    autoTailReduce();
+}
 
-  mReducer.classicReduceSPolySet(spairGroup, mBasis, reduced);
+void ClassicGBAlg::sortReduced(
+  std::vector<std::unique_ptr<Poly>>& reduced
+) const {
+  if (mTrace != nullptr) {
+    // The term counts and coefficients depend on the prime, so order by
+    // lead monomial only. Then a replay gets the same basis indices.
+    const auto& monoid = mRing.monoid();
+    const auto leadOrder = [&](
+      const std::unique_ptr<Poly>& a,
+      const std::unique_ptr<Poly>& b
+    ) {
+      return monoid.lessThan(a->leadMono(), b->leadMono());
+    };
+    std::sort(reduced.begin(), reduced.end(), leadOrder);
+    return;
+  }
 
   // sort the elements to get deterministic behavior. The order will change
   // arbitrarily when running multithreaded. Also, if preferring older
@@ -409,10 +614,17 @@ void ClassicGBAlg::step() {
     return false;
   };
   std::sort(reduced.begin(), reduced.end(), order);
-  
-  insertPolys(reduced);
-  if (mUseAutoTailReduction)
-    autoTailReduce();
+}
+
+auto ClassicGBAlg::sortedLeads(
+  const std::vector<std::unique_ptr<Poly>>& polys
+) const -> std::vector<F4Trace::Exponents> {
+  std::vector<F4Trace::Exponents> leads;
+  for (const auto& poly : polys)
+    if (!poly->isZero())
+      leads.push_back(F4Trace::exponents(mRing.monoid(), poly->leadMono()));
+  std::sort(leads.begin(), leads.end());
+  return leads;
 }
 
 void ClassicGBAlg::autoTailReduce() {
@@ -441,7 +653,11 @@ void ClassicGBAlg::printStats(std::ostream& out) const {
   out << " divisor tab type:   " << mBasis.monoLookup().getName() << '\n';
   out << " S-pair queue type:  " << mSPairs.name() << '\n';
   out << " total compute time: " << mTimer.getMilliseconds()/1000.0 << " seconds " << '\n';
-  out << " S-pair group size:  " << mSPairGroupSize << '\n';
+  out << " S-pair group size:  ";
+  if (mSPairGroupSize == 0)
+    out << "chosen by reducer, now " << mReducer.preferredSetSize() << '\n';
+  else
+    out << mSPairGroupSize << '\n';
 
   mic::ColumnPrinter pr;
   pr.addColumn(true, " ");
@@ -675,6 +891,8 @@ Basis computeGBClassicAlg(
   alg.setUseAutoTopReduction(params.useAutoTopReduction);
   alg.setUseAutoTailReduction(params.useAutoTailReduction);
   alg.setCallback(params.callback);
+  alg.setTrace(params.trace, params.replayTrace);
+  alg.setPipeline(params.pipeline);
 
   alg.computeGrobnerBasis();
   return std::move(*alg.basis().toBasisAndRetireAll());
@@ -9,6 +9,7 @@ MATHICGB_NAMESPACE_BEGIN
 
 class Reducer;
 class Basis;
+class F4Trace;
 
 struct ClassicGBAlgParams {
   Reducer* reducer;
@@ -23,6 +24,18 @@ struct ClassicGBAlgParams {
   bool useAutoTopReduction;
   bool useAutoTailReduction;
   std::function<bool(void)> callback;
+
+  /// If trace is not null, then the computation is recorded into *trace,
+  /// or if replayTrace is true, the computation follows *trace instead of
+  /// choosing S-pairs. A replay throws F4TraceMismatch if the computation
+  /// does not follow the trace, which happens for unlucky primes.
+  F4Trace* trace;
+  bool replayTrace;
+
+  /// If true, then the reducer is told about the next group of S-pairs
+  /// while it reduces the current group, so it can overlap the work on
+  /// the two groups. Ignored when trace is not null.
+  bool pipeline;
 };
 
 Basis computeGBClassicAlg(Basis&& inputBasis, ClassicGBAlgParams params);
@@ -5,6 +5,8 @@
 
 #include "LogDomain.hpp"
 #include "F4MatrixProjection.hpp"
+#include "Atomic.hpp"
+#include "ScopeExit.hpp"
 
 MATHICGB_DEFINE_LOG_DOMAIN(
   F4MatrixBuild2,
@@ -18,6 +20,7 @@ MATHICGB_DEFINE_LOG_DOMAIN(
 
 MATHICGB_NAMESPACE_BEGIN
 
+template<class S>
 class F4MatrixBuilder2::Builder {
 public:
   typedef PolyRing::Field Field;
@@ -29,11 +32,34 @@ public:
   typedef Monoid::MonoPtr MonoPtr;
   typedef Monoid::ConstMonoPtr ConstMonoPtr;
 
+  typedef BasicQuadMatrix<S> QuadMatrix;
+  typedef BasicF4ProtoMatrix<S> ProtoMatrix;
   typedef SparseMatrix::ColIndex ColIndex;
-  typedef SparseMatrix::Scalar Scalar;
+  typedef typename BasicSparseMatrix<S>::Scalar Scalar;
   typedef MonomialMap<ColIndex> Map;
   typedef SparseMatrix::RowIndex RowIndex;
 
+  /// The data that each thread has its own copy of while the rows are
+  /// constructed. The MonoRef's cannot be Mono's since
+  /// enumerable_thread_specific apparently requires the stored data type to
+  /// be copyable and Mono is not copyable.
+  struct ThreadData {
+    MonoRef tmp1;
+    MonoRef tmp2;
+
+    /// Scratch space for createColumn.
+    MonoRef columnTmp;
+
+    ProtoMatrix block;
+
+    /// The columns created by this thread that go to the left.
+    std::vector<ColIndex> leftColumns;
+
+    /// The pin of mMap for the row task that this thread is running, so
+    /// that readers and insertions do not each have to pin mMap.
+    Map::Pin* pin;
+  };
+
   /// Initializes the set of add-this-row tasks.
   void initializeRowsToReduce(std::vector<RowTask>& tasks) {
     // If aF-bG is an S-pair that is added as a bottom row in the matrix, and
@@ -93,12 +119,10 @@ public:
       MATHICGB_ASSERT(ColReader(mMap).find(*tasks[i].desiredLead).first == 0);
 
       // Create column for the lead term that cancels in the S-pair
-      if (mIsColumnToLeft.size() >= std::numeric_limits<ColIndex>::max())
-        throw std::overflow_error("Too many columns in matrix.");
-      const auto newIndex = static_cast<ColIndex>(mIsColumnToLeft.size());
+      const auto newIndex = newColumnIndex();
       const auto inserted =
         mMap.insert(std::make_pair(tasks[i].desiredLead, newIndex));
-      mIsColumnToLeft.push_back(true);
+      mSPairColumns.push_back(newIndex);
       const auto& mono = inserted.first.second;
 
       // Schedule the two parts of the S-pair as separate rows. This adds a row
@@ -135,7 +159,10 @@ public:
     }
   }
 
-  void buildMatrixAndClear(std::vector<RowTask>& tasks, QuadMatrix& quadMatrix) {
+  void buildMatrixAndClear(
+    std::vector<RowTask>& tasks,
+    QuadMatrix& quadMatrix
+  ) {
     MATHICGB_ASSERT(&quadMatrix.ring() == &ring());
     MATHICGB_LOG_TIME(F4MatrixBuild2) <<
       "\n***** Constructing matrix *****\n";
@@ -147,21 +174,16 @@ public:
 
     initializeRowsToReduce(tasks);
 
-    // The MonoRef's cannot be Mono's since enumerable_thread_specific
-    // apparently requires the stored data type to be copyable and
-    // Mono is not copyable.
-    struct ThreadData {
-      MonoRef tmp1;
-      MonoRef tmp2;
-      F4ProtoMatrix block;
-    };
-
     mgb::mtbb::enumerable_thread_specific<ThreadData> threadData([&](){  
       // We need to grab a lock since monoid isn't internally synchronized.
-      mgb::mtbb::mutex::scoped_lock guard(mCreateColumnLock);
+      mgb::mtbb::mutex::scoped_lock guard(mMonoidLock);
       ThreadData data = {
         *monoid().alloc().release(),
-        *monoid().alloc().release()
+        *monoid().alloc().release(),
+        *monoid().alloc().release(),
+        ProtoMatrix(),
+        std::vector<ColIndex>(),
+        nullptr
       };
       return data;
     });
@@ -172,6 +194,10 @@ public:
     {
       auto& data = threadData.local();
       const auto& poly = *task.poly;
+      Map::Pin pin(mMap);
+      auto const outerPin = data.pin;
+      data.pin = &pin;
+      MATHICGB_SCOPE_EXIT(pinGuard) {data.pin = outerPin;};
 
       // It is perfectly permissible for task.sPairPoly to be non-null. The
       // assert is there because of an interaction between S-pair
@@ -191,14 +217,14 @@ public:
           data.tmp1
         );
         appendRowSPair
-          (poly, data.tmp1, *task.sPairPoly, data.tmp2, data.block, feeder);
+          (poly, data.tmp1, *task.sPairPoly, data.tmp2, data, feeder);
         return;
       }
       if (task.desiredLead == nullptr)
         monoid().setIdentity(data.tmp1);
       else
         monoid().divide(poly.leadMono(), *task.desiredLead, data.tmp1);
-      appendRow(data.tmp1, *task.poly, data.block, feeder);
+      appendRow(data.tmp1, *task.poly, data, feeder);
     });
     MATHICGB_ASSERT(!threadData.empty()); // as tasks empty causes early return
 
@@ -208,13 +234,20 @@ public:
         monoid().freeRaw(*task.desiredLead.castAwayConst());
     tasks.clear();
 
-    // Move the proto-matrices across all threads into the projection.
-    F4MatrixProjection projection
-      (ring(), static_cast<ColIndex>(mMap.entryCount()));
-    const auto end = threadData.end();
+    // Move the proto-matrices across all threads into the projection. There
+    // can be unused column indices, so the column count is the number of
+    // indices handed out rather than the number of entries in mMap.
+    const auto colCount = mColumnCount.load();
+    F4MatrixProjection<S> projection(ring(), colCount);
+    mIsColumnToLeft.assign(colCount, false);
+    for (const auto col : mSPairColumns)
+      mIsColumnToLeft[col] = true;
     for (auto& data : threadData) {
       monoid().freeRaw(data.tmp1);
       monoid().freeRaw(data.tmp2);
+      monoid().freeRaw(data.columnTmp);
+      for (const auto col : data.leftColumns)
+        mIsColumnToLeft[col] = true;
       projection.addProtoMatrix(std::move(data.block));
     }
 
@@ -271,7 +304,7 @@ public:
 
     Builder(const PolyBasis& basis, const size_t memoryQuantum):
     mMemoryQuantum(memoryQuantum),
-    mTmp(basis.ring().monoid().alloc()),
+    mColumnCount(0),
     mBasis(basis),
     mMap(basis.ring())
   {
@@ -289,49 +322,70 @@ public:
 
   typedef mgb::mtbb::parallel_do_feeder<RowTask> TaskFeeder;
 
+  /// Returns a column index that has not been handed out before. This can
+  /// be called by several threads at the same time. An index goes unused
+  /// if the thread that got it loses a race to create a column, so the
+  /// indices of the columns need not be contiguous.
+  ColIndex newColumnIndex() {
+    const auto index = mColumnCount.fetch_add(1, std::memory_order_relaxed);
+    if (index >= std::numeric_limits<ColIndex>::max())
+      throw std::overflow_error("Too many columns in QuadMatrix");
+    return index;
+  }
+
   /// Creates a column with monomial label monoA * monoB and schedules a new
   /// row to reduce that column if possible. If such a column already
   /// exists, then a new column is not inserted. In either case, returns
   /// the column index and column monomial corresponding to monoA * monoB.
   ///
-  /// createColumn can be used simply to search for an existing column, but
-  /// since createColumn incurs locking overhead, this is not a good idea.
-  /// Note that createColumn has to work correctly for pre-existing columns
-  /// because the only way to be *certain* that no other thread has inserted
-  /// the column of interest is to grab a lock, and the lock being grabbed
-  /// is being grabbed inside createColumn.
+  /// Only the reducer lookup takes a lock. If several threads create the
+  /// same column at the same time, then the insertion into mMap succeeds
+  /// for exactly one of them and only that thread schedules a row for the
+  /// column. Still,
+  /// createColumn does more work than a lookup, so do not use it to search
+  /// for an existing column.
   MATHICGB_NO_INLINE
   std::pair<ColIndex, ConstMonoRef> createColumn(
     ConstMonoRef monoA,
     ConstMonoRef monoB,
+    ThreadData& data,
     TaskFeeder& feeder
   ) {
-    mgb::mtbb::mutex::scoped_lock lock(mCreateColumnLock);
-    // see if the column exists now after we have synchronized
+    // see if the column exists now with an up to date reader
     {
-      const auto found(ColReader(mMap).findProduct(monoA, monoB));
+      const auto found(ColReader(*data.pin).findProduct(monoA, monoB));
       if (found.first != 0)
         return std::make_pair(*found.first, *found.second);
     }
 
-    // The column really does not exist, so we need to create it
-    monoid().multiply(monoA, monoB, mTmp);
-    if (!monoid().hasAmpleCapacity(*mTmp))
+    // The column does not exist, so we need to create it
+    monoid().multiply(monoA, monoB, data.columnTmp);
+    if (!monoid().hasAmpleCapacity(data.columnTmp))
       mathic::reportError("Monomial exponent overflow in F4MatrixBuilder2.");
 
-    // look for a reducer of mTmp
-    const size_t reducerIndex = mBasis.classicReducer(*mTmp);
+    // look for a reducer of the column monomial. The basis does not change
+    // while the matrix is built, but the divisor lookup of the basis gives
+    // no guarantee that concurrent queries are safe.
+    size_t reducerIndex;
+    {
+      mgb::mtbb::mutex::scoped_lock guard(mReducerLookupLock);
+      reducerIndex = mBasis.classicReducer(data.columnTmp);
+    }
     const bool insertLeft = (reducerIndex != static_cast<size_t>(-1));
 
     // Create the new left or right column
-    if (mIsColumnToLeft.size() >= std::numeric_limits<ColIndex>::max())
-      throw std::overflow_error("Too many columns in QuadMatrix");
-    const auto newIndex = static_cast<ColIndex>(mIsColumnToLeft.size());
-    const auto inserted = mMap.insert(std::make_pair(mTmp.ptr(), newIndex));
-    mIsColumnToLeft.push_back(insertLeft);
+    const auto newIndex = newColumnIndex();
+    const auto inserted =
+      mMap.insert(std::make_pair(data.columnTmp.ptr(), newIndex), *data.pin);
+    if (!inserted.second) {
+      // Another thread created the column first and it has also scheduled
+      // the row for the column if there is a reducer.
+      return std::make_pair(*inserted.first.first, *inserted.first.second);
+    }
 
     // schedule new task if we found a reducer
     if (insertLeft) {
+      data.leftColumns.push_back(newIndex);
       RowTask task = {};
       task.poly = &mBasis.poly(reducerIndex);
       task.desiredLead = inserted.first.second;
@@ -342,24 +396,25 @@ public:
   }
 
 
-  /// Append multiple * poly to block, creating new columns as necessary.
+  /// Append multiple * poly to data.block, creating new columns as
+  /// necessary.
   void appendRow(
     ConstMonoRef multiple,
     const Poly& poly,
-    F4ProtoMatrix& block,
+    ThreadData& data,
     TaskFeeder& feeder
   ) {
     const auto begin = poly.begin();
     const auto end = poly.end();
     const auto count = poly.termCount();
     MATHICGB_ASSERT(count < std::numeric_limits<ColIndex>::max());
-    auto indices = block.makeRowWithTheseScalars(poly);
+    auto indices = data.block.makeRowWithTheseScalars(poly);
 
     auto it = begin;
     if ((count % 2) == 1) {
-      ColReader reader(mMap);
+      ColReader reader(*data.pin);
       const auto col = findOrCreateColumn
-        (it.mono(), multiple, reader, feeder);
+        (it.mono(), multiple, reader, data, feeder);
 	  MATHICGB_ASSERT(it.coef() < std::numeric_limits<Scalar>::max());
       MATHICGB_ASSERT(!field().isZero(it.coef()));
       *indices = col.first;
@@ -367,7 +422,7 @@ public:
       ++it;
     }
   updateReader:
-    ColReader colMap(mMap);
+    ColReader colMap(*data.pin);
     while (it != end) {
 	  MATHICGB_ASSERT(it.coef() < std::numeric_limits<Scalar>::max());
       MATHICGB_ASSERT(!field().isZero(it.coef()));
@@ -383,8 +438,8 @@ public:
 
       const auto colPair = colMap.findTwoProducts(mono1, mono2, multiple);
       if (colPair.first == 0 || colPair.second == 0) {
-        createColumn(mono1, multiple, feeder);
-        createColumn(mono2, multiple, feeder);
+        createColumn(mono1, multiple, data, feeder);
+        createColumn(mono2, multiple, data, feeder);
         goto updateReader;
       }
 
@@ -397,16 +452,17 @@ public:
     }
   }
 
-  /// Append poly*multiply - sPairPoly*sPairMultiply to block, creating new
-  /// columns as necessary.
+  /// Append poly*multiply - sPairPoly*sPairMultiply to data.block, creating
+  /// new columns as necessary.
   void appendRowSPair(
     const Poly& poly,
     ConstMonoRef multiply,
     const Poly& sPairPoly,
     ConstMonoRef sPairMultiply,
-    F4ProtoMatrix& block,
+    ThreadData& data,
     TaskFeeder& feeder
   ) {
+    auto& block = data.block;
     MATHICGB_ASSERT(!poly.isZero());
     auto itA = poly.begin();
     const auto endA = poly.end();
@@ -428,15 +484,15 @@ public:
     auto row = block.makeRow(maxCols);
     const auto indicesBegin = row.first;
 
-    const ColReader colMap(mMap);
+    const ColReader colMap(*data.pin);
 
     auto mulA = multiply;
     auto mulB = sPairMultiply;
     while (itB != endB && itA != endA) {
       const auto colA = findOrCreateColumn
-        (itA.mono(), mulA, colMap, feeder);
+        (itA.mono(), mulA, colMap, data, feeder);
       const auto colB = findOrCreateColumn
-        (itB.mono(), mulB, colMap, feeder);
+        (itB.mono(), mulB, colMap, data, feeder);
       const auto cmp = monoid().compare(colA.second, colB.second);
 
       coefficient coeff = 0;
@@ -460,14 +516,14 @@ public:
 
     for (; itA != endA; ++itA) {
       const auto colA = findOrCreateColumn
-        (itA.mono(), mulA, colMap, feeder);
+        (itA.mono(), mulA, colMap, data, feeder);
       *row.first++ = colA.first;
       *row.second++ = static_cast<Scalar>(itA.coef());
     }
 
     for (; itB != endB; ++itB) {
       const auto colB = findOrCreateColumn
-        (itB.mono(), mulB, colMap, feeder);
+        (itB.mono(), mulB, colMap, data, feeder);
       const auto negative = ring().coefficientNegate(itB.coef());
       *row.first = colB.first;
       ++row.first;
@@ -481,18 +537,18 @@ public:
   }
 
   /// As createColumn, except with much better performance in the common
-  /// case that the column for monoA * monoB already exists. In particular,
-  /// no lock is grabbed in that case.
+  /// case that the column for monoA * monoB already exists.
   MATHICGB_NO_INLINE
   std::pair<ColIndex, ConstMonoRef> findOrCreateColumn(
     ConstMonoRef monoA,
     ConstMonoRef monoB,
+    ThreadData& data,
     TaskFeeder& feeder
   ) {
-    const auto col = ColReader(mMap).findProduct(monoA, monoB);
+    const auto col = ColReader(*data.pin).findProduct(monoA, monoB);
     if (col.first != 0)
       return std::make_pair(*col.first, *col.second);
-    return createColumn(monoA, monoB, feeder);
+    return createColumn(monoA, monoB, data, feeder);
   }
 
   /// As the overload that does not take a ColReader parameter, except with
@@ -503,12 +559,13 @@ public:
     ConstMonoRef monoA,
     ConstMonoRef monoB,
     const ColReader& colMap,
+    ThreadData& data,
     TaskFeeder& feeder
   ) {
     const auto col = colMap.findProduct(monoA, monoB);
     if (col.first == 0) {
       // The reader may be out of date, so try again with a fresh reader.
-      return findOrCreateColumn(monoA, monoB, feeder);
+      return findOrCreateColumn(monoA, monoB, data, feeder);
     }
     return std::make_pair(*col.first, *col.second);
   }
@@ -517,18 +574,25 @@ public:
   /// has been constructed. This vector keeps track of which side each column
   /// should go to once we do the split. char is used in place of bool because
   /// the specialized bool would just be slower for this use case. See
-  /// http://isocpp.org/blog/2012/11/on-vectorbool .
+  /// http://isocpp.org/blog/2012/11/on-vectorbool . It is set up from
+  /// mSPairColumns and ThreadData::leftColumns once all rows are made.
   std::vector<char> mIsColumnToLeft;
 
+  /// The columns for the lead monomials of the S-pairs. These go to the left.
+  std::vector<ColIndex> mSPairColumns;
+
   /// How much memory to allocate every time more memory is needed.
   const size_t mMemoryQuantum;
 
-  /// If you want to modify the columns, you need to grab this lock first.
-  mgb::mtbb::mutex mCreateColumnLock;
+  /// The number of column indices handed out by newColumnIndex.
+  Atomic<ColIndex> mColumnCount;
 
-  /// A monomial for temporary scratch calculations. Protected by
-  /// mCreateColumnLock.
-  Mono mTmp;
+  /// Grab this lock to allocate from the monoid, which is not internally
+  /// synchronized.
+  mgb::mtbb::mutex mMonoidLock;
+
+  /// Grab this lock to look for a reducer in mBasis.
+  mgb::mtbb::mutex mReducerLookupLock;
 
   /// Mapping from monomials to column indices.
   Map mMap;
@@ -582,9 +646,14 @@ void F4MatrixBuilder2::addPolynomialToMatrix(
   mTodo.push_back(task);
 }
 
-void F4MatrixBuilder2::buildMatrixAndClear(QuadMatrix& quadMatrix) {
-  Builder builder(mBasis, mMemoryQuantum);
+template<class S>
+void F4MatrixBuilder2::buildMatrixAndClear(BasicQuadMatrix<S>& quadMatrix) {
+  Builder<S> builder(mBasis, mMemoryQuantum);
   builder.buildMatrixAndClear(mTodo, quadMatrix);
 }
 
+template void F4MatrixBuilder2::buildMatrixAndClear(BasicQuadMatrix<uint8>&);
+template void F4MatrixBuilder2::buildMatrixAndClear(BasicQuadMatrix<uint16>&);
+template void F4MatrixBuilder2::buildMatrixAndClear(BasicQuadMatrix<uint32>&);
+
 MATHICGB_NAMESPACE_END
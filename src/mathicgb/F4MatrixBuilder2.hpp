@@ -71,7 +71,11 @@ public:
   /// that exactly correspond to the polynomials that have been scheduled to
   /// be added to the matrix. It is only guaranteed that the whole matrix has
   /// the same row-space as though that had been the case.
-  void buildMatrixAndClear(QuadMatrix& matrix);
+  ///
+  /// The scalar type S must be able to hold every residue modulo the
+  /// characteristic. Instantiated for uint8, uint16 and uint32.
+  template<class S>
+  void buildMatrixAndClear(BasicQuadMatrix<S>& matrix);
 
   const PolyRing& ring() const {return mBasis.ring();}
   const Monoid& monoid() const {return ring().monoid();}
@@ -89,6 +93,7 @@ private:
     const Poly* sPairPoly;
   };
 
+  template<class S>
   class Builder;
 
   /// How much memory to allocate every time more memory is needed.
@@ -7,7 +7,8 @@
 
 MATHICGB_NAMESPACE_BEGIN
 
-F4MatrixProjection::F4MatrixProjection(
+template<class S>
+F4MatrixProjection<S>::F4MatrixProjection(
   const PolyRing& ring,
   ColIndex colCount
 ):
@@ -15,7 +16,8 @@ F4MatrixProjection::F4MatrixProjection(
   mColProjectTo(colCount)
 {}
 
-void F4MatrixProjection::addColumn(
+template<class S>
+void F4MatrixProjection<S>::addColumn(
   const ColIndex projectFrom,
   ConstMonoRef mono,
   const bool isLeft
@@ -48,8 +50,9 @@ struct RowData : F4ProtoMatrix::Row {
 typedef std::pair<RowData, SparseMatrix::Scalar> RowProjectFrom;
 
 
+template<class S>
 template<class Row>
-class F4MatrixProjection::TopBottom {
+class F4MatrixProjection<S>::TopBottom {
 public:
   typedef std::pair<Row, Scalar> RowMultiple;
   typedef std::vector<RowMultiple> RowVector;
@@ -112,10 +115,11 @@ private:
   RowVector mBottomRows;
 };
 
-class F4MatrixProjection::LeftRight {
+template<class S>
+class F4MatrixProjection<S>::LeftRight {
 public:
-  typedef F4ProtoMatrix::ExternalScalar ExternalScalar;
-  typedef F4ProtoMatrix::Row Row;
+  typedef typename ProtoMatrix::ExternalScalar ExternalScalar;
+  typedef typename ProtoMatrix::Row Row;
 
   LeftRight(
     const std::vector<ColProjectTo>& colProjectTo,
@@ -139,12 +143,12 @@ public:
       appendRow(it->first, it->second);
   }
 
-  void appendRows(const std::vector<F4ProtoMatrix*>& preBlocks) {
+  void appendRows(const std::vector<ProtoMatrix*>& preBlocks) {
     const auto end = preBlocks.end();
     for (auto it = preBlocks.begin(); it != end; ++it) {
       auto& block = **it;
       const auto rowCount = block.rowCount();
-      for (SparseMatrix::RowIndex r = 0; r < rowCount; ++r) {
+      for (RowIndex r = 0; r < rowCount; ++r) {
         const auto row = block.row(r);
         if (row.entryCount > 0)
           appendRow(row);
@@ -205,30 +209,36 @@ public:
     mRight.rowDone();
   };
 
-  const SparseMatrix& left() const {return mLeft;}
-  const SparseMatrix& right() const {return mRight;}
+  const Matrix& left() const {return mLeft;}
+  const Matrix& right() const {return mRight;}
 
-  SparseMatrix moveLeft() {return std::move(mLeft);}
-  SparseMatrix moveRight() {return std::move(mRight);}
+  Matrix moveLeft() {return std::move(mLeft);}
+  Matrix moveRight() {return std::move(mRight);}
 
 private:
   const std::vector<ColProjectTo>& mColProjectTo;
   const Scalar mModulus;
 
-  SparseMatrix mLeft;
-  SparseMatrix mRight;
+  Matrix mLeft;
+  Matrix mRight;
 };
 
-QuadMatrix F4MatrixProjection::makeAndClear(const size_t quantum) {
+template<class S>
+auto F4MatrixProjection<S>::makeAndClear(
+  const size_t quantum
+) -> QuadMatrix {
   if (true)
     return makeAndClearOneStep(quantum);
   else
     return makeAndClearTwoStep(quantum);
 }
 
-QuadMatrix F4MatrixProjection::makeAndClearOneStep(const size_t quantum) {
+template<class S>
+auto F4MatrixProjection<S>::makeAndClearOneStep(
+  const size_t quantum
+) -> QuadMatrix {
   // Construct top/bottom row permutation
-   TopBottom<F4ProtoMatrix::Row> tb(mLeftMonomials.size(), ring());
+  TopBottom<typename ProtoMatrix::Row> tb(mLeftMonomials.size(), ring());
   const auto end = mMatrices.end();
   for (auto it = mMatrices.begin(); it != end; ++it) {
     const auto& matrix = **it;
@@ -258,6 +268,13 @@ done:;
   }
   MATHICGB_ASSERT(tb.debugAssertValid());
 
+  // Record what polynomial each row is a multiple of
+  QuadMatrix qm(ring());
+  for (const auto& row : tb.top())
+    qm.topRowSources.push_back(row.first.source);
+  for (const auto& row : tb.bottom())
+    qm.bottomRowSources.push_back(row.first.source);
+
   // Split left/right and top/bottom simultaneously
   LeftRight top(mColProjectTo, ring(), quantum);
   top.appendRowsPermuted(tb.moveTop());
@@ -266,7 +283,6 @@ done:;
   bottom.appendRowsPermuted(tb.moveBottom());
 
   // Move the data into place
-  QuadMatrix qm(ring());
   qm.leftColumnMonomials = std::move(mLeftMonomials);
   qm.rightColumnMonomials = std::move(mRightMonomials);
 
@@ -280,29 +296,28 @@ done:;
 
 namespace {
   // Helper function for F4MatrixProjection::makeAndClearTwoStep
-  template<class TopBottom>
-  std::pair<SparseMatrix, SparseMatrix> projectRows(
+  template<class TopBottom, class Matrix>
+  std::pair<Matrix, Matrix> projectRows(
     const TopBottom& tb,
     size_t quantum,
-    SparseMatrix&& in
+    Matrix&& in
   ) {
+    typedef typename Matrix::RowIndex RowIndex;
     const auto modulus = tb.modulus();
 
-    SparseMatrix top(quantum);
+    Matrix top(quantum);
     const auto topRows = tb.top();
-    const auto rowCountTop =
-      static_cast<SparseMatrix::RowIndex>(topRows.size());
-    for (SparseMatrix::RowIndex toRow = 0; toRow < rowCountTop; ++toRow) {
+    const auto rowCountTop = static_cast<RowIndex>(topRows.size());
+    for (RowIndex toRow = 0; toRow < rowCountTop; ++toRow) {
       top.appendRow(in, topRows[toRow].first.index);
       if (topRows[toRow].second != 1)
         top.multiplyRow(toRow, topRows[toRow].second, modulus);
     }
 
-    SparseMatrix bottom(quantum);
+    Matrix bottom(quantum);
     const auto bottomRows = tb.bottom();
-    const auto rowCountBottom =
-      static_cast<SparseMatrix::RowIndex>(bottomRows.size());
-    for (SparseMatrix::RowIndex toRow = 0; toRow < rowCountBottom; ++toRow) {
+    const auto rowCountBottom = static_cast<RowIndex>(bottomRows.size());
+    for (RowIndex toRow = 0; toRow < rowCountBottom; ++toRow) {
       bottom.appendRow(in, bottomRows[toRow].first.index);
       if (bottomRows[toRow].second != 1)
           bottom.multiplyRow(toRow, bottomRows[toRow].second, modulus);
@@ -313,7 +328,10 @@ namespace {
   }
 }
 
-QuadMatrix F4MatrixProjection::makeAndClearTwoStep(const size_t quantum) {
+template<class S>
+auto F4MatrixProjection<S>::makeAndClearTwoStep(
+  const size_t quantum
+) -> QuadMatrix {
   // Split whole matrix into left/right
   LeftRight lr(mColProjectTo, ring(), quantum);
   lr.appendRows(mMatrices);
@@ -325,7 +343,7 @@ QuadMatrix F4MatrixProjection::makeAndClearTwoStep(const size_t quantum) {
   };
   TopBottom<Row> tb(mLeftMonomials.size(), ring());
   const auto rowCount = lr.left().rowCount();
-  for (SparseMatrix::RowIndex row = 0; row < rowCount; ++row) {
+  for (RowIndex row = 0; row < rowCount; ++row) {
     const auto leftEntryCount = lr.left().entryCountInRow(row);
     const auto entryCount = leftEntryCount + lr.right().entryCountInRow(row);
     MATHICGB_ASSERT(entryCount >= leftEntryCount); // no overflow
@@ -355,4 +373,8 @@ QuadMatrix F4MatrixProjection::makeAndClearTwoStep(const size_t quantum) {
   return std::move(qm);
 }
 
+template class F4MatrixProjection<uint8>;
+template class F4MatrixProjection<uint16>;
+template class F4MatrixProjection<uint32>;
+
 MATHICGB_NAMESPACE_END
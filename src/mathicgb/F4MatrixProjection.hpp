@@ -12,6 +12,9 @@
 
 MATHICGB_NAMESPACE_BEGIN
 
+/// Splits the rows of a set of F4ProtoMatrix blocks into the four parts of
+/// a QuadMatrix. The scalars have type S, as for BasicSparseMatrix.
+template<class S>
 class F4MatrixProjection {
 public:
   typedef PolyRing::Monoid Monoid;
@@ -21,13 +24,16 @@ public:
   typedef Monoid::MonoPtr MonoPtr;
   typedef Monoid::ConstMonoPtr ConstMonoPtr;
 
-  typedef SparseMatrix::RowIndex RowIndex;
-  typedef SparseMatrix::ColIndex ColIndex;
-  typedef SparseMatrix::Scalar Scalar;
+  typedef BasicSparseMatrix<S> Matrix;
+  typedef BasicQuadMatrix<S> QuadMatrix;
+  typedef BasicF4ProtoMatrix<S> ProtoMatrix;
+  typedef typename Matrix::RowIndex RowIndex;
+  typedef typename Matrix::ColIndex ColIndex;
+  typedef typename Matrix::Scalar Scalar;
 
   F4MatrixProjection(const PolyRing& ring, ColIndex colCount);
 
-  void addProtoMatrix(F4ProtoMatrix&& matrix) {mMatrices.push_back(&matrix);}
+  void addProtoMatrix(ProtoMatrix&& matrix) {mMatrices.push_back(&matrix);}
 
   // No reference to mono is retained.
   void addColumn(ColIndex index, ConstMonoRef mono, const bool isLeft);
@@ -54,12 +60,16 @@ private:
   };
   std::vector<ColProjectTo> mColProjectTo;
 
-  std::vector<F4ProtoMatrix*> mMatrices;
+  std::vector<ProtoMatrix*> mMatrices;
   std::vector<ConstMonoPtr> mLeftMonomials;
   std::vector<ConstMonoPtr> mRightMonomials;
   const PolyRing& mRing;
 };
 
+extern template class F4MatrixProjection<uint8>;
+extern template class F4MatrixProjection<uint16>;
+extern template class F4MatrixProjection<uint32>;
+
 MATHICGB_NAMESPACE_END
 
 #endif
@@ -9,13 +9,19 @@
 #include "LogDomain.hpp"
 #include "mtbb.hpp"
 #include <algorithm>
+#include <functional>
 #include <vector>
 #include <stdexcept>
 #include <map>  
 #include <string>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 
+#ifdef MATHICGB_USE_SIMD_X86
+#include <immintrin.h>
+#endif
+
 MATHICGB_DEFINE_LOG_DOMAIN(
   F4MatrixReduce,
   "Displays statistics about matrices that are row reduced."
@@ -34,44 +40,287 @@ MATHICGB_DEFINE_LOG_DOMAIN(
 MATHICGB_NAMESPACE_BEGIN
 
 namespace {
-  class DenseRow {
+  /// A kernel that performs
+  ///   entries[indices[i]] += scalars[i] * multiple
+  /// for i in [0, count) with 64 bit products and sums. The indices must be
+  /// distinct, which they are for the entries of a row in a SparseMatrix.
+  /// The caller has to make sure that the sums cannot overflow.
+  template<class Scalar>
+  struct RowKernel {
+    typedef void (*AddRowMultiple)(
+      uint64* entries,
+      Scalar multiple,
+      const SparseMatrix::ColIndex* indices,
+      const Scalar* scalars,
+      size_t count
+    );
+
+    const char* name;
+    AddRowMultiple addRowMultiple;
+  };
+
+  template<class Scalar>
+  void addRowMultipleScalar(
+    uint64* const MATHICGB_RESTRICT entries,
+    const Scalar multiple,
+    const SparseMatrix::ColIndex* const indices,
+    const Scalar* const scalars,
+    const size_t count
+  ) {
+    const uint64 m = multiple;
+    // I have a matrix reduction that goes from 2.601s to 2.480s on MSVC 2012
+    // by unrolling this loop manually. Unrolling more than once was not a
+    // benefit. So don't undo the unrolling unless you think it's worth a 5%
+    // slowdown of matrix reduction (the whole computation, not just this
+    // method).
+    size_t i = 0;
+    if (count % 2 == 1) {
+      // Replacing this by a goto into the middle of the following loop
+      // (similar to Duff's device) made the code slower on MSVC 2012.
+      entries[indices[i]] += scalars[i] * m;
+      ++i;
+    }
+    for (; i != count; i += 2) {
+      entries[indices[i]] += scalars[i] * m;
+      entries[indices[i + 1]] += scalars[i + 1] * m;
+    }
+  }
+
+  /// As addRowMultipleScalar, but each product is reduced modulo modulus
+  /// before it is added, so each entry grows by less than the modulus. This
+  /// is for when the unreduced products could overflow the entries.
+  template<class Scalar>
+  void addRowMultipleReduced(
+    uint64* const MATHICGB_RESTRICT entries,
+    const Scalar multiple,
+    const SparseMatrix::ColIndex* const indices,
+    const Scalar* const scalars,
+    const size_t count,
+    const BarrettModulus<Scalar>& modulus
+  ) {
+    for (size_t i = 0; i != count; ++i)
+      entries[indices[i]] += modulus.product(scalars[i], multiple);
+  }
+
+#ifdef MATHICGB_USE_SIMD_X86
+  // The gathers take signed 32 bit indices and zero-extend the scalars.
+  // DenseRow only uses these kernels if every column index fits in an int32.
+  // The multiplications take the low 32 bits of each 64 bit lane, which is
+  // all of a scalar.
+  static_assert(sizeof(SparseMatrix::ColIndex) == 4, "");
+
+  MATHICGB_TARGET("avx2")
+  inline __m256i loadFourScalars(const uint8* const scalars) {
+    int32 bytes;
+    std::memcpy(&bytes, scalars, sizeof(bytes));
+    return _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(bytes));
+  }
+
+  MATHICGB_TARGET("avx2")
+  inline __m256i loadFourScalars(const uint16* const scalars) {
+    return _mm256_cvtepu16_epi64
+      (_mm_loadl_epi64(reinterpret_cast<const __m128i*>(scalars)));
+  }
+
+  MATHICGB_TARGET("avx2")
+  inline __m256i loadFourScalars(const uint32* const scalars) {
+    return _mm256_cvtepu32_epi64
+      (_mm_loadu_si128(reinterpret_cast<const __m128i*>(scalars)));
+  }
+
+  MATHICGB_TARGET("avx512f")
+  inline __m512i loadEightScalars(const uint8* const scalars) {
+    return _mm512_cvtepu8_epi64
+      (_mm_loadl_epi64(reinterpret_cast<const __m128i*>(scalars)));
+  }
+
+  MATHICGB_TARGET("avx512f")
+  inline __m512i loadEightScalars(const uint16* const scalars) {
+    return _mm512_cvtepu16_epi64
+      (_mm_loadu_si128(reinterpret_cast<const __m128i*>(scalars)));
+  }
+
+  MATHICGB_TARGET("avx512f")
+  inline __m512i loadEightScalars(const uint32* const scalars) {
+    return _mm512_cvtepu32_epi64
+      (_mm256_loadu_si256(reinterpret_cast<const __m256i*>(scalars)));
+  }
+
+  /// AVX2 has a gather but no scatter, so we gather 4 accumulators at a
+  /// time, do the multiply-add in vector registers and then write the 4
+  /// sums back one at a time.
+  template<class Scalar>
+  MATHICGB_TARGET("avx2")
+  void addRowMultipleAvx2(
+    uint64* const MATHICGB_RESTRICT entries,
+    const Scalar multiple,
+    const SparseMatrix::ColIndex* const indices,
+    const Scalar* const scalars,
+    const size_t count
+  ) {
+    const auto base = reinterpret_cast<const long long*>(entries);
+    const __m256i m = _mm256_set1_epi64x(multiple);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      const __m128i index =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + i));
+      const __m256i sum = _mm256_add_epi64(
+        _mm256_i32gather_epi64(base, index, 8),
+        _mm256_mul_epu32(loadFourScalars(scalars + i), m)
+      );
+      entries[indices[i]] = _mm256_extract_epi64(sum, 0);
+      entries[indices[i + 1]] = _mm256_extract_epi64(sum, 1);
+      entries[indices[i + 2]] = _mm256_extract_epi64(sum, 2);
+      entries[indices[i + 3]] = _mm256_extract_epi64(sum, 3);
+    }
+    addRowMultipleScalar
+      (entries, multiple, indices + i, scalars + i, count - i);
+  }
+
+  /// AVX-512 has both gather and scatter, so 8 entries are updated at a time
+  /// without leaving the vector registers.
+  template<class Scalar>
+  MATHICGB_TARGET("avx512f")
+  void addRowMultipleAvx512(
+    uint64* const MATHICGB_RESTRICT entries,
+    const Scalar multiple,
+    const SparseMatrix::ColIndex* const indices,
+    const Scalar* const scalars,
+    const size_t count
+  ) {
+    const __m512i m = _mm512_set1_epi64(multiple);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+      const __m256i index =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + i));
+      const __m512i sum = _mm512_add_epi64(
+        _mm512_i32gather_epi64(index, entries, 8),
+        _mm512_mul_epu32(loadEightScalars(scalars + i), m)
+      );
+      _mm512_i32scatter_epi64(entries, index, sum, 8);
+    }
+    addRowMultipleScalar
+      (entries, multiple, indices + i, scalars + i, count - i);
+  }
+
+  template<class Scalar>
+  RowKernel<Scalar> selectSimdRowKernel() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+      const RowKernel<Scalar> kernel =
+        {"AVX-512", &addRowMultipleAvx512<Scalar>};
+      return kernel;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+      const RowKernel<Scalar> kernel = {"AVX2", &addRowMultipleAvx2<Scalar>};
+      return kernel;
+    }
+    const RowKernel<Scalar> kernel = {"scalar", &addRowMultipleScalar<Scalar>};
+    return kernel;
+  }
+#endif
+
+  template<class Scalar>
+  RowKernel<Scalar> selectRowKernel() {
+#ifdef MATHICGB_USE_SIMD_X86
+    return selectSimdRowKernel<Scalar>();
+#else
+    const RowKernel<Scalar> kernel = {"scalar", &addRowMultipleScalar<Scalar>};
+    return kernel;
+#endif
+  }
+
+  /// The row update kernel for the scalar type chosen for the CPU that we
+  /// are running on.
+  template<class Scalar>
+  const RowKernel<Scalar>& rowKernel() {
+    static const RowKernel<Scalar> kernel = selectRowKernel<Scalar>();
+    return kernel;
+  }
+
+  /// The number of rows that the parallel sparse reduction reduces
+  /// concurrently before resolving conflicts between them.
+  const SparseMatrix::RowIndex ParallelSparseBatchSize = 256;
+
+  /// The number of right columns in each block of the Faugere-Lachartre
+  /// reduction. The dense accumulator for a block then takes 64 KB.
+  const size_t FLColBlockWidth = 8 * 1024;
+
+  /// Keeps track of an upper bound on the unreduced entries of a row so
+  /// that the modulus only has to be taken when adding more to the entries
+  /// could overflow them. Also keeps the Barrett reduction for the modulus
+  /// of the row, which is computed again only if the modulus changes.
+  template<class S>
+  class EntryBound {
   public:
-    typedef uint16 Scalar;
-    typedef uint32 ScalarProduct;
+    typedef S Scalar;
     typedef uint64 ScalarProductSum;
 
-    static ScalarProduct product(const Scalar a, const Scalar b) {
-      return static_cast<ScalarProduct>(a) * b;
-    }
+    EntryBound(): mBound(0) {}
 
-    static void multiplyAdd(
-      const Scalar a,
-      const Scalar b,
-      ScalarProductSum& x
-    ) {
-      x += product(a, b);
+    /// Returns the Barrett reduction for modulus.
+    const BarrettModulus<Scalar>& barrett(const Scalar modulus) {
+      if (mBarrett.modulus() != modulus)
+        mBarrett = BarrettModulus<Scalar>(modulus);
+      return mBarrett;
     }
 
-    static void add(const Scalar a, ScalarProductSum& sum) {
-      sum += a;
+    /// Returns the Barrett reduction for the modulus most recently passed
+    /// to barrett().
+    const BarrettModulus<Scalar>& lastBarrett() const {return mBarrett;}
+
+    /// Records that every entry is now zero.
+    void setZero() {mBound = 0;}
+
+    /// Records that every entry is now reduced modulo modulus.
+    void setReduced(const Scalar modulus) {mBound = modulus - 1;}
+
+    /// Returns true if every entry can have another value of at most
+    /// increase added to it without overflowing. If so, records that this
+    /// has happened.
+    bool tryIncrease(const ScalarProductSum increase) {
+      if (increase > std::numeric_limits<ScalarProductSum>::max() - mBound)
+        return false;
+      mBound += increase;
+      return true;
     }
 
+  private:
+    ScalarProductSum mBound;
+    BarrettModulus<Scalar> mBarrett;
+  };
+
+  template<class S>
+  class DenseRow {
+  public:
+    typedef S Scalar;
+    typedef uint64 ScalarProductSum;
+    typedef BasicSparseMatrix<Scalar> Matrix;
+
     Scalar modulusOf(ScalarProductSum x, Scalar modulus) {
-      return static_cast<Scalar>(x % modulus);
+      return mBound.barrett(modulus).reduce(x);
     }
 
-    DenseRow() {}
-    DenseRow(size_t colCount): mEntries(colCount) {}
+    const BarrettModulus<Scalar>& barrett(const Scalar modulus) {
+      return mBound.barrett(modulus);
+    }
+
+    DenseRow(): mNextCol(0), mKernelFitsIndices(true) {}
+    DenseRow(size_t colCount): mEntries(colCount), mNextCol(0) {
+      updateKernelFit();
+    }
 
     /// returns false if all entries are zero
-    bool takeModulus(const SparseMatrix::Scalar modulus) {
+    bool takeModulus(const Scalar modulus) {
+      const auto& barrett = mBound.barrett(modulus);
       ScalarProductSum bitwiseOr = 0; // bitwise or of all entries after modulus
       const auto end = mEntries.end();
       for (auto it = mEntries.begin(); it != end; ++it) {
         if (*it >= modulus)
-          *it = modulusOf(*it, modulus);
+          *it = barrett.reduce(*it);
         bitwiseOr |= *it;
       }
+      mBound.setReduced(modulus);
       return bitwiseOr != 0;
     }
 
@@ -81,8 +330,35 @@ namespace {
     void clear(size_t colCount = 0) {
       mEntries.clear();
       mEntries.resize(colCount);
+      mNextCol = 0;
+      mBound.setZero();
+      updateKernelFit();
+    }
+
+    /// Sets col to the first column after those returned since the last
+    /// clear that has an entry that is non-zero modulo modulus. Then sets
+    /// that entry to zero and returns it modulo modulus. Returns zero if
+    /// there is no such column. Entries before the returned column must not
+    /// be changed until the next clear.
+    Scalar popLeading(SparseMatrix::ColIndex& col, const Scalar modulus) {
+      const auto colCount = mEntries.size();
+      for (; mNextCol < colCount; ++mNextCol) {
+        auto& entry = mEntries[mNextCol];
+        if (entry == 0)
+          continue;
+        const auto value = modulusOf(entry, modulus);
+        entry = 0;
+        if (value != 0) {
+          col = static_cast<SparseMatrix::ColIndex>(mNextCol);
+          ++mNextCol;
+          return value;
+        }
+      }
+      return 0;
     }
 
+    /// Entries must not be increased through the returned reference since
+    /// that would invalidate the bound on the entries.
     ScalarProductSum& operator[](size_t col) {
       MATHICGB_ASSERT(col < colCount());
       return mEntries[col];
@@ -93,41 +369,68 @@ namespace {
       return mEntries[col];
     }
 
-    void appendTo(SparseMatrix& matrix) {matrix.appendRow(mEntries);}
+    void appendTo(Matrix& matrix) {matrix.appendRow(mEntries);}
 
-    void makeUnitary(const SparseMatrix::Scalar modulus, const size_t lead) {
+    void makeUnitary(const Scalar modulus, const size_t lead) {
       MATHICGB_ASSERT(lead < colCount());
       MATHICGB_ASSERT(mEntries[lead] != 0);
 
+      const auto& barrett = mBound.barrett(modulus);
       const auto end = mEntries.end();
       auto it = mEntries.begin() + lead;
-      const auto toInvert = static_cast<SparseMatrix::Scalar>(*it % modulus);
+      const auto toInvert = barrett.reduce(*it);
       const auto multiply = modularInverse(toInvert, modulus);
       *it = 1;
       for (++it; it != end; ++it) {
-        const auto entry = modulusOf(*it, modulus);
+        const auto entry = barrett.reduce(*it);
         if (entry != 0)
-          *it = modulusOf(product(entry, multiply), modulus);
+          *it = barrett.product(entry, multiply);
         else
           *it = 0;
       }
+      mBound.setReduced(modulus);
     }
 
-    void addRow(const SparseMatrix& matrix, SparseMatrix::RowIndex row) {
+    void addRow(const Matrix& matrix, SparseMatrix::RowIndex row) {
+#ifdef MATHICGB_DEBUG
+      const auto end = matrix.rowEnd(row);
+      for (auto it = matrix.rowBegin(row); it != end; ++it)
+        MATHICGB_ASSERT(it.index() < colCount());
+#endif
+      addRowPart(matrix, row, 0);
+    }
+
+    /// Adds the entries of the given row of matrix in the columns
+    /// [firstCol, firstCol + colCount()) to the columns [0, colCount()) of
+    /// this row.
+    void addRowPart(
+      const Matrix& matrix,
+      const SparseMatrix::RowIndex row,
+      const size_t firstCol
+    ) {
       MATHICGB_ASSERT(row < matrix.rowCount());
+      // The modulus is not known here, so the bound has to allow for any
+      // scalar.
+      ensureRoom(std::numeric_limits<Scalar>::max());
       const auto end = matrix.rowEnd(row);
       for (auto it = matrix.rowBegin(row); it != end; ++it) {
-        MATHICGB_ASSERT(it.index() < colCount());
-        add(it.scalar(), mEntries[it.index()]);
+        const auto col = it.index() - firstCol;
+        if (col < colCount())
+          mEntries[col] += it.scalar();
       }
     }
 
     template<class Iter>
     void addRowMultiple(
-      const SparseMatrix::Scalar multiple,
+      const Scalar multiple,
       const Iter begin,
-      const Iter end
+      const Iter end,
+      const Scalar modulus
     ) {
+      const auto count = static_cast<size_t>(std::distance(begin, end));
+      if (count == 0)
+        return;
+
       // I have a matrix reduction that goes from 2.8s to 2.4s on MSVC 2012 by
       // using entries instead of mEntries, even after removing restrict and
       // const from entries. That does not make sense to me, but it is a fact
@@ -138,37 +441,49 @@ namespace {
 
 #ifdef MATHICGB_DEBUG
       // These asserts are separated out since otherwise they would also need
-      // to be duplicated due to the manual unrolling.
+      // to be duplicated in each kernel.
       for (auto it = begin; it != end; ++it) {
         MATHICGB_ASSERT(it.index() < colCount());
         MATHICGB_ASSERT(entries + it.index() == &mEntries[it.index()]);
+        MATHICGB_ASSERT(it.scalar() < modulus);
       }
 #endif
-      // I have a matrix reduction that goes from 2.601s to 2.480s on MSVC 2012
-      // by unrolling this loop manually. Unrolling more than once was not a
-      // benefit. So don't undo the unrolling unless you think it's worth a 5%
-      // slowdown of matrix reduction (the whole computation, not just this
-      // method).
-
-      auto it = begin;
-      if (std::distance(begin, end) % 2 == 1) {
-        // Replacing this by a goto into the middle of the following loop
-        // (similar to Duff's device) made the code slower on MSVC 2012.
-        multiplyAdd(it.scalar(), multiple, entries[it.index()]);
-        ++it;
-      }
-      while (it != end) {
-        multiplyAdd(it.scalar(), multiple, entries[it.index()]);
-        ++it;
-        multiplyAdd(it.scalar(), multiple, entries[it.index()]);
-        ++it;
+      // The entries of a row are stored contiguously, so the kernels can
+      // work directly on the underlying arrays.
+      const auto indices = &begin.index();
+      const auto scalars = &begin.scalar();
+
+      // The products are added without reducing them as long as that cannot
+      // overflow the entries. For 8 and 16 bit scalars that is always, in
+      // practice. For 32 bit scalars it depends on the modulus. The scalars
+      // of the matrices are always reduced, so they are less than modulus.
+      //
+      // For a modulus close to 2^31 only a few unreduced products fit, after
+      // which the products are reduced before they are added. Then each row
+      // adds less than 2^31 to the bound, so ensureRoom only has to reduce
+      // the whole row after billions more rows. Reducing a 3000 by 20000
+      // matrix modulo 2^31 - 1 never reduced the whole row, and reducing
+      // just the touched entries instead made it up to 40% slower.
+      MATHICGB_ASSERT(multiple < modulus);
+      const auto productBound = static_cast<uint64>(modulus - 1) * multiple;
+      if (mBound.tryIncrease(productBound)) {
+        if (mKernelFitsIndices) {
+          rowKernel<Scalar>().addRowMultiple
+            (entries, multiple, indices, scalars, count);
+        } else
+          addRowMultipleScalar(entries, multiple, indices, scalars, count);
+      } else {
+        const auto& barrett = mBound.barrett(modulus);
+        ensureRoom(modulus - 1);
+        addRowMultipleReduced
+          (entries, multiple, indices, scalars, count, barrett);
       }
     }
 
     void rowReduceByUnitary(
       const SparseMatrix::RowIndex pivotRow,
-      const SparseMatrix& matrix,
-      const SparseMatrix::Scalar modulus
+      const Matrix& matrix,
+      const Scalar modulus
     ) {
       MATHICGB_ASSERT(matrix.rowBegin(pivotRow).scalar() == 1); // unitary
       MATHICGB_ASSERT(modulus > 1);
@@ -183,22 +498,241 @@ namespace {
       addRowMultiple(
         modularNegativeNonZero(entry, modulus),
         begin,
-        matrix.rowEnd(pivotRow)
+        matrix.rowEnd(pivotRow),
+        modulus
       );
     }
 
   private:
+    void updateKernelFit() {
+      mKernelFitsIndices =
+        mEntries.size() <= static_cast<size_t>
+          (std::numeric_limits<int32>::max());
+    }
+
+    /// Makes sure that a value of at most increase can be added to each
+    /// entry, taking the modulus of every entry if necessary. The modulus is
+    /// the one most recently used, which exists since the bound can only
+    /// get this large after many calls to addRowMultiple.
+    void ensureRoom(const ScalarProductSum increase) {
+      if (mBound.tryIncrease(increase))
+        return;
+      const auto& barrett = mBound.lastBarrett();
+      for (auto it = mEntries.begin(); it != mEntries.end(); ++it)
+        *it = barrett.reduce(*it);
+      mBound.setReduced(barrett.modulus());
+      const bool fits = mBound.tryIncrease(increase);
+      MATHICGB_ASSERT(fits);
+    }
+
+    std::vector<ScalarProductSum> mEntries;
+
+    /// The column where the next call to popLeading starts looking.
+    size_t mNextCol;
+
+    /// True if all column indices of this row can be used as indices for
+    /// the gathers and scatters of the SIMD kernels.
+    bool mKernelFitsIndices;
+
+    EntryBound<Scalar> mBound;
+  };
+
+  /// A sparse accumulator that can be used instead of DenseRow for
+  /// very sparse matrices. It has the same dense array of entries, but it
+  /// also keeps track of which columns have been touched since the last
+  /// clear. So clearing it and going through its entries takes time
+  /// proportional to the number of touched columns rather than to the
+  /// number of columns. The touched columns are kept in a heap so that
+  /// popLeading returns them in increasing order even when more columns are
+  /// touched along the way.
+  template<class S>
+  class SparseAccumulator {
+  public:
+    typedef S Scalar;
+    typedef uint64 ScalarProductSum;
+    typedef BasicSparseMatrix<Scalar> Matrix;
+
+    SparseAccumulator() {}
+    SparseAccumulator(size_t colCount): mEntries(colCount) {}
+
+    size_t colCount() const {return mEntries.size();}
+
+    const BarrettModulus<Scalar>& barrett(const Scalar modulus) {
+      return mBound.barrett(modulus);
+    }
+
+    void clear(size_t colCount = 0) {
+      const auto end = mTouched.end();
+      for (auto it = mTouched.begin(); it != end; ++it)
+        mEntries[*it] = 0;
+      mTouched.clear();
+      // All entries are zero now, so this only touches the entries that are
+      // added or removed.
+      mEntries.resize(colCount);
+      mBound.setZero();
+    }
+
+    void addRow(const Matrix& matrix, SparseMatrix::RowIndex row) {
+      MATHICGB_ASSERT(row < matrix.rowCount());
+      ensureRoom(std::numeric_limits<Scalar>::max());
+      const auto end = matrix.rowEnd(row);
+      for (auto it = matrix.rowBegin(row); it != end; ++it)
+        add(it.index(), it.scalar());
+    }
+
+    /// As DenseRow::addRowMultiple.
+    template<class Iter>
+    void addRowMultiple(
+      const Scalar multiple,
+      const Iter begin,
+      const Iter end,
+      const Scalar modulus
+    ) {
+      MATHICGB_ASSERT(multiple < modulus);
+      const auto productBound = static_cast<uint64>(modulus - 1) * multiple;
+      if (mBound.tryIncrease(productBound)) {
+        const uint64 m = multiple;
+        for (auto it = begin; it != end; ++it) {
+          MATHICGB_ASSERT(it.scalar() < modulus);
+          add(it.index(), it.scalar() * m);
+        }
+      } else {
+        const auto& barrett = mBound.barrett(modulus);
+        ensureRoom(modulus - 1);
+        for (auto it = begin; it != end; ++it) {
+          MATHICGB_ASSERT(it.scalar() < modulus);
+          add(it.index(), barrett.product(it.scalar(), multiple));
+        }
+      }
+    }
+
+    /// As DenseRow::popLeading.
+    Scalar popLeading(SparseMatrix::ColIndex& col, const Scalar modulus) {
+      const auto& barrett = mBound.barrett(modulus);
+      while (!mTouched.empty()) {
+        std::pop_heap(mTouched.begin(), mTouched.end(), std::greater<Index>());
+        const auto touched = mTouched.back();
+        mTouched.pop_back();
+        auto& entry = mEntries[touched];
+        const auto value = barrett.reduce(entry);
+        entry = 0;
+        if (value != 0) {
+          col = touched;
+          return value;
+        }
+      }
+      return 0;
+    }
+
+  private:
+    typedef SparseMatrix::ColIndex Index;
+
+    void add(const Index col, const ScalarProductSum value) {
+      MATHICGB_ASSERT(col < colCount());
+      auto& entry = mEntries[col];
+      if (entry == 0) {
+        // A column can be pushed twice if value is zero, but then popLeading
+        // just sees a zero entry the second time.
+        mTouched.push_back(col);
+        std::push_heap(mTouched.begin(), mTouched.end(), std::greater<Index>());
+      }
+      entry += value;
+    }
+
+    /// As DenseRow::ensureRoom, except that only the touched entries can be
+    /// non-zero.
+    void ensureRoom(const ScalarProductSum increase) {
+      if (mBound.tryIncrease(increase))
+        return;
+      const auto& barrett = mBound.lastBarrett();
+      const auto end = mTouched.end();
+      for (auto it = mTouched.begin(); it != end; ++it)
+        mEntries[*it] = barrett.reduce(mEntries[*it]);
+      mBound.setReduced(barrett.modulus());
+      const bool fits = mBound.tryIncrease(increase);
+      MATHICGB_ASSERT(fits);
+    }
+
     std::vector<ScalarProductSum> mEntries;
+    std::vector<Index> mTouched; /// min-heap of touched columns
+    EntryBound<Scalar> mBound;
   };
 
-  SparseMatrix reduce(
-    const QuadMatrix& qm,
-    SparseMatrix::Scalar modulus
+  /// Removes all entries of row from left to right and appends them to
+  /// the current row of matrix after multiplying them by multiple. Returns
+  /// false if row had no entries that were non-zero modulo modulus.
+  template<class Row>
+  bool appendRemaining(
+    Row& row,
+    const typename Row::Scalar multiple,
+    typename Row::Matrix& matrix,
+    const typename Row::Scalar modulus
+  ) {
+    const auto& barrett = row.barrett(modulus);
+    bool nonZero = false;
+    SparseMatrix::ColIndex col;
+    while (true) {
+      const auto entry = row.popLeading(col, modulus);
+      if (entry == 0)
+        return nonZero;
+      nonZero = true;
+      if (multiple == 1)
+        matrix.appendEntry(col, entry);
+      else
+        matrix.appendEntry(col, modularProduct(entry, multiple, barrett));
+    }
+  }
+
+  /// The rows that one thread has produced along with the index of the
+  /// input row that each of them came from.
+  template<class S>
+  struct ThreadRows {
+    typedef BasicSparseMatrix<S> Matrix;
+
+    ThreadRows(size_t memoryQuantum): matrix(memoryQuantum) {}
+    ThreadRows(ThreadRows&& rows):
+      matrix(std::move(rows.matrix)),
+      origins(std::move(rows.origins))
+    {}
+
+    Matrix matrix;
+    std::vector<SparseMatrix::RowIndex> origins;
+  };
+
+  /// Moves the rows out of each ThreadRows in perThread into the returned
+  /// matrix and appends their origins to originsOut in the same order.
+  template<class S, class PerThread>
+  BasicSparseMatrix<S> mergeThreadRows(
+    PerThread& perThread,
+    std::vector<SparseMatrix::RowIndex>& originsOut,
+    const size_t memoryQuantum
+  ) {
+    BasicSparseMatrix<S> merged(memoryQuantum);
+    for (auto it = perThread.begin(); it != perThread.end(); ++it) {
+      MATHICGB_ASSERT(it->matrix.rowCount() == it->origins.size());
+      merged.takeRowsFrom(std::move(it->matrix));
+      originsOut.insert
+        (originsOut.end(), it->origins.begin(), it->origins.end());
+      it->origins.clear();
+    }
+    return std::move(merged);
+  }
+
+  /// Reduces the bottom rows of qm by the top rows and returns the non-zero
+  /// right parts in the order of the bottom rows they came from. If
+  /// originsOut is not null, then the index of the bottom row that each
+  /// returned row came from is appended to *originsOut.
+  template<class Row, class S>
+  BasicSparseMatrix<S> reduce(
+    const BasicQuadMatrix<S>& qm,
+    const S modulus,
+    std::vector<SparseMatrix::RowIndex>* originsOut = nullptr
   ) {
-    const SparseMatrix& toReduceLeft = qm.bottomLeft;
-    const SparseMatrix& toReduceRight = qm.bottomRight;
-    const SparseMatrix& reduceByLeft = qm.topLeft;
-    const SparseMatrix& reduceByRight = qm.topRight;
+    typedef BasicSparseMatrix<S> Matrix;
+    const Matrix& toReduceLeft = qm.bottomLeft;
+    const Matrix& toReduceRight = qm.bottomRight;
+    const Matrix& reduceByLeft = qm.topLeft;
+    const Matrix& reduceByRight = qm.topRight;
 
     const auto leftColCount = qm.computeLeftColCount();
     const auto rightColCount =
@@ -229,60 +763,64 @@ namespace {
     }
 #endif
 
-    SparseMatrix reduced(qm.topRight.memoryQuantum());
-
-    mgb::mtbb::enumerable_thread_specific<DenseRow> denseRowPerThread([&](){
-      return DenseRow();
-    }); 
-
-    SparseMatrix tmp(qm.topRight.memoryQuantum());
+    mgb::mtbb::enumerable_thread_specific<Row> denseRowPerThread([&](){
+      return Row();
+    });
 
-    std::vector<SparseMatrix::RowIndex> rowOrder(rowCount);
+    // Each thread appends its rows to its own matrix so that no lock is
+    // needed. The per-thread matrices are merged after each phase.
+    const auto quantum = qm.topRight.memoryQuantum();
+    mgb::mtbb::enumerable_thread_specific<ThreadRows<S>> tmpPerThread([&](){
+      return ThreadRows<S>(quantum);
+    });
 
-    mgb::mtbb::mutex lock;
     mgb::mtbb::parallel_for(mgb::mtbb::blocked_range<SparseMatrix::RowIndex>(0, rowCount, 2),
       [&](const mgb::mtbb::blocked_range<SparseMatrix::RowIndex>& range)
     {
       auto& denseRow = denseRowPerThread.local();
+      auto& out = tmpPerThread.local();
       for (auto it = range.begin(); it != range.end(); ++it) {
         const auto row = it;
         denseRow.clear(leftColCount);
         denseRow.addRow(toReduceLeft, row);
 
         MATHICGB_ASSERT(leftColCount == pivotCount);
-        for  (size_t pivot = 0; pivot < pivotCount; ++pivot) {
-          if (denseRow[pivot] != 0) {
-            auto entry = denseRow[pivot];
-            entry %= modulus;
-            if (entry == 0) {
-              denseRow[pivot] = 0;
-            } else {
-              entry = modulus - entry;
-              const auto row = rowThatReducesCol[pivot];
-              MATHICGB_ASSERT(row < pivotCount);
-              MATHICGB_ASSERT(!reduceByLeft.emptyRow(row));
-              MATHICGB_ASSERT(reduceByLeft.leadCol(row) == pivot);
-              MATHICGB_ASSERT(entry < std::numeric_limits<SparseMatrix::Scalar>::max());
-              denseRow.addRowMultiple(
-                static_cast<SparseMatrix::Scalar>(entry),
-                ++reduceByLeft.rowBegin(row),
-                reduceByLeft.rowEnd(row)
-              );
-              denseRow[pivot] = entry;
-            }
-          }
+        // The pivots come out in increasing order and reducing by the row
+        // for a pivot only adds to entries after that pivot.
+        SparseMatrix::ColIndex pivot;
+        while (true) {
+          const auto leading = denseRow.popLeading(pivot, modulus);
+          if (leading == 0)
+            break;
+          const auto entry = static_cast<S>(modulus - leading);
+          const auto row = rowThatReducesCol[pivot];
+          MATHICGB_ASSERT(row < pivotCount);
+          MATHICGB_ASSERT(!reduceByLeft.emptyRow(row));
+          MATHICGB_ASSERT(reduceByLeft.leadCol(row) == pivot);
+          denseRow.addRowMultiple(
+            entry,
+            ++reduceByLeft.rowBegin(row),
+            reduceByLeft.rowEnd(row),
+            modulus
+          );
+          out.matrix.appendEntry(row, entry);
         }
-        mgb::mtbb::mutex::scoped_lock lockGuard(lock);
-        for (size_t pivot = 0; pivot < pivotCount; ++pivot) {
-		  MATHICGB_ASSERT(denseRow[pivot] < std::numeric_limits<SparseMatrix::Scalar>::max());
-          if (denseRow[pivot] != 0)
-            tmp.appendEntry(rowThatReducesCol[pivot], static_cast<SparseMatrix::Scalar>(denseRow[pivot]));
-	    }
-        tmp.rowDone();
-        rowOrder[tmp.rowCount() - 1] = row;
+        out.matrix.rowDone();
+        out.origins.push_back(row);
       }
     });
 
+    // Row i of tmp is the reduction of bottom row rowOrder[i]. The order of
+    // the rows in tmp depends on scheduling, but that does not matter as
+    // the order is restored below.
+    std::vector<SparseMatrix::RowIndex> rowOrder;
+    Matrix tmp(mergeThreadRows<S>(tmpPerThread, rowOrder, quantum));
+    MATHICGB_ASSERT(tmp.rowCount() == rowCount);
+    MATHICGB_ASSERT(rowOrder.size() == rowCount);
+
+    mgb::mtbb::enumerable_thread_specific<ThreadRows<S>> reducedPerThread(
+      [&](){return ThreadRows<S>(quantum);}
+    );
     mgb::mtbb::parallel_for(mgb::mtbb::blocked_range<SparseMatrix::RowIndex>(0, rowCount),
       [&](const mgb::mtbb::blocked_range<SparseMatrix::RowIndex>& range)
       {for (auto iter = range.begin(); iter != range.end(); ++iter)
@@ -290,6 +828,7 @@ namespace {
       const auto i = iter;
       const auto row = rowOrder[i];
       auto& denseRow = denseRowPerThread.local();
+      auto& out = reducedPerThread.local();
 
       denseRow.clear(rightColCount);
       denseRow.addRow(toReduceRight, row);
@@ -298,29 +837,460 @@ namespace {
       for (; it != end; ++it) {
         const auto begin = reduceByRight.rowBegin(it.index());
         const auto end = reduceByRight.rowEnd(it.index());
-        denseRow.addRowMultiple(it.scalar(), begin, end);
+        denseRow.addRowMultiple(it.scalar(), begin, end, modulus);
       }
 
-      mgb::mtbb::mutex::scoped_lock lockGuard(lock);
-      bool zero = true;
-	  for (SparseMatrix::ColIndex col = 0; col < rightColCount; ++col) {
-        const auto entry =
-          static_cast<SparseMatrix::Scalar>(denseRow[col] % modulus);
-        if (entry != 0) {
-          reduced.appendEntry(col, entry);
-          zero = false;
+      if (appendRemaining(denseRow, 1, out.matrix, modulus)) {
+        out.matrix.rowDone();
+        out.origins.push_back(row);
+      }
+    }});
+
+    // Put the non-zero rows in the order of the bottom rows they came from
+    // so that the result does not depend on how the work was scheduled.
+    std::vector<SparseMatrix::RowIndex> origins;
+    Matrix reduced(mergeThreadRows<S>(reducedPerThread, origins, quantum));
+    const auto noRow = static_cast<SparseMatrix::RowIndex>(-1);
+    std::vector<SparseMatrix::RowIndex> reducedRowOf(rowCount, noRow);
+    for (SparseMatrix::RowIndex i = 0; i < origins.size(); ++i)
+      reducedRowOf[origins[i]] = i;
+    std::vector<SparseMatrix::RowIndex> order;
+    order.reserve(origins.size());
+    for (SparseMatrix::RowIndex row = 0; row < rowCount; ++row) {
+      if (reducedRowOf[row] != noRow) {
+        order.push_back(reducedRowOf[row]);
+        if (originsOut != nullptr)
+          originsOut->push_back(row);
+      }
+    }
+    reduced.permuteRows(order);
+    return std::move(reduced);
+  }
+
+  /// Returns the same matrix as reduce(), but computed in the way of
+  /// Faugere and Lachartre. Let A, B, C and D be the top left, top right,
+  /// bottom left and bottom right matrices of qm. The rows of A are monic
+  /// and A is upper triangular up to a permutation of its rows, so reduce()
+  /// computes D - C A^-1 B by reducing each row of C by A and then applying
+  /// the same operations to D.
+  ///
+  /// Here B is first replaced by A^-1 B, which is a triangular solve like
+  /// TRSM. Then D - C (A^-1 B) is computed directly, which is a
+  /// multiply-add like AXPY. So the left part of each bottom row is never
+  /// reduced and the work on A is done once instead of once per bottom row.
+  ///
+  /// The right columns are split into blocks of FLColBlockWidth columns
+  /// that are processed independently, so the dense accumulators fit in
+  /// cache. A row of A^-1 B only depends on the rows for the other columns
+  /// in the corresponding row of A, so the rows are computed level by level
+  /// with all rows on a level done in parallel.
+  template<class S>
+  BasicSparseMatrix<S> reduceFaugereLachartre(
+    const BasicQuadMatrix<S>& qm,
+    const S modulus
+  ) {
+    typedef BasicSparseMatrix<S> Matrix;
+    const Matrix& toReduceLeft = qm.bottomLeft;
+    const Matrix& toReduceRight = qm.bottomRight;
+    const Matrix& reduceByLeft = qm.topLeft;
+    const Matrix& reduceByRight = qm.topRight;
+
+    const auto leftColCount = qm.computeLeftColCount();
+    const auto rightColCount =
+      static_cast<SparseMatrix::ColIndex>(qm.computeRightColCount());
+    MATHICGB_ASSERT(leftColCount == reduceByLeft.rowCount());
+    const auto pivotCount = leftColCount;
+    const auto rowCount = toReduceLeft.rowCount();
+    const auto quantum = qm.topRight.memoryQuantum();
+    const auto noRow = static_cast<SparseMatrix::RowIndex>(-1);
+
+    const size_t blockCount =
+      (static_cast<size_t>(rightColCount) + FLColBlockWidth - 1) /
+      FLColBlockWidth;
+    if (blockCount == 0)
+      return Matrix(quantum); // all rows reduce to zero
+
+    // ** pre-calculate what rows are pivots for what columns.
+    std::vector<SparseMatrix::RowIndex> rowThatReducesCol(pivotCount, noRow);
+    for (SparseMatrix::RowIndex pivot = 0; pivot < pivotCount; ++pivot) {
+      MATHICGB_ASSERT(!reduceByLeft.emptyRow(pivot));
+      const auto col = reduceByLeft.leadCol(pivot);
+      MATHICGB_ASSERT(rowThatReducesCol[col] == noRow);
+      MATHICGB_ASSERT(reduceByLeft.rowBegin(pivot).scalar() == 1);
+      rowThatReducesCol[col] = pivot;
+    }
+
+    // ** Assign each pivot column to a level such that the row of A^-1 B
+    // for a column only depends on rows for columns on lower levels. The
+    // other columns of a pivot row are to the right of its lead column, so
+    // going from right to left sees the dependencies first.
+    std::vector<SparseMatrix::RowIndex> levelOfCol(pivotCount);
+    SparseMatrix::RowIndex levelCount = 0;
+    for (auto col = pivotCount; col != 0;) {
+      --col;
+      const auto pivot = rowThatReducesCol[col];
+      MATHICGB_ASSERT(pivot != noRow);
+      SparseMatrix::RowIndex level = 0;
+      auto it = reduceByLeft.rowBegin(pivot);
+      const auto end = reduceByLeft.rowEnd(pivot);
+      for (++it; it != end; ++it) {
+        MATHICGB_ASSERT(it.index() > col);
+        level = std::max(level, levelOfCol[it.index()] + 1);
+      }
+      levelOfCol[col] = level;
+      levelCount = std::max(levelCount, level + 1);
+    }
+
+    // The columns on level l are colsByLevel[levelBegin[l]] up to
+    // colsByLevel[levelBegin[l + 1]].
+    std::vector<SparseMatrix::ColIndex> levelBegin(levelCount + 1);
+    for (SparseMatrix::ColIndex col = 0; col < pivotCount; ++col)
+      ++levelBegin[levelOfCol[col] + 1];
+    for (SparseMatrix::RowIndex level = 0; level < levelCount; ++level)
+      levelBegin[level + 1] += levelBegin[level];
+    std::vector<SparseMatrix::ColIndex> colsByLevel(pivotCount);
+    {
+      auto next = levelBegin;
+      for (SparseMatrix::ColIndex col = 0; col < pivotCount; ++col)
+        colsByLevel[next[levelOfCol[col]]++] = col;
+    }
+
+    const auto blockWidth = [&](const size_t block) {
+      return std::min<size_t>
+        (FLColBlockWidth, rightColCount - block * FLColBlockWidth);
+    };
+
+    mgb::mtbb::enumerable_thread_specific<DenseRow<S>> denseRowPerThread([&](){
+      return DenseRow<S>();
+    });
+
+    // ** TRSM: compute A^-1 B. The part of the row for pivot column col that
+    // lies in the given block is row solvedRowOf[col * blockCount + block]
+    // of solved, with column indices relative to the block, or noRow if that
+    // part is zero.
+    Matrix solved(quantum);
+    std::vector<SparseMatrix::RowIndex> solvedRowOf
+      (pivotCount * blockCount, noRow);
+    for (SparseMatrix::RowIndex level = 0; level < levelCount; ++level) {
+      const auto levelSize = levelBegin[level + 1] - levelBegin[level];
+      const auto taskCount = levelSize * blockCount;
+      MATHICGB_ASSERT(taskCount < noRow);
+
+      // Task i is the column colsByLevel[levelBegin[level] + i % levelSize]
+      // in block i / levelSize, so a thread tends to stay within one block.
+      mgb::mtbb::enumerable_thread_specific<ThreadRows<S>> perThread([&](){
+        return ThreadRows<S>(quantum);
+      });
+      mgb::mtbb::parallel_for(
+        mgb::mtbb::blocked_range<size_t>(0, taskCount),
+        [&](const mgb::mtbb::blocked_range<size_t>& range)
+        {for (auto task = range.begin(); task != range.end(); ++task)
+      {
+        const auto block = task / levelSize;
+        const auto col = colsByLevel[levelBegin[level] + task % levelSize];
+        const auto pivot = rowThatReducesCol[col];
+        auto& denseRow = denseRowPerThread.local();
+        denseRow.clear(blockWidth(block));
+        denseRow.addRowPart(reduceByRight, pivot, block * FLColBlockWidth);
+
+        auto it = reduceByLeft.rowBegin(pivot);
+        const auto end = reduceByLeft.rowEnd(pivot);
+        for (++it; it != end; ++it) {
+          const auto solvedRow = solvedRowOf[it.index() * blockCount + block];
+          const auto entry = it.scalar();
+          if (solvedRow == noRow || entry == 0)
+            continue;
+          denseRow.addRowMultiple(
+            static_cast<S>(modulus - entry),
+            solved.rowBegin(solvedRow),
+            solved.rowEnd(solvedRow),
+            modulus
+          );
         }
+        if (!denseRow.takeModulus(modulus))
+          continue;
+        auto& out = perThread.local();
+        denseRow.appendTo(out.matrix);
+        out.origins.push_back(static_cast<SparseMatrix::RowIndex>(task));
+      }});
+
+      std::vector<SparseMatrix::RowIndex> origins;
+      const auto firstRow = solved.rowCount();
+      solved.takeRowsFrom(mergeThreadRows<S>(perThread, origins, quantum));
+      for (SparseMatrix::RowIndex i = 0; i < origins.size(); ++i) {
+        const auto block = origins[i] / levelSize;
+        const auto col =
+          colsByLevel[levelBegin[level] + origins[i] % levelSize];
+        solvedRowOf[col * blockCount + block] = firstRow + i;
+      }
+    }
+
+    // ** AXPY: compute D - C (A^-1 B). Task i is bottom row i % rowCount in
+    // block i / rowCount.
+    const auto taskCount = rowCount * blockCount;
+    MATHICGB_ASSERT(taskCount < noRow);
+    mgb::mtbb::enumerable_thread_specific<ThreadRows<S>> perThread([&](){
+      return ThreadRows<S>(quantum);
+    });
+    mgb::mtbb::parallel_for(
+      mgb::mtbb::blocked_range<size_t>(0, taskCount),
+      [&](const mgb::mtbb::blocked_range<size_t>& range)
+      {for (auto task = range.begin(); task != range.end(); ++task)
+    {
+      const auto block = task / rowCount;
+      const auto row = static_cast<SparseMatrix::RowIndex>(task % rowCount);
+      auto& denseRow = denseRowPerThread.local();
+      denseRow.clear(blockWidth(block));
+      denseRow.addRowPart(toReduceRight, row, block * FLColBlockWidth);
+
+      const auto end = toReduceLeft.rowEnd(row);
+      for (auto it = toReduceLeft.rowBegin(row); it != end; ++it) {
+        const auto solvedRow = solvedRowOf[it.index() * blockCount + block];
+        const auto entry = it.scalar();
+        if (solvedRow == noRow || entry == 0)
+          continue;
+        denseRow.addRowMultiple(
+          static_cast<S>(modulus - entry),
+          solved.rowBegin(solvedRow),
+          solved.rowEnd(solvedRow),
+          modulus
+        );
+      }
+      if (!denseRow.takeModulus(modulus))
+        continue;
+      auto& out = perThread.local();
+      denseRow.appendTo(out.matrix);
+      out.origins.push_back(static_cast<SparseMatrix::RowIndex>(task));
+    }});
+
+    // ** Put the blocks of each row back together, with the non-zero rows
+    // in the order of the bottom rows they came from like reduce() does.
+    std::vector<SparseMatrix::RowIndex> origins;
+    const auto parts = mergeThreadRows<S>(perThread, origins, quantum);
+    std::vector<SparseMatrix::RowIndex> partOfTask(taskCount, noRow);
+    for (SparseMatrix::RowIndex i = 0; i < origins.size(); ++i)
+      partOfTask[origins[i]] = i;
+
+    Matrix reduced(quantum);
+    for (SparseMatrix::RowIndex row = 0; row < rowCount; ++row) {
+      bool zero = true;
+      for (size_t block = 0; block < blockCount; ++block) {
+        const auto part = partOfTask[block * rowCount + row];
+        if (part == noRow)
+          continue;
+        const auto blockBegin =
+          static_cast<SparseMatrix::ColIndex>(block * FLColBlockWidth);
+        const auto end = parts.rowEnd(part);
+        for (auto it = parts.rowBegin(part); it != end; ++it)
+          reduced.appendEntry(blockBegin + it.index(), it.scalar());
+        zero = false;
       }
       if (!zero)
         reduced.rowDone();
-    }});
+    }
+    return std::move(reduced);
+  }
+
+  /// Reduces row by the unitary rows of pivots until its leading entry has
+  /// no pivot row, where the pivot row for column col is
+  /// pivotRowOfCol[col] or noRow if there is none. Then removes that entry
+  /// from row, sets col to its column and returns it. Returns zero if row
+  /// is reduced to zero.
+  template<class Row>
+  typename Row::Scalar reduceLeading(
+    Row& row,
+    SparseMatrix::ColIndex& col,
+    const typename Row::Matrix& pivots,
+    const std::vector<SparseMatrix::RowIndex>& pivotRowOfCol,
+    const typename Row::Scalar modulus
+  ) {
+    const auto noRow = static_cast<SparseMatrix::RowIndex>(-1);
+    while (true) {
+      const auto entry = row.popLeading(col, modulus);
+      if (entry == 0)
+        return 0;
+      const auto pivotRow = pivotRowOfCol[col];
+      if (pivotRow == noRow)
+        return entry;
+      MATHICGB_ASSERT(pivots.rowBegin(pivotRow).scalar() == 1); // unitary
+      row.addRowMultiple(
+        modularNegativeNonZero(entry, modulus),
+        ++pivots.rowBegin(pivotRow),
+        pivots.rowEnd(pivotRow),
+        modulus
+      );
+    }
+  }
+
+  /// Removes all entries of row from left to right. An entry in a column
+  /// after keepUpTo that has a pivot row in reduced is reduced away by that
+  /// row. The other entries are appended to kept. The pivot rows must be
+  /// unitary and must have zeroes in the columns of the other pivots.
+  template<class Row>
+  void reduceTail(
+    Row& row,
+    const SparseMatrix::ColIndex keepUpTo,
+    const typename Row::Matrix& reduced,
+    const std::vector<SparseMatrix::RowIndex>& pivotRowOfCol,
+    const typename Row::Scalar modulus,
+    std::vector<std::pair<SparseMatrix::ColIndex, typename Row::Scalar>>& kept
+  ) {
+    const auto noRow = static_cast<SparseMatrix::RowIndex>(-1);
+    kept.clear();
+    SparseMatrix::ColIndex col;
+    while (true) {
+      const auto entry = row.popLeading(col, modulus);
+      if (entry == 0)
+        return;
+      const auto pivotRow = pivotRowOfCol[col];
+      if (col <= keepUpTo || pivotRow == noRow) {
+        kept.push_back(std::make_pair(col, entry));
+        continue;
+      }
+      MATHICGB_ASSERT(reduced.rowBegin(pivotRow).scalar() == 1); // unitary
+      row.addRowMultiple(
+        modularNegativeNonZero(entry, modulus),
+        ++reduced.rowBegin(pivotRow),
+        reduced.rowEnd(pivotRow),
+        modulus
+      );
+    }
+  }
+
+  /// Appends the entries of a row as produced by reduceTail to matrix.
+  template<class S>
+  void appendKept(
+    const std::vector<std::pair<SparseMatrix::ColIndex, S>>& kept,
+    BasicSparseMatrix<S>& matrix
+  ) {
+    const auto end = kept.end();
+    for (auto it = kept.begin(); it != end; ++it)
+      matrix.appendEntry(it->first, it->second);
+    matrix.rowDone();
+  }
+
+  /// Returns the indices of the rows of toReduce that become pivots when
+  /// the rows are reduced to row echelon form one at a time in order. The
+  /// other rows reduce to zero, so the pivot rows span the same space as
+  /// all the rows.
+  template<class Row>
+  std::vector<SparseMatrix::RowIndex> echelonPivotRows(
+    const typename Row::Matrix& toReduce,
+    const typename Row::Scalar modulus
+  ) {
+    typedef typename Row::Matrix Matrix;
+    const auto colCount = toReduce.computeColCount();
+    const auto noRow = static_cast<SparseMatrix::RowIndex>(-1);
+    std::vector<SparseMatrix::RowIndex> pivotRowOfCol(colCount, noRow);
+    std::vector<SparseMatrix::RowIndex> pivotRows;
+
+    Row rowToReduce(colCount);
+    Matrix pivots(colCount);
+    for (SparseMatrix::RowIndex row = 0; row < toReduce.rowCount(); ++row) {
+      if (toReduce.emptyRow(row))
+        continue;
+      rowToReduce.clear(colCount);
+      rowToReduce.addRow(toReduce, row);
+
+      SparseMatrix::ColIndex leadingCol;
+      const auto leading = reduceLeading
+        (rowToReduce, leadingCol, pivots, pivotRowOfCol, modulus);
+      if (leading == 0)
+        continue;
+
+      pivotRowOfCol[leadingCol] = pivots.rowCount();
+      pivots.appendEntry(leadingCol, 1);
+      appendRemaining
+        (rowToReduce, modularInverse(leading, modulus), pivots, modulus);
+      pivots.rowDone();
+      pivotRows.push_back(row);
+    }
+    return pivotRows;
+  }
+
+  /// As F4MatrixReducer::reduceByLowerRanks.
+  template<class Row>
+  typename Row::Matrix reduceRowsByLowerRanks(
+    const typename Row::Matrix& toReduce,
+    const std::vector<size_t>& ranks,
+    const std::vector<char>& mustTopReduce,
+    std::vector<char>& singular,
+    const typename Row::Scalar modulus
+  ) {
+    typedef typename Row::Matrix Matrix;
+    typedef typename Row::Scalar Scalar;
+    const auto rowCount = toReduce.rowCount();
+    const auto colCount = toReduce.computeColCount();
+    const auto noRow = static_cast<SparseMatrix::RowIndex>(-1);
+    MATHICGB_ASSERT(ranks.size() == rowCount);
+    MATHICGB_ASSERT(mustTopReduce.size() == rowCount);
+    singular.assign(rowCount, false);
+
+    // pivotRowOfCol[col] is the first non-zero row of reduced of a smaller
+    // rank than the current row whose leading column is col, or noRow. The
+    // rows of the current rank go into newPivots until the rank goes up.
+    std::vector<SparseMatrix::RowIndex> pivotRowOfCol(colCount, noRow);
+    std::vector<SparseMatrix::RowIndex> newPivots;
+
+    const BarrettModulus<Scalar> barrett(modulus);
+    std::vector<std::pair<SparseMatrix::ColIndex, Scalar>> kept;
+    Row rowToReduce(colCount);
+    Matrix reduced(toReduce.memoryQuantum());
+    for (SparseMatrix::RowIndex row = 0; row < rowCount; ++row) {
+      MATHICGB_ASSERT(row == reduced.rowCount());
+      if (row > 0 && ranks[row] != ranks[row - 1]) {
+        MATHICGB_ASSERT(ranks[row - 1] < ranks[row]);
+        for (const auto pivot : newPivots) {
+          const auto col = reduced.leadCol(pivot);
+          if (pivotRowOfCol[col] == noRow)
+            pivotRowOfCol[col] = pivot;
+        }
+        newPivots.clear();
+      }
+
+      if (toReduce.emptyRow(row)) {
+        reduced.rowDone();
+        continue;
+      }
+      if (
+        mustTopReduce[row] &&
+        pivotRowOfCol[toReduce.leadCol(row)] == noRow
+      ) {
+        singular[row] = true;
+        reduced.rowDone();
+        continue;
+      }
+
+      rowToReduce.clear(colCount);
+      rowToReduce.addRow(toReduce, row);
+      kept.clear();
+      while (true) {
+        SparseMatrix::ColIndex col;
+        const auto entry = reduceLeading
+          (rowToReduce, col, reduced, pivotRowOfCol, modulus);
+        if (entry == 0)
+          break;
+        kept.push_back(std::make_pair(col, entry));
+      }
+
+      if (!kept.empty()) {
+        const auto multiple = modularInverse(kept.front().second, modulus);
+        for (auto& entry : kept)
+          entry.second = modularProduct(entry.second, multiple, barrett);
+        newPivots.push_back(row);
+      }
+      appendKept(kept, reduced);
+    }
     return std::move(reduced);
   }
 
-  SparseMatrix reduceToEchelonFormSparse(
-    const SparseMatrix& toReduce,
-    const SparseMatrix::Scalar modulus
+  template<class Row>
+  typename Row::Matrix reduceToEchelonFormSparse(
+    const typename Row::Matrix& toReduce,
+    const typename Row::Scalar modulus
   ) {
+    typedef typename Row::Matrix Matrix;
+    typedef typename Row::Scalar Scalar;
     const auto colCount = toReduce.computeColCount();
 
     const auto noRow = static_cast<SparseMatrix::RowIndex>(-1);
@@ -329,42 +1299,34 @@ namespace {
     // if we have not identified such a pivot so far.
     std::vector<SparseMatrix::RowIndex> pivotRowOfCol(colCount, noRow);
 
-    DenseRow rowToReduce(colCount);
+    Row rowToReduce(colCount);
 
     // ** Reduce to row echelon form -- every row is a pivot row.
-    SparseMatrix pivots(colCount);
+    Matrix pivots(colCount);
     for (SparseMatrix::RowIndex row = 0; row < toReduce.rowCount(); ++row) {
       if (toReduce.emptyRow(row))
         continue;
       rowToReduce.clear(colCount);
       rowToReduce.addRow(toReduce, row);
 
-      SparseMatrix::ColIndex leadingCol = 0;
-      while (true) { // reduce row by previous pivots
-        for (; leadingCol < colCount; ++leadingCol) {
-          auto& entry = rowToReduce[leadingCol];
-          if (entry != 0) {
-            entry %= modulus;
-            if (entry != 0)
-              break;
-          }
-        }
-        if (leadingCol == colCount)
-          break; // The row has been reduced to zero.
-        const auto pivotRow = pivotRowOfCol[leadingCol];
-        if (pivotRow == noRow) { // If the row is a new pivot.
-          rowToReduce.makeUnitary(modulus, leadingCol);
-          pivotRowOfCol[leadingCol] = pivots.rowCount();
-          rowToReduce.appendTo(pivots);
-          break;
-        }
-        rowToReduce.rowReduceByUnitary(pivotRow, pivots, modulus);
-      }
+      SparseMatrix::ColIndex leadingCol;
+      const auto leading = reduceLeading
+        (rowToReduce, leadingCol, pivots, pivotRowOfCol, modulus);
+      if (leading == 0)
+        continue; // The row has been reduced to zero.
+
+      // The row is a new pivot.
+      pivotRowOfCol[leadingCol] = pivots.rowCount();
+      pivots.appendEntry(leadingCol, 1);
+      appendRemaining
+        (rowToReduce, modularInverse(leading, modulus), pivots, modulus);
+      pivots.rowDone();
     }
 
     // ** Reduce from row echelon form to reduced row echelon form
 
-    SparseMatrix reduced(colCount);
+    Matrix reduced(colCount);
+    std::vector<std::pair<SparseMatrix::ColIndex, Scalar>> kept;
     auto pivotCol = colCount;
     // Reduce pivot rows in descending order of leading column. The reduced
     // pivots go into reduced and we update pivotRowOfCol to refer to the
@@ -376,34 +1338,202 @@ namespace {
         continue;
       rowToReduce.clear(colCount);
       rowToReduce.addRow(pivots, row);
-      MATHICGB_ASSERT(rowToReduce[pivotCol] == 1); // unitary
-      for (auto col = pivotCol + 1; col != colCount; ++col) {
-        auto& entry = rowToReduce[col];
-        if (entry == 0)
+      reduceTail
+        (rowToReduce, pivotCol, reduced, pivotRowOfCol, modulus, kept);
+      MATHICGB_ASSERT(!kept.empty());
+      MATHICGB_ASSERT(kept.front().first == pivotCol);
+      MATHICGB_ASSERT(kept.front().second == 1); // unitary
+      pivotRowOfCol[pivotCol] = reduced.rowCount();
+      appendKept(kept, reduced);
+    }
+    return std::move(reduced);
+  }
+
+  /// Returns the same matrix as reduceToEchelonFormSparse, but does most of
+  /// the work in parallel.
+  ///
+  /// The rows are processed batchSize at a time. First all the rows in a
+  /// batch are reduced in parallel by the pivots found before that batch
+  /// until their leading column has no pivot. Then the rows of the batch
+  /// are finished one at a time in order, which only requires further
+  /// reduction where a row of the same batch became a pivot. This is the
+  /// exact sequence of reduction steps that the sequential method performs,
+  /// so the pivot rows are the same.
+  ///
+  /// The back substitution is done in blocks of batchSize pivots in
+  /// descending order of pivot column. The rows of a block are reduced in
+  /// parallel by the already finished rows to the right of the block and
+  /// then one at a time by the rows of the block. The reduced row echelon
+  /// form is unique, so this also gives the same output.
+  template<class Row>
+  typename Row::Matrix reduceToEchelonFormSparseParallel(
+    const typename Row::Matrix& toReduce,
+    const typename Row::Scalar modulus,
+    const SparseMatrix::RowIndex batchSize
+  ) {
+    typedef typename Row::Matrix Matrix;
+    typedef typename Row::Scalar Scalar;
+    MATHICGB_ASSERT(batchSize > 0);
+    const auto colCount = toReduce.computeColCount();
+    const auto rowCount = toReduce.rowCount();
+
+    const auto noRow = static_cast<SparseMatrix::RowIndex>(-1);
+
+    // pivotRowOfCol[i] is the pivot in column i or noRow
+    // if we have not identified such a pivot so far.
+    std::vector<SparseMatrix::RowIndex> pivotRowOfCol(colCount, noRow);
+
+    // Returns the positions in rows of the rows that came from
+    // offset, offset + 1 and so on up to offset + count, with noRow for
+    // rows that are not there.
+    const auto positionsOf = [&](
+      const std::vector<SparseMatrix::RowIndex>& origins,
+      const SparseMatrix::RowIndex offset,
+      const SparseMatrix::RowIndex count
+    ) -> std::vector<SparseMatrix::RowIndex> {
+      std::vector<SparseMatrix::RowIndex> positions(count, noRow);
+      for (SparseMatrix::RowIndex i = 0; i < origins.size(); ++i) {
+        MATHICGB_ASSERT(origins[i] - offset < count);
+        positions[origins[i] - offset] = i;
+      }
+      return positions;
+    };
+
+    mgb::mtbb::enumerable_thread_specific<Row> denseRowPerThread([&](){
+      return Row();
+    });
+    typedef std::vector<std::pair<SparseMatrix::ColIndex, Scalar>> Kept;
+    mgb::mtbb::enumerable_thread_specific<Kept> keptPerThread([&](){
+      return Kept();
+    });
+    Row rowToReduce(colCount);
+    Kept kept;
+
+    // ** Reduce to row echelon form -- every row is a pivot row.
+    Matrix pivots(colCount);
+    for (SparseMatrix::RowIndex batchBegin = 0; batchBegin < rowCount;) {
+      const auto batchEnd = batchBegin + std::min(batchSize, rowCount - batchBegin);
+
+      mgb::mtbb::enumerable_thread_specific<ThreadRows<Scalar>> perThread(
+        [&](){return ThreadRows<Scalar>(0);}
+      );
+      mgb::mtbb::parallel_for(
+        mgb::mtbb::blocked_range<SparseMatrix::RowIndex>(batchBegin, batchEnd),
+        [&](const mgb::mtbb::blocked_range<SparseMatrix::RowIndex>& range)
+        {for (auto it = range.begin(); it != range.end(); ++it)
+      {
+        const auto row = it;
+        if (toReduce.emptyRow(row))
           continue;
-        entry %= modulus;
-        if (entry == 0)
+        auto& denseRow = denseRowPerThread.local();
+        denseRow.clear(colCount);
+        denseRow.addRow(toReduce, row);
+        SparseMatrix::ColIndex leadingCol;
+        const auto leading = reduceLeading
+          (denseRow, leadingCol, pivots, pivotRowOfCol, modulus);
+        if (leading == 0)
+          continue;
+        auto& out = perThread.local();
+        out.matrix.appendEntry(leadingCol, leading);
+        appendRemaining(denseRow, 1, out.matrix, modulus);
+        out.matrix.rowDone();
+        out.origins.push_back(row);
+      }});
+
+      std::vector<SparseMatrix::RowIndex> origins;
+      const auto candidates = mergeThreadRows<Scalar>(perThread, origins, 0);
+      const auto candidateOf =
+        positionsOf(origins, batchBegin, batchEnd - batchBegin);
+      for (size_t i = 0; i < candidateOf.size(); ++i) {
+        const auto candidate = candidateOf[i];
+        if (candidate == noRow)
           continue;
-        const auto pivotRow = pivotRowOfCol[col];
-        if (pivotRow != noRow)
-          rowToReduce.rowReduceByUnitary(pivotRow, reduced, modulus);
-        MATHICGB_ASSERT(entry < modulus);
+        rowToReduce.clear(colCount);
+        rowToReduce.addRow(candidates, candidate);
+        SparseMatrix::ColIndex leadingCol;
+        const auto leading = reduceLeading
+          (rowToReduce, leadingCol, pivots, pivotRowOfCol, modulus);
+        if (leading == 0)
+          continue;
+        pivotRowOfCol[leadingCol] = pivots.rowCount();
+        pivots.appendEntry(leadingCol, 1);
+        appendRemaining
+          (rowToReduce, modularInverse(leading, modulus), pivots, modulus);
+        pivots.rowDone();
       }
-      pivotRowOfCol[pivotCol] = reduced.rowCount();
-      rowToReduce.appendTo(reduced);
+      batchBegin = batchEnd;
+    }
+
+    // ** Reduce from row echelon form to reduced row echelon form
+
+    std::vector<SparseMatrix::ColIndex> pivotCols; // in descending order
+    for (auto col = colCount; col != 0;) {
+      --col;
+      if (pivotRowOfCol[col] != noRow)
+        pivotCols.push_back(col);
+    }
+    const auto pivotCount = static_cast<SparseMatrix::RowIndex>(pivotCols.size());
+
+    // The reduced pivots go into reduced and we update pivotRowOfCol to
+    // refer to the row indices in reduced as we go along.
+    Matrix reduced(colCount);
+    for (SparseMatrix::RowIndex blockBegin = 0; blockBegin < pivotCount;) {
+      const auto blockEnd =
+        blockBegin + std::min(batchSize, pivotCount - blockBegin);
+      // All pivots in columns to the right of blockCol are finished.
+      const auto blockCol = pivotCols[blockBegin];
+
+      mgb::mtbb::enumerable_thread_specific<ThreadRows<Scalar>> perThread(
+        [&](){return ThreadRows<Scalar>(0);}
+      );
+      mgb::mtbb::parallel_for(
+        mgb::mtbb::blocked_range<SparseMatrix::RowIndex>(blockBegin, blockEnd),
+        [&](const mgb::mtbb::blocked_range<SparseMatrix::RowIndex>& range)
+        {for (auto it = range.begin(); it != range.end(); ++it)
+      {
+        const auto i = it;
+        auto& denseRow = denseRowPerThread.local();
+        auto& threadKept = keptPerThread.local();
+        denseRow.clear(colCount);
+        denseRow.addRow(pivots, pivotRowOfCol[pivotCols[i]]);
+        reduceTail
+          (denseRow, blockCol, reduced, pivotRowOfCol, modulus, threadKept);
+        auto& out = perThread.local();
+        appendKept(threadKept, out.matrix);
+        out.origins.push_back(i);
+      }});
+
+      std::vector<SparseMatrix::RowIndex> origins;
+      const auto blockRows = mergeThreadRows<Scalar>(perThread, origins, 0);
+      const auto blockRowOf =
+        positionsOf(origins, blockBegin, blockEnd - blockBegin);
+      for (size_t i = 0; i < blockRowOf.size(); ++i) {
+        const auto pivotCol = pivotCols[blockBegin + i];
+        rowToReduce.clear(colCount);
+        rowToReduce.addRow(blockRows, blockRowOf[i]);
+        reduceTail
+          (rowToReduce, pivotCol, reduced, pivotRowOfCol, modulus, kept);
+        MATHICGB_ASSERT(!kept.empty());
+        MATHICGB_ASSERT(kept.front().first == pivotCol);
+        MATHICGB_ASSERT(kept.front().second == 1); // unitary
+        pivotRowOfCol[pivotCol] = reduced.rowCount();
+        appendKept(kept, reduced);
+      }
+      blockBegin = blockEnd;
     }
     return std::move(reduced);
   }
 
-  SparseMatrix reduceToEchelonForm(
-    const SparseMatrix& toReduce,
-    const SparseMatrix::Scalar modulus
+  template<class S>
+  BasicSparseMatrix<S> reduceToEchelonForm(
+    const BasicSparseMatrix<S>& toReduce,
+    const S modulus
   ) {
     const auto colCount = toReduce.computeColCount();
     const auto rowCount = toReduce.rowCount();
 
     // convert to dense representation 
-    std::vector<DenseRow> dense(rowCount);
+    std::vector<DenseRow<S>> dense(rowCount);
     mgb::mtbb::parallel_for(mgb::mtbb::blocked_range<SparseMatrix::RowIndex>(0, rowCount),
       [&](const mgb::mtbb::blocked_range<SparseMatrix::RowIndex>& range)
       {for (auto it = range.begin(); it != range.end(); ++it)
@@ -419,7 +1549,7 @@ namespace {
     std::vector<SparseMatrix::ColIndex> leadCols(rowCount);
 
     // pivot rows get copied here before being used to reduce the matrix.
-    SparseMatrix reduced(toReduce.memoryQuantum());
+    BasicSparseMatrix<S> reduced(toReduce.memoryQuantum());
 
     // (col,row) in nextReducers, then use row as a pivot in column col
     // for the next iteration.
@@ -445,7 +1575,7 @@ namespace {
       {
         const auto row = it;
         MATHICGB_ASSERT(leadCols[row] <= colCount);
-        DenseRow& denseRow = dense[row];
+        DenseRow<S>& denseRow = dense[row];
         if (denseRow.empty())
           continue;
 
@@ -461,7 +1591,7 @@ namespace {
         SparseMatrix::ColIndex col;
         MATHICGB_ASSERT(leadCols[row] <= colCount);
         for (col = leadCols[row]; col < colCount; ++col) {
-          denseRow[col] %= modulus;
+          denseRow[col] = denseRow.modulusOf(denseRow[col], modulus);
           if (denseRow[col] != 0)
             break;
         }
@@ -550,14 +1680,15 @@ namespace {
   }
 }
 
+template<class S>
 void addRowMultipleInplace(
-  std::vector< std::vector<SparseMatrix::Scalar> >& matrix,
+  std::vector<std::vector<S>>& matrix,
   const SparseMatrix::RowIndex addRow,
-  const SparseMatrix::Scalar multiple,
+  const S multiple,
   const SparseMatrix::RowIndex row,
   const SparseMatrix::ColIndex leadingCol,
   const SparseMatrix::ColIndex colCount,
-  const SparseMatrix::Scalar modulus
+  const BarrettModulus<S>& modulus
 ) {
   assert(addRow < matrix.size());
   assert(row < matrix.size());
@@ -568,30 +1699,33 @@ void addRowMultipleInplace(
   for(auto col = leadingCol; col < colCount; ++col){
     const auto product = modularProduct
       (multiple, matrix[addRow][col], modulus);
-    matrix[row][col] = modularSum(matrix[row][col], product, modulus);
+    matrix[row][col] =
+      modularSum(matrix[row][col], product, modulus.modulus());
   }
 }
 
+template<class S>
 void makeRowUnitary(
-  std::vector< std::vector<SparseMatrix::Scalar>>& matrix,
+  std::vector<std::vector<S>>& matrix,
   const SparseMatrix::RowIndex row,
   const SparseMatrix::ColIndex colCount,
   const SparseMatrix::ColIndex leadingCol,
-  const SparseMatrix::Scalar modulus
+  const BarrettModulus<S>& modulus
 ) {
   assert(row<matrix.size());
   assert(matrix[row].size() == colCount);
   assert(leadingCol < colCount);
-  assert(modulus> 1);
+  assert(modulus.modulus() > 1);
   const auto leadingScalar = matrix[row][leadingCol];
   assert(leadingScalar != 0);
-  auto multiply = modularInverse(leadingScalar, modulus);
+  auto multiply = modularInverse(leadingScalar, modulus.modulus());
   for(SparseMatrix::ColIndex col = leadingCol; col < colCount; ++col)
     matrix[row][col] = modularProduct(matrix[row][col], multiply, modulus);
 }
 
+template<class S>
 SparseMatrix::ColIndex leadingColumn(
-  const std::vector< std::vector<SparseMatrix::Scalar>>& matrix,
+  const std::vector<std::vector<S>>& matrix,
   const SparseMatrix::RowIndex row,
   const SparseMatrix::ColIndex colCount,
   SparseMatrix::ColIndex startAtCol 
@@ -605,14 +1739,16 @@ SparseMatrix::ColIndex leadingColumn(
   return colCount;
 }
 
+template<class S>
 void rowReducedEchelonMatrix(
-  std::vector< std::vector<SparseMatrix::Scalar> >& matrix,
+  std::vector<std::vector<S>>& matrix,
   const SparseMatrix::ColIndex colCount,
-  const SparseMatrix::Scalar modulus
+  const S modulus
 ) {
   assert(matrix.empty() || matrix[0].size() == colCount);
   const	SparseMatrix::RowIndex rowCount =
     static_cast<SparseMatrix::RowIndex>(matrix.size());
+  const BarrettModulus<S> barrett(modulus);
   // pivotRowOfCol[i] is the pivot in column i or rowCount
   // if we have not identified such a pivot so far.
   std::vector<SparseMatrix::RowIndex> pivotRowOfCol(colCount, rowCount);
@@ -626,13 +1762,13 @@ void rowReducedEchelonMatrix(
         break; // row was zero
       const auto pivotRow = pivotRowOfCol[leadingCol];
       if(pivotRow == rowCount) {
-        makeRowUnitary(matrix, row, colCount, leadingCol, modulus);
+        makeRowUnitary(matrix, row, colCount, leadingCol, barrett);
         pivotRowOfCol[leadingCol] = row;
         break; // row is now a pivot
       }
       const auto multiple = modularNegative(matrix[row][leadingCol], modulus);
 	  addRowMultipleInplace
-	    (matrix, pivotRow, multiple, row, leadingCol, colCount, modulus);
+	    (matrix, pivotRow, multiple, row, leadingCol, colCount, barrett);
     }
   }
 
@@ -647,20 +1783,21 @@ void rowReducedEchelonMatrix(
         continue; // no pivot for this column
       const auto multiple = modularNegative(matrix[row][col], modulus);
 	  addRowMultipleInplace
-        (matrix, pivotRow, multiple, row, col, colCount, modulus);
+        (matrix, pivotRow, multiple, row, col, colCount, barrett);
     }
   }
 }   
 
-SparseMatrix reduceToEchelonFormShrawan(
-  const SparseMatrix& toReduce,
-  SparseMatrix::Scalar modulus
+template<class S>
+BasicSparseMatrix<S> reduceToEchelonFormShrawan(
+  const BasicSparseMatrix<S>& toReduce,
+  S modulus
 ) {
   const SparseMatrix::RowIndex rowCount = toReduce.rowCount();
   const auto colCount = toReduce.computeColCount();
 
   // Convert input matrix to dense format
-  std::vector< std::vector<SparseMatrix::Scalar>> matrix(rowCount);
+  std::vector<std::vector<S>> matrix(rowCount);
   for (SparseMatrix::RowIndex row = 0; row < rowCount; ++row) {
     MATHICGB_ASSERT(!toReduce.emptyRow(row));
     matrix[row].resize(colCount);
@@ -674,7 +1811,7 @@ SparseMatrix reduceToEchelonFormShrawan(
   rowReducedEchelonMatrix(matrix, colCount, modulus);
 
   // convert reduced matrix to SparseMatrix.
-  SparseMatrix reduced;
+  BasicSparseMatrix<S> reduced;
   for (size_t row = 0; row < rowCount; ++row) {
     bool rowIsZero = true;
     for (SparseMatrix::ColIndex col = 0; col < colCount; ++col) {
@@ -689,15 +1826,16 @@ SparseMatrix reduceToEchelonFormShrawan(
   return std::move(reduced);
 }
 
-SparseMatrix reduceToEchelonFormShrawanDelayedModulus(
-  const SparseMatrix& toReduce,
-  SparseMatrix::Scalar modulus
+template<class S>
+BasicSparseMatrix<S> reduceToEchelonFormShrawanDelayedModulus(
+  const BasicSparseMatrix<S>& toReduce,
+  S modulus
 ) {
   const SparseMatrix::RowIndex rowCount = toReduce.rowCount();
   const auto colCount = toReduce.computeColCount();
 
   // Convert input matrix to dense format
-  std::vector< std::vector<SparseMatrix::Scalar>> matrix(rowCount);
+  std::vector<std::vector<S>> matrix(rowCount);
   for (SparseMatrix::RowIndex row = 0; row < rowCount; ++row) {
     MATHICGB_ASSERT(!toReduce.emptyRow(row));
     matrix[row].resize(colCount);
@@ -711,7 +1849,7 @@ SparseMatrix reduceToEchelonFormShrawanDelayedModulus(
   rowReducedEchelonMatrix(matrix, colCount, modulus);
 
   // convert reduced matrix to SparseMatrix.
-  SparseMatrix reduced;
+  BasicSparseMatrix<S> reduced;
   for (size_t row = 0; row < rowCount; ++row) {
     bool rowIsZero = true;
     for (SparseMatrix::ColIndex col = 0; col < colCount; ++col) {
@@ -726,67 +1864,218 @@ SparseMatrix reduceToEchelonFormShrawanDelayedModulus(
   return std::move(reduced);
 }
 
-SparseMatrix F4MatrixReducer::reduceToBottomRight(const QuadMatrix& matrix) {
+namespace {
+  /// this has to be a separate function that returns the scalar since signed
+  /// overflow is undefine behavior so we cannot check after the cast and
+  /// we also cannot set the modulus field inside the constructor since it is
+  /// const.
+  template<class Scalar>
+  Scalar checkModulus(const coefficient modulus) {
+    // this assert has to be NO_ASSUME as otherwise the branch below will get
+    // optimized out.
+    MATHICGB_ASSERT_NO_ASSUME(modulus <=
+      std::numeric_limits<Scalar>::max());
+    if (modulus > std::numeric_limits<Scalar>::max())
+      throw std::overflow_error("Too large modulus in F4 matrix reduction.");
+    return static_cast<Scalar>(modulus);
+  }
+}
+
+template<class S>
+BasicSparseMatrix<S> F4MatrixReducer::reduceToBottomRight(
+  const BasicQuadMatrix<S>& matrix
+) {
+  const auto modulus = checkModulus<S>(mModulus);
   MATHICGB_ASSERT(matrix.debugAssertValid());
   MATHICGB_LOG_TIME(F4MatReduceTop);
   MATHICGB_LOG_TIME(F4MatrixReduce) <<
     "\n***** Reducing QuadMatrix to bottom right matrix *****\n";
-  MATHICGB_IF_STREAM_LOG(F4MatrixReduce)
-    {matrix.printStatistics(log.stream());};
+  MATHICGB_IF_STREAM_LOG(F4MatrixReduce) {
+    matrix.printStatistics(stream);
+    stream << "Using " << sizeof(S) * 8 << " bit scalars and the "
+      << rowKernel<S>().name << " row update kernel.\n";
+    if (mFaugereLachartre)
+      stream << "Using Faugere-Lachartre reduction.\n";
+  };
 
-  return reduce(matrix, mModulus);
+  if (mFaugereLachartre)
+    return reduceFaugereLachartre(matrix, modulus);
+
+  // The left part is where a dense row has to go through every column for
+  // every bottom row.
+  const bool sparse =
+    preferSparseAccumulator(matrix.topLeft.computeDensity()) &&
+    preferSparseAccumulator(matrix.bottomLeft.computeDensity());
+  MATHICGB_LOG(F4MatrixReduce) << "Using a "
+    << (sparse ? "sparse accumulator" : "dense row")
+    << " for the bottom rows.\n";
+  if (sparse)
+    return reduce<SparseAccumulator<S>>(matrix, modulus);
+  else
+    return reduce<DenseRow<S>>(matrix, modulus);
 }
 
-SparseMatrix F4MatrixReducer::reducedRowEchelonForm(
-  const SparseMatrix& matrix
+template<class S>
+BasicSparseMatrix<S> F4MatrixReducer::reducedRowEchelonForm(
+  const BasicSparseMatrix<S>& matrix
 ) {
+  const auto modulus = checkModulus<S>(mModulus);
   MATHICGB_LOG_TIME(F4RedBottomRight);
   MATHICGB_LOG_TIME(F4MatrixReduce) <<
     "\n***** Reducing SparseMatrix to reduced row echelon form *****\n";
-  MATHICGB_IF_STREAM_LOG(F4MatrixReduce)
-    {matrix.printStatistics(log.stream());};
+  MATHICGB_IF_STREAM_LOG(F4MatrixReduce) {
+    matrix.printStatistics(stream);
+    stream << "Using " << sizeof(S) * 8 << " bit scalars and the "
+      << rowKernel<S>().name << " row update kernel.\n";
+  };
 
   const bool useShrawan = false;
   const bool useDelayedModulus = false;
   if (useShrawan) {
     if (useDelayedModulus)
-      return reduceToEchelonFormShrawanDelayedModulus(matrix, mModulus);
+      return reduceToEchelonFormShrawanDelayedModulus(matrix, modulus);
     else    
-      return reduceToEchelonFormShrawan(matrix, mModulus);
+      return reduceToEchelonFormShrawan(matrix, modulus);
   } else {
     // todo: actually do some work to find a good way to determine
     // when to use the sparse method, or alternatively make some
     // sort of hybrid.
-    if (matrix.computeDensity() < 0.02)
-      return reduceToEchelonFormSparse(matrix, mModulus);
-    else
-      return reduceToEchelonForm(matrix, mModulus);
+    const auto density = matrix.computeDensity();
+    if (density >= 0.02)
+      return reduceToEchelonForm(matrix, modulus);
+
+    const bool sparse = preferSparseAccumulator(density);
+    MATHICGB_LOG(F4MatrixReduce) << "Using a "
+      << (sparse ? "sparse accumulator" : "dense row")
+      << " for the sparse reduction.\n";
+    if (mParallelSparse && matrix.rowCount() > ParallelSparseBatchSize) {
+      if (sparse) {
+        return reduceToEchelonFormSparseParallel<SparseAccumulator<S>>
+          (matrix, modulus, ParallelSparseBatchSize);
+      } else {
+        return reduceToEchelonFormSparseParallel<DenseRow<S>>
+          (matrix, modulus, ParallelSparseBatchSize);
+      }
+    } else {
+      if (sparse)
+        return reduceToEchelonFormSparse<SparseAccumulator<S>>(matrix, modulus);
+      else
+        return reduceToEchelonFormSparse<DenseRow<S>>(matrix, modulus);
+    }
   }
 }
 
-SparseMatrix F4MatrixReducer::reducedRowEchelonFormBottomRight(
-  const QuadMatrix& matrix
+template<class S>
+BasicSparseMatrix<S> F4MatrixReducer::reduceByLowerRanks(
+  const BasicSparseMatrix<S>& matrix,
+  const std::vector<size_t>& ranks,
+  const std::vector<char>& mustTopReduce,
+  std::vector<char>& singular
+) {
+  const auto modulus = checkModulus<S>(mModulus);
+  MATHICGB_LOG_TIME(F4MatrixReduce) <<
+    "\n***** Reducing SparseMatrix by rows of lower rank *****\n";
+  MATHICGB_IF_STREAM_LOG(F4MatrixReduce) {
+    matrix.printStatistics(stream);
+    stream << "Using " << sizeof(S) * 8 << " bit scalars and the "
+      << rowKernel<S>().name << " row update kernel.\n";
+  };
+
+  const bool sparse = preferSparseAccumulator(matrix.computeDensity());
+  MATHICGB_LOG(F4MatrixReduce) << "Using a "
+    << (sparse ? "sparse accumulator" : "dense row")
+    << " for the rows.\n";
+  if (sparse) {
+    return reduceRowsByLowerRanks<SparseAccumulator<S>>
+      (matrix, ranks, mustTopReduce, singular, modulus);
+  } else {
+    return reduceRowsByLowerRanks<DenseRow<S>>
+      (matrix, ranks, mustTopReduce, singular, modulus);
+  }
+}
+
+template<class S>
+BasicSparseMatrix<S> F4MatrixReducer::reducedRowEchelonFormBottomRight(
+  const BasicQuadMatrix<S>& matrix
 ) {
   return reducedRowEchelonForm(reduceToBottomRight(matrix));
 }
 
-namespace {
-  /// this has to be a separate function that returns the scalar since signed
-  /// overflow is undefine behavior so we cannot check after the cast and
-  /// we also cannot set the modulus field inside the constructor since it is
-  /// const.
-  SparseMatrix::Scalar checkModulus(const coefficient modulus) {
-    // this assert has to be NO_ASSUME as otherwise the branch below will get
-    // optimized out.
-    MATHICGB_ASSERT_NO_ASSUME(modulus <=
-      std::numeric_limits<SparseMatrix::Scalar>::max());
-    if (modulus > std::numeric_limits<SparseMatrix::Scalar>::max())
-      throw std::overflow_error("Too large modulus in F4 matrix reduction.");
-    return static_cast<SparseMatrix::Scalar>(modulus);
-  }
+template<class S>
+std::vector<SparseMatrix::RowIndex> F4MatrixReducer::pivotBottomRows(
+  const BasicQuadMatrix<S>& matrix
+) {
+  const auto modulus = checkModulus<S>(mModulus);
+  MATHICGB_ASSERT(matrix.debugAssertValid());
+  MATHICGB_LOG_TIME(F4MatrixReduce) <<
+    "\n***** Finding the bottom rows that give new pivots *****\n";
+
+  std::vector<SparseMatrix::RowIndex> origins;
+  const auto reduced = reduce<DenseRow<S>>(matrix, modulus, &origins);
+  MATHICGB_ASSERT(origins.size() == reduced.rowCount());
+  auto pivotRows = echelonPivotRows<DenseRow<S>>(reduced, modulus);
+  for (auto& row : pivotRows)
+    row = origins[row];
+  return pivotRows;
 }
 
+const float F4MatrixReducer::DefaultSparseAccumulatorDensity = 0.002f;
+
 F4MatrixReducer::F4MatrixReducer(const coefficient modulus):
-  mModulus(checkModulus(modulus)) {}
+  mModulus(checkModulus<uint32>(modulus)),
+  mParallelSparse(true),
+  mFaugereLachartre(false),
+  mSparseAccumulatorDensity(DefaultSparseAccumulatorDensity)
+{}
+
+template BasicSparseMatrix<uint8> F4MatrixReducer::reduceToBottomRight
+  (const BasicQuadMatrix<uint8>&);
+template BasicSparseMatrix<uint16> F4MatrixReducer::reduceToBottomRight
+  (const BasicQuadMatrix<uint16>&);
+template BasicSparseMatrix<uint32> F4MatrixReducer::reduceToBottomRight
+  (const BasicQuadMatrix<uint32>&);
+
+template BasicSparseMatrix<uint8> F4MatrixReducer::reduceByLowerRanks(
+  const BasicSparseMatrix<uint8>&,
+  const std::vector<size_t>&,
+  const std::vector<char>&,
+  std::vector<char>&
+);
+template BasicSparseMatrix<uint16> F4MatrixReducer::reduceByLowerRanks(
+  const BasicSparseMatrix<uint16>&,
+  const std::vector<size_t>&,
+  const std::vector<char>&,
+  std::vector<char>&
+);
+template BasicSparseMatrix<uint32> F4MatrixReducer::reduceByLowerRanks(
+  const BasicSparseMatrix<uint32>&,
+  const std::vector<size_t>&,
+  const std::vector<char>&,
+  std::vector<char>&
+);
+
+template BasicSparseMatrix<uint8> F4MatrixReducer::reducedRowEchelonForm
+  (const BasicSparseMatrix<uint8>&);
+template BasicSparseMatrix<uint16> F4MatrixReducer::reducedRowEchelonForm
+  (const BasicSparseMatrix<uint16>&);
+template BasicSparseMatrix<uint32> F4MatrixReducer::reducedRowEchelonForm
+  (const BasicSparseMatrix<uint32>&);
+
+template BasicSparseMatrix<uint8>
+F4MatrixReducer::reducedRowEchelonFormBottomRight
+  (const BasicQuadMatrix<uint8>&);
+template BasicSparseMatrix<uint16>
+F4MatrixReducer::reducedRowEchelonFormBottomRight
+  (const BasicQuadMatrix<uint16>&);
+template BasicSparseMatrix<uint32>
+F4MatrixReducer::reducedRowEchelonFormBottomRight
+  (const BasicQuadMatrix<uint32>&);
+
+template std::vector<SparseMatrix::RowIndex>
+F4MatrixReducer::pivotBottomRows(const BasicQuadMatrix<uint8>&);
+template std::vector<SparseMatrix::RowIndex>
+F4MatrixReducer::pivotBottomRows(const BasicQuadMatrix<uint16>&);
+template std::vector<SparseMatrix::RowIndex>
+F4MatrixReducer::pivotBottomRows(const BasicQuadMatrix<uint32>&);
 
 MATHICGB_NAMESPACE_END
@@ -7,7 +7,8 @@
 
 MATHICGB_NAMESPACE_BEGIN
 
-class QuadMatrix;
+template<class S>
+class BasicQuadMatrix;
 class PolyRing;
 
 /// Class that reduces an F4 matrix represented as a QuadMatrix. The
@@ -17,6 +18,10 @@ class PolyRing;
 /// assumed to have a permutation of the top rows and left columns so
 /// that the top left matrix is upper unitriangular. In this way the
 /// lower left part of the matrix becomes all-zero after row reduction.
+///
+/// The methods are templates on the scalar type S of the matrices, which
+/// must be able to hold every residue modulo the modulus. They are
+/// instantiated for uint8, uint16 and uint32.
 class F4MatrixReducer {
 public:
   /// The ring used is Z/pZ where modulus is the prime p.
@@ -25,18 +30,84 @@ public:
   /// Reduces the bottom rows by the top rows and returns the bottom right
   /// submatrix of the resulting quad matrix. The lower left submatrix
   /// is not returned because it is always zero after row reduction.
-  SparseMatrix reduceToBottomRight(const QuadMatrix& matrix);
+  template<class S>
+  BasicSparseMatrix<S> reduceToBottomRight(const BasicQuadMatrix<S>& matrix);
 
   /// Returns the reduced row echelon form of matrix.
-  SparseMatrix reducedRowEchelonForm(const SparseMatrix& matrix);
+  template<class S>
+  BasicSparseMatrix<S> reducedRowEchelonForm(
+    const BasicSparseMatrix<S>& matrix
+  );
+
+  /// Reduces the rows of matrix one at a time in order and returns the
+  /// results, which have the same row indices. The entries of each row
+  /// must be non-zero and in increasing order of column. The ranks of the
+  /// rows must be increasing and row r is only reduced by the results of earlier rows
+  /// of a smaller rank than ranks[r]. Of those with the same leading column
+  /// the first one is used. The non-zero results are monic. If
+  /// mustTopReduce[r] is true and the leading entry of row r cannot be
+  /// reduced in this way, then singular[r] is set to true and the result
+  /// for row r is empty and is not used to reduce other rows. This is
+  /// regular reduction as in F5 when the ranks order the rows by signature.
+  template<class S>
+  BasicSparseMatrix<S> reduceByLowerRanks(
+    const BasicSparseMatrix<S>& matrix,
+    const std::vector<size_t>& ranks,
+    const std::vector<char>& mustTopReduce,
+    std::vector<char>& singular
+  );
+
+  /// Sets whether reducedRowEchelonForm may use the parallel method for
+  /// sparse matrices. The output is the same either way. The default is
+  /// true.
+  void setParallelSparseReduction(bool value) {mParallelSparse = value;}
+
+  /// Sets whether reduceToBottomRight uses the Faugere-Lachartre method,
+  /// which first reduces the top right matrix by the top left matrix and
+  /// then uses that to reduce the bottom rows. The output is the same
+  /// either way. The default is false.
+  void setFaugereLachartre(bool value) {mFaugereLachartre = value;}
+
+  /// Sets the density, as computed by SparseMatrix::computeDensity, below
+  /// which the rows being reduced are accumulated in a sparse structure
+  /// rather than in a dense row. The output is the same either way. The
+  /// default is DefaultSparseAccumulatorDensity.
+  void setSparseAccumulatorDensity(float density) {
+    mSparseAccumulatorDensity = density;
+  }
+
+  static const float DefaultSparseAccumulatorDensity;
 
   /// Returns the lower right submatrix of the reduced row echelon
   /// form of matrix. The lower left part is not returned because it is
   /// always zero after row reduction.
-  SparseMatrix reducedRowEchelonFormBottomRight(const QuadMatrix& matrix);
+  template<class S>
+  BasicSparseMatrix<S> reducedRowEchelonFormBottomRight(
+    const BasicQuadMatrix<S>& matrix
+  );
+
+  /// Returns the indices, in increasing order, of bottom rows of matrix
+  /// whose reductions by the top rows span the same space as the
+  /// reductions of all the bottom rows. So reducing just those bottom rows
+  /// gives the same bottom right reduced row echelon form. A bottom row is
+  /// included if it gives a new pivot when the reduced bottom rows are
+  /// put into row echelon form one at a time in order.
+  template<class S>
+  std::vector<SparseMatrix::RowIndex> pivotBottomRows(
+    const BasicQuadMatrix<S>& matrix
+  );
 
 private:
-  const SparseMatrix::Scalar mModulus;
+  /// Returns true if a matrix with the given density is sparse enough
+  /// to use a sparse accumulator.
+  bool preferSparseAccumulator(float density) const {
+    return density < mSparseAccumulatorDensity;
+  }
+
+  const uint32 mModulus;
+  bool mParallelSparse;
+  bool mFaugereLachartre;
+  float mSparseAccumulatorDensity;
 };
 
 MATHICGB_NAMESPACE_END
@@ -1,16 +1,18 @@
-// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+    // MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
 // NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
 #include "stdinc.h"
 #include "F4ProtoMatrix.hpp"
 
 MATHICGB_NAMESPACE_BEGIN
 
-auto F4ProtoMatrix::row(const RowIndex row) const -> Row {
+template<class S>
+auto BasicF4ProtoMatrix<S>::row(const RowIndex row) const -> Row {
   MATHICGB_ASSERT(row < mRows.size());
   const auto& r = mRows[row];
   Row rr;
   rr.indices = mIndices.data() + r.indicesBegin;
   rr.entryCount = r.entryCount;
+  rr.source = r.source;
   if (!r.scalarsStoredExternally) {
     rr.scalars = mScalars.data() + r.scalarsBegin;
   } else {
@@ -20,8 +22,10 @@ auto F4ProtoMatrix::row(const RowIndex row) const -> Row {
   return rr;
 }
 
-auto F4ProtoMatrix::makeRowWithTheseScalars(const Poly& scalars) -> ColIndex*
-{
+template<class S>
+auto BasicF4ProtoMatrix<S>::makeRowWithTheseScalars(
+  const Poly& scalars
+) -> ColIndex* {
   MATHICGB_ASSERT(rowCount() < std::numeric_limits<RowIndex>::max());
   MATHICGB_ASSERT(scalars.termCount() < std::numeric_limits<ColIndex>::max());
 
@@ -31,13 +35,17 @@ auto F4ProtoMatrix::makeRowWithTheseScalars(const Poly& scalars) -> ColIndex*
   row.entryCount = static_cast<ColIndex>(scalars.termCount());
   row.scalarsStoredExternally = true;
   row.externalScalars = scalars.coefBegin();
+  row.source = &scalars;
   mRows.push_back(row);
 
   mIndices.resize(mIndices.size() + row.entryCount);
   return mIndices.data() + row.indicesBegin;
 }
 
-auto F4ProtoMatrix::makeRow(ColIndex entryCount) -> std::pair<ColIndex*, Scalar*> {
+template<class S>
+auto BasicF4ProtoMatrix<S>::makeRow(
+  ColIndex entryCount
+) -> std::pair<ColIndex*, Scalar*> {
   MATHICGB_ASSERT(rowCount() < std::numeric_limits<RowIndex>::max());
 
   InternalRow row;
@@ -45,6 +53,7 @@ auto F4ProtoMatrix::makeRow(ColIndex entryCount) -> std::pair<ColIndex*, Scalar*
   row.scalarsBegin = mScalars.size();
   row.entryCount = entryCount;
   row.scalarsStoredExternally = false;
+  row.source = nullptr;
   mRows.push_back(row);
 
   mIndices.resize(mIndices.size() + entryCount);
@@ -55,7 +64,11 @@ auto F4ProtoMatrix::makeRow(ColIndex entryCount) -> std::pair<ColIndex*, Scalar*
   );
 }
 
-void F4ProtoMatrix::removeLastEntries(const RowIndex row, const ColIndex count) {
+template<class S>
+void BasicF4ProtoMatrix<S>::removeLastEntries(
+  const RowIndex row,
+  const ColIndex count
+) {
   MATHICGB_ASSERT(row < rowCount());
   MATHICGB_ASSERT(mRows[row].entryCount >= count);
   mRows[row].entryCount -= count;
@@ -66,4 +79,8 @@ void F4ProtoMatrix::removeLastEntries(const RowIndex row, const ColIndex count)
     mScalars.resize(mScalars.size() - count);
 }
 
+template class BasicF4ProtoMatrix<uint8>;
+template class BasicF4ProtoMatrix<uint16>;
+template class BasicF4ProtoMatrix<uint32>;
+
 MATHICGB_NAMESPACE_END
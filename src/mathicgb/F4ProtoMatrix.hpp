@@ -9,27 +9,38 @@
 
 MATHICGB_NAMESPACE_BEGIN
 
-class F4ProtoMatrix {
+/// Rows of an F4 matrix before they have been split into the four parts
+/// of a QuadMatrix. The scalars have type S, as for BasicSparseMatrix.
+template<class S>
+class BasicF4ProtoMatrix {
 public:
   typedef uint32 RowIndex;
   typedef uint32 ColIndex;
-  typedef SparseMatrix::Scalar Scalar;
+  typedef typename BasicSparseMatrix<S>::Scalar Scalar;
   typedef coefficient ExternalScalar;
   typedef Poly::ConstCoefIterator ExternalConstCoefIterator;
 
   struct Row {
-    Row(): indices(), scalars(), externalScalars(), entryCount() {}
+    Row():
+      indices(), scalars(), externalScalars(), entryCount(), source() {}
 
     const ColIndex* indices;
     const Scalar* scalars;
     ExternalConstCoefIterator externalScalars;
     ColIndex entryCount;
+
+    /// The polynomial that this row is a multiple of, or null if the row
+    /// was not made by makeRowWithTheseScalars.
+    const Poly* source;
   };
 
   RowIndex rowCount() const {return static_cast<RowIndex>(mRows.size());}
 
   Row row(const RowIndex row) const;
 
+  /// Makes a row that is a multiple of scalars, so the row has the same
+  /// coefficients. The caller writes the column indices to the returned
+  /// pointer. The row records scalars as its source.
   ColIndex* makeRowWithTheseScalars(const Poly& scalars);
 
   std::pair<ColIndex*, Scalar*> makeRow(ColIndex entryCount);
@@ -43,6 +54,7 @@ private:
     ColIndex entryCount;
     bool scalarsStoredExternally;
     ExternalConstCoefIterator externalScalars;
+    const Poly* source;
   };
 
   std::vector<ColIndex> mIndices;
@@ -50,6 +62,12 @@ private:
   std::vector<InternalRow> mRows;
 };
 
+extern template class BasicF4ProtoMatrix<uint8>;
+extern template class BasicF4ProtoMatrix<uint16>;
+extern template class BasicF4ProtoMatrix<uint32>;
+
+typedef BasicF4ProtoMatrix<uint16> F4ProtoMatrix;
+
 MATHICGB_NAMESPACE_END
 #endif
     
\ No newline at end of file
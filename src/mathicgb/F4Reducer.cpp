@@ -7,10 +7,14 @@
 #include "F4MatrixBuilder2.hpp"
 #include "F4MatrixReducer.hpp"
 #include "QuadMatrix.hpp"
+#include "MatrixCostModel.hpp"
+#include "SigMatrixReducer.hpp"
 #include "LogDomain.hpp"
 #include "CFile.hpp"
+#include "mtbb.hpp"
 #include <iostream>
 #include <limits>
+#include <unordered_map>
 
 MATHICGB_DEFINE_LOG_DOMAIN(
   F4MatrixRows,
@@ -32,6 +36,12 @@ MATHICGB_DEFINE_LOG_DOMAIN(
   "Count number of non-zero entries in F4 matrices."
 );
 
+MATHICGB_DEFINE_LOG_DOMAIN(
+  F4GroupSize,
+  "Displays the size of and the time spent on each F4 matrix along with "
+  "the number of S-pairs that are chosen for the next matrix."
+);
+
 MATHICGB_DEFINE_LOG_ALIAS(
   "F4Detail",
   "F4MatrixEntries,F4MatrixBottomRows,F4MatrixTopRows,F4MatrixRows,"
@@ -56,10 +66,15 @@ class F4Reducer : public Reducer {
 public:
   enum Type {
     OldType,
-    NewType
+    NewType,
+
+    /// As NewType, but the matrices are reduced by the Faugere-Lachartre
+    /// method.
+    FaugereLachartreType
   };
 
   F4Reducer(const PolyRing& ring, Type type);
+  virtual ~F4Reducer();
 
   virtual unsigned int preferredSetSize() const;
 
@@ -84,6 +99,22 @@ public:
     std::vector<std::unique_ptr<Poly> >& reducedOut
   );
 
+  virtual void classicReduceSPolySetAndFindUseful(
+    std::vector<std::pair<size_t, size_t> >& spairs,
+    const PolyBasis& basis,
+    std::vector<std::unique_ptr<Poly> >& reducedOut
+  );
+
+  /// Builds the matrix for nextSPairs while the matrix for spairs is
+  /// reduced. The matrix for nextSPairs is kept until the next call, where
+  /// it is used if that call is for the same S-pairs.
+  virtual void classicReduceSPolySetPipelined(
+    std::vector<std::pair<size_t, size_t> >& spairs,
+    const std::vector<std::pair<size_t, size_t> >& nextSPairs,
+    const PolyBasis& basis,
+    std::vector<std::unique_ptr<Poly> >& reducedOut
+  );
+
   virtual void classicReducePolySet(
     const std::vector<std::unique_ptr<Poly> >& polys,
     const PolyBasis& basis,
@@ -97,7 +128,19 @@ public:
     const SigPolyBasis& basis
   );
 
+  /// Reduces all the signatures in one matrix, see SigMatrixReducer.
+  virtual void regularReduceSet(
+    const std::vector<ConstMonoPtr>& sigs,
+    const std::vector<ConstMonoPtr>& multiples,
+    const std::vector<size_t>& basisElements,
+    const SigPolyBasis& basis,
+    std::vector<std::unique_ptr<Poly> >& reducedOut
+  );
+
   virtual void setMemoryQuantum(size_t quantum);
+  virtual void setMatrixMemoryBudget(size_t bytes);
+  virtual void setAdaptiveSetSize(bool value);
+  virtual void setSparseAccumulatorDensity(double density);
 
   virtual std::string description() const;
   virtual size_t getMemoryUse() const;
@@ -106,7 +149,91 @@ public:
   const Monoid& monoid() const {return mRing.monoid();}
 
 private:
-  void saveMatrix(const QuadMatrix& matrix);
+  /// Implements classicReduceSPolySet and, if findUseful is true,
+  /// classicReduceSPolySetAndFindUseful.
+  void reduceSPolySet(
+    std::vector<std::pair<size_t, size_t>>& spairs,
+    const PolyBasis& basis,
+    std::vector<std::unique_ptr<Poly>>& reducedOut,
+    bool findUseful
+  );
+
+  /// Builds the matrix for the rows that have been added to builder with
+  /// scalars of type S, reduces it and appends the new rows to reducedOut
+  /// as polynomials. If usefulSPairs is not null, then it must point to
+  /// the S-pairs that were added to builder and those S-pairs are then
+  /// reduced to the useful ones as for keepUsefulSPairs.
+  template<class S, class Builder>
+  void reduceMatrix(
+    Builder& builder,
+    const PolyBasis& basis,
+    std::vector<std::unique_ptr<Poly>>& reducedOut,
+    std::vector<std::pair<size_t, size_t>>* usefulSPairs
+  );
+
+  /// Reduces matrix, frees its column monomials and appends the new rows
+  /// to reducedOut as polynomials. usefulSPairs is as for reduceMatrix. If
+  /// nextSPairs is not null, then the matrix for nextSPairs is built while
+  /// matrix is reduced and it becomes the prepared matrix.
+  template<class S>
+  void reduceBuiltMatrix(
+    BasicQuadMatrix<S>& matrix,
+    const PolyBasis& basis,
+    std::vector<std::unique_ptr<Poly>>& reducedOut,
+    std::vector<std::pair<size_t, size_t>>* usefulSPairs,
+    const std::vector<std::pair<size_t, size_t>>* nextSPairs
+  );
+
+  /// Implements classicReduceSPolySetPipelined with scalars of type S.
+  template<class S>
+  void reduceSPolySetPipelined(
+    std::vector<std::pair<size_t, size_t>>& spairs,
+    const std::vector<std::pair<size_t, size_t>>& nextSPairs,
+    const PolyBasis& basis,
+    std::vector<std::unique_ptr<Poly>>& reducedOut
+  );
+
+  /// The prepared matrix with scalars of type S. At most one of these is
+  /// not null.
+  template<class S>
+  std::unique_ptr<BasicQuadMatrix<S>>& preparedMatrix();
+
+  /// Frees the prepared matrix, if any.
+  void discardPreparedMatrix();
+
+  template<class S>
+  void freeColumnMonomials(BasicQuadMatrix<S>& matrix);
+
+  /// As reduceMatrix with the narrowest scalar type that can hold every
+  /// residue modulo the characteristic.
+  void reduceMatrixNarrowest(
+    F4MatrixBuilder2& builder,
+    const PolyBasis& basis,
+    std::vector<std::unique_ptr<Poly>>& reducedOut,
+    std::vector<std::pair<size_t, size_t>>* usefulSPairs
+  );
+
+  /// Removes the S-pairs from spairs that are not needed to get the same
+  /// reduced matrix as from matrix, which must have been built from
+  /// spairs. The S-pairs that are kept are those whose rows are in
+  /// pivotRows, which are bottom rows of matrix, and those whose rows are
+  /// the pivot rows used to reduce those rows, directly or indirectly.
+  /// Keeps all of spairs if the rows of matrix cannot be traced back to
+  /// the S-pairs.
+  template<class S>
+  void keepUsefulSPairs(
+    const BasicQuadMatrix<S>& matrix,
+    const std::vector<SparseMatrix::RowIndex>& pivotRows,
+    const PolyBasis& basis,
+    std::vector<std::pair<size_t, size_t>>& spairs
+  );
+
+  template<class S>
+  void saveMatrix(const BasicQuadMatrix<S>& matrix);
+
+  /// Tells the cost model about the matrix that was last reduced, which
+  /// was built from sPairCount S-pairs in the given time.
+  void addToCostModel(size_t sPairCount, double seconds);
 
   Type mType;
   std::unique_ptr<Reducer> mFallback;
@@ -115,8 +242,43 @@ private:
   std::string mStoreToFile; /// stem of file names to save matrices to
   size_t mMinEntryCountForStore; /// don't save matrices with fewer entries
   size_t mMatrixSaveCount; // how many matrices have been saved
+  float mSparseAccumulatorDensity;
+
+  /// Chooses preferredSetSize() from the matrices so far. mLastMatrix
+  /// holds the size of the last matrix, and the time spent reducing it,
+  /// until the time to give to the cost model is known.
+  MatrixCostModel mCostModel;
+  MatrixCostModel::Matrix mLastMatrix;
+
+  /// The S-pairs that the prepared matrix was built from. The prepared
+  /// matrix is built ahead of time by classicReduceSPolySetPipelined.
+  std::vector<std::pair<size_t, size_t>> mPreparedSPairs;
+  std::unique_ptr<BasicQuadMatrix<uint8>> mPreparedMatrix8;
+  std::unique_ptr<BasicQuadMatrix<uint16>> mPreparedMatrix16;
+  std::unique_ptr<BasicQuadMatrix<uint32>> mPreparedMatrix32;
 };
 
+template<>
+auto F4Reducer::preparedMatrix<uint8>()
+  -> std::unique_ptr<BasicQuadMatrix<uint8>>&
+{
+  return mPreparedMatrix8;
+}
+
+template<>
+auto F4Reducer::preparedMatrix<uint16>()
+  -> std::unique_ptr<BasicQuadMatrix<uint16>>&
+{
+  return mPreparedMatrix16;
+}
+
+template<>
+auto F4Reducer::preparedMatrix<uint32>()
+  -> std::unique_ptr<BasicQuadMatrix<uint32>>&
+{
+  return mPreparedMatrix32;
+}
+
 F4Reducer::F4Reducer(const PolyRing& ring, Type type):
   mType(type),
   mFallback(Reducer::makeReducer(Reducer::Reducer_Geobucket_Hashed, ring)),
@@ -124,11 +286,17 @@ F4Reducer::F4Reducer(const PolyRing& ring, Type type):
   mMemoryQuantum(0),
   mStoreToFile(""),
   mMinEntryCountForStore(0),
-  mMatrixSaveCount(0) {
+  mMatrixSaveCount(0),
+  mSparseAccumulatorDensity(F4MatrixReducer::DefaultSparseAccumulatorDensity),
+  mLastMatrix() {
+}
+
+F4Reducer::~F4Reducer() {
+  discardPreparedMatrix();
 }
 
 unsigned int F4Reducer::preferredSetSize() const {
-  return 100000;
+  return static_cast<unsigned int>(mCostModel.groupSize());
 }
 
 void F4Reducer::writeMatricesTo(std::string file, size_t minEntries) {
@@ -172,6 +340,87 @@ void F4Reducer::classicReduceSPolySet(
   std::vector<std::pair<size_t, size_t>>& spairs,
   const PolyBasis& basis,
   std::vector<std::unique_ptr<Poly>>& reducedOut
+) {
+  reduceSPolySet(spairs, basis, reducedOut, false);
+}
+
+void F4Reducer::classicReduceSPolySetAndFindUseful(
+  std::vector<std::pair<size_t, size_t>>& spairs,
+  const PolyBasis& basis,
+  std::vector<std::unique_ptr<Poly>>& reducedOut
+) {
+  reduceSPolySet(spairs, basis, reducedOut, true);
+}
+
+void F4Reducer::classicReduceSPolySetPipelined(
+  std::vector<std::pair<size_t, size_t>>& spairs,
+  const std::vector<std::pair<size_t, size_t>>& nextSPairs,
+  const PolyBasis& basis,
+  std::vector<std::unique_ptr<Poly>>& reducedOut
+) {
+  if (mType == OldType) {
+    classicReduceSPolySet(spairs, basis, reducedOut);
+    return;
+  }
+  const auto charac = ring().charac();
+  if (charac <= std::numeric_limits<uint8>::max())
+    reduceSPolySetPipelined<uint8>(spairs, nextSPairs, basis, reducedOut);
+  else if (charac <= std::numeric_limits<uint16>::max())
+    reduceSPolySetPipelined<uint16>(spairs, nextSPairs, basis, reducedOut);
+  else
+    reduceSPolySetPipelined<uint32>(spairs, nextSPairs, basis, reducedOut);
+}
+
+template<class S>
+void F4Reducer::reduceSPolySetPipelined(
+  std::vector<std::pair<size_t, size_t>>& spairs,
+  const std::vector<std::pair<size_t, size_t>>& nextSPairs,
+  const PolyBasis& basis,
+  std::vector<std::unique_ptr<Poly>>& reducedOut
+) {
+  // The caller may have removed S-pairs whose basis elements have been
+  // retired since the prepared matrix was built, in which case the
+  // prepared matrix cannot be used.
+  std::unique_ptr<BasicQuadMatrix<S>> qm;
+  if (preparedMatrix<S>() != nullptr && mPreparedSPairs == spairs) {
+    qm = std::move(preparedMatrix<S>());
+    mPreparedSPairs.clear();
+    if (tracingLevel >= 2)
+      std::cerr << "F4Reducer: Using prepared matrix for "
+        << spairs.size() << " S-polynomials.\n";
+  } else {
+    discardPreparedMatrix();
+    if (spairs.size() <= 1) {
+      classicReduceSPolySet(spairs, basis, reducedOut);
+      return;
+    }
+    if (tracingLevel >= 2)
+      std::cerr << "F4Reducer: Reducing " << spairs.size()
+        << " S-polynomials.\n";
+    F4MatrixBuilder2 builder(basis, mMemoryQuantum);
+    for (const auto& spair : spairs)
+      builder.addSPolynomialToMatrix
+        (basis.poly(spair.first), basis.poly(spair.second));
+    qm = make_unique<BasicQuadMatrix<S>>(basis.ring());
+    builder.buildMatrixAndClear(*qm);
+  }
+  reducedOut.clear();
+
+  // A single S-pair goes to the fall-back reducer on the next call, so
+  // there is no matrix to prepare for it.
+  const auto next = nextSPairs.size() > 1 ? &nextSPairs : nullptr;
+  reduceBuiltMatrix(*qm, basis, reducedOut, nullptr, next);
+
+  // Most matrices here are built while the previous one is reduced, so
+  // only the time of the reduction is given to the cost model.
+  addToCostModel(spairs.size(), mLastMatrix.seconds);
+}
+
+void F4Reducer::reduceSPolySet(
+  std::vector<std::pair<size_t, size_t>>& spairs,
+  const PolyBasis& basis,
+  std::vector<std::unique_ptr<Poly>>& reducedOut,
+  const bool findUseful
 ) {
   if (spairs.size() <= 1) {
     if (tracingLevel >= 2)
@@ -186,44 +435,25 @@ void F4Reducer::classicReduceSPolySet(
   if (tracingLevel >= 2)
     std::cerr << "F4Reducer: Reducing " << spairs.size() << " S-polynomials.\n";
 
-  SparseMatrix reduced;
-  QuadMatrix::Monomials monomials;
-  {
-    QuadMatrix qm(basis.ring());
-    {
-      if (mType == OldType) {
-        F4MatrixBuilder builder(basis, mMemoryQuantum);
-        for (const auto& spair : spairs)
-          builder.addSPolynomialToMatrix
-            (basis.poly(spair.first), basis.poly(spair.second));
-        builder.buildMatrixAndClear(qm);
-      } else {
-        F4MatrixBuilder2 builder(basis, mMemoryQuantum);
-        for (const auto& spair : spairs)
-          builder.addSPolynomialToMatrix
-            (basis.poly(spair.first), basis.poly(spair.second));
-        builder.buildMatrixAndClear(qm);
-      }
-    }
-    MATHICGB_LOG_INCREMENT_BY(F4MatrixRows, qm.rowCount());
-    MATHICGB_LOG_INCREMENT_BY(F4MatrixTopRows, qm.topLeft.rowCount());
-    MATHICGB_LOG_INCREMENT_BY(F4MatrixBottomRows, qm.bottomLeft.rowCount());
-    MATHICGB_LOG_INCREMENT_BY(F4MatrixEntries, qm.entryCount());
-    saveMatrix(qm);
-    reduced = F4MatrixReducer(basis.ring().charac()).
-      reducedRowEchelonFormBottomRight(qm);
-    monomials = std::move(qm.rightColumnMonomials);
-    for (auto& mono : qm.leftColumnMonomials)
-      monoid().freeRaw(mono.castAwayConst());
-  }
-
-  for (SparseMatrix::RowIndex row = 0; row < reduced.rowCount(); ++row) {
-    auto p = make_unique<Poly>(basis.ring());
-    reduced.rowToPolynomial(row, monomials, *p);
-    reducedOut.push_back(std::move(p));
+  const auto before = mgb::mtbb::tick_count::now();
+  const auto sPairCount = spairs.size();
+  const auto usefulSPairs = findUseful ? &spairs : nullptr;
+  if (mType == OldType) {
+    F4MatrixBuilder builder(basis, mMemoryQuantum);
+    for (const auto& spair : spairs)
+      builder.addSPolynomialToMatrix
+        (basis.poly(spair.first), basis.poly(spair.second));
+    reduceMatrix<SparseMatrix::Scalar>
+      (builder, basis, reducedOut, usefulSPairs);
+  } else {
+    F4MatrixBuilder2 builder(basis, mMemoryQuantum);
+    for (const auto& spair : spairs)
+      builder.addSPolynomialToMatrix
+        (basis.poly(spair.first), basis.poly(spair.second));
+    reduceMatrixNarrowest(builder, basis, reducedOut, usefulSPairs);
   }
-  for (auto& mono : monomials)
-    monoid().freeRaw(mono.castAwayConst());
+  addToCostModel
+    (sPairCount, (mgb::mtbb::tick_count::now() - before).seconds());
 }
 
 void F4Reducer::classicReducePolySet(
@@ -245,46 +475,257 @@ void F4Reducer::classicReducePolySet(
   if (tracingLevel >= 2)
     std::cerr << "F4Reducer: Reducing " << polys.size() << " polynomials.\n";
 
-  SparseMatrix reduced;
-  QuadMatrix::Monomials monomials;
-  {
-    QuadMatrix qm(ring());
-    {
-      if (mType == OldType) {
-        F4MatrixBuilder builder(basis, mMemoryQuantum);
-        for (const auto& poly : polys)
-          builder.addPolynomialToMatrix(*poly);
-        builder.buildMatrixAndClear(qm);
-      } else {
+  if (mType == OldType) {
+    F4MatrixBuilder builder(basis, mMemoryQuantum);
+    for (const auto& poly : polys)
+      builder.addPolynomialToMatrix(*poly);
+    reduceMatrix<SparseMatrix::Scalar>(builder, basis, reducedOut, nullptr);
+  } else {
+    F4MatrixBuilder2 builder(basis, mMemoryQuantum);
+    for (const auto& poly : polys)
+      builder.addPolynomialToMatrix(*poly);
+    reduceMatrixNarrowest(builder, basis, reducedOut, nullptr);
+  }
+}
+
+template<class S, class Builder>
+void F4Reducer::reduceMatrix(
+  Builder& builder,
+  const PolyBasis& basis,
+  std::vector<std::unique_ptr<Poly>>& reducedOut,
+  std::vector<std::pair<size_t, size_t>>* const usefulSPairs
+) {
+  BasicQuadMatrix<S> qm(basis.ring());
+  builder.buildMatrixAndClear(qm);
+  reduceBuiltMatrix(qm, basis, reducedOut, usefulSPairs, nullptr);
+}
+
+template<class S>
+void F4Reducer::reduceBuiltMatrix(
+  BasicQuadMatrix<S>& qm,
+  const PolyBasis& basis,
+  std::vector<std::unique_ptr<Poly>>& reducedOut,
+  std::vector<std::pair<size_t, size_t>>* const usefulSPairs,
+  const std::vector<std::pair<size_t, size_t>>* const nextSPairs
+) {
+  MATHICGB_LOG_INCREMENT_BY(F4MatrixRows, qm.rowCount());
+  MATHICGB_LOG_INCREMENT_BY(F4MatrixTopRows, qm.topLeft.rowCount());
+  MATHICGB_LOG_INCREMENT_BY(F4MatrixBottomRows, qm.bottomLeft.rowCount());
+  MATHICGB_LOG_INCREMENT_BY(F4MatrixEntries, qm.entryCount());
+  mLastMatrix.rowCount = qm.rowCount();
+  mLastMatrix.columnCount =
+    qm.leftColumnMonomials.size() + qm.rightColumnMonomials.size();
+  mLastMatrix.entryCount = qm.entryCount();
+  mLastMatrix.memoryUse = qm.memoryUse();
+  saveMatrix(qm);
+  F4MatrixReducer matrixReducer(basis.ring().charac());
+  matrixReducer.setFaugereLachartre(mType == FaugereLachartreType);
+  matrixReducer.setSparseAccumulatorDensity(mSparseAccumulatorDensity);
+  if (usefulSPairs != nullptr) {
+    const auto pivotRows = matrixReducer.pivotBottomRows(qm);
+    keepUsefulSPairs(qm, pivotRows, basis, *usefulSPairs);
+  }
+
+  BasicSparseMatrix<S> reduced;
+  const auto reduce = [&]() {
+    const auto before = mgb::mtbb::tick_count::now();
+    reduced = matrixReducer.reducedRowEchelonFormBottomRight(qm);
+    mLastMatrix.seconds = (mgb::mtbb::tick_count::now() - before).seconds();
+  };
+  if (nextSPairs == nullptr)
+    reduce();
+  else {
+    // Reducing qm does not use basis or the monomial pool, so the matrix
+    // for nextSPairs can be built from basis at the same time.
+    auto next = make_unique<BasicQuadMatrix<S>>(basis.ring());
+    mgb::mtbb::parallel_for(0, 2, 1, [&](int i) {
+      if (i == 0)
+        reduce();
+      else {
         F4MatrixBuilder2 builder(basis, mMemoryQuantum);
-        for (const auto& poly : polys)
-          builder.addPolynomialToMatrix(*poly);
-        builder.buildMatrixAndClear(qm);
+        for (const auto& spair : *nextSPairs)
+          builder.addSPolynomialToMatrix
+            (basis.poly(spair.first), basis.poly(spair.second));
+        builder.buildMatrixAndClear(*next);
       }
-    }
-    MATHICGB_LOG_INCREMENT_BY(F4MatrixRows, qm.rowCount());
-    MATHICGB_LOG_INCREMENT_BY(F4MatrixTopRows, qm.topLeft.rowCount());
-    MATHICGB_LOG_INCREMENT_BY(F4MatrixBottomRows, qm.bottomLeft.rowCount());
-    MATHICGB_LOG_INCREMENT_BY(F4MatrixEntries, qm.entryCount());
-    saveMatrix(qm);
-    reduced = F4MatrixReducer(basis.ring().charac()).
-      reducedRowEchelonFormBottomRight(qm);
-    monomials = std::move(qm.rightColumnMonomials);
-    for (auto& mono : qm.leftColumnMonomials)
-      monoid().freeRaw(mono.castAwayConst());
+    });
+    mPreparedSPairs = *nextSPairs;
+    preparedMatrix<S>() = std::move(next);
   }
 
   if (tracingLevel >= 2 && false)
     std::cerr << "F4Reducer: Extracted " << reduced.rowCount()
               << " non-zero rows\n";
 
-  for (SparseMatrix::RowIndex row = 0; row < reduced.rowCount(); ++row) {
+  // Each row becomes a separate polynomial and converting a row does not
+  // use the monomial pool, so the rows can be converted in parallel.
+  const auto firstNew = reducedOut.size();
+  const auto rowCount = reduced.rowCount();
+  reducedOut.resize(firstNew + rowCount);
+  mgb::mtbb::parallel_for(
+    mgb::mtbb::blocked_range<SparseMatrix::RowIndex>(0, rowCount),
+    [&](const mgb::mtbb::blocked_range<SparseMatrix::RowIndex>& range)
+    {for (auto row = range.begin(); row != range.end(); ++row)
+  {
     auto p = make_unique<Poly>(basis.ring());
-    reduced.rowToPolynomial(row, monomials, *p);
-    reducedOut.push_back(std::move(p));
-  }
-  for (auto& mono : monomials)
+    reduced.rowToPolynomial(row, qm.rightColumnMonomials, *p);
+    reducedOut[firstNew + row] = std::move(p);
+  }});
+  freeColumnMonomials(qm);
+}
+
+template<class S>
+void F4Reducer::freeColumnMonomials(BasicQuadMatrix<S>& matrix) {
+  for (auto& mono : matrix.leftColumnMonomials)
     monoid().freeRaw(mono.castAwayConst());
+  matrix.leftColumnMonomials.clear();
+  for (auto& mono : matrix.rightColumnMonomials)
+    monoid().freeRaw(mono.castAwayConst());
+  matrix.rightColumnMonomials.clear();
+}
+
+void F4Reducer::discardPreparedMatrix() {
+  if (mPreparedMatrix8 != nullptr)
+    freeColumnMonomials(*mPreparedMatrix8);
+  if (mPreparedMatrix16 != nullptr)
+    freeColumnMonomials(*mPreparedMatrix16);
+  if (mPreparedMatrix32 != nullptr)
+    freeColumnMonomials(*mPreparedMatrix32);
+  mPreparedMatrix8.reset();
+  mPreparedMatrix16.reset();
+  mPreparedMatrix32.reset();
+  mPreparedSPairs.clear();
+}
+
+void F4Reducer::reduceMatrixNarrowest(
+  F4MatrixBuilder2& builder,
+  const PolyBasis& basis,
+  std::vector<std::unique_ptr<Poly>>& reducedOut,
+  std::vector<std::pair<size_t, size_t>>* const usefulSPairs
+) {
+  const auto charac = ring().charac();
+  if (charac <= std::numeric_limits<uint8>::max())
+    reduceMatrix<uint8>(builder, basis, reducedOut, usefulSPairs);
+  else if (charac <= std::numeric_limits<uint16>::max())
+    reduceMatrix<uint16>(builder, basis, reducedOut, usefulSPairs);
+  else
+    reduceMatrix<uint32>(builder, basis, reducedOut, usefulSPairs);
+}
+
+template<class S>
+void F4Reducer::keepUsefulSPairs(
+  const BasicQuadMatrix<S>& matrix,
+  const std::vector<SparseMatrix::RowIndex>& pivotRows,
+  const PolyBasis& basis,
+  std::vector<std::pair<size_t, size_t>>& spairs
+) {
+  typedef SparseMatrix::RowIndex RowIndex;
+  typedef SparseMatrix::ColIndex ColIndex;
+  const auto noRow = static_cast<RowIndex>(-1);
+  const auto topCount = matrix.topLeft.rowCount();
+  const auto bottomCount = matrix.bottomLeft.rowCount();
+  if (
+    matrix.topRowSources.size() != topCount ||
+    matrix.bottomRowSources.size() != bottomCount
+  )
+    return; // the builder did not record where the rows came from
+
+  // The rows are numbered with the top rows first. The top row with index
+  // col is the pivot row for left column col. The two halves of an S-pair
+  // with lcm L are rows with leading monomial L and those rows are
+  // multiples of the two polynomials of the S-pair.
+  std::vector<std::vector<RowIndex>> rowsOfCol(topCount);
+  for (RowIndex row = 0; row < topCount; ++row)
+    rowsOfCol[row].push_back(row);
+  for (RowIndex row = 0; row < bottomCount; ++row)
+    if (!matrix.bottomLeft.emptyRow(row))
+      rowsOfCol[matrix.bottomLeft.leadCol(row)].push_back(topCount + row);
+  const auto source = [&](const RowIndex row) {
+    return row < topCount ?
+      matrix.topRowSources[row] : matrix.bottomRowSources[row - topCount];
+  };
+  const auto rowOf = [&](const Poly& poly, const ColIndex col) {
+    for (const auto row : rowsOfCol[col])
+      if (source(row) == &poly)
+        return row;
+    return noRow;
+  };
+
+  std::unordered_map<const Poly*, std::vector<size_t>> sPairsOf;
+  for (size_t i = 0; i < spairs.size(); ++i) {
+    sPairsOf[&basis.poly(spairs[i].first)].push_back(i);
+    sPairsOf[&basis.poly(spairs[i].second)].push_back(i);
+  }
+
+  // Keeps an S-pair with lcm equal to the monomial of col that poly is a
+  // part of and schedules both rows of that S-pair to be visited. Returns
+  // false if there is no such S-pair.
+  std::vector<char> keep(spairs.size());
+  std::vector<RowIndex> toVisit;
+  auto lcm = monoid().alloc();
+  const auto keepSPair = [&](const Poly* poly, const ColIndex col) {
+    const auto it = sPairsOf.find(poly);
+    if (it == sPairsOf.end())
+      return false;
+    for (const auto i : it->second) {
+      const auto& a = basis.poly(spairs[i].first);
+      const auto& b = basis.poly(spairs[i].second);
+      monoid().lcm(a.leadMono(), b.leadMono(), *lcm);
+      if (!monoid().equal(*lcm, *matrix.leftColumnMonomials[col]))
+        continue;
+      if (!keep[i]) {
+        keep[i] = true;
+        toVisit.push_back(rowOf(a, col));
+        toVisit.push_back(rowOf(b, col));
+      }
+      return true;
+    }
+    return false;
+  };
+
+  for (const auto row : pivotRows) {
+    MATHICGB_ASSERT(row < bottomCount);
+    if (
+      matrix.bottomLeft.emptyRow(row) ||
+      !keepSPair(matrix.bottomRowSources[row], matrix.bottomLeft.leadCol(row))
+    )
+      return; // cannot tell which S-pair this row came from
+  }
+
+  // Visit the rows that the kept rows are reduced by. A top row that is not
+  // part of an S-pair is a reducer from the basis, which the builder will
+  // find again when it sees the column of that row.
+  std::vector<char> visited(topCount + bottomCount);
+  std::vector<char> colReached(topCount);
+  while (!toVisit.empty()) {
+    const auto row = toVisit.back();
+    toVisit.pop_back();
+    if (row == noRow)
+      return; // an S-pair is missing a row, so something is off
+    if (visited[row])
+      continue;
+    visited[row] = true;
+    const auto& left = row < topCount ? matrix.topLeft : matrix.bottomLeft;
+    const auto leftRow = row < topCount ? row : row - topCount;
+    const auto end = left.rowEnd(leftRow);
+    for (auto it = left.rowBegin(leftRow); it != end; ++it) {
+      const auto col = it.index();
+      if (colReached[col])
+        continue;
+      colReached[col] = true;
+      toVisit.push_back(col);
+      keepSPair(matrix.topRowSources[col], col);
+    }
+  }
+
+  std::vector<std::pair<size_t, size_t>> useful;
+  for (size_t i = 0; i < spairs.size(); ++i)
+    if (keep[i])
+      useful.push_back(spairs[i]);
+  if (tracingLevel >= 2)
+    std::cerr << "F4Reducer: " << useful.size() << " of " << spairs.size()
+      << " S-pairs were useful.\n";
+  spairs = std::move(useful);
 }
 
 std::unique_ptr<Poly> F4Reducer::regularReduce(
@@ -300,10 +741,43 @@ std::unique_ptr<Poly> F4Reducer::regularReduce(
   return p;
 }
 
+void F4Reducer::regularReduceSet(
+  const std::vector<ConstMonoPtr>& sigs,
+  const std::vector<ConstMonoPtr>& multiples,
+  const std::vector<size_t>& basisElements,
+  const SigPolyBasis& basis,
+  std::vector<std::unique_ptr<Poly> >& reducedOut
+) {
+  // A matrix for a single signature has no rows of other signatures to
+  // share reducers with, so it is no faster than the fall-back reducer.
+  if (sigs.size() <= 1) {
+    Reducer::regularReduceSet
+      (sigs, multiples, basisElements, basis, reducedOut);
+    return;
+  }
+  if (tracingLevel >= 2)
+    std::cerr << "F4Reducer: Reducing " << sigs.size()
+      << " signatures in one matrix.\n";
+  SigMatrixReducer(ring()).reduce
+    (sigs, multiples, basisElements, basis, reducedOut);
+}
+
 void F4Reducer::setMemoryQuantum(size_t quantum) {
   mMemoryQuantum = quantum;
 }
 
+void F4Reducer::setMatrixMemoryBudget(size_t bytes) {
+  mCostModel.setMemoryBudget(bytes);
+}
+
+void F4Reducer::setAdaptiveSetSize(const bool value) {
+  mCostModel.setAdaptive(value);
+}
+
+void F4Reducer::setSparseAccumulatorDensity(double density) {
+  mSparseAccumulatorDensity = static_cast<float>(density);
+}
+
 std::string F4Reducer::description() const {
   return "F4 reducer";
 }
@@ -312,7 +786,8 @@ size_t F4Reducer::getMemoryUse() const {
   return 0; // @todo: implement
 }
 
-void F4Reducer::saveMatrix(const QuadMatrix& matrix) {
+template<class S>
+void F4Reducer::saveMatrix(const BasicQuadMatrix<S>& matrix) {
   if (mStoreToFile.empty())
     return;
   const auto entryCount = matrix.entryCount();
@@ -325,8 +800,24 @@ void F4Reducer::saveMatrix(const QuadMatrix& matrix) {
     std::cerr << "F4Reducer: Saving matrix to " << fileName.str() << '\n';
 
   CFile file(fileName.str(), "wb");
-  matrix.write
-    (static_cast<SparseMatrix::Scalar>(mRing.charac()), file.handle());
+  matrix.write(static_cast<S>(mRing.charac()), file.handle());
+}
+
+void F4Reducer::addToCostModel(
+  const size_t sPairCount,
+  const double seconds
+) {
+  mLastMatrix.sPairCount = sPairCount;
+  mLastMatrix.seconds = seconds;
+  mCostModel.addMatrix(mLastMatrix);
+
+  MATHICGB_LOG(F4GroupSize) << "F4 matrix from " << sPairCount
+    << " S-pairs: " << mLastMatrix.rowCount << " rows, "
+    << mLastMatrix.columnCount << " columns, "
+    << mLastMatrix.entryCount << " entries, "
+    << mLastMatrix.memoryUse << " bytes in " << seconds
+    << "s. Next group size is " << mCostModel.groupSize() << ".\n";
+  mLastMatrix = MatrixCostModel::Matrix();
 }
 
 std::unique_ptr<Reducer> makeF4Reducer(
@@ -354,4 +845,10 @@ MATHICGB_REGISTER_REDUCER(
   (make_unique<F4Reducer>(ring, F4Reducer::NewType))
 );
 
+MATHICGB_REGISTER_REDUCER(
+  "F4FL",
+  Reducer_F4_FaugereLachartre,
+  (make_unique<F4Reducer>(ring, F4Reducer::FaugereLachartreType))
+);
+
 MATHICGB_NAMESPACE_END
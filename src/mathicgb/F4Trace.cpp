@@ -0,0 +1,71 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#include "stdinc.h"
+#include "F4Trace.hpp"
+
+#include "Scanner.hpp"
+#include <algorithm>
+
+MATHICGB_NAMESPACE_BEGIN
+
+void F4Trace::addStep(Step&& step) {
+#ifdef MATHICGB_DEBUG
+  for (const auto& lead : step.leads)
+    MATHICGB_ASSERT(lead.size() == varCount() + 1);
+  MATHICGB_ASSERT(std::is_sorted(step.leads.begin(), step.leads.end()));
+#endif
+  mSteps.push_back(std::move(step));
+}
+
+auto F4Trace::exponents(
+  const Monoid& monoid,
+  ConstMonoRef mono
+) -> Exponents {
+  Exponents e;
+  e.reserve(monoid.varCount() + 1);
+  for (Monoid::VarIndex var = 0; var < monoid.varCount(); ++var)
+    e.push_back(monoid.externalExponent(mono, var));
+  e.push_back(monoid.component(mono));
+  return e;
+}
+
+void F4Trace::write(std::ostream& out) const {
+  out << "f4trace " << varCount() << ' ' << stepCount() << '\n';
+  for (const auto& step : mSteps) {
+    out << step.sPairs.size() << ' ' << step.leads.size() << ' '
+      << step.basisSize << '\n';
+    for (const auto& sPair : step.sPairs)
+      out << ' ' << sPair.first << ' ' << sPair.second << '\n';
+    for (const auto& lead : step.leads) {
+      for (const auto e : lead)
+        out << ' ' << e;
+      out << '\n';
+    }
+  }
+}
+
+void F4Trace::read(Scanner& in) {
+  in.expect("f4trace");
+  mVarCount = in.readInteger<size_t>();
+  const auto stepCount = in.readInteger<size_t>();
+  mSteps.clear();
+  mSteps.resize(stepCount);
+  for (auto& step : mSteps) {
+    step.sPairs.resize(in.readInteger<size_t>());
+    step.leads.resize(in.readInteger<size_t>());
+    step.basisSize = in.readInteger<size_t>();
+    for (auto& sPair : step.sPairs) {
+      sPair.first = in.readInteger<size_t>();
+      sPair.second = in.readInteger<size_t>();
+    }
+    for (auto& lead : step.leads) {
+      lead.resize(varCount() + 1);
+      for (auto& e : lead)
+        e = in.readInteger<exponent>();
+    }
+    if (!std::is_sorted(step.leads.begin(), step.leads.end()))
+      in.reportError("The lead monomials of a trace step must be sorted.");
+  }
+}
+
+MATHICGB_NAMESPACE_END
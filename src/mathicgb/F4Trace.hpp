@@ -0,0 +1,86 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#ifndef MATHICGB_F4_TRACE_GUARD
+#define MATHICGB_F4_TRACE_GUARD
+
+#include "PolyRing.hpp"
+#include <vector>
+#include <ostream>
+#include <stdexcept>
+
+MATHICGB_NAMESPACE_BEGIN
+
+class Scanner;
+
+/// A record of a classic Buchberger computation with an F4 reducer that
+/// allows the same computation to be replayed modulo a different prime.
+///
+/// Each step records the S-pairs whose rows gave new pivots in the F4
+/// matrix of that step, along with the S-pairs whose rows were the pivot
+/// rows used to reduce those rows. All the other S-pairs of the step
+/// reduced to zero or to something already spanned by the useful rows, so
+/// a replay can skip S-pair selection and only build and reduce the
+/// matrix for the recorded S-pairs. The lead monomials that a step
+/// produced are recorded too, so that a replay can detect an unlucky
+/// prime where the computation no longer follows the trace.
+class F4Trace {
+public:
+  typedef PolyRing::Monoid Monoid;
+  typedef Monoid::ConstMonoRef ConstMonoRef;
+
+  /// The exponents of a monomial followed by its component.
+  typedef std::vector<exponent> Exponents;
+
+  struct Step {
+    /// The basis indices of the S-pairs to reduce in this step.
+    std::vector<std::pair<size_t, size_t>> sPairs;
+
+    /// The lead monomials of the polynomials that this step produced,
+    /// sorted in increasing lexicographic order of the exponents.
+    std::vector<Exponents> leads;
+
+    /// The number of basis elements, including retired elements, after
+    /// the polynomials from this step have been inserted.
+    size_t basisSize;
+  };
+
+  F4Trace(): mVarCount(0) {}
+
+  /// All the recorded lead monomials have varCount variables.
+  F4Trace(size_t varCount): mVarCount(varCount) {}
+
+  size_t varCount() const {return mVarCount;}
+  size_t stepCount() const {return mSteps.size();}
+
+  const Step& step(size_t index) const {
+    MATHICGB_ASSERT(index < stepCount());
+    return mSteps[index];
+  }
+
+  void addStep(Step&& step);
+
+  /// Returns the exponents and component of mono.
+  static Exponents exponents(const Monoid& monoid, ConstMonoRef mono);
+
+  /// Writes the trace in a text format that read can parse.
+  void write(std::ostream& out) const;
+
+  /// Replaces this trace by the trace in the format from write that is
+  /// read from in.
+  void read(Scanner& in);
+
+private:
+  size_t mVarCount;
+  std::vector<Step> mSteps;
+};
+
+/// Thrown when a replayed computation does not follow the trace. This
+/// means that the prime is unlucky for the input, or that the trace was
+/// recorded for a different input.
+class F4TraceMismatch : public std::runtime_error {
+public:
+  F4TraceMismatch(const std::string& what): std::runtime_error(what) {}
+};
+
+MATHICGB_NAMESPACE_END
+#endif
@@ -10,15 +10,22 @@
 #include <limits>
 #include <vector>
 #include <algorithm>
+#include <memory>
+#include <type_traits>
 
 MATHICGB_NAMESPACE_BEGIN
 
 /// Concurrent hashtable mapping from monomials to T with a fixed number of
-/// buckets. Lookups are lockless while insertions grab a lock.
+/// buckets. Lookups and insertions are lockless. An insertion puts a new
+/// node at the front of its bucket with a compare-and-swap, so a bucket
+/// only ever changes by getting a new first node. The nodes are allocated
+/// from a pool for each thread, so insertions from different threads do not
+/// share an allocator.
 ///
 /// There is no limitation on the number of entries that can be inserted,
 /// but performance will suffer if the ratio of elements to buckets gets
-/// high.
+/// high. The nodes can be moved to a table with more buckets one bucket at
+/// a time while lookups and insertions go on - see moveSomeBucketsTo().
 ///
 /// You can insert new values but you cannot change the value that an
 /// already-inserted value maps to. It is possible to clear the table
@@ -51,7 +58,9 @@ public:
       make_unique_array<Atomic<Node*>>(hashMaskToBucketCount(mHashToIndexMask))
     ),
     mRing(ring),
-    mNodeAlloc(Node::bytesPerNode(ring.monoid()))
+    mNodeAllocs(makeNodeAllocs(ring.monoid())),
+    mNextBucketToMove(0),
+    mMovedBucketCount(0)
   {
     // Calling new int[x] does not zero the array. std::atomic has a trivial
     // constructor so the same thing is true of new atomic[x]. Calling
@@ -62,39 +71,25 @@ public:
     setTableEntriesToNullRelaxed();
   }
 
-  /// Construct a hash table with at least requestedBucketCount buckets and
-  /// insert the elements from the parameter map.
-  ///
-  /// The parameter map remains a valid object that can satisfy queries.
-  /// However, it is an error to call non-const methods on the map other
-  /// than the destructor. Also, insertions into *this may or may not
-  /// be reflected for queries into map and some of the entries currently
-  /// in map will disappear.
+  /// Construct an empty hash table with at least requestedBucketCount
+  /// buckets that allocates its nodes from the same pools as map. Use this
+  /// to make the table that the nodes of map are moved to. The pools are
+  /// kept alive until both tables have been destructed.
   FixedSizeMonomialMap(
     const size_t requestedBucketCount,
-    FixedSizeMonomialMap<T>&& map
+    const FixedSizeMonomialMap<T>& map
   ):
     mHashToIndexMask(computeHashMask(requestedBucketCount)),
     mBuckets(
       make_unique_array<Atomic<Node*>>(hashMaskToBucketCount(mHashToIndexMask))
     ),
     mRing(map.ring()),
-    mNodeAlloc(std::move(map.mNodeAlloc))
+    mNodeAllocs(map.mNodeAllocs),
+    mNextBucketToMove(0),
+    mMovedBucketCount(0)
   {
     // We can store relaxed as the constructor does not run concurrently.
-    const auto relax = std::memory_order_relaxed;
-
     setTableEntriesToNullRelaxed();
-    const auto tableEnd = map.mBuckets.get() + map.bucketCount();
-    for (auto tableIt = map.mBuckets.get(); tableIt != tableEnd; ++tableIt) {
-      for (Node* node = tableIt->load(); node != 0;) {
-        const size_t index = hashToIndex(monoid().hash(node->mono()));
-        const auto next = node->next(relax);
-        node->setNext(mBuckets[index].load(relax), relax);
-        mBuckets[index].store(node, relax);
-        node = next;
-      }
-    }
   }
 
   /// Return how many buckets the hash table has.
@@ -189,64 +184,178 @@ public:
   /// inserted value equals the already present value.
   ///
   /// p.first.second is a internal monomial that equals value.first.
+  ///
+  /// If the bucket of value.first is being moved or has been moved to
+  /// another table, then nothing is done and p.first.first is null. The
+  /// insertion then has to be done into the other table once
+  /// hasMoved(*value.first) is true.
+  ///
+  /// This method can be called concurrently with itself, with queries and
+  /// with moveSomeBucketsTo(). If several threads insert the same monomial
+  /// at the same time, then exactly one of them performs the insertion.
   std::pair< std::pair<const mapped_type*, ConstMonoPtr>, bool>
   insert(const value_type& value) {
-    const mgb::mtbb::mutex::scoped_lock lockGuard(mInsertionMutex);
-    // find() loads buckets with memory_order_consume, so it may seem like
-    // we need some extra synchronization to make sure that we have the
-    // most up to date view of the bucket that value.first goes in -
-    // what if a pending insert is hiding in a cache of some other processor
-    // somewhere? We in fact have an up to date view of every bucket in the
-    // the table already because inserts only happen while holding the
-    // insertion mutex and by locking that mutex we have synchronized with
-    // all threads that previously did insertions.
-    {
-      const auto found = find(*value.first);
-      if (found.first != 0) {
-        auto p = std::make_pair(found.first, *found.second);
-        return std::make_pair(p, false); // key already present
+    const size_t index = hashToIndex(monoid().hash(*value.first));
+    auto& bucket = mBuckets[index];
+    auto& nodeAlloc = mNodeAllocs->local();
+
+    // The node is only made once we know that value.first was not present
+    // when we looked. Nodes are only ever put at the front of a bucket, so
+    // after a failed compare-and-swap we only need to look through the
+    // nodes in front of the node that was first last time we looked.
+    Node* node = nullptr;
+    Node* first = bucket.load(std::memory_order_acquire);
+    const Node* lookedUntil = nullptr;
+    while (true) {
+      if (tagOf(first) != 0) {
+        // The bucket is being moved, so insertions have to go to the
+        // table that it is being moved to.
+        if (node != nullptr)
+          nodeAlloc.free(node);
+        const mapped_type* const noValue = nullptr;
+        return std::make_pair(std::make_pair(noValue, ConstMonoPtr()), false);
       }
+      for (const Node* it = first; it != lookedUntil;
+        it = it->next(std::memory_order_consume)
+      ) {
+        if (monoid().equalHintTrue(*value.first, it->mono())) {
+          if (node != nullptr)
+            nodeAlloc.free(node); // Node has a trivial destructor
+          auto p = std::make_pair(&it->value, it->constMono().ptr());
+          return std::make_pair(p, false); // key already present
+        }
+      }
+      lookedUntil = first;
+
+      if (node == nullptr) {
+        node = static_cast<Node*>(nodeAlloc.alloc());
+        // the constructor initializes the first field of node->mono, so
+        // it has to be called before copying the monomial.
+        new (node) Node(first, value.second);
+        monoid().copy(*value.first, node->mono());
+      } else
+        node->setNext(first, std::memory_order_relaxed);
+
+      // We need release so that a reader that sees node also sees the
+      // contents of node. We need acquire for the case where the swap
+      // fails since then first becomes a node that we are going to read.
+      if (bucket.compare_exchange_weak(first, node, std::memory_order_acq_rel))
+        break;
     }
 
-    const auto node = static_cast<Node*>(mNodeAlloc.alloc());
-    const size_t index = hashToIndex(monoid().hash(*value.first));
-    // the constructor initializes the first field of node->mono, so
-    // it has to be called before copying the monomial.
-    new (node) Node(bucketAtIndex(index), value.second);
-    monoid().copy(*value.first, node->mono());
+    auto p = std::make_pair(&node->value, node->constMono().ptr());
+    return std::make_pair(p, true); // successful insertion
+  }
 
-    // we cannot store with memory_order_relaxed here because unlocking the
-    // lock only synchronizes with threads who later grab the lock - it does
-    // not synchronize with reading threads since they do not grab the lock.
-    mBuckets[index].store(node, std::memory_order_release);
+  /// Moves some of the buckets that no other thread has started moving to
+  /// to, which must have at least as many buckets as *this. Returns true
+  /// if this call moved the last of the buckets, which happens for exactly
+  /// one call. Several threads can move buckets at the same time and
+  /// lookups and insertions can go on in both tables meanwhile.
+  ///
+  /// A bucket that is being moved rejects insertions and to is only
+  /// inserted into for monomials whose bucket in *this has moved. So a
+  /// monomial is never present in both tables. The next pointer of a node
+  /// changes when it moves, so a lookup in *this that is going through the
+  /// bucket at that time can miss a monomial that is present.
+  bool moveSomeBucketsTo(FixedSizeMonomialMap<T>& to) {
+    MATHICGB_ASSERT(&to != this);
+    MATHICGB_ASSERT(to.bucketCount() >= bucketCount());
+    const auto begin =
+      mNextBucketToMove.fetch_add(BucketsPerMove, std::memory_order_relaxed);
+    if (begin >= bucketCount())
+      return false;
+    const auto end = std::min(begin + BucketsPerMove, bucketCount());
+    for (auto index = begin; index != end; ++index)
+      moveBucketTo(index, to);
+
+    // acq_rel so that whoever sees the final count also sees all the moves.
+    const auto moved = end - begin;
+    return mMovedBucketCount.fetch_add(moved, std::memory_order_acq_rel) +
+      moved == bucketCount();
+  }
 
-    auto p = std::make_pair(&node->value, node->constMono());
-    return std::make_pair(p, true); // successful insertion
+  /// Returns true if moveSomeBucketsTo() has moved all buckets.
+  bool allBucketsMoved() const {
+    return mMovedBucketCount.load(std::memory_order_acquire) == bucketCount();
+  }
+
+  /// Returns true if the bucket for mono has been moved to another table.
+  bool hasMoved(ConstMonoRef mono) const {
+    const auto index = hashToIndex(monoid().hash(mono));
+    return tagOf(mBuckets[index].load(std::memory_order_acquire)) == MovedTag;
   }
 
   /// This operation removes all entries from the table. This operation
   /// requires synchronization with and mutual exclusion from all other
   /// clients of *this - you need to supply this synchronization manually.
   void clearNonConcurrent() {
-#ifdef MATHICGB_DEBUG
-    // requires mutual exclusion from both readers and writers, but we can
-    // only assert on this for the writers.
-    if (mInsertionMutex.try_lock())
-      mInsertionMutex.unlock();
-    else {
-      MATHICGB_ASSERT(false);
-    }
-#endif
     // we can store relaxed as the client supplies synchronization.
     setTableEntriesToNullRelaxed();
 
     // This is the reason that we cannot support this operation concurrently -
     // we have no way to know when it is safe to deallocate the monomials
     // since readers do no synchronization.
-    mNodeAlloc.freeAllBuffers();
+    for (auto& nodeAlloc : *mNodeAllocs)
+      nodeAlloc.freeAllBuffers();
   }
 
 private:
+  class Node;
+
+  /// The number of buckets that moveSomeBucketsTo() moves at a time.
+  static const size_t BucketsPerMove = 64;
+
+  /// The two lowest bits of a bucket pointer mark a bucket that is being
+  /// moved or that has moved to another table. Nodes are aligned, so these
+  /// bits are otherwise zero. Lookups ignore the tag.
+  static const uintptr_t MovingTag = 1;
+  static const uintptr_t MovedTag = 2;
+  static const uintptr_t TagMask = MovingTag | MovedTag;
+
+  static uintptr_t tagOf(const Node* node) {
+    return reinterpret_cast<uintptr_t>(node) & TagMask;
+  }
+
+  static Node* withTag(Node* node, const uintptr_t tag) {
+    MATHICGB_ASSERT(tagOf(node) == 0);
+    return reinterpret_cast<Node*>(reinterpret_cast<uintptr_t>(node) | tag);
+  }
+
+  template<class N>
+  static N* untag(N* node) {
+    return reinterpret_cast<N*>(reinterpret_cast<uintptr_t>(node) & ~TagMask);
+  }
+
+  void moveBucketTo(const size_t index, FixedSizeMonomialMap<T>& to) {
+    auto& bucket = mBuckets[index];
+
+    // Tag the bucket so that no more nodes are put into it. Acquire so that
+    // we see the contents of the nodes.
+    Node* first = bucket.load(std::memory_order_acquire);
+    while (!bucket.compare_exchange_weak
+      (first, withTag(first, MovingTag), std::memory_order_acq_rel)) {
+    }
+
+    // The bucket in to that a node goes to only gets nodes from this
+    // bucket until the bucket is tagged as moved, so we are the only
+    // writer of it. The number of buckets are powers of two, so all the
+    // monomials of such a bucket map to the same bucket in *this.
+    for (Node* node = first; node != nullptr;) {
+      const auto next = node->next(std::memory_order_relaxed);
+      auto& toBucket = to.mBuckets[to.hashToIndex(monoid().hash(node->mono()))];
+      const auto toFirst = toBucket.load(std::memory_order_relaxed);
+      MATHICGB_ASSERT(tagOf(toFirst) == 0);
+      node->setNext(toFirst, std::memory_order_relaxed);
+      toBucket.store(node, std::memory_order_release);
+      node = next;
+    }
+
+    // Release so that an insertion that sees the tag also sees the nodes
+    // in to.
+    bucket.store(withTag(nullptr, MovedTag), std::memory_order_release);
+  }
+
   void setTableEntriesToNullRelaxed() {
     const auto tableEnd = mBuckets.get() + bucketCount();
     for (auto tableIt = mBuckets.get(); tableIt != tableEnd; ++tableIt)
@@ -269,8 +378,14 @@ private:
 
     const mapped_type value;
 
+    /// Rounded up to the alignment of Node so that the nodes in a pool
+    /// are aligned. The tags on bucket pointers rely on that.
     static size_t bytesPerNode(const Monoid& monoid) {
-      return sizeof(Node) + sizeof(exponent) * (monoid.entryCount() - 1);
+      const auto bytes =
+        sizeof(Node) + sizeof(exponent) * (monoid.entryCount() - 1);
+      const auto align = std::alignment_of<Node>::value;
+      static_assert(std::alignment_of<Node>::value > TagMask, "");
+      return (bytes + align - 1) / align * align;
     }
 
   private:
@@ -309,19 +424,36 @@ private:
 
   Node* bucketAtIndex(size_t index) {
     MATHICGB_ASSERT(index < bucketCount());
-    return mBuckets[index].load(std::memory_order_consume);
+    return untag(mBuckets[index].load(std::memory_order_consume));
   }
 
   const Node* bucketAtIndex(size_t index) const {
     MATHICGB_ASSERT(index < bucketCount());
-    return mBuckets[index].load(std::memory_order_consume);
+    return untag(mBuckets[index].load(std::memory_order_consume));
+  }
+
+  typedef mgb::mtbb::enumerable_thread_specific<memt::BufferPool> NodeAllocs;
+
+  static std::shared_ptr<NodeAllocs> makeNodeAllocs(const Monoid& monoid) {
+    const auto bytesPerNode = Node::bytesPerNode(monoid);
+    return std::make_shared<NodeAllocs>([bytesPerNode]() {
+      return memt::BufferPool(bytesPerNode);
+    });
   }
 
   const HashValue mHashToIndexMask;
   std::unique_ptr<Atomic<Node*>[]> const mBuckets;
   const PolyRing& mRing;
-  memt::BufferPool mNodeAlloc; // nodes are allocated from here.
-  mgb::mtbb::mutex mInsertionMutex;
+
+  /// Nodes are allocated from here, using the pool of the inserting thread.
+  /// This is shared with the table that the nodes are moved to.
+  std::shared_ptr<NodeAllocs> mNodeAllocs;
+
+  /// The first bucket that no call to moveSomeBucketsTo() has claimed.
+  Atomic<size_t> mNextBucketToMove;
+
+  /// The number of buckets that moveSomeBucketsTo() has finished moving.
+  Atomic<size_t> mMovedBucketCount;
 
 public:
   class const_iterator {
@@ -373,7 +505,8 @@ public:
         mNode = 0;
         return;
       }
-      const Node* const node = bucketBegin->load(std::memory_order_consume);
+      const Node* const node =
+        untag(bucketBegin->load(std::memory_order_consume));
       if (node != 0)
         mNode = node;
       else
@@ -388,7 +521,8 @@ public:
           mNode = 0;
           break;
         }
-        const Node* const node = mBucket->load(std::memory_order_consume);
+        const Node* const node =
+          untag(mBucket->load(std::memory_order_consume));
         if (node != 0) {
           mNode = node;
           break;
@@ -0,0 +1,158 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#include "stdinc.h"
+#include "MappedFile.hpp"
+
+#include "Scanner.hpp"
+#include <limits>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MATHICGB_NAMESPACE_BEGIN
+
+MappedFile::MappedFile(): mBegin(0), mSize(0), mMapped(false) {}
+
+#ifdef _WIN32
+bool MappedFile::open(const std::string& fileName) {
+  close();
+  const auto file = CreateFileA(
+    fileName.c_str(),
+    GENERIC_READ,
+    FILE_SHARE_READ,
+    0,
+    OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL,
+    0
+  );
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+  if (GetFileType(file) != FILE_TYPE_DISK) {
+    CloseHandle(file);
+    return false;
+  }
+
+  LARGE_INTEGER size;
+  if (
+    !GetFileSizeEx(file, &size) ||
+    static_cast<unsigned long long>(size.QuadPart) >
+      std::numeric_limits<size_t>::max()
+  ) {
+    CloseHandle(file);
+    return false;
+  }
+  if (size.QuadPart == 0) {
+    CloseHandle(file);
+    mBegin = "";
+    return true;
+  }
+
+  // The view keeps the mapping and the file open after their handles are
+  // closed.
+  const auto mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+  CloseHandle(file);
+  if (mapping == 0)
+    return false;
+  const auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (view == 0)
+    return false;
+
+  mBegin = static_cast<const char*>(view);
+  mSize = static_cast<size_t>(size.QuadPart);
+  mMapped = true;
+  return true;
+}
+
+void MappedFile::close() {
+  if (mMapped)
+    UnmapViewOfFile(mBegin);
+  mBegin = 0;
+  mSize = 0;
+  mMapped = false;
+}
+#else
+bool MappedFile::open(const std::string& fileName) {
+  close();
+
+  // Check for a pipe before opening it, since opening and closing the
+  // reading end of a named pipe can make the writer fail before the
+  // caller gets to read it in some other way.
+  struct stat info;
+  if (::stat(fileName.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+    return false;
+  const int file = ::open(fileName.c_str(), O_RDONLY);
+  if (file == -1)
+    return false;
+
+  if (
+    fstat(file, &info) != 0 ||
+    !S_ISREG(info.st_mode) ||
+    static_cast<unsigned long long>(info.st_size) >
+      std::numeric_limits<size_t>::max()
+  ) {
+    ::close(file);
+    return false;
+  }
+  const auto size = static_cast<size_t>(info.st_size);
+  if (size == 0) {
+    ::close(file);
+    mBegin = "";
+    return true;
+  }
+
+  // The mapping keeps the file open after it is closed here.
+  const auto map = mmap(0, size, PROT_READ, MAP_PRIVATE, file, 0);
+  ::close(file);
+  if (map == MAP_FAILED)
+    return false;
+
+  mBegin = static_cast<const char*>(map);
+  mSize = size;
+  mMapped = true;
+  return true;
+}
+
+void MappedFile::close() {
+  if (mMapped)
+    munmap(const_cast<char*>(mBegin), mSize);
+  mBegin = 0;
+  mSize = 0;
+  mMapped = false;
+}
+#endif
+
+InputFile::InputFile() {}
+
+InputFile::~InputFile() {}
+
+bool InputFile::open(const std::string& fileName) {
+  mScanner.reset();
+  mMappedFile.close();
+  if (mStream.is_open())
+    mStream.close();
+  mStream.clear();
+
+  if (mMappedFile.open(fileName)) {
+    mScanner = make_unique<Scanner>(mMappedFile.begin(), mMappedFile.end());
+    return true;
+  }
+  mStream.open(fileName.c_str());
+  if (mStream.fail())
+    return false;
+  mScanner = make_unique<Scanner>(mStream);
+  return true;
+}
+
+Scanner& InputFile::scanner() {
+  MATHICGB_ASSERT(mScanner.get() != 0);
+  return *mScanner;
+}
+
+MATHICGB_NAMESPACE_END
@@ -0,0 +1,71 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#ifndef MATHICGB_MAPPED_FILE_GUARD
+#define MATHICGB_MAPPED_FILE_GUARD
+
+#include "NonCopyable.hpp"
+#include <string>
+#include <fstream>
+#include <memory>
+
+MATHICGB_NAMESPACE_BEGIN
+
+/// Gives read-only access to the contents of a file by mapping the file
+/// into memory. Pass begin() and end() to a Scanner to read the file
+/// without copying it, which also allows reading from several places in
+/// the file at the same time.
+class MappedFile : public NonCopyable<MappedFile> {
+public:
+  MappedFile();
+  ~MappedFile() {close();}
+
+  /// Maps the file fileName into memory, replacing any file mapped
+  /// before. Returns false if the file could not be opened or mapped. That
+  /// includes anything that is not a regular file, such as a pipe, which
+  /// has to be read as a stream instead.
+  bool open(const std::string& fileName);
+
+  /// Unmaps the file, if any.
+  void close();
+
+  bool isOpen() const {return mBegin != 0;}
+
+  const char* begin() const {return mBegin;}
+  const char* end() const {return mBegin + mSize;}
+  size_t size() const {return mSize;}
+
+private:
+  const char* mBegin;
+  size_t mSize;
+
+  /// False for an empty file, which is not mapped since that is not
+  /// possible.
+  bool mMapped;
+};
+
+class Scanner;
+
+/// Gives a Scanner that reads a file. The file is mapped into memory if
+/// possible, so that MathicIO::readBasisParallel can read it in parallel.
+/// Anything that cannot be mapped, such as a pipe, is read as a stream
+/// instead.
+class InputFile : public NonCopyable<InputFile> {
+public:
+  InputFile();
+  ~InputFile();
+
+  /// Opens the file fileName, replacing any file opened before. Returns
+  /// false if the file could not be opened.
+  bool open(const std::string& fileName);
+
+  /// Returns a Scanner that reads the file. A file must be open.
+  Scanner& scanner();
+
+private:
+  MappedFile mMappedFile;
+  std::ifstream mStream;
+  std::unique_ptr<Scanner> mScanner;
+};
+
+MATHICGB_NAMESPACE_END
+#endif
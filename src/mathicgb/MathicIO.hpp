@@ -8,8 +8,11 @@
 #include "Scanner.hpp"
 #include "PolyRing.hpp"
 #include "MonoProcessor.hpp"
+#include "mtbb.hpp"
 #include <ostream>
 #include <string>
+#include <vector>
+#include <algorithm>
 
 MATHICGB_NAMESPACE_BEGIN
 
@@ -74,6 +77,20 @@ public:
     Scanner& in
   );
 
+  /// Reads a basis like readBasis, but if the input is in memory then the
+  /// input is split at line breaks into chunks of about chunkSize
+  /// characters and the chunks are read in parallel. If that does not give
+  /// the same polynomials as reading them one at a time, which can only
+  /// happen if there is a syntax error or a line break inside a
+  /// polynomial, then the polynomials are read one at a time after all,
+  /// so errors are reported just as by readBasis.
+  Basis readBasisParallel(
+    const PolyRing& ring,
+    const bool readComponent,
+    Scanner& in,
+    const size_t chunkSize = 1024 * 1024
+  );
+
   void writeBasis(
     const Basis& basis,
     const bool writeComponent,
@@ -88,6 +105,16 @@ public:
     Scanner& in
   );
 
+  /// As above, using mono to hold each monomial as it is read. That
+  /// avoids allocating from the pool of the monoid, which is not thread
+  /// safe.
+  Poly readPolyDoNotOrder(
+    const PolyRing& ring,
+    const bool readComponent,
+    MonoRef mono,
+    Scanner& in
+  );
+
   /// Reads a polynomial and orders the terms in descending order.
   Poly readPoly(const PolyRing& ring, const bool readComponent, Scanner& in);
 
@@ -358,6 +385,103 @@ Basis MathicIO<M, BF>::readBasis(
   return std::move(basis);
 }
 
+template<class M, class BF>
+Basis MathicIO<M, BF>::readBasisParallel(
+  const PolyRing& ring,
+  const bool readComponent,
+  Scanner& in,
+  const size_t chunkSize
+) {
+  MATHICGB_ASSERT(chunkSize > 0);
+  if (!in.inMemory())
+    return readBasis(ring, readComponent, in);
+
+  const auto polyCount = in.readInteger<size_t>();
+  Basis basis(ring);
+  if (polyCount == 0)
+    return std::move(basis);
+
+  // Split the input into chunks that start after a line break.
+  const auto end = in.inputEnd();
+  std::vector<const char*> starts(1, in.position());
+  while (static_cast<size_t>(end - starts.back()) > chunkSize) {
+    const auto lineEnd = std::find(starts.back() + chunkSize, end, '\n');
+    if (lineEnd == end)
+      break;
+    starts.push_back(lineEnd + 1);
+  }
+
+  // Each chunk reads the polynomials that start in that chunk, even if
+  // they end after it. Syntax errors are ignored here since the start of a
+  // chunk need not be the start of a polynomial if there is a line break
+  // inside a polynomial.
+  struct Chunk {
+    Chunk(): failed(false) {}
+
+    std::vector<std::unique_ptr<Poly>> polys;
+    std::vector<const char*> polyEnds;
+    bool failed;
+  };
+  const auto chunkCount = starts.size();
+  std::vector<Chunk> chunks(chunkCount);
+  mtbb::parallel_for(size_t(0), chunkCount, size_t(1), [&](const size_t i) {
+    auto& chunk = chunks[i];
+    const auto chunkEnd = i + 1 < chunkCount ? starts[i + 1] : end;
+    try {
+      Scanner chunkIn(starts[i], end);
+      PolyRing::Monoid::MonoPool pool(ring.monoid());
+      auto mono = pool.alloc();
+      while (!chunkIn.matchEOF() && chunkIn.position() < chunkEnd) {
+        auto p = make_unique<Poly>
+          (readPolyDoNotOrder(ring, readComponent, *mono, chunkIn));
+        *p = p->polyWithTermsDescending();
+        chunk.polys.push_back(std::move(p));
+        chunk.polyEnds.push_back(chunkIn.position());
+      }
+    } catch (...) {
+      chunk.failed = true;
+    }
+  });
+
+  // The chunks have read the polynomials that would be read one at a time
+  // if none of them failed and no polynomial extends into the next chunk.
+  size_t readCount = 0;
+  for (size_t i = 0; i < chunkCount; ++i) {
+    const auto& chunk = chunks[i];
+    const auto chunkEnd = i + 1 < chunkCount ? starts[i + 1] : end;
+    if (
+      chunk.failed ||
+      (!chunk.polyEnds.empty() && chunk.polyEnds.back() > chunkEnd)
+    ) {
+      readCount = 0;
+      break;
+    }
+    readCount += chunk.polys.size();
+  }
+
+  if (readCount < polyCount) {
+    for (size_t i = 0; i < polyCount; ++i) {
+      auto p = make_unique<Poly>(readPoly(ring, readComponent, in));
+      basis.insert(std::move(p));
+    }
+    return std::move(basis);
+  }
+
+  // There may be more input after the basis, so stop after polyCount
+  // polynomials.
+  for (auto& chunk : chunks) {
+    for (size_t j = 0; j < chunk.polys.size(); ++j) {
+      basis.insert(std::move(chunk.polys[j]));
+      if (basis.size() == polyCount) {
+        in.skipTo(chunk.polyEnds[j]);
+        return std::move(basis);
+      }
+    }
+  }
+  MATHICGB_ASSERT(false);
+  return std::move(basis);
+}
+
 template<class M, class BF>
 void MathicIO<M, BF>::writeBasis(
   const Basis& basis,
@@ -386,6 +510,17 @@ Poly MathicIO<M, BF>::readPolyDoNotOrder(
   const PolyRing& ring,
   const bool readComponent,
   Scanner& in
+) {
+  auto mono = ring.monoid().alloc();
+  return readPolyDoNotOrder(ring, readComponent, *mono, in);
+}
+
+template<class M, class BF>
+Poly MathicIO<M, BF>::readPolyDoNotOrder(
+  const PolyRing& ring,
+  const bool readComponent,
+  MonoRef mono,
+  Scanner& in
 ) {
   Poly p(ring);
 
@@ -394,13 +529,12 @@ Poly MathicIO<M, BF>::readPolyDoNotOrder(
     return std::move(p);
   MATHICGB_ASSERT(!in.peekWhite());
 
-  auto mono = ring.monoid().alloc();
   auto coef = ring.field().zero();
   do {
     if (!p.isZero() && !in.peekSign() && (!readComponent || in.peek() != '<'))
       in.expect('+', '-');
     readTerm(ring, readComponent, coef, mono, in);
-    p.append(coef.value(), *mono);
+    p.append(coef.value(), mono);
   } while (!in.peekWhite() && !in.matchEOF());
   return std::move(p);
 }
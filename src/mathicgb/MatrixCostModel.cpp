@@ -0,0 +1,91 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#include "stdinc.h"
+#include "MatrixCostModel.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+MATHICGB_NAMESPACE_BEGIN
+
+const size_t MatrixCostModel::InitialGroupSize;
+const size_t MatrixCostModel::MinGroupSize;
+const size_t MatrixCostModel::MaxGroupSize;
+const size_t MatrixCostModel::FixedGroupSize;
+
+MatrixCostModel::MatrixCostModel():
+  mMemoryBudget(0),
+  mAdaptive(true),
+  mMatrixCount(0),
+  mGroupSize(InitialGroupSize),
+  mGrowing(true),
+  mSecondsPerEntry(0.0),
+  mRowsPerSPair(0.0),
+  mEntriesPerRow(0.0),
+  mBytesPerEntry(0.0)
+{}
+
+void MatrixCostModel::addMatrix(const Matrix& matrix) {
+  if (matrix.sPairCount == 0 || matrix.rowCount == 0 || matrix.entryCount == 0)
+    return;
+
+  const auto rowCount = static_cast<double>(matrix.rowCount);
+  const auto entryCount = static_cast<double>(matrix.entryCount);
+  mRowsPerSPair = average(mRowsPerSPair, rowCount / matrix.sPairCount);
+  mEntriesPerRow = average(mEntriesPerRow, entryCount / rowCount);
+  mBytesPerEntry = average(mBytesPerEntry, matrix.memoryUse / entryCount);
+  ++mMatrixCount;
+
+  // The last S-pairs of a degree can give a matrix that is much smaller
+  // than the group size, and such a matrix says little about whether the
+  // group size is right.
+  if (2 * matrix.sPairCount < mGroupSize)
+    return;
+
+  // The time per entry also changes from one matrix to the next for other
+  // reasons than the size, so only a clearly worse throughput changes the
+  // direction.
+  const auto secondsPerEntry = matrix.seconds / entryCount;
+  if (mSecondsPerEntry > 0.0 && secondsPerEntry > 1.1 * mSecondsPerEntry)
+    mGrowing = !mGrowing;
+  mSecondsPerEntry = secondsPerEntry;
+
+  if (mGrowing)
+    mGroupSize = std::min(2 * mGroupSize, MaxGroupSize);
+  else
+    mGroupSize = std::max(mGroupSize / 2, MinGroupSize);
+}
+
+size_t MatrixCostModel::groupSize() const {
+  auto size = mAdaptive ? mGroupSize : FixedGroupSize;
+  if (mMemoryBudget != 0 && mMatrixCount != 0) {
+    while (size > MinGroupSize && predictedMemoryUse(size) > mMemoryBudget)
+      size /= 2;
+  }
+  return size;
+}
+
+size_t MatrixCostModel::predictedRowCount(const size_t sPairCount) const {
+  return static_cast<size_t>(std::ceil(mRowsPerSPair * sPairCount));
+}
+
+size_t MatrixCostModel::predictedEntryCount(const size_t sPairCount) const {
+  return static_cast<size_t>
+    (std::ceil(mEntriesPerRow * predictedRowCount(sPairCount)));
+}
+
+size_t MatrixCostModel::predictedMemoryUse(const size_t sPairCount) const {
+  return static_cast<size_t>
+    (std::ceil(mBytesPerEntry * predictedEntryCount(sPairCount)));
+}
+
+double MatrixCostModel::average(
+  const double average,
+  const double value
+) const {
+  // The matrices change as the degree grows, so the recent matrices count
+  // the most.
+  return mMatrixCount == 0 ? value : (3 * average + value) / 4;
+}
+
+MATHICGB_NAMESPACE_END
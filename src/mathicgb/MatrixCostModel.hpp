@@ -0,0 +1,101 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#ifndef MATHICGB_MATRIX_COST_MODEL_GUARD
+#define MATHICGB_MATRIX_COST_MODEL_GUARD
+
+#include <cstddef>
+
+MATHICGB_NAMESPACE_BEGIN
+
+/// Chooses how many S-pairs to put into the next F4 matrix based on the
+/// matrices so far.
+///
+/// Small matrices do not amortize the fixed cost of building and reducing
+/// a matrix, while large matrices no longer fit in cache and use a lot of
+/// memory. Both show up as a lower throughput, measured as the time spent
+/// per non-zero entry of the matrix. So the group size is doubled as long
+/// as the throughput gets better and it is halved when the throughput gets
+/// worse.
+///
+/// The sizes of the previous matrices also predict the size of the next
+/// matrix, which keeps the group size within a memory budget if there is
+/// one.
+///
+/// If the model is not adaptive, the group size is FixedGroupSize before
+/// the memory budget is applied. That was the group size of the F4
+/// reducers before there was a cost model.
+class MatrixCostModel {
+public:
+  /// What happened when building and reducing a matrix.
+  struct Matrix {
+    size_t sPairCount;
+    size_t rowCount;
+    size_t columnCount;
+    size_t entryCount;
+    size_t memoryUse; /// in bytes
+
+    /// Time to build and reduce the matrix, or only to reduce it if the
+    /// matrix was built while the previous one was being reduced. Which
+    /// of the two must be the same for every matrix.
+    double seconds;
+  };
+
+  MatrixCostModel();
+
+  /// The predicted memory use of a matrix is kept within bytes. A value
+  /// of 0 means that there is no limit, which is the default.
+  void setMemoryBudget(size_t bytes) {mMemoryBudget = bytes;}
+  size_t memoryBudget() const {return mMemoryBudget;}
+
+  /// Sets whether the group size follows the throughput of the matrices.
+  /// The default is true.
+  void setAdaptive(bool value) {mAdaptive = value;}
+  bool adaptive() const {return mAdaptive;}
+
+  /// Updates the model with a matrix that has been built and reduced.
+  void addMatrix(const Matrix& matrix);
+
+  /// Returns the number of S-pairs to put into the next matrix.
+  size_t groupSize() const;
+
+  /// Predictions for a matrix from sPairCount S-pairs. The number of rows
+  /// grows with the number of S-pairs, while the number of columns grows
+  /// more slowly as the S-pairs share monomials. So the number of entries
+  /// is predicted from the number of rows and the number of entries per
+  /// row, that is the density times the number of columns, rather than
+  /// from the number of columns.
+  size_t predictedRowCount(size_t sPairCount) const;
+  size_t predictedEntryCount(size_t sPairCount) const;
+  size_t predictedMemoryUse(size_t sPairCount) const;
+
+  /// The time per entry of the most recent matrix that was large enough
+  /// to tell something about the group size.
+  double secondsPerEntry() const {return mSecondsPerEntry;}
+
+  static const size_t InitialGroupSize = 1024;
+  static const size_t MinGroupSize = 2;
+  static const size_t MaxGroupSize = 1 << 20;
+  static const size_t FixedGroupSize = 100000;
+
+private:
+  /// Returns the running average of average and value. The first value
+  /// becomes the average.
+  double average(double average, double value) const;
+
+  size_t mMemoryBudget;
+  bool mAdaptive;
+  size_t mMatrixCount;
+  size_t mGroupSize;
+
+  /// If true, the group size was doubled after the last measurement.
+  /// Otherwise it was halved.
+  bool mGrowing;
+
+  double mSecondsPerEntry;
+  double mRowsPerSPair;
+  double mEntriesPerRow;
+  double mBytesPerEntry;
+};
+
+MATHICGB_NAMESPACE_END
+#endif
@@ -127,14 +127,356 @@ private:
   Lookup* const mLookups;
 };
 
+/// Keeps the module monomials of each component in a binary trie on the
+/// bits of their divisibility masks. An interior node splits its monomials
+/// on one bit of the mask, and the monomials are stored in the leaves. A
+/// divisor of a monomial cannot have a bit that the monomial does not
+/// have, so a lookup only has to follow the zero child at the nodes whose
+/// bit is not set in the mask of the monomial. memberSet takes all the
+/// monomials of a component down the trie together, so each node is
+/// visited at most once per call.
+class DivMaskModuleMonoSet : public ModuleMonoSet {
+public:
+  typedef PolyRing::Monoid Monoid;
+  typedef Monoid::DivMask DivMask;
+
+  DivMaskModuleMonoSet(
+    const Monoid& monoid,
+    const size_t componentCount,
+    const bool allowRemovals
+  ):
+    mMonoid(monoid),
+    mAllowRemovals(allowRemovals),
+    mBitCount(std::min<size_t>(monoid.varCount(), MaskBitCount)),
+    mTries(componentCount, Trie(1)),
+    mElementCount(0)
+  {}
+
+  virtual bool insert(ConstMonoRef mono) {
+    const auto c = monoid().component(mono);
+    MATHICGB_ASSERT(c < componentCount());
+    auto& trie = mTries[c];
+    const auto mask = monoid().divMask(mono);
+    if (hasDivisor(trie, 0, mono, mask))
+      return false;
+    if (mAllowRemovals)
+      mElementCount -= removeMultiples(trie, 0, mono, mask);
+
+    size_t node = 0;
+    while (!trie[node].isLeaf())
+      node = hasBit(mask, trie[node].bit) ? trie[node].one : trie[node].zero;
+    Entry entry = {mask, mono.ptr()};
+    trie[node].entries.push_back(entry);
+    if (trie[node].entries.size() > trie[node].splitSize)
+      split(trie, node);
+    ++mElementCount;
+    return true;
+  }
+
+  virtual bool member(ConstMonoRef mono) {
+    const auto c = monoid().component(mono);
+    MATHICGB_ASSERT(c < componentCount());
+    return hasDivisor(mTries[c], 0, mono, monoid().divMask(mono));
+  }
+
+  virtual void memberSet(
+    const std::vector<ConstMonoPtr>& monos,
+    std::vector<bool>& isMemberOut
+  ) {
+    isMemberOut.assign(monos.size(), false);
+    mQueries.clear();
+    for (size_t i = 0; i < monos.size(); ++i) {
+      const Query query = {monoid().divMask(*monos[i]), i};
+      mQueries.push_back(query);
+    }
+
+    // Sort by component so that each trie is entered once.
+    const auto& monoid = this->monoid();
+    const auto componentLess = [&](const Query& a, const Query& b) {
+      return monoid.component(*monos[a.index]) <
+        monoid.component(*monos[b.index]);
+    };
+    std::sort(mQueries.begin(), mQueries.end(), componentLess);
+
+    const auto end = mQueries.data() + mQueries.size();
+    for (auto begin = mQueries.data(); begin != end;) {
+      const auto c = monoid.component(*monos[begin->index]);
+      MATHICGB_ASSERT(c < componentCount());
+      auto componentEnd = begin;
+      while (
+        componentEnd != end &&
+        monoid.component(*monos[componentEnd->index]) == c
+      )
+        ++componentEnd;
+      members(mTries[c], 0, begin, componentEnd, monos, isMemberOut);
+      begin = componentEnd;
+    }
+  }
+
+  virtual std::string name() const {
+    return "divisibility mask trie";
+  }
+
+  virtual void display(std::ostream& out) const {
+    std::vector<ConstMonoPtr> monomials;
+    for (size_t c = 0; c < componentCount(); ++c) {
+      monomials.clear();
+      for (const auto& node : mTries[c])
+        for (const auto& entry : node.entries)
+          monomials.push_back(entry.mono);
+      if (monomials.empty())
+        continue;
+      out << "  " << c << ": ";
+      const auto& monoid = this->monoid();
+      const auto cmp = [&](ConstMonoPtr a, ConstMonoPtr b) {
+        return monoid.lessThan(*a, *b);
+      };
+      std::sort(monomials.begin(), monomials.end(), cmp);
+      for (auto mono = monomials.cbegin(); mono != monomials.cend(); ++mono) {
+        MathicIO<>().writeMonomial(monoid, false, **mono, out);
+        out << "  ";
+      }
+      out << '\n';
+    }
+  }
+
+  virtual void forAllVirtual(EntryOutput& consumer) {
+    for (const auto& trie : mTries)
+      for (const auto& node : trie)
+        for (const auto& entry : node.entries)
+          consumer.proceed(*entry.mono);
+  }
+
+  virtual size_t elementCount() const {return mElementCount;}
+
+  virtual size_t getMemoryUse() const {
+    size_t sum = mTries.capacity() * sizeof(Trie) +
+      mQueries.capacity() * sizeof(Query);
+    for (const auto& trie : mTries) {
+      sum += trie.capacity() * sizeof(Node);
+      for (const auto& node : trie)
+        sum += node.entries.capacity() * sizeof(Entry);
+    }
+    return sum;
+  }
+
+  const Monoid& monoid() const {return mMonoid;}
+  size_t componentCount() const {return mTries.size();}
+
+private:
+  /// The top bit of a mask is set for monomials with a negative exponent,
+  /// which do not occur in this set, so only the bits below it are used.
+  static const size_t MaskBitCount = sizeof(DivMask) * 8 - 1;
+
+  /// A leaf is split once it has more entries than this.
+  static const size_t LeafSize = 16;
+
+  static const size_t NoNode = static_cast<size_t>(-1);
+
+  struct Entry {
+    DivMask mask;
+    ConstMonoPtr mono;
+  };
+
+  struct Node {
+    Node(): bit(0), zero(NoNode), one(NoNode), splitSize(LeafSize) {}
+
+    bool isLeaf() const {return zero == NoNode;}
+
+    /// The bit that an interior node splits on.
+    size_t bit;
+
+    /// The children of an interior node. The monomials of one have bit set.
+    size_t zero;
+    size_t one;
+
+    /// The number of entries above which a leaf is split. It grows for
+    /// leaves that cannot be split since all entries have the same mask.
+    size_t splitSize;
+
+    std::vector<Entry> entries;
+  };
+
+  /// The nodes of a trie. The root is at index 0.
+  typedef std::vector<Node> Trie;
+
+  struct Query {
+    DivMask mask;
+    size_t index;
+  };
+
+  static bool hasBit(const DivMask mask, const size_t bit) {
+    return (mask & (static_cast<DivMask>(1) << bit)) != 0;
+  }
+
+  /// Returns true if a can divide b as far as the masks can tell.
+  static bool maskSubset(const DivMask a, const DivMask b) {
+    const auto bitsOfA = a & ~(static_cast<DivMask>(1) << MaskBitCount);
+    return (bitsOfA & ~b) == 0;
+  }
+
+  bool hasDivisor(
+    const Trie& trie,
+    const size_t node,
+    ConstMonoRef mono,
+    const DivMask mask
+  ) const {
+    const auto& n = trie[node];
+    if (n.isLeaf()) {
+      for (const auto& entry : n.entries)
+        if (maskSubset(entry.mask, mask) &&
+          monoid().divides(*entry.mono, mono))
+          return true;
+      return false;
+    }
+    return
+      (hasBit(mask, n.bit) && hasDivisor(trie, n.one, mono, mask)) ||
+      hasDivisor(trie, n.zero, mono, mask);
+  }
+
+  /// Sets isMemberOut for the queries in [begin, end) that have a divisor
+  /// in the subtrie at node.
+  void members(
+    const Trie& trie,
+    const size_t node,
+    Query* begin,
+    Query* end,
+    const std::vector<ConstMonoPtr>& monos,
+    std::vector<bool>& isMemberOut
+  ) const {
+    if (begin == end)
+      return;
+    const auto& n = trie[node];
+    if (n.isLeaf()) {
+      for (auto query = begin; query != end; ++query) {
+        const auto& mono = *monos[query->index];
+        for (const auto& entry : n.entries) {
+          if (
+            maskSubset(entry.mask, query->mask) &&
+            monoid().divides(*entry.mono, mono)
+          ) {
+            isMemberOut[query->index] = true;
+            break;
+          }
+        }
+      }
+      return;
+    }
+
+    // Only the queries with the bit of this node set can have a divisor
+    // under the one child. The queries found there need not go further.
+    const auto bit = n.bit;
+    const auto withBit = std::partition(begin, end, [&](const Query& query) {
+      return hasBit(query.mask, bit);
+    });
+    members(trie, n.one, begin, withBit, monos, isMemberOut);
+    const auto notFound = std::partition(begin, end, [&](const Query& query) {
+      return !isMemberOut[query.index];
+    });
+    members(trie, n.zero, begin, notFound, monos, isMemberOut);
+  }
+
+  /// Removes the entries in the subtrie at node that mono divides and
+  /// returns how many there were.
+  size_t removeMultiples(
+    Trie& trie,
+    const size_t node,
+    ConstMonoRef mono,
+    const DivMask mask
+  ) {
+    auto& n = trie[node];
+    if (!n.isLeaf()) {
+      const auto removed = removeMultiples(trie, n.one, mono, mask);
+      if (hasBit(mask, n.bit))
+        return removed;
+      return removed + removeMultiples(trie, n.zero, mono, mask);
+    }
+
+    auto& entries = n.entries;
+    const auto isMultiple = [&](const Entry& entry) {
+      return maskSubset(mask, entry.mask) &&
+        monoid().divides(mono, *entry.mono);
+    };
+    const auto newEnd =
+      std::remove_if(entries.begin(), entries.end(), isMultiple);
+    const auto removed = static_cast<size_t>(entries.end() - newEnd);
+    entries.erase(newEnd, entries.end());
+    return removed;
+  }
+
+  /// Splits the leaf at node on the bit that divides its entries most
+  /// evenly.
+  void split(Trie& trie, const size_t node) {
+    MATHICGB_ASSERT(trie[node].isLeaf());
+    const auto entryCount = trie[node].entries.size();
+    size_t bestBit = 0;
+    size_t bestBalance = 0;
+    for (size_t bit = 0; bit < mBitCount; ++bit) {
+      size_t withBit = 0;
+      for (const auto& entry : trie[node].entries)
+        if (hasBit(entry.mask, bit))
+          ++withBit;
+      const auto balance = std::min(withBit, entryCount - withBit);
+      if (balance > bestBalance) {
+        bestBit = bit;
+        bestBalance = balance;
+      }
+    }
+    if (bestBalance == 0) {
+      trie[node].splitSize *= 2;
+      return;
+    }
+
+    // Adding the children can move the nodes, so node is only accessed
+    // by index after this.
+    const auto zero = trie.size();
+    const auto one = zero + 1;
+    trie.resize(trie.size() + 2);
+    auto& n = trie[node];
+    for (const auto& entry : n.entries)
+      trie[hasBit(entry.mask, bestBit) ? one : zero].entries.push_back(entry);
+    n.entries.clear();
+    n.entries.shrink_to_fit();
+    n.bit = bestBit;
+    n.zero = zero;
+    n.one = one;
+  }
+
+  const Monoid& mMonoid;
+  const bool mAllowRemovals;
+
+  /// The number of bits of the masks that a trie can split on.
+  const size_t mBitCount;
+
+  std::vector<Trie> mTries;
+  size_t mElementCount;
+
+  /// Scratch space for memberSet.
+  std::vector<Query> mQueries;
+};
+
+const size_t DivMaskModuleMonoSet::MaskBitCount;
+const size_t DivMaskModuleMonoSet::LeafSize;
+const size_t DivMaskModuleMonoSet::NoNode;
+
 ModuleMonoSet::~ModuleMonoSet() {}
 
+void ModuleMonoSet::memberSet(
+  const std::vector<ConstMonoPtr>& monos,
+  std::vector<bool>& isMemberOut
+) {
+  isMemberOut.resize(monos.size());
+  for (size_t i = 0; i < monos.size(); ++i)
+    isMemberOut[i] = member(*monos[i]);
+}
+
 void ModuleMonoSet::displayCodes(std::ostream& out) {
   out <<
    "  1   list, using divmasks\n"
    "  2   KD-tree, using divmasks\n"
    "  3   list\n"
-   "  4   KD-tree\n";
+   "  4   KD-tree\n"
+   "  5   trie of divisibility masks, checks sets of monomials together\n";
 }
 
 namespace {
@@ -178,6 +520,8 @@ std::unique_ptr<ModuleMonoSet> ModuleMonoSet::make(
   const size_t components,
   const bool allowRemovals
 ) {
+  if (type == 5)
+    return make_unique<DivMaskModuleMonoSet>(monoid, components, allowRemovals);
   return ModuleMonoSetFactory().make(monoid, type, components, allowRemovals);
 }
 
@@ -30,6 +30,14 @@ public:
   /// Returns true if mono is a member of the ideal generated by this set.
   virtual bool member(ConstMonoRef mono) = 0;
 
+  /// Sets isMemberOut[i] to member(*monos[i]) for each i. Implementations
+  /// can use this to check all of monos in one pass over the set. The
+  /// default implementation calls member for each mono.
+  virtual void memberSet(
+    const std::vector<ConstMonoPtr>& monos,
+    std::vector<bool>& isMemberOut
+  );
+
   /// Prints a human-readable representation of this set to out.
   virtual void display(std::ostream& out) const = 0;
 
@@ -68,7 +68,16 @@ namespace {
 
     virtual size_t regularReducer(ConstMonoRef sig, ConstMonoRef mono) const {
       return mLookup.regularReducer
-        (sig, mono, sigBasis(), preferSparseReducers());
+        (sig, mono, sigBasis(), preferSparseReducers(), nullptr);
+    }
+
+    virtual size_t regularReducer(
+      ConstMonoRef sig,
+      ConstMonoRef mono,
+      MonoPool& pool
+    ) const {
+      return mLookup.regularReducer
+        (sig, mono, sigBasis(), preferSparseReducers(), &pool);
     }
 
     virtual size_t classicReducer(ConstMonoRef mono) const {
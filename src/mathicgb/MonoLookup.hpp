@@ -19,6 +19,7 @@ public:
   typedef PolyRing::Monoid Monoid;
   typedef Monoid::ConstMonoRef ConstMonoRef;
   typedef Monoid::ConstMonoPtr ConstMonoPtr;
+  typedef Monoid::MonoPool MonoPool;
 
   virtual ~MonoLookup();
 
@@ -38,6 +39,15 @@ public:
   // and (mono / leadTerm(u)) * signature(u) < sig.
   virtual size_t regularReducer(ConstMonoRef sig, ConstMonoRef mono) const = 0;
 
+  // As regularReducer(sig, mono), but several threads can call this at the
+  // same time as long as nothing is inserted. Temporary monomials are taken
+  // from pool, which must not be used by any other thread during the call.
+  virtual size_t regularReducer(
+    ConstMonoRef sig,
+    ConstMonoRef mono,
+    MonoPool& pool
+  ) const = 0;
+
   // Returns the index of a basis element whose lead term divides mono. The
   // strategy used to break ties is up to the implementation of the interface,
   // but the outcome must be deterministic.
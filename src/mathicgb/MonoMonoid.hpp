@@ -5,6 +5,7 @@
 
 #include "MonoOrder.hpp"
 #include "NonCopyable.hpp"
+#include "MonoSimd.hpp"
 #include <cstddef>
 #include <vector>
 #include <algorithm>
@@ -27,22 +28,25 @@ template<
   class Exponent,
   bool HasComponent = true,
   bool StoreHash = true,
-  bool StoreOrder = true
+  bool StoreOrder = true,
+  bool StoreDivMask = false
 >
 class MonoMonoid;
 
 namespace MonoMonoidInternal {
-  template<class E, bool HC, bool SH, bool SO>
+  template<class E, bool HC, bool SH, bool SO, bool SDM>
   class Base {
   public:
     static const bool HasComponent = HC;
     static const bool StoreHash = SH;
     static const bool StoreOrder = SO;
+    static const bool StoreDivMask = SDM;
 
     typedef size_t VarIndex;
     typedef E Exponent;
     typedef typename std::make_unsigned<E>::type Component;
     typedef typename std::make_unsigned<E>::type HashValue;
+    typedef typename std::make_unsigned<E>::type DivMask;
     typedef const Exponent* const_iterator;
     typedef MonoOrder<Exponent> Order;
 
@@ -54,7 +58,9 @@ namespace MonoMonoidInternal {
       ),
       mOrderIndexBegin(HasComponent + order.varCount()),
       mOrderIndexEnd(mOrderIndexBegin + StoreOrder * mGradingCount),
-      mEntryCount(std::max<VarIndex>(mOrderIndexEnd + StoreHash, 1)),
+      mEntryCount(
+        std::max<VarIndex>(mOrderIndexEnd + StoreHash + StoreDivMask, 1)
+      ),
       mHashCoefficients(makeHashCoefficients(order.varCount())),
       mOrderIsTotalDegreeRevLex(
         !order.hasLexBaseOrder() &&
@@ -66,7 +72,8 @@ namespace MonoMonoidInternal {
       mComponentGradingIndex(
         reverseComponentGradingIndex(mGradingCount, order.componentBefore())
       ),
-      mVarsReversed(order.hasFromLeftBaseOrder())
+      mVarsReversed(order.hasFromLeftBaseOrder()),
+      mKernels(monoKernels())
     {
       MATHICGB_ASSERT(order.isMonomialOrder());
       MATHICGB_ASSERT(mGradings.size() == gradingCount() * varCount());
@@ -79,8 +86,10 @@ namespace MonoMonoidInternal {
     VarIndex orderIndexEnd() const {return mOrderIndexEnd;}
     VarIndex orderIndexBegin() const {return mOrderIndexBegin;}
     VarIndex hashIndex() const {return mOrderIndexEnd;}
+    VarIndex divMaskIndex() const {return mOrderIndexEnd + StoreHash;}
     VarIndex componentGradingIndex() const {return mComponentGradingIndex;}
     bool varsReversed() const {return mVarsReversed;}
+    const MonoKernels& kernels() const {return mKernels;}
 
   protected:
     typedef std::vector<Exponent> HashCoefficients;
@@ -272,13 +281,17 @@ namespace MonoMonoidInternal {
     /// case it needs to be done again before showing a monomial to the
     /// outside world.
     const bool mVarsReversed;
+
+    /// A copy of monoKernels(), so that using a kernel does not need a
+    /// call to find it.
+    const MonoKernels mKernels;
   };
 }
 
-template<class E, bool HC, bool SH, bool SO>
-class MonoMonoid : private MonoMonoidInternal::Base<E, HC, SH, SO> {
+template<class E, bool HC, bool SH, bool SO, bool SDM>
+class MonoMonoid : private MonoMonoidInternal::Base<E, HC, SH, SO, SDM> {
 private:
-  typedef MonoMonoidInternal::Base<E, HC, SH, SO> Base;
+  typedef MonoMonoidInternal::Base<E, HC, SH, SO, SDM> Base;
 
 public:
   static_assert(std::numeric_limits<E>::is_signed, "");
@@ -306,6 +319,16 @@ public:
   /// is not much for most operations.
   using Base::StoreOrder;
 
+  /// Is true if a divisibility mask is stored with each monomial. Bit
+  /// var % (number of bits in DivMask - 1) of the mask is set if and only
+  /// if var or another variable with the same bit has a positive exponent.
+  /// If a divides b then the mask of a is a subset of the mask of b, so
+  /// most non-divisors are rejected by a single and of the two masks
+  /// before looking at any exponents. The top bit is set if the monomial
+  /// has a negative exponent, since then the mask of a product is not
+  /// just the or of the masks of the factors.
+  using Base::StoreDivMask;
+
   /// Type used to indicate the component of a module monomial. For example,
   /// the component of xe_3 is 3.
   typedef typename Base::Component Component;
@@ -313,6 +336,9 @@ public:
   /// Type used to store hash values of monomials.
   typedef typename Base::HashValue HashValue;
 
+  /// Type of the divisibility masks of monomials. See StoreDivMask.
+  typedef typename Base::DivMask DivMask;
+
   /// Iterator for the exponents in a monomial.
   typedef typename Base::const_iterator const_iterator;
 
@@ -392,8 +418,10 @@ public:
   }
 
   /// Creates a compatible copy of monoid.
-  template<class E2, bool HC2, bool SH2, bool SO2>
-  static MonoMonoid create(const MonoMonoid<E2, HC2, SH2, SO2>& monoid) {
+  template<class E2, bool HC2, bool SH2, bool SO2, bool SDM2>
+  static MonoMonoid create(
+    const MonoMonoid<E2, HC2, SH2, SO2, SDM2>& monoid
+  ) {
     return MonoMonoid(monoid.makeOrder(false, false));
   }
 
@@ -508,6 +536,15 @@ public:
 
   /// Returns true if a and b are equal. Includes check for component.
   bool equal(ConstMonoRef a, ConstMonoRef b) const {
+    Exponent orOfXor = 0;
+    const auto xorEntry = [&](const VarIndex i) {
+      orOfXor |= access(a, i) ^ access(b, i);
+    };
+    if (isFixedCount(exponentsIndexEnd())) {
+      forEachIndex(entriesIndexBegin(), exponentsIndexEnd(), xorEntry);
+      return orOfXor == 0;
+    }
+
     for (auto i = entriesIndexBegin(); i != exponentsIndexEnd(); ++i)
       if (access(a, i) != access(b, i))
         return false;
@@ -535,8 +572,10 @@ public:
     // that none of the early-exit branches are taken - that is, when a equals
     // b.
     Exponent orOfXor = 0;
-    for (VarIndex i = lastExponentIndex(); i != beforeEntriesIndexBegin(); --i)
+    const auto xorEntry = [&](const VarIndex i) {
       orOfXor |= access(a, i) ^ access(b, i);
+    };
+    forEachIndex(entriesIndexBegin(), exponentsIndexEnd(), xorEntry);
     MATHICGB_ASSERT((orOfXor == 0) == equal(a, b));
     return orOfXor == 0;
   }
@@ -628,6 +667,15 @@ public:
     return static_cast<HashValue>(static_cast<Exponent>(hashA + hashB));
   }
 
+  /// Returns the divisibility mask of mono. See StoreDivMask.
+  DivMask divMask(ConstMonoRef mono) const {
+    MATHICGB_ASSERT(debugDivMaskValid(mono));
+    if (StoreDivMask)
+      return static_cast<DivMask>(access(mono, divMaskIndex()));
+    else
+      return computeDivMask(mono);
+  }
+
   /// Returns true if all the exponents of mono are zero. In other
   /// words, returns true if mono is the identity for multiplication
   /// of monomials.
@@ -642,10 +690,9 @@ public:
     // dividesWithComponent.
     //if (HasComponent && component(div) != component(into))
     //  return false;
-    for (auto i = exponentsIndexBegin(); i < exponentsIndexEnd(); ++i)
-      if (access(div, i) > access(into, i))
-        return false;
-    return true;
+    if (StoreDivMask && !divMaskSubset(div, into))
+      return false;
+    return exponentsLessOrEqual(div, into);
   }
 
   /// Returns true if a divides b. Equal monomials divide each other.
@@ -660,10 +707,9 @@ public:
   bool dividesWithComponent(ConstMonoRef div, ConstMonoRef into) const {
     if (HasComponent && component(div) != component(into))
       return false;
-    for (auto i = exponentsIndexBegin(); i < exponentsIndexEnd(); ++i)
-      if (access(div, i) > access(into, i))
-        return false;
-    return true;
+    if (StoreDivMask && !divMaskSubset(div, into))
+      return false;
+    return exponentsLessOrEqual(div, into);
   }
 
   template<class MonoidA>
@@ -721,6 +767,11 @@ public:
     MATHICGB_ASSERT(debugLcmCheck(*this, a, *this, b));
     MATHICGB_ASSERT(debugValid(div));
 
+    if (StoreDivMask) {
+      const auto lcmMask = divMask(a) | divMask(b);
+      if ((divMask(div) & ~lcmMask & ~DivMaskNegativeBit) != 0)
+        return false;
+    }
     for (auto i = exponentsIndexBegin(); i != exponentsIndexEnd(); ++i) {
       const auto dive = access(div, i);
       if (access(div, i) > access(a, i) && access(div, i) > access(b, i))
@@ -814,6 +865,17 @@ public:
     // If StoreOrder is true then this first checks the degrees.
     // Then the exponents are checked.
     // Finally, if HasComponent is true, the component is checked.
+    if (useKernels(index)) {
+      index = static_cast<VarIndex>(kernels().lastDifference
+        (asInt32(ptr(a, 0)), asInt32(ptr(b, 0)), index));
+      if (index == entriesIndexBegin())
+        return EqualTo;
+      --index;
+      const auto cmp = access(a, index) - access(b, index);
+      return cmp < 0 ?
+        (isLexBaseOrder() ? LessThan : GreaterThan) :
+        (isLexBaseOrder() ? GreaterThan : LessThan);
+    }
     while (index != entriesIndexBegin()) {
       --index;
       const auto cmp = access(a, index) - access(b, index);
@@ -902,6 +964,18 @@ public:
     return degree(mono, gradingCount() - 1);
   }
 
+  /// Compares monomials a and b where a has degree degreeA and b has
+  /// degree degreeB, as far as the degree decides the order. The degree
+  /// is the first thing that compare() looks at, so a result other than
+  /// EqualTo is the result that compare(a, b) would give. Returns EqualTo
+  /// if the degrees are equal, in which case the rest of the monomials
+  /// has to decide the order.
+  CompareResult compareDegrees(Exponent degreeA, Exponent degreeB) const {
+    if (degreeA == degreeB)
+      return EqualTo;
+    return (degreeA < degreeB) == isLexBaseOrder() ? LessThan : GreaterThan;
+  }
+
   /// Returns the degree of mono according to the grading with the
   /// given index.
   Exponent degree(ConstMonoRef mono, VarIndex grading) const {
@@ -957,6 +1031,7 @@ public:
     }
     if (StoreHash)
       access(to, hashIndex()) = monoidFrom.hash(from);
+    setDivMask(to);
 
     MATHICGB_ASSERT(debugValid(to));
     // todo: check equal
@@ -976,6 +1051,7 @@ public:
 
     updateOrderData(var, oldExponent, newExponent, mono);
     updateHashExponent(var, oldExponent, newExponent, mono);
+    setDivMask(mono);
 
     MATHICGB_ASSERT(debugValid(mono));
   }
@@ -1004,6 +1080,7 @@ public:
     }
     setOrderData(mono);
     setHash(mono);
+    setDivMask(mono);
 
     MATHICGB_ASSERT(debugValid(mono));
   }
@@ -1034,8 +1111,21 @@ public:
     MATHICGB_ASSERT(debugValid(a));
     MATHICGB_ASSERT(debugValid(b));
 
-    for (auto i = lastEntryIndex(); i != beforeEntriesIndexBegin(); --i)
+    // prod can be the same as a or b, so read the masks first.
+    const auto productMask =
+      StoreDivMask ? divMask(a) | divMask(b) : static_cast<DivMask>(0);
+
+    const auto addEntries = [&](const VarIndex i) {
       access(prod, i) = access(a, i) + access(b, i);
+    };
+    const auto end = productEntriesIndexEnd();
+    if (useKernels(end)) {
+      kernels().add
+        (asInt32(ptr(a, 0)), asInt32(ptr(b, 0)), asInt32(ptr(prod, 0)), end);
+    } else
+      forEachIndex(entriesIndexBegin(), end, addEntries);
+    if (StoreDivMask)
+      setProductDivMask(productMask, prod);
 
     MATHICGB_ASSERT(debugValid(prod));
   }
@@ -1045,8 +1135,20 @@ public:
     MATHICGB_ASSERT(debugValid(a));
     MATHICGB_ASSERT(debugValid(prod));
 
-    for (auto i = entriesIndexBegin(); i < entriesIndexEnd(); ++i)
+    const auto productMask =
+      StoreDivMask ? divMask(a) | divMask(prod) : static_cast<DivMask>(0);
+
+    const auto addEntry = [&](const VarIndex i) {
       access(prod, i) += access(a, i);
+    };
+    const auto end = productEntriesIndexEnd();
+    if (useKernels(end)) {
+      kernels().add
+        (asInt32(ptr(a, 0)), asInt32(ptr(prod, 0)), asInt32(ptr(prod, 0)), end);
+    } else
+      forEachIndex(entriesIndexBegin(), end, addEntry);
+    if (StoreDivMask)
+      setProductDivMask(productMask, prod);
 
     MATHICGB_ASSERT(debugValid(prod));      
   }
@@ -1057,8 +1159,9 @@ public:
     MATHICGB_ASSERT(debugValid(num));
     MATHICGB_ASSERT(debugValid(by));
 
-    for (auto i = entriesIndexBegin(); i < entriesIndexEnd(); ++i)
+    for (auto i = entriesIndexBegin(); i < productEntriesIndexEnd(); ++i)
       access(quo, i) = access(num, i) - access(by, i);
+    setDivMask(quo);
 
     MATHICGB_ASSERT(debugValid(quo));
   }
@@ -1069,8 +1172,9 @@ public:
     MATHICGB_ASSERT(debugValid(by));
     MATHICGB_ASSERT(debugValid(num));
 
-    for (auto i = entriesIndexBegin(); i < entriesIndexEnd(); ++i)
+    for (auto i = entriesIndexBegin(); i < productEntriesIndexEnd(); ++i)
       access(num, i) -= access(by, i);
+    setDivMask(num);
 
     MATHICGB_ASSERT(debugValid(num));
   }
@@ -1086,8 +1190,9 @@ public:
       component(by) == component(num)
     );
 
-    for (auto i = entriesIndexBegin(); i < entriesIndexEnd(); ++i)
+    for (auto i = entriesIndexBegin(); i < productEntriesIndexEnd(); ++i)
       access(quo, i) = access(num, i) - access(by, i);
+    setDivMask(quo);
 
     MATHICGB_ASSERT(debugValid(quo));
   }
@@ -1114,6 +1219,7 @@ public:
     }
     setOrderData(out);
     setHash(out);
+    setDivMask(out);
     MATHICGB_ASSERT(debugValid(out));
   }
 
@@ -1152,8 +1258,10 @@ public:
     }
     setOrderData(aColonB);
     setHash(aColonB);
+    setDivMask(aColonB);
     setOrderData(bColonA);
     setHash(bColonA);
+    setDivMask(bColonA);
 
     MATHICGB_ASSERT(debugValid(aColonB));
     MATHICGB_ASSERT(debugValid(bColonA));
@@ -1165,10 +1273,20 @@ public:
       MATHICGB_ASSERT(component(a) == component(b));
       access(lcmAB, componentIndex()) = access(a, componentIndex());
     }
-    for (auto i = exponentsIndexBegin(); i != exponentsIndexEnd(); ++i)
-      access(lcmAB, i) = std::max(access(a, i), access(b, i));
+    if (useKernels(varCount())) {
+      kernels().max(
+        asInt32(ptr(a, exponentsIndexBegin())),
+        asInt32(ptr(b, exponentsIndexBegin())),
+        asInt32(ptr(lcmAB, exponentsIndexBegin())),
+        varCount()
+      );
+    } else {
+      for (auto i = exponentsIndexBegin(); i != exponentsIndexEnd(); ++i)
+        access(lcmAB, i) = std::max(access(a, i), access(b, i));
+    }
     setOrderData(lcmAB);
     setHash(lcmAB);
+    setDivMask(lcmAB);
 
     MATHICGB_ASSERT(debugValid(lcmAB));
     MATHICGB_ASSERT(isLcm(a, b, lcmAB));
@@ -1196,6 +1314,7 @@ public:
 
     setOrderData(lcmAB);
     setHash(lcmAB);
+    setDivMask(lcmAB);
 
     MATHICGB_ASSERT(debugValid(lcmAB));
     MATHICGB_ASSERT(isLcm(monoidA, a, monoidB, b, lcmAB));
@@ -1662,6 +1781,7 @@ public:
   bool debugValid(ConstMonoRef mono) const {
     MATHICGB_ASSERT(debugOrderValid(mono));
     MATHICGB_ASSERT(debugHashValid(mono));
+    MATHICGB_ASSERT(debugDivMaskValid(mono));
     return true;
   }
 
@@ -1669,7 +1789,7 @@ private:
   void operator=(MonoMonoid&); // not available
 
   // Grants access to other template instantiations.
-  template<class E2, bool HC2, bool SH2, bool SO2>
+  template<class E2, bool HC2, bool SH2, bool SO2, bool SDM2>
   friend class MonoMonoid;
 
   // The main point here is to grant access to rawPtr().
@@ -1692,10 +1812,11 @@ private:
     const auto storedDegrees = StoreOrder * gradingCount();
     MATHICGB_ASSERT(orderIndexEnd() == orderIndexBegin() + storedDegrees);
     MATHICGB_ASSERT(orderIndexEnd() <= entryCount());
-    if (orderIndexEnd() + StoreHash == 0) {
+    const auto storedCount = orderIndexEnd() + StoreHash + StoreDivMask;
+    if (storedCount == 0) {
       MATHICGB_ASSERT(entryCount() == 1);
     } else {
-      MATHICGB_ASSERT(entryCount() == orderIndexEnd() + StoreHash);
+      MATHICGB_ASSERT(entryCount() == storedCount);
     }
 
     MATHICGB_ASSERT(isLexBaseOrder() || varCount() == 0 || gradingCount() >= 1);
@@ -1720,6 +1841,12 @@ private:
       MATHICGB_ASSERT(hashIndex() == orderIndexEnd());
     }
     MATHICGB_ASSERT(hashCoefficients().size() == varCount());
+
+    // ** Divisibility mask checks
+    if (StoreDivMask) {
+      MATHICGB_ASSERT(divMaskIndex() < entryCount());
+      MATHICGB_ASSERT(divMaskIndex() == orderIndexEnd() + StoreHash);
+    }
 #endif
     return true;
   }
@@ -1782,6 +1909,92 @@ private:
     return rawPtr(m)[index];
   }
 
+  // *** Loops over the entries of monomials
+
+  /// Returns true if count is one of the common loop lengths 4, 8, 16 or
+  /// 32 that forEachIndex() has a loop with a fixed trip count for. Since
+  /// this is the length of a loop rather than the number of variables,
+  /// it also covers monomials with a few variables plus component, degree
+  /// and hash entries.
+  static bool isFixedCount(const VarIndex count) {
+    return count == 4 || count == 8 || count == 16 || count == 32;
+  }
+
+  /// Calls op(i) for each i in [begin, begin + count). If isFixedCount(count)
+  /// then the loop has a trip count known at compile time, so the compiler
+  /// unrolls it completely and keeps the entries in registers.
+  template<class Op>
+  static void forEachIndex(
+    const VarIndex begin,
+    const VarIndex count,
+    const Op& op
+  ) {
+    switch (count) {
+    case 4: forEachIndexFixed<4>(begin, op); break;
+    case 8: forEachIndexFixed<8>(begin, op); break;
+    case 16: forEachIndexFixed<16>(begin, op); break;
+    case 32: forEachIndexFixed<32>(begin, op); break;
+    default:
+      for (VarIndex i = 0; i < count; ++i)
+        op(begin + i);
+    }
+  }
+
+  template<VarIndex Count, class Op>
+  static MATHICGB_INLINE void forEachIndexFixed(
+    const VarIndex begin,
+    const Op& op
+  ) {
+    for (VarIndex i = 0; i < Count; ++i)
+      op(begin + i);
+  }
+
+  /// The kernels from MonoSimd.hpp only handle 32 bit exponents, and they
+  /// only pay off once a loop is long enough to fill a vector register.
+  /// Shorter loops and loops of a fixed length are left to the compiler,
+  /// which avoids the indirect call.
+  static const VarIndex KernelThreshold = 8;
+
+  static bool useKernels(const VarIndex count) {
+    return std::is_same<Exponent, int32>::value &&
+      count >= KernelThreshold &&
+      !isFixedCount(count);
+  }
+
+  static const int32* asInt32(const Exponent* p) {
+    return reinterpret_cast<const int32*>(p);
+  }
+
+  static int32* asInt32(Exponent* p) {
+    return reinterpret_cast<int32*>(p);
+  }
+
+  /// Returns true if no exponent of a is greater than the same exponent
+  /// of b.
+  bool exponentsLessOrEqual(ConstMonoRef a, ConstMonoRef b) const {
+    // Without an early exit the fixed count loops have no branches.
+    bool greater = false;
+    const auto compareEntry = [&](const VarIndex i) {
+      greater |= access(a, i) > access(b, i);
+    };
+    if (isFixedCount(varCount())) {
+      forEachIndex(exponentsIndexBegin(), varCount(), compareEntry);
+      return !greater;
+    }
+
+    if (useKernels(varCount())) {
+      return kernels().lessOrEqual(
+        asInt32(ptr(a, exponentsIndexBegin())),
+        asInt32(ptr(b, exponentsIndexBegin())),
+        varCount()
+      );
+    }
+    for (auto i = exponentsIndexBegin(); i < exponentsIndexEnd(); ++i)
+      if (access(a, i) > access(b, i))
+        return false;
+    return true;
+  }
+
   // *** Implementation of monomial ordering
 
   using Base::gradingsOppositeRowIndex;
@@ -1922,9 +2135,62 @@ private:
   }
 
 
+  // *** Implementation of divisibility masks
+
+  static const VarIndex DivMaskVarBitCount = sizeof(DivMask) * 8 - 1;
+  static const DivMask DivMaskNegativeBit =
+    static_cast<DivMask>(1) << DivMaskVarBitCount;
+
+  bool debugDivMaskValid(ConstMonoRef mono) const {
+    if (!StoreDivMask)
+      return true;
+    MATHICGB_ASSERT(
+      static_cast<DivMask>(access(mono, divMaskIndex())) == computeDivMask(mono)
+    );
+    return true;
+  }
+
+  DivMask computeDivMask(ConstMonoRef mono) const {
+    DivMask mask = 0;
+    for (VarIndex var = 0; var < varCount(); ++var) {
+      const auto e = exponent(mono, var);
+      if (e > 0)
+        mask |= static_cast<DivMask>(1) << (var % DivMaskVarBitCount);
+      else if (e < 0)
+        mask |= DivMaskNegativeBit;
+    }
+    return mask;
+  }
+
+  /// Returns true if the variable bits of the mask of a are a subset of
+  /// those of b, which is a necessary condition for a to divide b.
+  bool divMaskSubset(ConstMonoRef a, ConstMonoRef b) const {
+    return (divMask(a) & ~divMask(b) & ~DivMaskNegativeBit) == 0;
+  }
+
+  void setDivMask(MonoRef mono) const {
+    if (!StoreDivMask)
+      return;
+    rawPtr(mono)[divMaskIndex()] = static_cast<Exponent>(computeDivMask(mono));
+    MATHICGB_ASSERT(debugDivMaskValid(mono));
+  }
+
+  /// Sets the mask of prod, which is the product of two monomials whose
+  /// masks or together to productMask.
+  void setProductDivMask(const DivMask productMask, MonoRef prod) const {
+    if ((productMask & DivMaskNegativeBit) != 0) {
+      // A negative exponent can cancel out a positive one.
+      setDivMask(prod);
+      return;
+    }
+    access(prod, divMaskIndex()) = static_cast<Exponent>(productMask);
+    MATHICGB_ASSERT(debugDivMaskValid(prod));
+  }
+
+
   // *** Code determining the layout of monomials in memory
   // Layout in memory:
-  //   [component] [exponents...] [order data...] [hash]
+  //   [component] [exponents...] [order data...] [hash] [divisibility mask]
 
   VarIndex componentIndex() const {
     //static_assert(HasComponent, "");
@@ -1938,35 +2204,44 @@ private:
   using Base::orderIndexBegin;
   using Base::orderIndexEnd;
   using Base::hashIndex;
+  using Base::divMaskIndex;
   using Base::orderIsTotalDegreeRevLex;
   using Base::gradings;
   using Base::isLexBaseOrder;
   using Base::componentGradingIndex;
+  using Base::kernels;
 
   VarIndex entriesIndexBegin() const {return 0;}
   VarIndex entriesIndexEnd() const {return entryCount();}
   VarIndex beforeEntriesIndexBegin() const {return entriesIndexBegin() - 1;}
   VarIndex lastEntryIndex() const {return entriesIndexEnd() - 1;}
 
+  /// The entries before this index are added when multiplying monomials
+  /// and subtracted when dividing them. That is all entries except the
+  /// divisibility mask.
+  VarIndex productEntriesIndexEnd() const {
+    return entriesIndexEnd() - StoreDivMask;
+  }
+
   using Base::hashCoefficients;
 
   mutable MonoPool mPool;
 };
 
 /// Returns true if a and b are the same object.
-template<class E, bool HC, bool SH, bool SO>
+template<class E, bool HC, bool SH, bool SO, bool SDM>
 bool operator==(
-  const MonoMonoid<E,HC,SH,SO>& a,
-  const MonoMonoid<E,HC,SH,SO>& b
+  const MonoMonoid<E,HC,SH,SO,SDM>& a,
+  const MonoMonoid<E,HC,SH,SO,SDM>& b
 ) {
   return &a == &b;
 }
 
 /// As !(a == b).
-template<class E, bool HC, bool SH, bool SO>
+template<class E, bool HC, bool SH, bool SO, bool SDM>
 bool operator!=(
-  const MonoMonoid<E,HC,SH,SO>& a,
-  const MonoMonoid<E,HC,SH,SO>& b
+  const MonoMonoid<E,HC,SH,SO,SDM>& a,
+  const MonoMonoid<E,HC,SH,SO,SDM>& b
 ) {
   return !(a == b);
 }
@@ -0,0 +1,249 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#include "stdinc.h"
+#include "MonoSimd.hpp"
+
+#include <algorithm>
+
+#ifdef MATHICGB_USE_SIMD_X86
+#include <immintrin.h>
+#endif
+
+MATHICGB_NAMESPACE_BEGIN
+
+namespace {
+  void addScalar(
+    const int32* const a,
+    const int32* const b,
+    int32* const sum,
+    const size_t count
+  ) {
+    for (size_t i = 0; i < count; ++i)
+      sum[i] = a[i] + b[i];
+  }
+
+  void maxScalar(
+    const int32* const a,
+    const int32* const b,
+    int32* const max,
+    const size_t count
+  ) {
+    for (size_t i = 0; i < count; ++i)
+      max[i] = std::max(a[i], b[i]);
+  }
+
+  bool lessOrEqualScalar(
+    const int32* const a,
+    const int32* const b,
+    const size_t count
+  ) {
+    for (size_t i = 0; i < count; ++i)
+      if (a[i] > b[i])
+        return false;
+    return true;
+  }
+
+  size_t lastDifferenceScalar(
+    const int32* const a,
+    const int32* const b,
+    size_t count
+  ) {
+    while (count != 0 && a[count - 1] == b[count - 1])
+      --count;
+    return count;
+  }
+
+#ifdef MATHICGB_USE_SIMD_X86
+  MATHICGB_TARGET("sse4.1")
+  void addSse41(
+    const int32* const a,
+    const int32* const b,
+    int32* const sum,
+    const size_t count
+  ) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      const __m128i va =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+      const __m128i vb =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+      _mm_storeu_si128
+        (reinterpret_cast<__m128i*>(sum + i), _mm_add_epi32(va, vb));
+    }
+    addScalar(a + i, b + i, sum + i, count - i);
+  }
+
+  MATHICGB_TARGET("sse4.1")
+  void maxSse41(
+    const int32* const a,
+    const int32* const b,
+    int32* const max,
+    const size_t count
+  ) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      const __m128i va =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+      const __m128i vb =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+      _mm_storeu_si128
+        (reinterpret_cast<__m128i*>(max + i), _mm_max_epi32(va, vb));
+    }
+    maxScalar(a + i, b + i, max + i, count - i);
+  }
+
+  /// Or's together the lanes where a > b and checks the result only once
+  /// at the end, since divisibility tests usually succeed in the places
+  /// where they are hot.
+  MATHICGB_TARGET("sse4.1")
+  bool lessOrEqualSse41(
+    const int32* const a,
+    const int32* const b,
+    const size_t count
+  ) {
+    __m128i greater = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      const __m128i va =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+      const __m128i vb =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+      greater = _mm_or_si128(greater, _mm_cmpgt_epi32(va, vb));
+    }
+    return _mm_testz_si128(greater, greater) &&
+      lessOrEqualScalar(a + i, b + i, count - i);
+  }
+
+  MATHICGB_TARGET("sse4.1")
+  size_t lastDifferenceSse41(
+    const int32* const a,
+    const int32* const b,
+    size_t count
+  ) {
+    for (; count >= 4; count -= 4) {
+      const auto begin = count - 4;
+      const __m128i va =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + begin));
+      const __m128i vb =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + begin));
+      const int equal =
+        _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va, vb)));
+      if (equal != 0xF)
+        return begin + (31 - __builtin_clz(~equal & 0xF)) + 1;
+    }
+    return lastDifferenceScalar(a, b, count);
+  }
+
+  MATHICGB_TARGET("avx2")
+  void addAvx2(
+    const int32* const a,
+    const int32* const b,
+    int32* const sum,
+    const size_t count
+  ) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+      const __m256i va =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+      const __m256i vb =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+      _mm256_storeu_si256
+        (reinterpret_cast<__m256i*>(sum + i), _mm256_add_epi32(va, vb));
+    }
+    addScalar(a + i, b + i, sum + i, count - i);
+  }
+
+  MATHICGB_TARGET("avx2")
+  void maxAvx2(
+    const int32* const a,
+    const int32* const b,
+    int32* const max,
+    const size_t count
+  ) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+      const __m256i va =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+      const __m256i vb =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+      _mm256_storeu_si256
+        (reinterpret_cast<__m256i*>(max + i), _mm256_max_epi32(va, vb));
+    }
+    maxScalar(a + i, b + i, max + i, count - i);
+  }
+
+  MATHICGB_TARGET("avx2")
+  bool lessOrEqualAvx2(
+    const int32* const a,
+    const int32* const b,
+    const size_t count
+  ) {
+    __m256i greater = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+      const __m256i va =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+      const __m256i vb =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+      greater = _mm256_or_si256(greater, _mm256_cmpgt_epi32(va, vb));
+    }
+    return _mm256_testz_si256(greater, greater) &&
+      lessOrEqualScalar(a + i, b + i, count - i);
+  }
+
+  MATHICGB_TARGET("avx2")
+  size_t lastDifferenceAvx2(
+    const int32* const a,
+    const int32* const b,
+    size_t count
+  ) {
+    for (; count >= 8; count -= 8) {
+      const auto begin = count - 8;
+      const __m256i va =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + begin));
+      const __m256i vb =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + begin));
+      const int equal =
+        _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(va, vb)));
+      if (equal != 0xFF)
+        return begin + (31 - __builtin_clz(~equal & 0xFF)) + 1;
+    }
+    return lastDifferenceScalar(a, b, count);
+  }
+
+  MonoKernels selectSimdMonoKernels() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      const MonoKernels kernels = {
+        "AVX2", &addAvx2, &maxAvx2, &lessOrEqualAvx2, &lastDifferenceAvx2
+      };
+      return kernels;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+      const MonoKernels kernels = {
+        "SSE4.1", &addSse41, &maxSse41, &lessOrEqualSse41, &lastDifferenceSse41
+      };
+      return kernels;
+    }
+    return scalarMonoKernels();
+  }
+#endif
+}
+
+const MonoKernels& scalarMonoKernels() {
+  static const MonoKernels kernels = {
+    "scalar", &addScalar, &maxScalar, &lessOrEqualScalar, &lastDifferenceScalar
+  };
+  return kernels;
+}
+
+const MonoKernels& monoKernels() {
+#ifdef MATHICGB_USE_SIMD_X86
+  static const MonoKernels kernels = selectSimdMonoKernels();
+  return kernels;
+#else
+  return scalarMonoKernels();
+#endif
+}
+
+MATHICGB_NAMESPACE_END
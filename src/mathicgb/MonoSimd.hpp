@@ -0,0 +1,42 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#ifndef MATHICGB_MONO_SIMD_GUARD
+#define MATHICGB_MONO_SIMD_GUARD
+
+#include <cstddef>
+
+MATHICGB_NAMESPACE_BEGIN
+
+/// Kernels for the loops over the entries of monomials with 32 bit
+/// exponents that MonoMonoid spends most of its time in. All of them work
+/// on arrays of count entries that may be unaligned. The kernels are
+/// selected once at run time based on what the CPU supports - see
+/// monoKernels().
+struct MonoKernels {
+  /// The name of the instruction set used, such as "AVX2".
+  const char* name;
+
+  /// Sets sum[i] to a[i] + b[i]. sum may be equal to a or b.
+  void (*add)(const int32* a, const int32* b, int32* sum, size_t count);
+
+  /// Sets max[i] to the maximum of a[i] and b[i]. max may be equal to a
+  /// or b.
+  void (*max)(const int32* a, const int32* b, int32* max, size_t count);
+
+  /// Returns true if a[i] <= b[i] for all i.
+  bool (*lessOrEqual)(const int32* a, const int32* b, size_t count);
+
+  /// Returns one plus the largest index i such that a[i] != b[i], or 0
+  /// if a and b are equal.
+  size_t (*lastDifference)(const int32* a, const int32* b, size_t count);
+};
+
+/// The kernels for the CPU that we are running on.
+const MonoKernels& monoKernels();
+
+/// The portable kernels. These are the reference that the other kernels
+/// are tested and benchmarked against.
+const MonoKernels& scalarMonoKernels();
+
+MATHICGB_NAMESPACE_END
+#endif
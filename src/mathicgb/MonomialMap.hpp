@@ -7,37 +7,66 @@
 #include "mtbb.hpp"
 #include "Atomic.hpp"
 #include "PolyRing.hpp"
+#include "ScopeExit.hpp"
 #include <memtailor.h>
 #include <limits>
 #include <vector>
 #include <algorithm>
+#include <thread>
 
 MATHICGB_NAMESPACE_BEGIN
 
 /// A concurrent hash map from monomials to T. This map can resize itself
 /// if there are too few buckets compared to entries.
 ///
-/// Queries are supported through a MonomialMap::Reader object. On resize all
-/// previous readers are subject to permanent spurious misses -
-/// querying clients need to grab a fresh reader to confirm misses. Grabbing
-/// a reader incurs synchronization so do not do it for every query.
+/// Insertions do not take a lock. An insertion links a new node into its
+/// bucket with a compare-and-swap, so if several threads insert the same
+/// monomial at the same time, exactly one of them wins and the others get
+/// the entry of the winner back. The only lock is mResizeMutex, which is
+/// taken to start and finish a resize and to delete old tables, but never
+/// to insert or look up an entry.
 ///
-/// External synchronization with writers is required if spurious misses are
-/// not acceptable. There are no spurious hits. If misses are very rare then
-/// reads can be done with minimal overhead by following this pattern:
+/// A resize moves the entries to a table with more buckets a few buckets at
+/// a time. The thread that starts the resize keeps moving buckets until all
+/// have moved, and every insertion that happens in the meantime helps by
+/// moving some buckets too, so no thread waits for another to rehash the
+/// whole table. An insertion looks in the old table first and only goes on
+/// to the new table once its bucket has moved, so an insertion never
+/// misses an entry that is already there.
+///
+/// An old table is retired once all its buckets have moved, but it is only
+/// deleted once no thread can still be looking at it. Every Reader and
+/// every insertion pins the map to the current epoch for as long as it
+/// looks at the tables - see pin(). A retired table is deleted once the
+/// epoch has advanced past the epoch it was retired in and no thread is
+/// pinned to that epoch any more. Pinning updates a counter that all
+/// threads share, so code that makes many readers or insertions should make
+/// a Pin and pass it to them. A Pin also batches the updates of the entry
+/// count.
+///
+/// Queries are supported through a MonomialMap::Reader object. A Reader
+/// looks only at the tables that existed when it was made, so it is subject
+/// to permanent spurious misses for entries that are moved to a new table
+/// after that - querying clients need to grab a fresh reader to confirm
+/// misses. A lookup can also miss spuriously if it happens at the same time
+/// as the bucket it looks in is moved. There are no spurious hits.
+///
+/// If spurious misses are not acceptable, confirm a miss with insert(),
+/// which never misses: it either finds the entry that is already there or
+/// inserts the value it is given. If misses are very rare then reads can be
+/// done with minimal overhead by following this pattern:
 ///
 ///  1) grab a reader X
 ///  2) perform queries on X until done or there is a miss
 ///  3) replace X with a fresh reader
 ///  4) go to 2 if the miss is now a hit
-///  5) grab a lock shared with all writers
-///  6) perform the query again - a miss is now guaranteed to be accurate
-///  7) release the lock after the processing of the miss is done and go to 2
+///  5) insert the key - if another thread inserted it first, insert()
+///     returns that entry
+///  6) go to 2
 ///
-/// There is no way to avoid locking if spurious misses are not acceptable
-/// as otherwise a writer could make an insertion of the requested key at any
-/// time while processing the miss - which then makes the miss spurious
-/// after-the-fact.
+/// Another thread can insert the key at any time after a miss, so a miss
+/// is only meaningful as "not there yet". Code that has to act on a miss
+/// exactly once should act only if its own insertion won.
 template<class T>
 class MonomialMap {
 public:
@@ -54,28 +83,75 @@ public:
 
   MonomialMap(const PolyRing& ring):
     mMap(new FixedSizeMap(InitialBucketCount, ring)),
-    mCapacityUntilGrowth
-    (maxEntries(mMap.load(std::memory_order_relaxed)->bucketCount())),
-    mRing(ring)
+    mOldMap(nullptr),
+    mRing(ring),
+    mEntryCount(0),
+    mEpoch(0),
+    mRetiredMapCount(0)
   {
     // We can load mMap as std::memory_order_relaxed because we just stored it
     // and the constructor cannot run concurrently.
+    mPinCounts[0].store(0, std::memory_order_relaxed);
+    mPinCounts[1].store(0, std::memory_order_relaxed);
   }
 
   ~MonomialMap() {
     // We can load with std::memory_order_relaxed because the destructor
-    // cannot run concurrently.
+    // cannot run concurrently. A resize always finishes before the
+    // insertion that started it returns, so there is no old table.
+    MATHICGB_ASSERT(mOldMap.load(std::memory_order_relaxed) == nullptr);
     delete mMap.load(std::memory_order_relaxed);
   }
 
   const PolyRing& ring() const {return mRing;}
 
+  /// Pins the map for as long as it exists, as a Reader does. A Reader or an
+  /// insertion that is given a Pin uses it instead of pinning the map
+  /// itself, so make one Pin for a task that makes many readers or
+  /// insertions. A Pin also counts the insertions that it is given to and
+  /// adds them to the entry count of the map a batch at a time. A Pin must
+  /// only be used by one thread at a time and it should not be kept around
+  /// for longer than a task as it delays the deletion of old tables.
+  class Pin {
+  public:
+    Pin(MonomialMap<T>& map):
+      mMap(map),
+      mEpoch(map.pin()),
+      mInsertCount(0)
+    {}
+
+    ~Pin() {
+      // Growing the table could throw, so that is left to a later
+      // insertion.
+      if (mInsertCount != 0)
+        mMap.mEntryCount.fetch_add(mInsertCount);
+      mMap.unpin(mEpoch);
+    }
+
+  private:
+    Pin(const Pin&); // not available
+    void operator=(const Pin&); // not available
+
+    friend class MonomialMap<T>;
+
+    MonomialMap<T>& mMap;
+    const size_t mEpoch;
+
+    /// The number of insertions that have not been added to the entry
+    /// count of mMap yet.
+    size_t mInsertCount;
+  };
+
   /// All queries are performed through a Reader. Readers are subject to
   /// permanent spurious misses on hash map resize. Grab a fresh reader
   /// on misses to confirm them. Making a Reader imposes synchronization
-  /// overhead. External locking is required to guarantee that a miss is
-  /// genuine since there is no mutual exclusion between queries and
-  /// insertions.
+  /// overhead unless it is made from a Pin. Queries and insertions are not
+  /// mutually exclusive, so use insert() if a miss has to be confirmed.
+  ///
+  /// A Reader pins the map for as long as it exists, so that the tables it
+  /// looks at are not deleted, unless it is made from a Pin. Do not keep a
+  /// Reader around for longer than necessary as that delays the deletion of
+  /// old tables.
   ///
   /// It is intentional that a reader does not have an update() method. The
   /// purpose of this is to make the internal hash table pointer const inside
@@ -90,11 +166,29 @@ public:
   class Reader {
   public:
     Reader(const MonomialMap<T>& map):
-      mMap(*map.mMap.load(std::memory_order_seq_cst))
+      mUnpin(&map),
+      mEpoch(map.pin()),
+      mMap(*map.mMap.load(std::memory_order_seq_cst)),
+      mOldMap(map.mOldMap.load(std::memory_order_seq_cst))
     {
       // We grab the hash table pointer with std::memory_order_seq_cst in order
       // to force a CPU cache flush - in this way we are more likely to get an
-      // up to date value.
+      // up to date value. The tables are loaded after pinning, so they are
+      // not deleted until we unpin.
+    }
+
+    /// Makes a reader of the map of pin that does not pin the map itself.
+    /// The reader must not outlive pin.
+    Reader(const Pin& pin):
+      mUnpin(nullptr),
+      mEpoch(pin.mEpoch),
+      mMap(*pin.mMap.mMap.load(std::memory_order_seq_cst)),
+      mOldMap(pin.mMap.mOldMap.load(std::memory_order_seq_cst))
+    {}
+
+    ~Reader() {
+      if (mUnpin != nullptr)
+        mUnpin->unpin(mEpoch);
     }
 
     /// Returns the value that mono maps to or null if no such key has been
@@ -103,7 +197,10 @@ public:
     /// class.
     std::pair<const mapped_type*, ConstMonoPtr>
     find(ConstMonoRef mono) const {
-      return mMap.find(mono);
+      const auto found = mMap.find(mono);
+      if (found.first != nullptr || mOldMap == nullptr)
+        return found;
+      return mOldMap->find(mono);
     }
 
     // As find but looks for the product of a and b and also returns the
@@ -112,7 +209,10 @@ public:
       ConstMonoRef a,
       ConstMonoRef b
     ) const {
-      return mMap.findProduct(a, b);
+      const auto found = mMap.findProduct(a, b);
+      if (found.first != nullptr || mOldMap == nullptr)
+        return found;
+      return mOldMap->findProduct(a, b);
     }
 
     /// As findProduct() but looks for the two products a1*b and a2*b
@@ -124,19 +224,39 @@ public:
       const ConstMonoRef a2,
       const ConstMonoRef b
     ) const {
-      return mMap.findTwoProducts(a1, a2, b);
+      auto found = mMap.findTwoProducts(a1, a2, b);
+      if (mOldMap != nullptr) {
+        if (found.first == nullptr)
+          found.first = mOldMap->findProduct(a1, b).first;
+        if (found.second == nullptr)
+          found.second = mOldMap->findProduct(a2, b).first;
+      }
+      return found;
     }
 
     typedef typename FixedSizeMonomialMap<T>::const_iterator const_iterator;
 
     /// The range [begin(), end()) contains all entries in the hash table.
     /// Insertions invalidate all iterators. Beware that insertions can
-    /// happen concurrently.
+    /// happen concurrently. Entries that are still in the old table of a
+    /// resize are not included, but there is no resize once insertions
+    /// stop.
     const_iterator begin() const {return mMap.begin();}
     const_iterator end() const {return mMap.end();}
 
   private:
+    Reader(const Reader&); // not available
+    void operator=(const Reader&); // not available
+
+    /// The map to unpin on destruction. Null if the reader was made from a
+    /// Pin.
+    const MonomialMap<T>* const mUnpin;
+    const size_t mEpoch;
     const FixedSizeMonomialMap<T>& mMap;
+
+    /// The table that the entries of mMap were being moved from when the
+    /// reader was made. Null if there was no resize going on.
+    const FixedSizeMonomialMap<T>* const mOldMap;
   };
 
   /// Removes all entries from the hash table. This requires mutual exclusion
@@ -144,7 +264,13 @@ public:
   void clearNonConcurrent() {
     // We can load with std::memory_order_relaxed because this method
     // requires external synchronization.
+    MATHICGB_ASSERT(mOldMap.load(std::memory_order_relaxed) == nullptr);
     mMap.load(std::memory_order_relaxed)->clearNonConcurrent();
+    mEntryCount.store(0, std::memory_order_relaxed);
+
+    // There are no readers, so the old tables can go.
+    mRetiredMaps.clear();
+    mRetiredMapCount.store(0, std::memory_order_relaxed);
   }
 
   /// Makes value.first map to value.second unless value.first is already
@@ -154,53 +280,59 @@ public:
   /// equal value.second if an insertion was not performed - unless the
   /// inserted value equals the already present value. p.first.second is an
   /// internal monomial that equals value.first.
+  ///
+  /// Insertions do not take a lock, except briefly to start or finish a
+  /// resize. An insertion that happens during a resize moves some of the
+  /// buckets to the new table.
   std::pair<std::pair<const mapped_type*, ConstMonoPtr>, bool>
   insert(const value_type& value) {
-    const mgb::mtbb::mutex::scoped_lock lockGuard(mInsertionMutex);
-
-    // We can load mMap as std::memory_order_relaxed because we have already
-    // synchronized with all other mutators by locking mInsertionMutex;
-    auto map = mMap.load(std::memory_order_relaxed);
-
-    // this is a loop since it is possible to set the growth factor and
-    // the initial size so low that several rounds are required. This should
-    // only happen when debugging as otherwise such low parameters are
-    // not a good idea.
-    while (mCapacityUntilGrowth == 0) {
-      // Resize the table by making a bigger one and using that instead.
-      if (map->bucketCount() > // check overflow
-        std::numeric_limits<size_t>::max() / GrowthFactor)
-      {
-        throw std::bad_alloc();
-      }
-      const size_t newBucketCount = map->bucketCount() * GrowthFactor;
-      auto nextMap =
-        make_unique<FixedSizeMap>(newBucketCount, std::move(*map));
-      mOldMaps.emplace_back(map);
-      mCapacityUntilGrowth =
-        maxEntries(nextMap->bucketCount()) - maxEntries(map->bucketCount());
-
-      // Store with std::memory_order_seq_cst to force a memory flush so that
-      // readers see the new table as soon as possible.
-      map = nextMap.release();
-      mMap.store(map, std::memory_order_seq_cst);
-    }
-    MATHICGB_ASSERT(mCapacityUntilGrowth > 0);
+    const auto epoch = pin();
+    MATHICGB_SCOPE_EXIT(unpinGuard) {unpin(epoch);};
 
-    auto p = map->insert(value);
+    const auto p = insertPinned(value);
     if (p.second)
-      --mCapacityUntilGrowth;
+      addEntries(1);
+    if (mRetiredMapCount.load(std::memory_order_relaxed) != 0)
+      tryDeleteRetiredMaps();
+    return p;
+  }
+
+  /// As insert(value), except that the map is not pinned again and the
+  /// insertion is only added to the entry count of the map once pin has
+  /// counted a batch of insertions or the table is close to needing to
+  /// grow. pin must be a Pin of this map.
+  std::pair<std::pair<const mapped_type*, ConstMonoPtr>, bool>
+  insert(const value_type& value, Pin& pin) {
+    MATHICGB_ASSERT(&pin.mMap == this);
+    const auto p = insertPinned(value);
+    if (p.second) {
+      ++pin.mInsertCount;
+      const auto map = mMap.load();
+      if (
+        pin.mInsertCount == InsertCountBatch ||
+        mEntryCount.load(std::memory_order_relaxed) + pin.mInsertCount >
+          maxEntries(map->bucketCount())
+      ) {
+        const auto count = pin.mInsertCount;
+        pin.mInsertCount = 0;
+        addEntries(count);
+      }
+    }
+    if (mRetiredMapCount.load(std::memory_order_relaxed) != 0)
+      tryDeleteRetiredMaps();
     return p;
   }
 
-  /// Return the number of entries. This method uses internal synchronization
-  /// so do not call too much or you'll get degraded performance.
+  /// Return the number of entries. Insertions through a Pin that still
+  /// exists might not be counted yet.
   size_t entryCount() const {
-    const mgb::mtbb::mutex::scoped_lock lockGuard(mInsertionMutex);
-    // We can load with std::memory_order_relaxed because we are holding the
-    // lock.
-    auto& map = *mMap.load(std::memory_order_relaxed);
-    return maxEntries(map.bucketCount()) - mCapacityUntilGrowth;
+    return mEntryCount.load();
+  }
+
+  /// Returns the number of old tables from finished resizes that have not
+  /// been deleted yet.
+  size_t retiredMapCount() const {
+    return mRetiredMapCount.load();
   }
 
 private:
@@ -208,23 +340,197 @@ private:
   static const size_t GrowthFactor = 2;
   static const size_t InitialBucketCount = 1 << 1;
 
+  /// The number of insertions that a Pin counts before it adds them to
+  /// mEntryCount.
+  static const size_t InsertCountBatch = 64;
+
   static size_t maxEntries(const size_t bucketCount) {
     return (bucketCount + (MinBucketsPerEntry - 1)) / MinBucketsPerEntry;
   }
 
+  /// Inserts value as insert() does. Must be called while pinned. Does not
+  /// update mEntryCount.
+  std::pair<std::pair<const mapped_type*, ConstMonoPtr>, bool>
+  insertPinned(const value_type& value) {
+    std::pair<std::pair<const mapped_type*, ConstMonoPtr>, bool> p;
+    while (true) {
+      // A resize stores mOldMap before mMap, so if mOldMap is the same
+      // before and after loading mMap then map is the table that oldMap is
+      // being moved to - or oldMap is null and map is the current table or a
+      // table that has moved entirely, which then rejects the insertion.
+      const auto oldMap = mOldMap.load();
+      const auto map = mMap.load();
+      if (map == oldMap || mOldMap.load() != oldMap)
+        continue; // a resize started while we looked
+
+      if (oldMap != nullptr) {
+        moveSomeBuckets(*oldMap, *map);
+
+        // A monomial is in the new table only if its bucket in the old
+        // table has moved, so we have to wait for that before looking in
+        // the new table. Moving a single bucket does not take long.
+        p = oldMap->insert(value);
+        if (p.first.first == nullptr) {
+          while (!oldMap->hasMoved(*value.first))
+            std::this_thread::yield();
+          p = map->insert(value);
+        }
+      } else
+        p = map->insert(value);
+      if (p.first.first != nullptr)
+        break;
+      // The bucket was tagged by a resize that we did not know about.
+    }
+    return p;
+  }
+
+  /// Adds count to mEntryCount and grows the table if there are now too
+  /// many entries. Must be called while pinned.
+  void addEntries(const size_t count) {
+    const auto entryCount = mEntryCount.fetch_add(count) + count;
+    if (entryCount > maxEntries(mMap.load()->bucketCount()))
+      growIfNeeded();
+  }
+
+  /// Starts a resize if there are too many entries for the number of
+  /// buckets and no resize is going on. If a resize is started, then this
+  /// method moves buckets until all have moved - other threads may help.
+  /// Must be called while pinned.
+  void growIfNeeded() {
+    FixedSizeMap* map;
+    FixedSizeMap* nextMap;
+    {
+      const mgb::mtbb::mutex::scoped_lock lockGuard(mResizeMutex);
+      if (mOldMap.load() != nullptr)
+        return; // the table grows once the current resize is done
+
+      // We can load mMap as std::memory_order_relaxed because we have
+      // already synchronized with all other resizes by locking mResizeMutex.
+      map = mMap.load(std::memory_order_relaxed);
+      if (mEntryCount.load() <= maxEntries(map->bucketCount()))
+        return; // another thread already did the resize
+
+      // this is a loop since it is possible to set the growth factor and
+      // the initial size so low that several rounds are required. This should
+      // only happen when debugging as otherwise such low parameters are
+      // not a good idea.
+      auto bucketCount = map->bucketCount();
+      while (mEntryCount.load() > maxEntries(bucketCount)) {
+        if (bucketCount > // check overflow
+          std::numeric_limits<size_t>::max() / GrowthFactor)
+          throw std::bad_alloc();
+        bucketCount *= GrowthFactor;
+      }
+      nextMap = new FixedSizeMap(bucketCount, *map);
+
+      // Insertions rely on mOldMap being stored before mMap. Store with
+      // std::memory_order_seq_cst to force a memory flush so that readers
+      // see the new table as soon as possible.
+      mOldMap.store(map, std::memory_order_seq_cst);
+      mMap.store(nextMap, std::memory_order_seq_cst);
+    }
+
+    while (!map->allBucketsMoved())
+      moveSomeBuckets(*map, *nextMap);
+  }
+
+  /// Moves some buckets of a resize from map to nextMap. If that finishes
+  /// the resize, the old table is retired. Must be called while pinned.
+  void moveSomeBuckets(FixedSizeMap& map, FixedSizeMap& nextMap) {
+    if (!map.moveSomeBucketsTo(nextMap))
+      return;
+
+    // We moved the last bucket, so the resize is done.
+    mOldMap.store(nullptr, std::memory_order_seq_cst);
+    const mgb::mtbb::mutex::scoped_lock lockGuard(mResizeMutex);
+    mRetiredMaps.emplace_back(mEpoch.load(), std::unique_ptr<FixedSizeMap>(&map));
+    mRetiredMapCount.store(mRetiredMaps.size(), std::memory_order_relaxed);
+  }
+
+  /// Marks the calling thread as looking at the tables of *this until
+  /// unpin() is called with the returned epoch. A table is deleted only
+  /// once all threads that might have loaded a pointer to it have
+  /// unpinned - load the table pointers only after pinning.
+  ///
+  /// There is a count of pinned threads for even and for odd epochs. A
+  /// table that is retired in epoch e can be deleted once the epoch has
+  /// advanced past e and the count for e has dropped to zero, since later
+  /// epochs only pin threads that cannot see the table. The epoch only
+  /// advances once the count for the previous epoch is zero, so the count
+  /// that new pins go to is always of the current epoch.
+  size_t pin() const {
+    while (true) {
+      const auto epoch = mEpoch.load();
+      mPinCounts[epoch % 2].fetch_add(1);
+      if (mEpoch.load() == epoch)
+        return epoch;
+      // The epoch advanced before we were counted, so we might not have
+      // been seen by a thread that deletes tables.
+      mPinCounts[epoch % 2].fetch_sub(1);
+    }
+  }
+
+  void unpin(const size_t epoch) const {
+    mPinCounts[epoch % 2].fetch_sub(1);
+  }
+
+  /// Deletes the retired tables that no thread can still be looking at and
+  /// advances the epoch if there are still retired tables. Does nothing if
+  /// another thread holds mResizeMutex.
+  void tryDeleteRetiredMaps() {
+    mgb::mtbb::mutex::scoped_lock lockGuard;
+    if (!lockGuard.try_acquire(mResizeMutex))
+      return;
+
+    const auto epoch = mEpoch.load();
+    if (mPinCounts[(epoch + 1) % 2].load() != 0)
+      return; // some thread is still pinned in the previous epoch
+
+    const auto isOld = [epoch](const RetiredMap& retired) {
+      return retired.first < epoch;
+    };
+    mRetiredMaps.erase(
+      std::remove_if(mRetiredMaps.begin(), mRetiredMaps.end(), isOld),
+      mRetiredMaps.end()
+    );
+    mRetiredMapCount.store(mRetiredMaps.size(), std::memory_order_relaxed);
+    if (!mRetiredMaps.empty())
+      mEpoch.store(epoch + 1);
+  }
+
+  /// The table that readers look in and that buckets are moved to in a
+  /// resize.
   Atomic<FixedSizeMap*> mMap;
+
+  /// The table that buckets are being moved from. Null if there is no resize
+  /// going on.
+  Atomic<FixedSizeMap*> mOldMap;
+
   const PolyRing& mRing;
-  mutable mgb::mtbb::mutex mInsertionMutex;
 
-  /// Only access this field while holding the mInsertionMutex lock.
-  size_t mCapacityUntilGrowth;
+  /// Held while starting a resize and while accessing mRetiredMaps.
+  mgb::mtbb::mutex mResizeMutex;
+
+  /// The number of entries in the table. This can be greater than
+  /// maxEntries of the bucket count until the next resize.
+  Atomic<size_t> mEntryCount;
+
+  /// The current epoch. See pin().
+  Atomic<size_t> mEpoch;
+
+  /// The number of pinned threads for even and odd epochs. See pin().
+  mutable Atomic<size_t> mPinCounts[2];
+
+  /// A table from a finished resize along with the epoch it was retired in.
+  typedef std::pair<size_t, std::unique_ptr<FixedSizeMap>> RetiredMap;
+
+  /// Only access this field while holding the mResizeMutex lock.
+  /// Contains the old tables that readers might still be looking at.
+  std::vector<RetiredMap> mRetiredMaps;
 
-  /// Only access this field while holding the mInsertionMutex lock.
-  /// Contains the old hash tables that we discarded on resize. We have to
-  /// keep these around as we have no way to determine if there are still
-  /// readers looking at them. This could be changed at the cost of
-  /// more overhead in the Reader constructor and destructor.
-  std::vector<std::unique_ptr<FixedSizeMap>> mOldMaps;
+  /// The size of mRetiredMaps, so that insertions can check for retired
+  /// tables without taking the lock.
+  Atomic<size_t> mRetiredMapCount;
 };
 
 MATHICGB_NAMESPACE_END
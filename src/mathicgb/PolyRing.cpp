@@ -44,6 +44,7 @@ void PolyRing::setWeightsAndHash(Monomial& a1) const
 {
   setWeightsOnly(a1);
   setHashOnly(a1);
+  monoid().setDivMask(a1);
 }
 
 int PolyRing::monomialCompare(ConstMonomial sig, ConstMonomial m2, ConstMonomial sig2) const
@@ -109,6 +110,9 @@ void PolyRing::mysteriousSPairMonomialRoutine(ConstMonomial newSig,
         x = std::numeric_limits<exponent>::max();
       result[i] = std::max(baseDivLead[i], x);
     }
+    // result is used as the right hand side of divisibility checks, and
+    // those look at the divisibility mask.
+    monoid().setDivMask(result);
 }
 
 // The following two read/write monomials in the form:
@@ -58,6 +58,14 @@ T modularProduct(T a, T b, T modulus) {
   return f.product(f.toElementInRange(a), f.toElementInRange(b)).value();
 }
 
+/** As modularProduct(a, b, modulus.modulus()), but without a division. */
+template<class T>
+T modularProduct(T a, T b, const BarrettModulus<T>& modulus) {
+  MATHICGB_ASSERT(a < modulus.modulus());
+  MATHICGB_ASSERT(b < modulus.modulus());
+  return modulus.product(a, b);
+}
+
 /** Returns a+b mod modulus.  It is required that 0 <= a, b < modulus. */
 template<class T>
 T modularSum(T a, T b, T modulus) {
@@ -90,7 +98,7 @@ T modularNegativeNonZero(T a, T modulus) {
 typedef int32 exponent ;
 typedef uint32 HashValue;
 typedef long coefficient;
-typedef MonoMonoid<exponent> Monoid;
+typedef MonoMonoid<exponent, true, true, true, true> Monoid;
 
 /// This typedef should really be for an unsigned type.
 typedef PrimeField<coefficient> Field;
@@ -191,20 +199,20 @@ inline const Monomial& ConstMonomial::castAwayConst() const
 typedef Monomial monomial;
 typedef ConstMonomial const_monomial;
 #else
-typedef MonoMonoid<exponent>::MonoPtr monomial;
-typedef MonoMonoid<exponent>::MonoPtr Monomial;
-typedef MonoMonoid<exponent>::ConstMonoPtr const_monomial;
-typedef MonoMonoid<exponent>::ConstMonoPtr ConstMonomial;
+typedef Monoid::MonoPtr monomial;
+typedef Monoid::MonoPtr Monomial;
+typedef Monoid::ConstMonoPtr const_monomial;
+typedef Monoid::ConstMonoPtr ConstMonomial;
 #endif
 
 struct NewConstTerm {
   coefficient coef;
-  MonoMonoid<exponent>::ConstMonoPtr mono;
+  Monoid::ConstMonoPtr mono;
 };
 
 struct NewTerm {
   coefficient coef;
-  MonoMonoid<exponent>::MonoPtr mono;
+  Monoid::MonoPtr mono;
 
   operator NewConstTerm() const {
     NewConstTerm t = {coef, mono};
@@ -232,7 +240,7 @@ struct term {
 
 class PolyRing {
 public:
-  typedef MonoMonoid<exponent> Monoid;
+  typedef MonoMonoid<exponent, true, true, true, true> Monoid;
 
   /// This typedef should really be for an unsigned type.
   typedef PrimeField<coefficient> Field;
@@ -362,7 +370,8 @@ public:
     return monoid().exponent(m, var);
   }
 
-  // This function only sets component and the monomial itself. NOT weights, degree, or hash value
+  // This function only sets component, the monomial itself and the divisibility
+  // mask. NOT weights, degree, or hash value
   //TODO: get Bjarke to name this function!!
   void mysteriousSPairMonomialRoutine(ConstMonomial newSig,
                                       ConstMonomial newLead,
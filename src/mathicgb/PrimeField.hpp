@@ -273,6 +273,74 @@ auto PrimeField<T>::inverse(const Element elementA) const -> Element {
   return inverseElement;
 }
 
+/// Computes remainders modulo a fixed modulus by Barrett reduction. This
+/// replaces the hardware division of % by multiplications with a
+/// precomputed reciprocal of the modulus, so it pays off when many
+/// remainders are taken with the same modulus. T must be an unsigned
+/// integer type of at most 32 bits and the modulus must be at least 2.
+template<class T>
+class BarrettModulus {
+public:
+  static_assert(!std::numeric_limits<T>::is_signed, "");
+  static_assert(sizeof(T) <= 4, "");
+
+  /// Sets the modulus to zero. The object must be assigned a proper
+  /// modulus before it is used.
+  BarrettModulus(): mModulus(0), mReciprocal(0) {}
+
+  BarrettModulus(const T modulus):
+    mModulus(modulus),
+    mReciprocal(std::numeric_limits<uint64>::max() / modulus)
+  {
+    MATHICGB_ASSERT(modulus > 1);
+  }
+
+  T modulus() const {return mModulus;}
+
+  /// Returns x mod modulus(). Any 64 bit x is allowed.
+  T reduce(const uint64 x) const {
+    MATHICGB_ASSERT(mModulus > 1);
+    // mReciprocal is at least 2^64 / modulus() - 1, so quotient is at most
+    // one less than the true quotient and the remainder is less than
+    // 2 * modulus().
+    const auto quotient = multiplyHigh(x, mReciprocal);
+    auto remainder = x - quotient * mModulus;
+    if (remainder >= mModulus)
+      remainder -= mModulus;
+    MATHICGB_ASSERT(remainder == x % mModulus);
+    return static_cast<T>(remainder);
+  }
+
+  /// Returns a * b mod modulus().
+  T product(const T a, const T b) const {
+    return reduce(static_cast<uint64>(a) * b);
+  }
+
+private:
+  /// Returns the upper 64 bits of the 128 bit product a * b.
+  static uint64 multiplyHigh(const uint64 a, const uint64 b) {
+#ifdef __SIZEOF_INT128__
+    typedef unsigned __int128 uint128;
+    return static_cast<uint64>((static_cast<uint128>(a) * b) >> 64);
+#else
+    const uint64 lowMask = 0xFFFFFFFFu;
+    const auto aLow = a & lowMask;
+    const auto aHigh = a >> 32;
+    const auto bLow = b & lowMask;
+    const auto bHigh = b >> 32;
+    const auto lowLow = aLow * bLow;
+    const auto lowHigh = aLow * bHigh;
+    const auto highLow = aHigh * bLow;
+    const auto middle =
+      (lowLow >> 32) + (lowHigh & lowMask) + (highLow & lowMask);
+    return aHigh * bHigh + (lowHigh >> 32) + (highLow >> 32) + (middle >> 32);
+#endif
+  }
+
+  T mModulus;
+  uint64 mReciprocal;
+};
+
 /// Returns true if a and b are the same object.
 template<class E>
 bool operator==(const PrimeField<E>& a, const PrimeField<E>& b) {
@@ -11,7 +11,8 @@
 
 MATHICGB_NAMESPACE_BEGIN
 
-bool QuadMatrix::debugAssertValid() const {
+template<class S>
+bool BasicQuadMatrix<S>::debugAssertValid() const {
 #ifndef MATHICGB_DEBUG
   return true;
 #else
@@ -30,14 +31,18 @@ bool QuadMatrix::debugAssertValid() const {
 
   MATHICGB_ASSERT(topLeft.rowCount() == topRight.rowCount());
   MATHICGB_ASSERT(bottomRight.rowCount() == bottomLeft.rowCount());
+  MATHICGB_ASSERT(topRowSources.empty() ||
+    topRowSources.size() == topLeft.rowCount());
+  MATHICGB_ASSERT(bottomRowSources.empty() ||
+    bottomRowSources.size() == bottomLeft.rowCount());
   return true;
 #endif
 }
 
-void QuadMatrix::print(std::ostream& out) const {
+template<class S>
+void BasicQuadMatrix<S>::print(std::ostream& out) const {
   MATHICGB_ASSERT(debugAssertValid());
 
-  typedef SparseMatrix::ColIndex ColIndex;
   mathic::ColumnPrinter printer;
   printer.addColumn(true, "", "");
   printer.addColumn(true, " | ", "");
@@ -69,55 +74,63 @@ void QuadMatrix::print(std::ostream& out) const {
   out << printer;
 }
 
-size_t QuadMatrix::rowCount() const {
+template<class S>
+size_t BasicQuadMatrix<S>::rowCount() const {
   return topLeft.rowCount() + bottomLeft.rowCount();
 }
 
-SparseMatrix::ColIndex QuadMatrix::computeLeftColCount() const {
+template<class S>
+auto BasicQuadMatrix<S>::computeLeftColCount() const -> ColIndex {
   if (!leftColumnMonomials.empty()) {
     MATHICGB_ASSERT(
       leftColumnMonomials.size() <=
-      std::numeric_limits<SparseMatrix::ColIndex>::max()
+      std::numeric_limits<ColIndex>::max()
     );
-    return static_cast<SparseMatrix::ColIndex>(leftColumnMonomials.size());
+    return static_cast<ColIndex>(leftColumnMonomials.size());
   }
   return std::max(topLeft.computeColCount(), bottomLeft.computeColCount());
 }
 
-SparseMatrix::ColIndex QuadMatrix::computeRightColCount() const {
+template<class S>
+auto BasicQuadMatrix<S>::computeRightColCount() const -> ColIndex {
   if (!rightColumnMonomials.empty()) {
     MATHICGB_ASSERT(
       rightColumnMonomials.size() <=
-      std::numeric_limits<SparseMatrix::ColIndex>::max()
+      std::numeric_limits<ColIndex>::max()
     );
-    return static_cast<SparseMatrix::ColIndex>(rightColumnMonomials.size());
+    return static_cast<ColIndex>(rightColumnMonomials.size());
   }
   return std::max(topRight.computeColCount(), bottomRight.computeColCount());
 }
 
-size_t QuadMatrix::entryCount() const {
+template<class S>
+size_t BasicQuadMatrix<S>::entryCount() const {
   return
     topLeft.entryCount() + topRight.entryCount() +
     bottomLeft.entryCount() + bottomRight.entryCount();
 }
 
-std::string QuadMatrix::toString() const {
+template<class S>
+std::string BasicQuadMatrix<S>::toString() const {
   std::ostringstream out;
   print(out);
   return out.str();
 }
 
-size_t QuadMatrix::memoryUse() const {
+template<class S>
+size_t BasicQuadMatrix<S>::memoryUse() const {
   return topLeft.memoryUse() + topRight.memoryUse() +
 	bottomLeft.memoryUse() + bottomRight.memoryUse();
 }
 
-size_t QuadMatrix::memoryUseTrimmed() const {
+template<class S>
+size_t BasicQuadMatrix<S>::memoryUseTrimmed() const {
   return topLeft.memoryUseTrimmed() + topRight.memoryUseTrimmed() +
 	bottomLeft.memoryUseTrimmed() + bottomRight.memoryUseTrimmed();
 }
 
-void QuadMatrix::printStatistics(std::ostream& out) const {
+template<class S>
+void BasicQuadMatrix<S>::printStatistics(std::ostream& out) const {
   typedef mathic::ColumnPrinter ColPr;
 
   ColPr pr;
@@ -131,11 +144,11 @@ void QuadMatrix::printStatistics(std::ostream& out) const {
 
   auto printDataCol = [&](
     std::ostream& out,
-    const SparseMatrix& top,
-    const SparseMatrix& bottom,
-    const SparseMatrix::ColIndex colCount
+    const Matrix& top,
+    const Matrix& bottom,
+    const ColIndex colCount
   ) {
-    auto printDataCell = [&](const SparseMatrix& matrix) {
+    auto printDataCell = [&](const Matrix& matrix) {
       const auto entryCount = matrix.entryCount();
       const uint64 area =
         static_cast<uint64>(matrix.rowCount()) * static_cast<uint64>(colCount);
@@ -176,11 +189,12 @@ void QuadMatrix::printStatistics(std::ostream& out) const {
 	<< " used)\n\n";
 }
 
-QuadMatrix QuadMatrix::toCanonical() const {
+template<class S>
+auto BasicQuadMatrix<S>::toCanonical() const -> BasicQuadMatrix {
   class RowComparer {
   public:
-    RowComparer(const SparseMatrix& matrix): mMatrix(matrix) {}
-    bool operator()(SparseMatrix::RowIndex a, SparseMatrix::RowIndex b) const {
+    RowComparer(const Matrix& matrix): mMatrix(matrix) {}
+    bool operator()(RowIndex a, RowIndex b) const {
       auto itA = mMatrix.rowBegin(a);
       const auto endA = mMatrix.rowEnd(a);
       auto itB = mMatrix.rowBegin(b);
@@ -203,17 +217,17 @@ QuadMatrix QuadMatrix::toCanonical() const {
     }
 
   private:
-    const SparseMatrix& mMatrix;
+    const Matrix& mMatrix;
   };
 
   const auto leftColCount = leftColumnMonomials.size();
   const auto rightColCount = rightColumnMonomials.size();
 
   // todo: eliminate left/right code duplication here
-  QuadMatrix matrix(ring());
+  BasicQuadMatrix matrix(ring());
   { // left side
-    std::vector<SparseMatrix::RowIndex> rows;
-    for (SparseMatrix::RowIndex row = 0; row < topLeft.rowCount(); ++row)
+    std::vector<RowIndex> rows;
+    for (RowIndex row = 0; row < topLeft.rowCount(); ++row)
       rows.push_back(row);
     {
       RowComparer comparer(topLeft);
@@ -222,14 +236,14 @@ QuadMatrix QuadMatrix::toCanonical() const {
 
     matrix.topLeft.clear();
     matrix.topRight.clear();
-    for (SparseMatrix::RowIndex i = 0; i < rows.size(); ++i) {
+    for (RowIndex i = 0; i < rows.size(); ++i) {
       matrix.topLeft.appendRow(topLeft, rows[i]);
       matrix.topRight.appendRow(topRight, rows[i]);
     }
   }
   { // right side
-    std::vector<SparseMatrix::RowIndex> rows;
-    for (SparseMatrix::RowIndex row = 0; row < bottomLeft.rowCount(); ++row)
+    std::vector<RowIndex> rows;
+    for (RowIndex row = 0; row < bottomLeft.rowCount(); ++row)
       rows.push_back(row);
     {
       RowComparer comparer(bottomLeft);
@@ -238,7 +252,7 @@ QuadMatrix QuadMatrix::toCanonical() const {
 
     matrix.bottomLeft.clear();
     matrix.bottomRight.clear();
-    for (SparseMatrix::RowIndex i = 0; i < rows.size(); ++i) {
+    for (RowIndex i = 0; i < rows.size(); ++i) {
       matrix.bottomLeft.appendRow(bottomLeft, rows[i]);
       matrix.bottomRight.appendRow(bottomRight, rows[i]);
     }
@@ -250,11 +264,6 @@ QuadMatrix QuadMatrix::toCanonical() const {
   return std::move(matrix);
 }
 
-std::ostream& operator<<(std::ostream& out, const QuadMatrix& qm) {
-  qm.print(out);
-  return out;
-}
-
 namespace {
   template<class Monoid>
   class ColumnComparer {
@@ -314,8 +323,8 @@ namespace {
   }
 }
 
-void QuadMatrix::sortColumnsLeftRightParallel() {
-  typedef SparseMatrix::ColIndex ColIndex;
+template<class S>
+void BasicQuadMatrix<S>::sortColumnsLeftRightParallel() {
   std::vector<ColIndex> leftPermutation;
   std::vector<ColIndex> rightPermutation;
   
@@ -342,8 +351,9 @@ void QuadMatrix::sortColumnsLeftRightParallel() {
   });
 }
 
-void QuadMatrix::write(
-  const SparseMatrix::Scalar modulus,
+template<class S>
+void BasicQuadMatrix<S>::write(
+  const Scalar modulus,
   FILE* file
 ) const {
   MATHICGB_ASSERT(file != 0);
@@ -353,7 +363,8 @@ void QuadMatrix::write(
   bottomRight.write(modulus, file);
 }
 
-SparseMatrix::Scalar QuadMatrix::read(FILE* file) {
+template<class S>
+auto BasicQuadMatrix<S>::read(FILE* file) -> Scalar {
   MATHICGB_ASSERT(file != 0);
 
   leftColumnMonomials.clear();
@@ -374,4 +385,8 @@ SparseMatrix::Scalar QuadMatrix::read(FILE* file) {
   return topLeftModulus;
 }
 
+template class BasicQuadMatrix<uint8>;
+template class BasicQuadMatrix<uint16>;
+template class BasicQuadMatrix<uint32>;
+
 MATHICGB_NAMESPACE_END
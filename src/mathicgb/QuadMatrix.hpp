@@ -11,12 +11,21 @@
 
 MATHICGB_NAMESPACE_BEGIN
 
+class Poly;
+
 /// Represents a matrix composed of 4 sub-matrices that fit together
 /// into one matrix divided into top left, top right, bottom left and
 /// bottom right. This is a convenient representation of the matrices
-/// encountered in the F4 polynomial reduction algorithm.
-class QuadMatrix {
+/// encountered in the F4 polynomial reduction algorithm. The scalars
+/// have type S, as for BasicSparseMatrix.
+template<class S>
+class BasicQuadMatrix {
 public:
+  typedef BasicSparseMatrix<S> Matrix;
+  typedef typename Matrix::Scalar Scalar;
+  typedef typename Matrix::RowIndex RowIndex;
+  typedef typename Matrix::ColIndex ColIndex;
+
   typedef PolyRing::Monoid Monoid;
   typedef Monoid::Mono Mono;
   typedef Monoid::MonoRef MonoRef;
@@ -24,39 +33,49 @@ public:
   typedef Monoid::MonoPtr MonoPtr;
   typedef Monoid::ConstMonoPtr ConstMonoPtr;
 
-  QuadMatrix(): mRing(nullptr) {}
-  QuadMatrix(const PolyRing& ring): mRing(&ring) {}
+  BasicQuadMatrix(): mRing(nullptr) {}
+  BasicQuadMatrix(const PolyRing& ring): mRing(&ring) {}
 
-  QuadMatrix(QuadMatrix&& matrix):
+  BasicQuadMatrix(BasicQuadMatrix&& matrix):
     topLeft(std::move(matrix.topLeft)),
     topRight(std::move(matrix.topRight)),
     bottomLeft(std::move(matrix.bottomLeft)),
     bottomRight(std::move(matrix.bottomRight)),
     leftColumnMonomials(std::move(matrix.leftColumnMonomials)),
     rightColumnMonomials(std::move(matrix.rightColumnMonomials)),
+    topRowSources(std::move(matrix.topRowSources)),
+    bottomRowSources(std::move(matrix.bottomRowSources)),
     mRing(&matrix.ring())
   {}
 
-  QuadMatrix& operator=(QuadMatrix&& matrix) {
+  BasicQuadMatrix& operator=(BasicQuadMatrix&& matrix) {
     MATHICGB_ASSERT(mRing == matrix.mRing);
-    this->~QuadMatrix();
-    new (this) QuadMatrix(std::move(matrix));
+    this->~BasicQuadMatrix();
+    new (this) BasicQuadMatrix(std::move(matrix));
     return *this;
   }
 
   void clear() {
-    *this = QuadMatrix(ring());
+    *this = BasicQuadMatrix(ring());
   }
 
   typedef std::vector<ConstMonoPtr> Monomials;
 
-  SparseMatrix topLeft; 
-  SparseMatrix topRight;
-  SparseMatrix bottomLeft;
-  SparseMatrix bottomRight;
+  Matrix topLeft; 
+  Matrix topRight;
+  Matrix bottomLeft;
+  Matrix bottomRight;
   Monomials leftColumnMonomials;
   Monomials rightColumnMonomials;
 
+  /// If not empty, then row i of the top and bottom matrices is a multiple
+  /// of topRowSources[i] and bottomRowSources[i] respectively, where null
+  /// means that the row is not a multiple of a single polynomial. Only
+  /// F4MatrixBuilder2 sets these and operations that permute the rows, such
+  /// as toCanonical and read, leave them empty.
+  std::vector<const Poly*> topRowSources;
+  std::vector<const Poly*> bottomRowSources;
+
   /// Prints whole matrix to out in human-readable format. Useful for
   /// debugging.
   void print(std::ostream& out) const;
@@ -76,16 +95,16 @@ public:
   size_t rowCount() const;
 
   /// Return the number of left columns.
-  SparseMatrix::ColIndex computeLeftColCount() const;
+  ColIndex computeLeftColCount() const;
 
   /// Return the number of right columns.
-  SparseMatrix::ColIndex computeRightColCount() const;
+  ColIndex computeRightColCount() const;
 
-  void write(SparseMatrix::Scalar modulus, FILE* file) const;
+  void write(Scalar modulus, FILE* file) const;
 
   /// Read a matrix from file into *this. Return the modulus from file.
   /// This method clears the column monomials and the ring pointer.
-  SparseMatrix::Scalar read(FILE* file);
+  Scalar read(FILE* file);
 
   /// Sort the left columns to be in decreasing order according to the monomial
   /// order from the ring. The operation is done in parallel.
@@ -93,7 +112,7 @@ public:
 
   /// Makes a copy of this matrix whose rows are sorted in some canonical way.
   /// TODO: Actually only coarsely sorts the top rows right now.
-  QuadMatrix toCanonical() const;
+  BasicQuadMatrix toCanonical() const;
 
   /// Asserts internal invariants if asserts are turned on.
   bool debugAssertValid() const;
@@ -102,13 +121,23 @@ public:
   const Monoid& monoid() const {return ring().monoid();}
 
 private:
-  QuadMatrix(const QuadMatrix&); // not available
-  void operator=(const QuadMatrix&); // not available
+  BasicQuadMatrix(const BasicQuadMatrix&); // not available
+  void operator=(const BasicQuadMatrix&); // not available
 
   const PolyRing* const mRing;
 };
 
-std::ostream& operator<<(std::ostream& out, const QuadMatrix& qm);
+template<class S>
+std::ostream& operator<<(std::ostream& out, const BasicQuadMatrix<S>& qm) {
+  qm.print(out);
+  return out;
+}
+
+extern template class BasicQuadMatrix<uint8>;
+extern template class BasicQuadMatrix<uint16>;
+extern template class BasicQuadMatrix<uint32>;
+
+typedef BasicQuadMatrix<uint16> QuadMatrix;
 
 MATHICGB_NAMESPACE_END
 
@@ -15,7 +15,9 @@
 
 MATHICGB_NAMESPACE_BEGIN
 
-class QuadMatrix;
+template<class S>
+class BasicQuadMatrix;
+typedef BasicQuadMatrix<uint16> QuadMatrix;
 
 /// Builder for QuadMatrix. This is not quite the builder pattern in
 /// that the interface is not virtual and the implementation cannot be
@@ -0,0 +1,200 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#include "stdinc.h"
+#include "RatioRanks.hpp"
+
+#include <limits>
+
+MATHICGB_NAMESPACE_BEGIN
+
+const size_t RatioRanks::NoIndex;
+const size_t RatioRanks::BlockSize;
+const unsigned int RatioRanks::LowBits;
+const unsigned int RatioRanks::BlockBits;
+
+RatioRanks::RatioRanks(
+  const std::vector<MonoPtr>& ratios,
+  const Monoid& monoid
+):
+  mRatios(ratios),
+  mMonoid(monoid),
+  mBlocks(1)
+{
+  mBlocks.front().label = static_cast<Rank>(1) << (BlockBits - 1);
+}
+
+void RatioRanks::insert() {
+  const auto index = size();
+  MATHICGB_ASSERT(index < mRatios.size());
+  mRanks.push_back(0);
+  mNextEqual.push_back(NoIndex);
+
+  size_t block;
+  size_t pos;
+  bool equal;
+  find(*mRatios[index], block, pos, equal);
+  auto& ratios = mBlocks[block].ratios;
+  if (equal) {
+    const auto first = ratios[pos];
+    mNextEqual[index] = mNextEqual[first];
+    mNextEqual[first] = index;
+    mRanks[index] = mRanks[first];
+    return;
+  }
+
+  const Rank prev = pos == 0 ? 0 : lowLabel(ratios[pos - 1]);
+  const Rank next = pos == ratios.size() ?
+    static_cast<Rank>(1) << LowBits : lowLabel(ratios[pos]);
+  MATHICGB_ASSERT(prev < next);
+  ratios.insert(ratios.begin() + pos, index);
+
+  // Leave a gap of at least one on both sides.
+  if (next - prev >= 4) {
+    const auto low = prev + (next - prev) / 2;
+    setRank(index, (mBlocks[block].label << LowBits) | low);
+  } else
+    relabelBlock(block);
+
+  if (ratios.size() > BlockSize)
+    splitBlock(block);
+}
+
+auto RatioRanks::rank(ConstMonoRef ratio) const -> Rank {
+  if (size() == 0)
+    return 0; // any value will do as there is nothing to compare to
+
+  size_t block;
+  size_t pos;
+  bool equal;
+  find(ratio, block, pos, equal);
+  const auto& ratios = mBlocks[block].ratios;
+  if (equal)
+    return mRanks[ratios[pos]];
+
+  // There is a gap of at least one below each rank, so the rank one less
+  // than that of the next ratio is greater than that of the previous one.
+  if (pos < ratios.size())
+    return mRanks[ratios[pos]] - 1;
+  if (block + 1 < mBlocks.size())
+    return mRanks[mBlocks[block + 1].ratios.front()] - 1;
+  return std::numeric_limits<Rank>::max();
+}
+
+size_t RatioRanks::getMemoryUse() const {
+  size_t total = 0;
+  total += mRanks.capacity() * sizeof(mRanks.front());
+  total += mNextEqual.capacity() * sizeof(mNextEqual.front());
+  total += mBlocks.capacity() * sizeof(mBlocks.front());
+  for (const auto& block : mBlocks)
+    total += block.ratios.capacity() * sizeof(block.ratios.front());
+  return total;
+}
+
+void RatioRanks::find(
+  ConstMonoRef ratio,
+  size_t& block,
+  size_t& pos,
+  bool& equal
+) const {
+  // Find the last block whose first ratio is not greater than ratio. Only
+  // the first block can be empty, so it is not looked at.
+  size_t lower = 1;
+  size_t upper = mBlocks.size();
+  while (lower < upper) {
+    const auto middle = lower + (upper - lower) / 2;
+    const auto first = mBlocks[middle].ratios.front();
+    if (mMonoid.lessThan(ratio, *mRatios[first]))
+      upper = middle;
+    else
+      lower = middle + 1;
+  }
+  block = lower - 1;
+
+  // Find the first ratio in the block that is not less than ratio.
+  const auto& ratios = mBlocks[block].ratios;
+  lower = 0;
+  upper = ratios.size();
+  while (lower < upper) {
+    const auto middle = lower + (upper - lower) / 2;
+    if (mMonoid.lessThan(*mRatios[ratios[middle]], ratio))
+      lower = middle + 1;
+    else
+      upper = middle;
+  }
+  pos = lower;
+  equal = pos < ratios.size() && mMonoid.equal(*mRatios[ratios[pos]], ratio);
+}
+
+void RatioRanks::setRank(const size_t first, const Rank rank) {
+  for (auto index = first; index != NoIndex; index = mNextEqual[index])
+    mRanks[index] = rank;
+}
+
+void RatioRanks::relabelBlock(const size_t block) {
+  const auto& b = mBlocks[block];
+  const auto count = b.ratios.size();
+  const auto spacing = (static_cast<Rank>(1) << LowBits) / (count + 1);
+  MATHICGB_ASSERT(spacing >= 2);
+  for (size_t i = 0; i < count; ++i)
+    setRank(b.ratios[i], (b.label << LowBits) | (spacing * (i + 1)));
+}
+
+void RatioRanks::splitBlock(const size_t block) {
+  // The labels within the two halves are still in order with gaps, so
+  // only the upper half needs new ranks for its new block label.
+  Block upper;
+  auto& ratios = mBlocks[block].ratios;
+  const auto half = ratios.size() / 2;
+  upper.ratios.assign(ratios.begin() + half, ratios.end());
+  ratios.resize(half);
+  mBlocks.insert(mBlocks.begin() + block + 1, std::move(upper));
+
+  const auto label = mBlocks[block].label;
+  const auto next = block + 2 < mBlocks.size() ?
+    mBlocks[block + 2].label : (static_cast<Rank>(1) << BlockBits) - 1;
+  if (next - label < 2) {
+    relabelBlocksAround(block);
+    return;
+  }
+
+  auto& newBlock = mBlocks[block + 1];
+  newBlock.label = label + (next - label) / 2;
+  for (const auto first : newBlock.ratios)
+    setRank(first, (newBlock.label << LowBits) | lowLabel(first));
+}
+
+void RatioRanks::relabelBlocksAround(const size_t block) {
+  // The new block at block + 1 does not have a label yet. Look for the
+  // smallest aligned range of labels around the label of block that has
+  // few enough blocks in it, allowing fewer blocks per label the larger
+  // the range is. The range of all labels is used if there is no such
+  // range.
+  const auto label = mBlocks[block].label;
+  size_t begin = block;
+  size_t end = block + 2;
+  Rank rangeBegin = 0;
+  Rank rangeSize = 0;
+  double maxCount = 1;
+  for (unsigned int bits = 1; bits <= BlockBits; ++bits) {
+    rangeSize = static_cast<Rank>(1) << bits;
+    rangeBegin = label & ~(rangeSize - 1);
+    while (begin > 0 && mBlocks[begin - 1].label >= rangeBegin)
+      --begin;
+    while (end < mBlocks.size() && mBlocks[end].label - rangeBegin < rangeSize)
+      ++end;
+    maxCount *= 4.0 / 3.0;
+    if (end - begin <= maxCount)
+      break;
+  }
+
+  const auto spacing = rangeSize / (end - begin + 1);
+  MATHICGB_ASSERT(spacing >= 2);
+  for (auto i = begin; i < end; ++i) {
+    auto& b = mBlocks[i];
+    b.label = rangeBegin + spacing * (i - begin + 1);
+    for (const auto first : b.ratios)
+      setRank(first, (b.label << LowBits) | lowLabel(first));
+  }
+}
+
+MATHICGB_NAMESPACE_END
@@ -0,0 +1,129 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#ifndef MATHICGB_RATIO_RANKS_GUARD
+#define MATHICGB_RATIO_RANKS_GUARD
+
+#include "PolyRing.hpp"
+#include <vector>
+
+MATHICGB_NAMESPACE_BEGIN
+
+/// Gives each sig/lead ratio of a SigPolyBasis an integer rank so that
+/// ratios can be compared by comparing their ranks. Equal ratios have the
+/// same rank. There is a gap of at least one between the ranks of
+/// different ratios, so that a ratio that is not in the basis can also be
+/// given a rank that compares correctly to the ranks in the basis.
+///
+/// This is an order-maintenance structure with two levels. The distinct
+/// ratios are kept in order in blocks of at most BlockSize ratios. A rank
+/// is the label of its block in the high bits followed by a label within
+/// the block in the low bits. A new ratio gets a label between those of
+/// its neighbours, so usually no other rank changes. When there is no
+/// room, only the labels of that block are spread out again. A block that
+/// gets too big is split, and the new block gets a label between the
+/// labels of its neighbours. If there is no room for that either, the
+/// labels of the smallest range of blocks around it that is sparse enough
+/// are spread out again. The number of ranks that change per insert is
+/// constant on average.
+///
+/// The ranks of the ratios can change at each insert. Looking up a rank
+/// does not change anything, so that can be done on several threads at the
+/// same time.
+class RatioRanks {
+public:
+  typedef PolyRing::Monoid Monoid;
+  typedef Monoid::ConstMonoRef ConstMonoRef;
+  typedef Monoid::MonoPtr MonoPtr;
+  typedef uint64 Rank;
+
+  /// ratios is the vector of sig/lead ratios of the basis. A reference to
+  /// it is kept.
+  RatioRanks(const std::vector<MonoPtr>& ratios, const Monoid& monoid);
+
+  /// Gives a rank to ratios[size()]. The ratios before it must already
+  /// have ranks.
+  void insert();
+
+  /// Returns the rank of ratios[index].
+  Rank rank(size_t index) const {
+    MATHICGB_ASSERT(index < size());
+    return mRanks[index];
+  }
+
+  /// Returns a rank for ratio, which need not be a ratio of the basis. The
+  /// rank is only useful for comparing to the ranks of the basis.
+  Rank rank(ConstMonoRef ratio) const;
+
+  size_t size() const {return mRanks.size();}
+
+  size_t getMemoryUse() const;
+
+private:
+  static const size_t NoIndex = static_cast<size_t>(-1);
+
+  /// The most distinct ratios that a block can have.
+  static const size_t BlockSize = 64;
+
+  /// The number of bits of a rank that hold the label within a block.
+  /// Those labels are in [1, 2^LowBits), so the ranks of the last ratio
+  /// of a block and the first ratio of the next block differ by at
+  /// least 2.
+  static const unsigned int LowBits = 24;
+
+  /// The number of bits of a block label. The block labels are in
+  /// [1, 2^BlockBits - 1), so the largest rank is less than the rank for
+  /// ratios after all the ratios of the basis.
+  static const unsigned int BlockBits = 40;
+
+  struct Block {
+    Rank label;
+
+    /// For each distinct ratio in the block in increasing order, the index
+    /// of the first basis element with that ratio.
+    std::vector<size_t> ratios;
+  };
+
+  /// Returns the position that ratio has or would have if inserted, in
+  /// the form of a block and a position in that block. Sets equal to
+  /// whether the ratio at that position is equal to ratio.
+  void find(
+    ConstMonoRef ratio,
+    size_t& block,
+    size_t& pos,
+    bool& equal
+  ) const;
+
+  /// Returns the label within its block of the distinct ratio whose first
+  /// basis element is index.
+  Rank lowLabel(size_t index) const {
+    return mRanks[index] & ((static_cast<Rank>(1) << LowBits) - 1);
+  }
+
+  /// Sets the rank of all the basis elements with the same ratio as the
+  /// basis element first, which must be the first basis element with
+  /// that ratio.
+  void setRank(size_t first, Rank rank);
+
+  /// Spreads the labels within block evenly.
+  void relabelBlock(size_t block);
+
+  /// Splits block into two blocks of half the size.
+  void splitBlock(size_t block);
+
+  /// Spreads out the block labels around block so that there is room
+  /// for a label between block and the block after it.
+  void relabelBlocksAround(size_t block);
+
+  const std::vector<MonoPtr>& mRatios;
+  const Monoid& mMonoid;
+
+  std::vector<Rank> mRanks;
+
+  /// The index of the next basis element with the same ratio, or NoIndex.
+  std::vector<size_t> mNextEqual;
+
+  std::vector<Block> mBlocks;
+};
+
+MATHICGB_NAMESPACE_END
+#endif
@@ -9,6 +9,7 @@
 #include "ReducerDedup.hpp"
 #include "ReducerHash.hpp"
 #include "ReducerHashPack.hpp"
+#include "ReducerAdaptive.hpp"
 #include "F4Reducer.hpp"
 #include "SigPolyBasis.hpp"
 #include <iostream>
@@ -30,6 +31,7 @@ void dummyLinkerFix() {
   reducerDedupDependency();
   reducerHashDependency();
   reducerHashPackDependency();
+  reducerAdaptiveDependency();
   f4ReducerDependency();
 }
 
@@ -38,6 +40,45 @@ Reducer::~Reducer() {
   dummyLinkerFix();
 }
 
+void Reducer::classicReduceSPolySetAndFindUseful(
+  std::vector<std::pair<size_t, size_t> >& spairs,
+  const PolyBasis& basis,
+  std::vector<std::unique_ptr<Poly> >& reducedOut
+) {
+  classicReduceSPolySet(spairs, basis, reducedOut);
+}
+
+void Reducer::classicReduceSPolySetPipelined(
+  std::vector<std::pair<size_t, size_t> >& spairs,
+  const std::vector<std::pair<size_t, size_t> >& nextSPairs,
+  const PolyBasis& basis,
+  std::vector<std::unique_ptr<Poly> >& reducedOut
+) {
+  classicReduceSPolySet(spairs, basis, reducedOut);
+}
+
+void Reducer::regularReduceSet(
+  const std::vector<ConstMonoPtr>& sigs,
+  const std::vector<ConstMonoPtr>& multiples,
+  const std::vector<size_t>& basisElements,
+  const SigPolyBasis& basis,
+  std::vector<std::unique_ptr<Poly> >& reducedOut
+) {
+  MATHICGB_ASSERT(sigs.size() == multiples.size());
+  MATHICGB_ASSERT(sigs.size() == basisElements.size());
+  reducedOut.clear();
+  for (size_t i = 0; i < sigs.size(); ++i) {
+    reducedOut.push_back
+      (regularReduce(*sigs[i], *multiples[i], basisElements[i], basis));
+  }
+}
+
+void Reducer::setMatrixMemoryBudget(size_t bytes) {}
+
+void Reducer::setAdaptiveSetSize(bool value) {}
+
+void Reducer::setSparseAccumulatorDensity(double density) {}
+
 /// Vector that stores the registered reducer typers. This has to be a
 /// function rather than just a naked object to ensure that the object
 /// gets initialized before it is used.
@@ -109,6 +150,8 @@ Reducer::ReducerType Reducer::reducerType(int type)
 
   case 25: return Reducer_F4_Old;
   case 26: return Reducer_F4_New;
+  case 27: return Reducer_F4_FaugereLachartre;
+  case 28: return Reducer_Adaptive;
 
   default: return Reducer_Geobucket_Hashed;
   }
@@ -65,6 +65,31 @@ public:
     std::vector<std::unique_ptr<Poly> >& reducedOut
   ) = 0;
 
+  /// As classicReduceSPolySet, but afterwards spairs is replaced by a
+  /// subset of spairs such that reducing just that subset gives the same
+  /// polynomials in reducedOut. Reducers that cannot tell which S-pairs
+  /// were needed leave spairs as it is, which is what the default
+  /// implementation does.
+  virtual void classicReduceSPolySetAndFindUseful(
+    std::vector<std::pair<size_t, size_t> >& spairs,
+    const PolyBasis& basis,
+    std::vector<std::unique_ptr<Poly> >& reducedOut
+  );
+
+  /// As classicReduceSPolySet, but nextSPairs is a hint that the next call
+  /// to this method will be for nextSPairs, so work on those can start
+  /// early and run at the same time as the work on spairs. The reduction
+  /// of nextSPairs may then be by basis as it is now, without the
+  /// polynomials that are inserted into basis between the two calls, so
+  /// those reductions need not be top reduced. The default implementation
+  /// ignores nextSPairs.
+  virtual void classicReduceSPolySetPipelined(
+    std::vector<std::pair<size_t, size_t> >& spairs,
+    const std::vector<std::pair<size_t, size_t> >& nextSPairs,
+    const PolyBasis& basis,
+    std::vector<std::unique_ptr<Poly> >& reducedOut
+  );
+
   /// Clasically reduces the passed-in polynomials of these pairs. May
   /// or may not also interreduce these to some extent. Polynomials
   /// that are reduced to zero are not put into reducedOut.
@@ -85,10 +110,45 @@ public:
     const SigPolyBasis& basis
   ) = 0;
 
+  /// Regular reduces multiples[i]*basisElements[i] in signature sigs[i] for
+  /// each i and places the result at reducedOut[i] with the same meaning
+  /// as the return value of regularReduce. The signatures must be
+  /// increasing. The reduction for sigs[i] may also use the results for
+  /// the signatures before it that are neither null nor zero, as though
+  /// they had been inserted into basis. The reducer need not use all the
+  /// ways that it could use those results, so a result need not be regular
+  /// top reduced with respect to basis after the results before it have
+  /// been inserted. The caller has to check that. The default
+  /// implementation calls regularReduce for each signature and so does
+  /// not use the results of the other signatures at all.
+  virtual void regularReduceSet(
+    const std::vector<ConstMonoPtr>& sigs,
+    const std::vector<ConstMonoPtr>& multiples,
+    const std::vector<size_t>& basisElements,
+    const SigPolyBasis& basis,
+    std::vector<std::unique_ptr<Poly> >& reducedOut
+  );
+
   /// Sets how many bytes of memory to increase the memory use by
   /// at a time - if such a thing is appropriate for the reducer.
   virtual void setMemoryQuantum(size_t quantum) = 0;
 
+  /// Asks a matrix-based reducer to choose preferredSetSize() so that its
+  /// matrices use at most about this many bytes. A value of 0 means that
+  /// there is no limit. The default implementation does nothing.
+  virtual void setMatrixMemoryBudget(size_t bytes);
+
+  /// Tells a matrix-based reducer whether to choose preferredSetSize()
+  /// from the time spent on its matrices so far. Otherwise the set size is
+  /// fixed at 100000, subject to the memory budget. The default is true.
+  /// The default implementation does nothing.
+  virtual void setAdaptiveSetSize(bool value);
+
+  /// Tells a matrix-based reducer to use a sparse accumulator for rows of
+  /// matrices whose density is below the given fraction of non-zero
+  /// entries. The default implementation does nothing.
+  virtual void setSparseAccumulatorDensity(double density);
+
 
   // ***** Kinds of reducers and creating a Reducer 
 
@@ -115,7 +175,14 @@ public:
     Reducer_Geobucket_Hashed_Packed,
 
     Reducer_F4_Old,
-    Reducer_F4_New
+    Reducer_F4_New,
+    Reducer_F4_FaugereLachartre,
+
+    /// Times the classic reducers on the reductions of the computation and
+    /// uses the fastest one. The F4 reducers are not among the candidates.
+    /// This is only used when asked for, so the library interface does not
+    /// select it for ClassicReducer.
+    Reducer_Adaptive
   };
 
   static std::unique_ptr<Reducer> makeReducer
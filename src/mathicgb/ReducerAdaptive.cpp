@@ -0,0 +1,386 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#include "stdinc.h"
+#include "ReducerAdaptive.hpp"
+
+#include "Reducer.hpp"
+#include "PolyBasis.hpp"
+#include "SigPolyBasis.hpp"
+#include "LogDomain.hpp"
+#include "mtbb.hpp"
+#include <algorithm>
+
+MATHICGB_DEFINE_LOG_DOMAIN(
+  ReducerAdaptive,
+  "Displays which reducer the adaptive reducer chooses and the timings "
+  "that the choice is based on."
+);
+
+MATHICGB_NAMESPACE_BEGIN
+
+void reducerAdaptiveDependency() {}
+
+/// Delegates to one of a few classic reducers, using the one that has been
+/// fastest on the reductions of this computation. At first, and again each
+/// time that the degree or the size of the basis has grown enough since
+/// the last choice, the candidates take turns doing the reductions until
+/// each of them has done SampleSize reductions. The candidate that took the
+/// least time per reduction is then used until the next round of sampling.
+///
+/// The F4 reducers are not candidates. They want large groups of S-pairs
+/// while the classic reducers want them one at a time, so switching between
+/// them would change the size of the S-pair groups and with it the timings
+/// that the choice is based on.
+class ReducerAdaptive : public Reducer {
+public:
+  ReducerAdaptive(const PolyRing& ring);
+
+  virtual unsigned int preferredSetSize() const;
+
+  virtual std::string description() const;
+  virtual size_t getMemoryUse() const;
+
+  virtual std::unique_ptr<Poly> classicReduce
+    (const Poly& poly, const PolyBasis& basis);
+
+  virtual std::unique_ptr<Poly> classicTailReduce
+    (const Poly& poly, const PolyBasis& basis);
+
+  virtual std::unique_ptr<Poly> classicReduceSPoly
+    (const Poly& a, const Poly& b, const PolyBasis& basis);
+
+  virtual void classicReduceSPolySet(
+    std::vector<std::pair<size_t, size_t> >& spairs,
+    const PolyBasis& basis,
+    std::vector<std::unique_ptr<Poly> >& reducedOut
+  );
+
+  virtual void classicReduceSPolySetAndFindUseful(
+    std::vector<std::pair<size_t, size_t> >& spairs,
+    const PolyBasis& basis,
+    std::vector<std::unique_ptr<Poly> >& reducedOut
+  );
+
+  virtual void classicReduceSPolySetPipelined(
+    std::vector<std::pair<size_t, size_t> >& spairs,
+    const std::vector<std::pair<size_t, size_t> >& nextSPairs,
+    const PolyBasis& basis,
+    std::vector<std::unique_ptr<Poly> >& reducedOut
+  );
+
+  virtual void classicReducePolySet(
+    const std::vector<std::unique_ptr<Poly> >& polys,
+    const PolyBasis& basis,
+    std::vector<std::unique_ptr<Poly> >& reducedOut
+  );
+
+  virtual std::unique_ptr<Poly> regularReduce(
+    ConstMonoRef sig,
+    ConstMonoRef multiple,
+    size_t basisElement,
+    const SigPolyBasis& basis
+  );
+
+  virtual void setMemoryQuantum(size_t quantum);
+
+private:
+  /// The number of reductions that each candidate does in a round of
+  /// sampling.
+  static const size_t SampleSize = 10;
+
+  struct Candidate {
+    std::unique_ptr<Reducer> reducer;
+
+    /// The time spent and the number of reductions done in the current
+    /// round of sampling.
+    double seconds;
+    size_t reductionCount;
+  };
+
+  /// Does count reductions in the given degree and with a basis of
+  /// basisSize elements by calling reduce(reducer) for the reducer of
+  /// the current candidate. Keeps track of the time if sampling.
+  template<class Reduce>
+  void reduceWith(
+    exponent degree,
+    size_t basisSize,
+    size_t count,
+    const Reduce& reduce
+  );
+
+  /// Returns true if the computation has changed enough since the last
+  /// choice of reducer that the candidates should be sampled again.
+  bool shouldSample(exponent degree, size_t basisSize) const;
+
+  void startSampling();
+  void finishSampling(exponent degree, size_t basisSize);
+
+  exponent degree(const Poly& poly) const;
+  exponent sPolyDegree(const Poly& a, const Poly& b) const;
+
+  const PolyRing& mRing;
+  std::vector<Candidate> mCandidates;
+  size_t mCurrent;
+  bool mSampling;
+
+  /// The degree and the size of the basis when the current candidate was
+  /// chosen.
+  exponent mChosenDegree;
+  size_t mChosenBasisSize;
+};
+
+ReducerAdaptive::ReducerAdaptive(const PolyRing& ring):
+  mRing(ring),
+  mCurrent(0),
+  mSampling(true),
+  mChosenDegree(0),
+  mChosenBasisSize(0)
+{
+  const ReducerType types[] = {
+    Reducer_Geobucket_Hashed,
+    Reducer_Geobucket_Hashed_Packed,
+    Reducer_Heap_Hashed_Packed,
+    Reducer_TourTree_Dedup_Packed
+  };
+  for (const auto type : types) {
+    Candidate candidate = {makeReducer(type, ring), 0.0, 0};
+    mCandidates.push_back(std::move(candidate));
+  }
+}
+
+unsigned int ReducerAdaptive::preferredSetSize() const {
+  return mCandidates[mCurrent].reducer->preferredSetSize();
+}
+
+std::string ReducerAdaptive::description() const {
+  return "adaptive, currently " + mCandidates[mCurrent].reducer->description();
+}
+
+size_t ReducerAdaptive::getMemoryUse() const {
+  size_t sum = 0;
+  for (const auto& candidate : mCandidates)
+    sum += candidate.reducer->getMemoryUse();
+  return sum;
+}
+
+std::unique_ptr<Poly> ReducerAdaptive::classicReduce(
+  const Poly& poly,
+  const PolyBasis& basis
+) {
+  std::unique_ptr<Poly> reduced;
+  reduceWith(degree(poly), basis.size(), 1, [&](Reducer& reducer) {
+    reduced = reducer.classicReduce(poly, basis);
+  });
+  return reduced;
+}
+
+std::unique_ptr<Poly> ReducerAdaptive::classicTailReduce(
+  const Poly& poly,
+  const PolyBasis& basis
+) {
+  std::unique_ptr<Poly> reduced;
+  reduceWith(degree(poly), basis.size(), 1, [&](Reducer& reducer) {
+    reduced = reducer.classicTailReduce(poly, basis);
+  });
+  return reduced;
+}
+
+std::unique_ptr<Poly> ReducerAdaptive::classicReduceSPoly(
+  const Poly& a,
+  const Poly& b,
+  const PolyBasis& basis
+) {
+  std::unique_ptr<Poly> reduced;
+  reduceWith(sPolyDegree(a, b), basis.size(), 1, [&](Reducer& reducer) {
+    reduced = reducer.classicReduceSPoly(a, b, basis);
+  });
+  return reduced;
+}
+
+void ReducerAdaptive::classicReduceSPolySet(
+  std::vector<std::pair<size_t, size_t> >& spairs,
+  const PolyBasis& basis,
+  std::vector<std::unique_ptr<Poly> >& reducedOut
+) {
+  if (spairs.empty())
+    return;
+  // The S-pairs of a group all have the same degree.
+  const auto& first = spairs.front();
+  const auto degree =
+    sPolyDegree(basis.poly(first.first), basis.poly(first.second));
+  reduceWith(degree, basis.size(), spairs.size(), [&](Reducer& reducer) {
+    reducer.classicReduceSPolySet(spairs, basis, reducedOut);
+  });
+}
+
+void ReducerAdaptive::classicReduceSPolySetAndFindUseful(
+  std::vector<std::pair<size_t, size_t> >& spairs,
+  const PolyBasis& basis,
+  std::vector<std::unique_ptr<Poly> >& reducedOut
+) {
+  if (spairs.empty())
+    return;
+  const auto& first = spairs.front();
+  const auto degree =
+    sPolyDegree(basis.poly(first.first), basis.poly(first.second));
+  reduceWith(degree, basis.size(), spairs.size(), [&](Reducer& reducer) {
+    reducer.classicReduceSPolySetAndFindUseful(spairs, basis, reducedOut);
+  });
+}
+
+void ReducerAdaptive::classicReduceSPolySetPipelined(
+  std::vector<std::pair<size_t, size_t> >& spairs,
+  const std::vector<std::pair<size_t, size_t> >& nextSPairs,
+  const PolyBasis& basis,
+  std::vector<std::unique_ptr<Poly> >& reducedOut
+) {
+  if (spairs.empty())
+    return;
+  const auto& first = spairs.front();
+  const auto degree =
+    sPolyDegree(basis.poly(first.first), basis.poly(first.second));
+  reduceWith(degree, basis.size(), spairs.size(), [&](Reducer& reducer) {
+    reducer.classicReduceSPolySetPipelined
+      (spairs, nextSPairs, basis, reducedOut);
+  });
+}
+
+void ReducerAdaptive::classicReducePolySet(
+  const std::vector<std::unique_ptr<Poly> >& polys,
+  const PolyBasis& basis,
+  std::vector<std::unique_ptr<Poly> >& reducedOut
+) {
+  if (polys.empty())
+    return;
+  exponent maxDegree = 0;
+  for (const auto& poly : polys)
+    maxDegree = std::max(maxDegree, degree(*poly));
+  reduceWith(maxDegree, basis.size(), polys.size(), [&](Reducer& reducer) {
+    reducer.classicReducePolySet(polys, basis, reducedOut);
+  });
+}
+
+std::unique_ptr<Poly> ReducerAdaptive::regularReduce(
+  ConstMonoRef sig,
+  ConstMonoRef multiple,
+  size_t basisElement,
+  const SigPolyBasis& basis
+) {
+  const auto& monoid = mRing.monoid();
+  const auto degree =
+    monoid.degree(multiple) + monoid.degree(basis.leadMono(basisElement));
+  std::unique_ptr<Poly> reduced;
+  reduceWith(degree, basis.size(), 1, [&](Reducer& reducer) {
+    reduced = reducer.regularReduce(sig, multiple, basisElement, basis);
+  });
+  return reduced;
+}
+
+void ReducerAdaptive::setMemoryQuantum(size_t quantum) {
+  for (auto& candidate : mCandidates)
+    candidate.reducer->setMemoryQuantum(quantum);
+}
+
+template<class Reduce>
+void ReducerAdaptive::reduceWith(
+  const exponent degree,
+  const size_t basisSize,
+  const size_t count,
+  const Reduce& reduce
+) {
+  if (!mSampling && shouldSample(degree, basisSize))
+    startSampling();
+
+  auto& candidate = mCandidates[mCurrent];
+  if (!mSampling) {
+    reduce(*candidate.reducer);
+    return;
+  }
+
+  const auto before = mtbb::tick_count::now();
+  reduce(*candidate.reducer);
+  candidate.seconds += (mtbb::tick_count::now() - before).seconds();
+  candidate.reductionCount += count;
+
+  // Take turns so that all candidates get reductions of about the same
+  // degree.
+  for (size_t i = 1; i <= mCandidates.size(); ++i) {
+    const auto next = (mCurrent + i) % mCandidates.size();
+    if (mCandidates[next].reductionCount < SampleSize) {
+      mCurrent = next;
+      return;
+    }
+  }
+  finishSampling(degree, basisSize);
+}
+
+bool ReducerAdaptive::shouldSample(
+  const exponent degree,
+  const size_t basisSize
+) const {
+  if (basisSize > 2 * mChosenBasisSize)
+    return true;
+  const auto degreeStep = std::max<exponent>(1, mChosenDegree / 4);
+  return degree >= mChosenDegree + degreeStep;
+}
+
+void ReducerAdaptive::startSampling() {
+  for (auto& candidate : mCandidates) {
+    candidate.seconds = 0.0;
+    candidate.reductionCount = 0;
+  }
+  mCurrent = 0;
+  mSampling = true;
+}
+
+void ReducerAdaptive::finishSampling(
+  const exponent degree,
+  const size_t basisSize
+) {
+  const auto timePerReduction = [](const Candidate& candidate) {
+    MATHICGB_ASSERT(candidate.reductionCount > 0);
+    return candidate.seconds / candidate.reductionCount;
+  };
+
+  mCurrent = 0;
+  for (size_t i = 1; i < mCandidates.size(); ++i)
+    if (timePerReduction(mCandidates[i]) <
+      timePerReduction(mCandidates[mCurrent]))
+      mCurrent = i;
+  mSampling = false;
+  mChosenDegree = degree;
+  mChosenBasisSize = basisSize;
+
+  MATHICGB_IF_STREAM_LOG(ReducerAdaptive) {
+    stream << "Adaptive reducer chose "
+      << mCandidates[mCurrent].reducer->description()
+      << " in degree " << degree
+      << " with " << basisSize << " basis elements.\n";
+    for (const auto& candidate : mCandidates) {
+      stream << "  " << candidate.reducer->description() << ": "
+        << timePerReduction(candidate) * 1e6 << " us per reduction\n";
+    }
+  };
+}
+
+auto ReducerAdaptive::degree(const Poly& poly) const -> exponent {
+  return poly.isZero() ? 0 : mRing.monoid().degree(poly.leadMono());
+}
+
+auto ReducerAdaptive::sPolyDegree(
+  const Poly& a,
+  const Poly& b
+) const -> exponent {
+  const auto& monoid = mRing.monoid();
+  auto lcm = monoid.alloc();
+  monoid.lcm(a.leadMono(), b.leadMono(), *lcm);
+  return monoid.degree(*lcm);
+}
+
+MATHICGB_REGISTER_REDUCER(
+  "Adaptive",
+  Reducer_Adaptive,
+  make_unique<ReducerAdaptive>(ring)
+);
+
+MATHICGB_NAMESPACE_END
@@ -27,6 +27,10 @@ public:
     return mQueue.getName() + "-dedup"; 
   }
 
+  virtual std::unique_ptr<TypicalReducer> makeEmptyCopy() const {
+    return make_unique<ReducerDedup>(mRing);
+  }
+
   virtual void insertTail(NewConstTerm multiplier, const Poly& f);
   virtual void insert(ConstMonoRef multiplier, const Poly& f);
 
@@ -43,16 +47,20 @@ public:
   class Configuration : public ReducerHelper::DedupConfiguration {
   public:
     typedef NewTerm Entry;
-    Configuration(const PolyRing& ring): DedupConfiguration(ring) {}
+    Configuration(const PolyRing& ring, Monoid::MonoPool& pool):
+      DedupConfiguration(ring), mPool(&pool) {}
     CompareResult compare(const Entry& a, const Entry& b) const {
       return ring().monoid().compare(*a.mono, *b.mono);
     }
     Entry deduplicate(Entry a, Entry b) const {
       // change a.coeff, and free b.monom
       ring().coefficientAddTo(a.coef, b.coef);
-      ring().monoid().freeRaw(*b.mono);
+      mPool->freeRaw(*b.mono);
       return a;
     }
+
+  private:
+    Monoid::MonoPool* mPool;
   };
 
 private:
@@ -64,17 +72,18 @@ private:
 
 template<template<typename> class Q>
 ReducerDedup<Q>::ReducerDedup(const PolyRing& ring):
+  TypicalReducer(ring),
   mRing(ring),
   mLeadTermKnown(false),
-  mQueue(Configuration(ring))
+  mQueue(Configuration(ring, mMonoPool))
 {
-  mLeadTerm.mono = mRing.monoid().alloc().release();
+  mLeadTerm.mono = mMonoPool.alloc().release();
 }
 
 template<template<typename> class Q>
 ReducerDedup<Q>::~ReducerDedup() {
   resetReducer();
-  mRing.monoid().freeRaw(*mLeadTerm.mono);
+  mMonoPool.freeRaw(*mLeadTerm.mono);
 }
 
 template<template<typename> class Q>
@@ -87,7 +96,7 @@ void ReducerDedup<Q>::insertTail(NewConstTerm multiple, const Poly& poly) {
   const auto end = poly.end();
   for (++it; it != end; ++it) {
     NewTerm t;
-    t.mono = mRing.monoid().alloc().release();
+    t.mono = mMonoPool.alloc().release();
     mRing.monoid().multiply(*multiple.mono, it.mono(), *t.mono);
     mRing.coefficientMult(multiple.coef, it.coef(), t.coef);
     mQueue.push(t);
@@ -102,7 +111,7 @@ void ReducerDedup<Q>::insert(ConstMonoRef multiple, const Poly& poly) {
 
   const auto end = poly.end();
   for (auto it = poly.begin(); it != end; ++it) {
-    NewTerm t = {it.coef(), mRing.monoid().alloc().release()};
+    NewTerm t = {it.coef(), mMonoPool.alloc().release()};
     mRing.monoid().multiply(multiple, it.mono(), *t.mono);
     mQueue.push(t);
   }
@@ -122,7 +131,7 @@ bool ReducerDedup<Q>::leadTerm(NewConstTerm& result) {
         if (!mRing.monoid().equal(*entry.mono, *mLeadTerm.mono))
           break;
         mRing.coefficientAddTo(mLeadTerm.coef, entry.coef);
-        mRing.monoid().freeRaw(*entry.mono);
+        mMonoPool.freeRaw(*entry.mono);
         mQueue.pop();
       }
     } while (mRing.coefficientIsZero(mLeadTerm.coef));
@@ -146,18 +155,18 @@ template<template<typename> class Q>
 void ReducerDedup<Q>::resetReducer() {
   class MonomialFree {
   public:
-    MonomialFree(const PolyRing& ring): mRing(ring) {}
+    MonomialFree(Monoid::MonoPool& pool): mPool(pool) {}
 
     bool proceed(NewTerm entry)
     {
-      mRing.monoid().freeRaw(*entry.mono);
+      mPool.freeRaw(*entry.mono);
       return true;
     }
   private:
-    const PolyRing& mRing;
+    Monoid::MonoPool& mPool;
   };
 
-  MonomialFree freeer(mRing);
+  MonomialFree freeer(mMonoPool);
   mQueue.forAll(freeer);
   mQueue.clear();
 }
@@ -26,6 +26,10 @@ public:
     return mQueue.getName() + "-hashed";
   }
 
+  virtual std::unique_ptr<TypicalReducer> makeEmptyCopy() const {
+    return make_unique<ReducerHash>(mRing);
+  }
+
   void insertTail(NewConstTerm multiplier, const Poly& f);
   void insert(ConstMonoRef multiplier, const Poly& f);
 
@@ -57,6 +61,7 @@ private:
 
 template<template<typename> class Q>
 ReducerHash<Q>::ReducerHash(const PolyRing &ring):
+  TypicalReducer(ring),
   mRing(ring),
   mHashTable(ring),
   mQueue(Configuration(ring))
@@ -38,6 +38,10 @@ public:
     return mQueue.getName() + "-hashed-packed";
   }
 
+  virtual std::unique_ptr<TypicalReducer> makeEmptyCopy() const {
+    return make_unique<ReducerHashPack>(mRing);
+  }
+
   virtual void insertTail(NewConstTerm multiplier, const Poly& f);
   virtual void insert(ConstMonoRef multiplier, const Poly& f);
 
@@ -52,14 +56,18 @@ private:
   // Represents a term multiple of a polynomial, 
   // together with a current term of the multiple.
   struct MultipleWithPos {
-    MultipleWithPos(const Poly& poly, NewConstTerm multiple);
+    MultipleWithPos(
+      const Poly& poly,
+      NewConstTerm multiple,
+      Monoid::MonoPool& pool
+    );
 
     Poly::ConstTermIterator pos;
     const Poly::ConstTermIterator end;
     NewTerm multiple;
     PolyHashTable::Node* node;
 
-    void destroy(const PolyRing& ring);
+    void destroy(Monoid::MonoPool& pool);
   };
 
   class Configuration : public ReducerHelper::PlainConfiguration {
@@ -81,6 +89,7 @@ private:
 
 template<template<typename> class Q>
 ReducerHashPack<Q>::ReducerHashPack(const PolyRing& ring):
+  TypicalReducer(ring),
   mRing(ring),
   mQueue(Configuration(ring)),
   mHashTable(ring),
@@ -97,7 +106,8 @@ void ReducerHashPack<Q>::insertTail(NewConstTerm multiple, const Poly& poly) {
   MATHICGB_ASSERT(&poly.ring() == &mRing);
   if (poly.termCount() <= 1)
     return;
-  auto entry = new (mPool.alloc()) MultipleWithPos(poly, multiple);
+  auto entry =
+    new (mPool.alloc()) MultipleWithPos(poly, multiple, mMonoPool);
   ++entry->pos;
   insertEntry(entry);
 }
@@ -108,26 +118,28 @@ void ReducerHashPack<Q>::insert(ConstMonoRef multiple, const Poly& poly) {
   if (poly.isZero())
     return;
   NewConstTerm termMultiple = {1, multiple.ptr()};
-  insertEntry(new (mPool.alloc()) MultipleWithPos(poly, termMultiple));
+  insertEntry
+    (new (mPool.alloc()) MultipleWithPos(poly, termMultiple, mMonoPool));
 }
 
 template<template<typename> class Q>
 ReducerHashPack<Q>::MultipleWithPos::MultipleWithPos(
   const Poly& poly,
-  NewConstTerm multipleParam
+  NewConstTerm multipleParam,
+  Monoid::MonoPool& pool
 ):
   pos(poly.begin()),
   end(poly.end()),
   node(0)
 {
-  multiple.mono = poly.ring().monoid().alloc().release();
+  multiple.mono = pool.alloc().release();
   poly.ring().monoid().copy(*multipleParam.mono, *multiple.mono);
   multiple.coef = multipleParam.coef;
 }
 
 template<template<typename> class Q>
-void ReducerHashPack<Q>::MultipleWithPos::destroy(const PolyRing& ring) {
-  ring.monoid().freeRaw(*multiple.mono);
+void ReducerHashPack<Q>::MultipleWithPos::destroy(Monoid::MonoPool& pool) {
+  pool.freeRaw(*multiple.mono);
 
   // Call the destructor to destruct the iterators into std::vector.
   // In debug mode MSVC puts those in a linked list and the destructor
@@ -169,7 +181,7 @@ void ReducerHashPack<Q>::removeLeadTerm() {
     ++entry->pos;
     if (entry->pos == entry->end) {
       mQueue.pop();
-      entry->destroy(mRing);
+      entry->destroy(mMonoPool);
       mPool.free(entry);
       break;
     }
@@ -194,7 +206,7 @@ void ReducerHashPack<Q>::insertEntry(MultipleWithPos* entry) {
       return;
     }
   }
-  entry->destroy(mRing);
+  entry->destroy(mMonoPool);
   mPool.free(entry);
 }
 
@@ -202,17 +214,17 @@ template<template<typename> class Q>
 void ReducerHashPack<Q>::resetReducer() {
   class MonomialFree {
   public:
-    MonomialFree(const PolyRing& ring): mRing(ring) {}
+    MonomialFree(Monoid::MonoPool& pool): mPool(pool) {}
 
     bool proceed(MultipleWithPos* entry) {
-      entry->destroy(mRing);
+      entry->destroy(mPool);
       return true;
     }
   private:
-    const PolyRing& mRing;
+    Monoid::MonoPool& mPool;
   };
 
-  MonomialFree freeer(mRing);
+  MonomialFree freeer(mMonoPool);
   mQueue.forAll(freeer);
   mQueue.clear();
   mHashTable.clear();
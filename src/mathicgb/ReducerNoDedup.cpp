@@ -27,6 +27,10 @@ public:
     return mQueue.getName() + "-nodedup"; 
   }
 
+  virtual std::unique_ptr<TypicalReducer> makeEmptyCopy() const {
+    return make_unique<ReducerNoDedup>(mRing);
+  }
+
   virtual void insertTail(NewConstTerm multiplier, const Poly& f);
   virtual void insert(ConstMonoRef multiplier, const Poly& f);
 
@@ -57,17 +61,18 @@ private:
 
 template<template<typename> class Q>
 ReducerNoDedup<Q>::ReducerNoDedup(const PolyRing& ring):
+  TypicalReducer(ring),
   mRing(ring),
   mLeadTermKnown(false),
   mQueue(Configuration(ring))
 {
-  mLeadTerm.mono = mRing.monoid().alloc().release();
+  mLeadTerm.mono = mMonoPool.alloc().release();
 }
 
 template<template<typename> class Q>
 ReducerNoDedup<Q>::~ReducerNoDedup() {
   resetReducer();
-  mRing.monoid().freeRaw(*mLeadTerm.mono);
+  mMonoPool.freeRaw(*mLeadTerm.mono);
 }
 
 template<template<typename> class Q>
@@ -80,7 +85,7 @@ void ReducerNoDedup<Q>::insertTail(NewConstTerm multiple, const Poly& poly) {
   const auto end = poly.end();
   for (++it; it != end; ++it) {
     NewTerm t;
-    t.mono = mRing.allocMonomial();
+    t.mono = mMonoPool.alloc().release();
     mRing.monoid().multiply(*multiple.mono, it.mono(), *t.mono);
     mRing.coefficientMult(multiple.coef, it.coef(), t.coef);
     mQueue.push(t);
@@ -95,7 +100,7 @@ void ReducerNoDedup<Q>::insert(ConstMonoRef multiple, const Poly& poly) {
 
   const auto end = poly.end();
   for (auto it = poly.begin(); it != end; ++it) {
-    NewTerm t = {it.coef(), mRing.monoid().alloc().release()};
+    NewTerm t = {it.coef(), mMonoPool.alloc().release()};
     mRing.monoid().multiply(multiple, it.mono(), *t.mono);
     mQueue.push(t);
   }
@@ -118,7 +123,7 @@ bool ReducerNoDedup<Q>::leadTerm(NewConstTerm& result) {
         if (!mRing.monoid().equal(*entry.mono, *mLeadTerm.mono))
           break;
         mRing.coefficientAddTo(mLeadTerm.coef, entry.coef);
-        mRing.monoid().freeRaw(*entry.mono);
+        mMonoPool.freeRaw(*entry.mono);
         mQueue.pop();
       }
     } while (mRing.coefficientIsZero(mLeadTerm.coef));
@@ -142,18 +147,18 @@ template<template<typename> class Q>
 void ReducerNoDedup<Q>::resetReducer() {
   class MonomialFree {
   public:
-    MonomialFree(const PolyRing& ring): mRing(ring) {}
+    MonomialFree(Monoid::MonoPool& pool): mPool(pool) {}
 
     bool proceed(NewTerm entry) {
-      mRing.monoid().freeRaw(*entry.mono);
+      mPool.freeRaw(*entry.mono);
       return true;
     }
 
   private:
-    const PolyRing& mRing;
+    Monoid::MonoPool& mPool;
   };
 
-  MonomialFree freeer(mRing);
+  MonomialFree freeer(mMonoPool);
   mQueue.forAll(freeer);
   mQueue.clear();
 }
@@ -22,23 +22,28 @@ template<template<typename> class Queue>
 class ReducerPack : public TypicalReducer {
 public:
   ReducerPack(const PolyRing& ring):
+    TypicalReducer(ring),
     mRing(ring),
     mLeadTermKnown(false),
     mQueue(Configuration(ring)),
     mPool(sizeof(MultipleWithPos))
   {
-    mLeadTerm.mono = mRing.monoid().alloc().release();
+    mLeadTerm.mono = mMonoPool.alloc().release();
   }
 
   virtual ~ReducerPack() {
     resetReducer();
-    mRing.monoid().freeRaw(*mLeadTerm.mono);
+    mMonoPool.freeRaw(*mLeadTerm.mono);
   }
 
   virtual std::string description() const {
     return mQueue.getName() + "-packed";
   }
 
+  virtual std::unique_ptr<TypicalReducer> makeEmptyCopy() const {
+    return make_unique<ReducerPack>(mRing);
+  }
+
   virtual void insertTail(NewConstTerm multiplier, const Poly& f);
   virtual void insert(ConstMonoRef multiplier, const Poly& f);
 
@@ -53,7 +58,11 @@ private:
   // Represents a term multiple of a polynomial, 
   // together with a current term of the multiple.
   struct MultipleWithPos {
-    MultipleWithPos(const Poly& poly, NewConstTerm multiple);
+    MultipleWithPos(
+      const Poly& poly,
+      NewConstTerm multiple,
+      Monoid::MonoPool& pool
+    );
 
     Poly::ConstTermIterator pos;
     const Poly::ConstTermIterator end;
@@ -67,7 +76,7 @@ private:
     // multiple.monom and pos.getMonomial().
     void computeCurrent(const PolyRing& ring);
     void currentCoefficient(const PolyRing& ring, coefficient& coeff);
-    void destroy(const PolyRing& ring);
+    void destroy(Monoid::MonoPool& pool);
   };
 
   class Configuration : public ReducerHelper::PlainConfiguration {
@@ -95,7 +104,7 @@ void ReducerPack<Q>::insertTail(NewConstTerm multiple, const Poly& poly)
   mLeadTermKnown = false;
 
   MultipleWithPos* entry =
-    new (mPool.alloc()) MultipleWithPos(poly, multiple);
+    new (mPool.alloc()) MultipleWithPos(poly, multiple, mMonoPool);
   ++entry->pos;
   entry->computeCurrent(poly.ring());
   mQueue.push(entry);
@@ -109,7 +118,8 @@ void ReducerPack<Q>::insert(ConstMonoRef multiple, const Poly& poly)
   mLeadTermKnown = false;
 
   NewConstTerm termMultiple = {1, multiple.ptr()};
-  auto entry = new (mPool.alloc()) MultipleWithPos(poly, termMultiple);
+  auto entry =
+    new (mPool.alloc()) MultipleWithPos(poly, termMultiple, mMonoPool);
   entry->computeCurrent(poly.ring());
   mQueue.push(entry);
 }
@@ -117,13 +127,14 @@ void ReducerPack<Q>::insert(ConstMonoRef multiple, const Poly& poly)
 template<template<typename> class Q>
 ReducerPack<Q>::MultipleWithPos::MultipleWithPos(
   const Poly& poly,
-  NewConstTerm multipleParam
+  NewConstTerm multipleParam,
+  Monoid::MonoPool& pool
 ):
   pos(poly.begin()),
   end(poly.end()),
-  current(poly.ring().allocMonomial())
+  current(pool.alloc().release())
 {
-  multiple.mono = poly.ring().monoid().alloc().release();
+  multiple.mono = pool.alloc().release();
   poly.ring().monoid().copy(*multipleParam.mono, *multiple.mono);
   multiple.coef = multipleParam.coef;
 }
@@ -140,9 +151,9 @@ void ReducerPack<Q>::MultipleWithPos::currentCoefficient
 }
 
 template<template<typename> class Q>
-void ReducerPack<Q>::MultipleWithPos::destroy(const PolyRing& ring) {
-  ring.monoid().freeRaw(*current);
-  ring.monoid().freeRaw(*multiple.mono);
+void ReducerPack<Q>::MultipleWithPos::destroy(Monoid::MonoPool& pool) {
+  pool.freeRaw(*current);
+  pool.freeRaw(*multiple.mono);
 
   // Call the destructor to destruct the iterators into std::vector.
   // In debug mode MSVC puts those in a linked list and the destructor
@@ -166,7 +177,7 @@ bool ReducerPack<Q>::leadTerm(NewConstTerm& result)
         ++entry->pos;
         if (entry->pos == entry->end) {
           mQueue.pop();
-          entry->destroy(mRing);
+          entry->destroy(mMonoPool);
           mPool.free(entry);
         } else {
           entry->computeCurrent(mRing);
@@ -207,18 +218,18 @@ void ReducerPack<Q>::resetReducer()
 {
   class MonomialFree {
   public:
-    MonomialFree(const PolyRing& ring): mRing(ring) {}
+    MonomialFree(Monoid::MonoPool& pool): mPool(pool) {}
 
     bool proceed(MultipleWithPos* entry) {
-      entry->destroy(mRing);
+      entry->destroy(mPool);
       return true;
     }
 
   private:
-    const PolyRing& mRing;
+    Monoid::MonoPool& mPool;
   };
 
-  MonomialFree freeer(mRing);
+  MonomialFree freeer(mMonoPool);
   mQueue.forAll(freeer);
   mQueue.clear();
 }
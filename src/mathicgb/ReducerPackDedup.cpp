@@ -34,6 +34,10 @@ public:
     return mQueue.getName() + "-packed";
   }
 
+  virtual std::unique_ptr<TypicalReducer> makeEmptyCopy() const {
+    return make_unique<ReducerPackDedup>(mRing);
+  }
+
   virtual void insertTail(NewConstTerm multiplier, const Poly& f);
   virtual void insert(ConstMonoRef multiplier, const Poly& f);
 
@@ -48,7 +52,11 @@ private:
   // Represents a term multiple of a polynomial, 
   // together with a current term of the multiple.
   struct MultipleWithPos {
-    MultipleWithPos(const Poly& poly, NewConstTerm multiple);
+    MultipleWithPos(
+      const Poly& poly,
+      NewConstTerm multiple,
+      Monoid::MonoPool& pool
+    );
 
     Poly::ConstTermIterator pos;
     const Poly::ConstTermIterator end;
@@ -63,7 +71,7 @@ private:
     void computeCurrent(const PolyRing& ring);
     void currentCoefficient(const PolyRing& ring, Coefficient& coeff);
     void addCurrentCoefficient(const PolyRing& ring, Coefficient& coeff);
-    void destroy(const PolyRing& ring);
+    void destroy(Monoid::MonoPool& pool);
 
     // Points to a circular list of entries that have the same current
     // monomial. If no other such entries have been discovered, then
@@ -101,18 +109,19 @@ private:
 
 template<template<typename> class Q>
 ReducerPackDedup<Q>::ReducerPackDedup(const PolyRing& ring):
+  TypicalReducer(ring),
   mRing(ring),
   mLeadTermKnown(false),
   mQueue(Configuration(ring)),
   mPool(sizeof(MultipleWithPos))
 {
-  mLeadTerm.mono = mRing.monoid().alloc().release();
+  mLeadTerm.mono = mMonoPool.alloc().release();
 }
 
 template<template<typename> class Q>
 ReducerPackDedup<Q>::~ReducerPackDedup() {
   resetReducer();
-  mRing.monoid().freeRaw(*mLeadTerm.mono);
+  mMonoPool.freeRaw(*mLeadTerm.mono);
 }
 
 template<template<typename> class Q>
@@ -121,7 +130,8 @@ void ReducerPackDedup<Q>::insertTail(NewConstTerm multiple, const Poly& poly) {
     return;
   mLeadTermKnown = false;
 
-  auto entry = new (mPool.alloc()) MultipleWithPos(poly, multiple);
+  auto entry =
+    new (mPool.alloc()) MultipleWithPos(poly, multiple, mMonoPool);
   ++entry->pos;
   entry->computeCurrent(poly.ring());
   mQueue.push(entry);
@@ -134,7 +144,8 @@ void ReducerPackDedup<Q>::insert(ConstMonoRef multiple, const Poly& poly) {
   mLeadTermKnown = false;
 
   NewConstTerm termMultiple = {1, multiple.ptr()};
-  auto entry = new (mPool.alloc()) MultipleWithPos(poly, termMultiple);
+  auto entry =
+    new (mPool.alloc()) MultipleWithPos(poly, termMultiple, mMonoPool);
   entry->computeCurrent(poly.ring());
   mQueue.push(entry);
 }
@@ -142,14 +153,15 @@ void ReducerPackDedup<Q>::insert(ConstMonoRef multiple, const Poly& poly) {
 template<template<typename> class Q>
 ReducerPackDedup<Q>::MultipleWithPos::MultipleWithPos(
   const Poly& poly,
-  NewConstTerm multipleParam
+  NewConstTerm multipleParam,
+  Monoid::MonoPool& pool
 ):
   pos(poly.begin()),
   end(poly.end()),
-  current(poly.ring().monoid().alloc().release()),
+  current(pool.alloc().release()),
   chain(this)
 {
-  multiple.mono = poly.ring().monoid().alloc().release();
+  multiple.mono = pool.alloc().release();
   poly.ring().monoid().copy(*multipleParam.mono, *multiple.mono);
   multiple.coef = multipleParam.coef;
 }
@@ -180,11 +192,11 @@ void ReducerPackDedup<Q>::MultipleWithPos::addCurrentCoefficient(
 }
 
 template<template<typename> class Q>
-void ReducerPackDedup<Q>::MultipleWithPos::destroy(const PolyRing& ring) {
+void ReducerPackDedup<Q>::MultipleWithPos::destroy(Monoid::MonoPool& pool) {
   MultipleWithPos* entry = this;
   do {
-    ring.monoid().freeRaw(*entry->current);
-    ring.monoid().freeRaw(*entry->multiple.mono);
+    pool.freeRaw(*entry->current);
+    pool.freeRaw(*entry->multiple.mono);
     MultipleWithPos* next = entry->chain;
     MATHICGB_ASSERT(next != 0);
 
@@ -217,7 +229,7 @@ bool ReducerPackDedup<Q>::leadTerm(NewConstTerm& result) {
         ++entry->pos;
         if (entry->pos == entry->end) {
           mQueue.pop();
-          entry->destroy(mRing);
+          entry->destroy(mMonoPool);
           mPool.free(entry);
         } else {
           entry->computeCurrent(mRing);
@@ -239,7 +251,7 @@ bool ReducerPackDedup<Q>::leadTerm(NewConstTerm& result) {
           chain->addCurrentCoefficient(mRing, mLeadTerm.coef);
           ++chain->pos;
           if (chain->pos == chain->end) {
-            chain->destroy(mRing);
+            chain->destroy(mMonoPool);
             mPool.free(chain);
           } else {
             chain->computeCurrent(mRing);
@@ -280,18 +292,18 @@ template<template<typename> class Q>
 void ReducerPackDedup<Q>::resetReducer() {
   class MonomialFree {
   public:
-    MonomialFree(const PolyRing& ring): mRing(ring) {}
+    MonomialFree(Monoid::MonoPool& pool): mPool(pool) {}
 
     bool proceed(MultipleWithPos* entry) {
-      entry->destroy(mRing);
+      entry->destroy(mPool);
       return true;
     }
 
   private:
-    const PolyRing& mRing;
+    Monoid::MonoPool& mPool;
   };
 
-  MonomialFree freeer(mRing);
+  MonomialFree freeer(mMonoPool);
   mQueue.forAll(freeer);
   mQueue.clear();
 }
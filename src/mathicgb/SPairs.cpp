@@ -6,6 +6,7 @@
 #include "SigPolyBasis.hpp"
 #include "LogDomain.hpp"
 #include "MathicIO.hpp"
+#include "mtbb.hpp"
 #include <iostream>
 
 MATHICGB_DEFINE_LOG_DOMAIN_WITH_DEFAULTS(
@@ -35,7 +36,8 @@ SPairs::SPairs(const PolyBasis& basis, bool preferSparseSPairs):
   mOrderMonoid(OrderMonoid::create(mMonoid)),
   mBareMonoid(BareMonoid::create(mMonoid)),
   mQueue(QueueConfiguration(basis, mOrderMonoid, preferSparseSPairs)),
-  mBasis(basis)
+  mBasis(basis),
+  mParallelThreshold(1024)
  {}
 
 std::pair<size_t, size_t> SPairs::pop() {
@@ -59,6 +61,7 @@ std::pair<size_t, size_t> SPairs::pop() {
       monoid(), mBasis.leadMono(p.second),
       *lcm
     ));
+
     if (!advancedBuchbergerLcmCriterion(p.first, p.second, *lcm)) {
       mEliminated.setBit(p.first, p.second, true);
       return p;
@@ -221,6 +224,40 @@ void SPairs::addPairs(size_t newGen) {
     throw std::overflow_error
       ("Too large basis element index in constructing S-pairs.");
 
+  // The S-pairs of newGen are first looked at in parallel, but only as far
+  // as the result does not depend on the other S-pairs of newGen. The
+  // simple Buchberger lcm criterion can depend on which of those have
+  // been eliminated, so the S-pairs that are still undecided after that
+  // are checked serially in order. Eliminating more S-pairs can only make
+  // the criterion apply more often, so an S-pair that the hit cache
+  // eliminates before the other S-pairs of newGen are eliminated would
+  // also have been eliminated by the serial check. So the result is the
+  // same as checking every S-pair serially.
+  std::vector<PairStatus> statuses(newGen);
+  if (newGen < mParallelThreshold) {
+    auto lcm = mBareMonoid.alloc();
+    for (size_t oldGen = 0; oldGen < newGen; ++oldGen)
+      statuses[oldGen] = pairStatus(newGen, oldGen, *lcm);
+  } else {
+    // enumerable_thread_specific needs a copyable type, so each thread gets
+    // a pointer to its lcm and the vector owns the lcm's.
+    std::vector<BareMonoid::Mono> lcms;
+    mtbb::mutex lcmsLock;
+    mtbb::enumerable_thread_specific<BareMonoid::MonoPtr> threadLcm([&]() {
+      mtbb::mutex::scoped_lock guard(lcmsLock);
+      lcms.push_back(mBareMonoid.alloc());
+      return lcms.back().ptr();
+    });
+    mtbb::parallel_for(
+      mtbb::blocked_range<size_t>(0, newGen, 256),
+      [&](const mtbb::blocked_range<size_t>& range) {
+        auto lcm = *threadLcm.local();
+        for (auto oldGen = range.begin(); oldGen != range.end(); ++oldGen)
+          statuses[oldGen] = pairStatus(newGen, oldGen, lcm);
+      }
+    );
+  }
+
   OrderMonoid::MonoVector prePairMonos(orderMonoid());
   typedef std::pair<OrderMonoid::ConstMonoPtr, Queue::Index> PrePair;
   std::vector<PrePair> prePairs;
@@ -230,18 +267,31 @@ void SPairs::addPairs(size_t newGen) {
   auto newLead = mBasis.leadMono(newGen);
   auto lcm = mBareMonoid.alloc();
   for (size_t oldGen = 0; oldGen < newGen; ++oldGen) {
-    if (mBasis.retired(oldGen))
+    switch (statuses[oldGen]) {
+    case OldGenRetired:
       continue;
-    auto oldLead = mBasis.leadMono(oldGen);
-    if (monoid().component(newLead) != monoid().component(oldLead)) {
+
+    case OtherComponent:
       mEliminated.setBit(newGen, oldGen, true);
       continue;
-    }
-    if (monoid().relativelyPrime(newLead, oldLead)) {
+
+    case RelativelyPrime:
       ++mStats.relativelyPrimeHits;
       mEliminated.setBit(newGen, oldGen, true);
       continue;
+
+    case LcmCacheHit:
+      MATHICGB_ASSERT(simpleBuchbergerLcmCriterionSlow(newGen, oldGen));
+      ++mStats.buchbergerLcmCacheHits;
+      ++mStats.buchbergerLcmSimpleHits;
+      mEliminated.setBit(newGen, oldGen, true);
+      continue;
+
+    case Undecided:
+      break;
     }
+
+    auto oldLead = mBasis.leadMono(oldGen);
     mBareMonoid.lcm(monoid(), newLead, monoid(), oldLead, *lcm);
     if (simpleBuchbergerLcmCriterion(newGen, oldGen, *lcm)) {
       mEliminated.setBit(newGen, oldGen, true);
@@ -264,7 +314,129 @@ void SPairs::addPairs(size_t newGen) {
 }
 
 size_t SPairs::getMemoryUse() const {
-  return mQueue.getMemoryUse();
+  return
+    mQueue.getMemoryUse() +
+    mEliminated.getMemoryUse() +
+    mQueue.columnCount() * orderMonoid().entryCount() * sizeof(Exponent) +
+    mBuchbergerLcmHitCache.capacity() * sizeof(mBuchbergerLcmHitCache.front());
+}
+
+class SPairs::LcmCriterion : public MonoLookup::EntryOutput {
+public:
+  LcmCriterion(
+    const size_t a,
+    const size_t b,
+    BareMonoid::ConstMonoRef lcmAB,
+    const SPairs& sPairs
+  ):
+    mA(a), mB(b),
+    mLcmAB(lcmAB),
+    mSPairs(sPairs),
+    mMonoid(sPairs.monoid()),
+    mBareMonoid(sPairs.bareMonoid()),
+    mBasis(sPairs.basis()),
+    mHit(static_cast<size_t>(-1)),
+    mAlmostApplies(false) {}
+
+  virtual bool proceed(size_t index) {
+    MATHICGB_ASSERT(index < mBasis.size());
+    MATHICGB_ASSERT(!applies()); // should have stopped search in this case
+    MATHICGB_ASSERT
+      (mBareMonoid.divides(mMonoid, mBasis.leadMono(index), mLcmAB));
+    if (index == mA || index == mB)
+      return true;
+    mAlmostApplies = true;
+
+    // check lcm(a,index) != lcm(a,b) <=>
+    // exists i such that max(a[i], c[i]) != max(a[i],b[i]) <=>
+    // exists i such that b[i] > a[i] && b[i] > c[i] <=>
+    // exists i such that b[i] > max(a[i], c[i]) <=>
+    // b does not divide lcm(a[i], c[i])
+    auto leadA = mBasis.leadMono(mA);
+    auto leadB = mBasis.leadMono(mB);
+    auto leadC = mBasis.leadMono(index);
+
+    if (
+      !mSPairs.eliminated(index, mA) &&
+      mMonoid.dividesLcm(leadB, leadC, leadA)
+    )
+      return true; // we had lcm(a,index) == lcm(a,b)
+
+    // check lcm(b,index) != lcm(a,b)
+    if (
+      !mSPairs.eliminated(index, mB) &&
+      mMonoid.dividesLcm(leadA, leadC, leadB)
+    )
+      return true;  // we had lcm(b,index) == lcm(a,b)
+
+    mHit = index;
+    return false; // stop search
+  }
+
+  size_t a() const {return mA;}
+  size_t b() const {return mB;}
+  BareMonoid::ConstMonoRef lcmAB() const {return mLcmAB;}
+  bool almostApplies() const {return mAlmostApplies;}
+  bool applies() const {return mHit != static_cast<size_t>(-1);}
+  size_t hit() const {return mHit;}
+
+private:
+  const size_t mA;
+  const size_t mB;
+  BareMonoid::ConstMonoRef mLcmAB;
+  const SPairs& mSPairs;
+  const Monoid& mMonoid;
+  const BareMonoid& mBareMonoid;
+  const PolyBasis& mBasis;
+  size_t mHit; // the divisor that made the criterion apply
+  bool mAlmostApplies; // applies ignoring lcm(a,b)=lcm(a,c) complication
+};
+
+size_t SPairs::lcmHitCacheWitness(LcmCriterion& criterion) const {
+  MATHICGB_ASSERT(mUseBuchbergerLcmHitCache);
+  MATHICGB_ASSERT(!criterion.applies());
+
+  // Check cacheB first since when I tried this there was a higher hit rate
+  // for cacheB than cacheA. Might not be a persistent phenomenon, but
+  // there's no downside to trying out cacheB first so I'm going for that.
+  const auto isWitness = [&](const size_t cache) {
+    return
+      !mBasis.retired(cache) &&
+      mBareMonoid.dividesWithComponent
+        (monoid(), mBasis.leadMono(cache), criterion.lcmAB()) &&
+      !criterion.LcmCriterion::proceed(cache);
+  };
+  const size_t cacheB = mBuchbergerLcmHitCache[criterion.b()];
+  if (isWitness(cacheB))
+    return cacheB;
+  const size_t cacheA = mBuchbergerLcmHitCache[criterion.a()];
+  if (isWitness(cacheA))
+    return cacheA;
+  return static_cast<size_t>(-1);
+}
+
+auto SPairs::pairStatus(
+  const size_t newGen,
+  const size_t oldGen,
+  BareMonoid::MonoRef lcm
+) const -> PairStatus {
+  MATHICGB_ASSERT(oldGen < newGen);
+  if (mBasis.retired(oldGen))
+    return OldGenRetired;
+  auto newLead = mBasis.leadMono(newGen);
+  auto oldLead = mBasis.leadMono(oldGen);
+  if (monoid().component(newLead) != monoid().component(oldLead))
+    return OtherComponent;
+  if (monoid().relativelyPrime(newLead, oldLead))
+    return RelativelyPrime;
+  if (!mUseBuchbergerLcmHitCache)
+    return Undecided;
+
+  mBareMonoid.lcm(monoid(), newLead, monoid(), oldLead, lcm);
+  LcmCriterion criterion(newGen, oldGen, lcm, *this);
+  if (lcmHitCacheWitness(criterion) != static_cast<size_t>(-1))
+    return LcmCacheHit;
+  return Undecided;
 }
 
 bool SPairs::simpleBuchbergerLcmCriterion(
@@ -286,84 +458,11 @@ bool SPairs::simpleBuchbergerLcmCriterion(
   );
   MATHICGB_ASSERT(mEliminated.columnCount() == mBasis.size());
 
-  class Criterion : public MonoLookup::EntryOutput {
-  public:
-    Criterion(
-      const size_t a,
-      const size_t b,
-      BareMonoid::ConstMonoRef lcmAB,
-      const SPairs& sPairs
-    ):
-      mA(a), mB(b),
-      mLcmAB(lcmAB),
-      mSPairs(sPairs),
-      mMonoid(sPairs.monoid()),
-      mBareMonoid(sPairs.bareMonoid()),
-      mBasis(sPairs.basis()),
-      mHit(static_cast<size_t>(-1)),
-      mAlmostApplies(false) {}
-
-    virtual bool proceed(size_t index) {
-      MATHICGB_ASSERT(index < mBasis.size());
-      MATHICGB_ASSERT(!applies()); // should have stopped search in this case
-      MATHICGB_ASSERT
-        (mBareMonoid.divides(mMonoid, mBasis.leadMono(index), mLcmAB));
-      if (index == mA || index == mB)
-        return true;
-      mAlmostApplies = true;
-
-      // check lcm(a,index) != lcm(a,b) <=>
-      // exists i such that max(a[i], c[i]) != max(a[i],b[i]) <=>
-      // exists i such that b[i] > a[i] && b[i] > c[i] <=>
-      // exists i such that b[i] > max(a[i], c[i]) <=>
-      // b does not divide lcm(a[i], c[i])
-      auto leadA = mBasis.leadMono(mA);
-      auto leadB = mBasis.leadMono(mB);
-      auto leadC = mBasis.leadMono(index);
-
-      if (
-        !mSPairs.eliminated(index, mA) &&
-        mMonoid.dividesLcm(leadB, leadC, leadA)
-      )
-        return true; // we had lcm(a,index) == lcm(a,b)
-
-      // check lcm(b,index) != lcm(a,b)
-      if (
-        !mSPairs.eliminated(index, mB) &&
-        mMonoid.dividesLcm(leadA, leadC, leadB)
-      )
-        return true;  // we had lcm(b,index) == lcm(a,b)
-
-      mHit = index;
-      return false; // stop search
-    }
-
-    BareMonoid::ConstMonoRef lcmAB() const {return mLcmAB;}
-    bool almostApplies() const {return mAlmostApplies;}
-    bool applies() const {return mHit != static_cast<size_t>(-1);}
-    size_t hit() const {return mHit;}
-
-  private:
-    const size_t mA;
-    const size_t mB;
-    BareMonoid::ConstMonoRef mLcmAB;
-    const SPairs& mSPairs;
-    const Monoid& mMonoid;
-    const BareMonoid& mBareMonoid;
-    const PolyBasis& mBasis;
-    size_t mHit; // the divisor that made the criterion apply
-    bool mAlmostApplies; // applies ignoring lcm(a,b)=lcm(a,c) complication
-  };
-
   bool applies = false;
   bool almostApplies = false;
   {
-    Criterion criterion(a, b, lcmAB, *this);
+    LcmCriterion criterion(a, b, lcmAB, *this);
     if (mUseBuchbergerLcmHitCache) {
-      // Check cacheB first since when I tried this there was a higher hit rate
-      // for cacheB than cacheA. Might not be a persistent phenomenon, but
-      // there's no downside to trying out cacheB first so I'm going for that.
-      //
       // I update the cache if the second check is a hit but not if the first
       // check is a hit. In the one test I did, the worst hit rate was from
       // updating the cache every time, the second best hit rate was from
@@ -379,26 +478,10 @@ bool SPairs::simpleBuchbergerLcmCriterion(
       // a high hit rate element. So it should be better to replace it.
       // That idea seems to be right since it worked better in the one
       // test I did.
-      size_t cacheB = mBuchbergerLcmHitCache[b];
-      if (
-          !applies &&
-          !mBasis.retired(cacheB) &&
-          mBareMonoid.dividesWithComponent
-            (monoid(), mBasis.leadMono(cacheB), criterion.lcmAB())
-      )
-        applies = !criterion.Criterion::proceed(cacheB);
-
-      size_t cacheA = mBuchbergerLcmHitCache[a];
-      if (
-        !applies &&
-        !mBasis.retired(cacheA) &&
-        mBareMonoid.dividesWithComponent
-          (monoid(), mBasis.leadMono(cacheA), criterion.lcmAB())
-      ) {
-        applies = !criterion.Criterion::proceed(cacheA);
-        if (applies)
-          mBuchbergerLcmHitCache[b] = cacheA;
-      }
+      const auto witness = lcmHitCacheWitness(criterion);
+      applies = witness != static_cast<size_t>(-1);
+      if (applies && witness != mBuchbergerLcmHitCache[b])
+        mBuchbergerLcmHitCache[b] = witness;
     }
     if (applies) {
       if (mStats.late)
@@ -407,9 +490,11 @@ bool SPairs::simpleBuchbergerLcmCriterion(
         ++mStats.buchbergerLcmCacheHits;
     } else {
       MATHICGB_ASSERT(!criterion.applies());
-      // This will be a tough nut to crack in terms of getting the types to match.
-      mBasis.monoLookup().divisors
-        (Monoid::toRef(BareMonoid::toOld(criterion.lcmAB())), criterion);
+      // The lookup reads the divisibility mask of the monomial, which a
+      // monomial of bareMonoid() does not have, so copy the lcm first.
+      auto lcm = monoid().alloc();
+      monoid().copy(bareMonoid(), criterion.lcmAB(), *lcm);
+      mBasis.monoLookup().divisors(*lcm, criterion);
       applies = criterion.applies();
 
       if (mUseBuchbergerLcmHitCache && applies) {
@@ -525,9 +610,11 @@ bool SPairs::advancedBuchbergerLcmCriterion(
   Graph& graph = mAdvancedBuchbergerLcmCriterionGraph;
   graph.clear();
   GraphBuilder builder(graph);
-  // This will be a tough nut to crack in terms of getting the types to match.
-  mBasis.monoLookup().divisors
-    (Monoid::toRef(BareMonoid::toOld(lcmAB)), builder);
+  // The lookup needs a monomial of monoid(), as in
+  // simpleBuchbergerLcmCriterion.
+  auto lcm = monoid().alloc();
+  monoid().copy(bareMonoid(), lcmAB, *lcm);
+  mBasis.monoLookup().divisors(*lcm, builder);
 
   if (graph.size() <= 3) {
     // For the graph approach to be better than the simpler approach of
@@ -696,13 +783,15 @@ void SPairs::QueueConfiguration::computePairData(
   MATHICGB_ASSERT(a < mBasis.size());
   MATHICGB_ASSERT(b < mBasis.size());
   if (mBasis.retired(a) || mBasis.retired(b)) {
-    // todo: do something special here?
-    return; //return false;
+    // The lead monomial of a retired element is gone. Retired S-pairs are
+    // discarded when they reach the top of the queue, so any fixed value
+    // will do.
+    orderMonoid().setIdentity(orderBy);
+    return;
   }
   Monoid::ConstMonoRef leadA = mBasis.leadMono(a);
   Monoid::ConstMonoRef leadB = mBasis.leadMono(b);
   orderMonoid().lcm(monoid(), leadA, monoid(), leadB, orderBy);
-  return; //todo: return true;
 }
 
 MATHICGB_NAMESPACE_END
@@ -85,6 +85,11 @@ public:
   const Monoid& monoid() const {return mMonoid;}
   const PolyBasis& basis() const {return mBasis;}
 
+  // addPairs(index) only looks at the S-pairs of index in parallel if there
+  // are at least this many of them. For fewer S-pairs, starting the tasks
+  // costs more than the parallelism saves. The result is the same either way.
+  void setParallelThreshold(size_t threshold) {mParallelThreshold = threshold;}
+
   size_t getMemoryUse() const;
 
   struct Stats {
@@ -143,6 +148,29 @@ private:
   // As the non-slow version, but uses simpler and slower code.
   bool simpleBuchbergerLcmCriterionSlow(size_t a, size_t b) const;
 
+  // Checks whether one of the basis elements in the Buchberger lcm hit
+  // cache for a and b shows that simpleBuchbergerLcmCriterion applies to
+  // (a,b). Returns that basis element, or -1 if there is none. Does not
+  // change anything, so several threads can call this at the same time.
+  class LcmCriterion;
+  size_t lcmHitCacheWitness(LcmCriterion& criterion) const;
+
+  // What addPairs() finds out about the S-pair (newGen, oldGen) before
+  // looking at the other S-pairs of newGen.
+  enum PairStatus {
+    OldGenRetired,
+    OtherComponent,
+    RelativelyPrime,
+    LcmCacheHit, // lcmHitCacheWitness found a witness
+    Undecided
+  };
+
+  // Returns the status of (newGen, oldGen), using lcm as space to compute
+  // lcm(newGen, oldGen) in. Does not change anything, so several threads
+  // can call this at the same time.
+  PairStatus pairStatus
+    (size_t newGen, size_t oldGen, BareMonoid::MonoRef lcm) const;
+
   // Improves on Buchberger's second criterion by using connection in a graph
   // to determine if an S-pair can be eliminated. This can eliminate some pairs
   // that cannot be eliminated by looking at any one triple of generators.
@@ -236,6 +264,8 @@ private:
   const PolyBasis& mBasis;
   mutable Stats mStats;
 
+  size_t mParallelThreshold;
+
   static const bool mUseBuchbergerLcmHitCache = true;
   mutable std::vector<size_t> mBuchbergerLcmHitCache;
 
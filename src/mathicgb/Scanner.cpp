@@ -7,6 +7,7 @@
 #include <limits>
 #include <sstream>
 #include <cstring>
+#include <algorithm>
 
 MATHICGB_NAMESPACE_BEGIN
 
@@ -36,7 +37,8 @@ Scanner::Scanner(FILE* input):
   mLineCount(1),
   mChar(' '),
   mBuffer(BufferSize),
-  mBufferPos(mBuffer.end())
+  mBufferPos(0),
+  mBufferEnd(0)
 {
   get();
 }
@@ -47,7 +49,8 @@ Scanner::Scanner(std::istream& input):
   mLineCount(1),
   mChar(' '),
   mBuffer(BufferSize),
-  mBufferPos(mBuffer.end())
+  mBufferPos(0),
+  mBufferEnd(0)
 {
   get();
 }
@@ -58,7 +61,8 @@ Scanner::Scanner(const char* const input):
   mLineCount(1),
   mChar(' '),
   mBuffer(input, input + std::strlen(input)),
-  mBufferPos(mBuffer.begin())
+  mBufferPos(mBuffer.data()),
+  mBufferEnd(mBuffer.data() + mBuffer.size())
 {
   get();
 }
@@ -69,11 +73,24 @@ Scanner::Scanner(const std::string& input):
   mLineCount(1),
   mChar(' '),
   mBuffer(input.begin(), input.end()),
-  mBufferPos(mBuffer.begin())
+  mBufferPos(mBuffer.data()),
+  mBufferEnd(mBuffer.data() + mBuffer.size())
 {
   get();
 }
 
+Scanner::Scanner(const char* const begin, const char* const end):
+  mFile(0),
+  mStream(0),
+  mLineCount(1),
+  mChar(' '),
+  mBufferPos(begin),
+  mBufferEnd(end)
+{
+  MATHICGB_ASSERT(begin <= end);
+  get();
+}
+
 bool Scanner::match(const char* const str) {
   eatWhite();
   MATHICGB_ASSERT(str != 0);
@@ -84,14 +101,14 @@ bool Scanner::match(const char* const str) {
     return true;
   if (peek() != *str)
     return false;
-  if (std::strncmp(&*mBufferPos, str + 1, size - 1) != 0)
+  if (std::strncmp(mBufferPos, str + 1, size - 1) != 0)
     return false;
   ignore(size);
   return true;
 }
 
 bool Scanner::ensureBuffer(size_t min) {
-  const auto got = size_t(std::distance(mBufferPos, mBuffer.end()) + 1);
+  const auto got = size_t(mBufferEnd - mBufferPos) + 1;
   return got >= min || readBuffer(min - got);
 }
 
@@ -125,6 +142,20 @@ void Scanner::expect(const char* str) {
   }
 }
 
+void Scanner::skipTo(const char* const pos) {
+  MATHICGB_ASSERT(inMemory());
+  MATHICGB_ASSERT(position() <= pos && pos <= mBufferEnd);
+  if (pos == position())
+    return;
+
+  // get() counts the newline of the character that it takes off, which
+  // is the character before mBufferPos, so the new mChar is not counted.
+  mLineCount += std::count(position(), pos, '\n');
+  mBufferPos = pos;
+  mChar = ' ';
+  get();
+}
+
 void Scanner::expectEOF() {
   eatWhite();
   if (get() != EOF)
@@ -167,9 +198,12 @@ void Scanner::reportErrorUnexpectedToken(
 }
 
 bool Scanner::readBuffer(size_t minRead) {
-  auto saveCount = std::distance(mBufferPos, mBuffer.end());
-  if (mBufferPos != mBuffer.begin() && mBufferPos != mBuffer.end())
-    std::copy(mBufferPos, mBuffer.end(), mBuffer.begin());
+  if (inMemory())
+    return false; // there is nothing more to read
+
+  const auto saveCount = size_t(mBufferEnd - mBufferPos);
+  if (saveCount != 0 && mBufferPos != mBuffer.data())
+    std::copy(mBufferPos, mBufferEnd, mBuffer.begin());
   mBuffer.resize(std::max(saveCount + minRead, mBuffer.capacity()));
   auto readInto = reinterpret_cast<char*>(mBuffer.data() + saveCount);
   auto readCount = mBuffer.size() - saveCount;
@@ -186,7 +220,8 @@ bool Scanner::readBuffer(size_t minRead) {
     didReadCount = static_cast<size_t>(mStream->gcount());
   }
   mBuffer.resize(saveCount + didReadCount);
-  mBufferPos = mBuffer.begin();
+  mBufferPos = mBuffer.data();
+  mBufferEnd = mBuffer.data() + mBuffer.size();
 
   return didReadCount >= minRead;
 }
@@ -55,6 +55,11 @@ public:
   /// Construct a Scanner object reading from the input string.
   Scanner(const std::string& input);
 
+  /// Construct a Scanner object reading from the characters in
+  /// [begin, end). The characters are not copied, so they must stay
+  /// valid while the Scanner is in use.
+  Scanner(const char* begin, const char* end);
+
   /// Reads a single character from the stream.
   int get();
 
@@ -106,7 +111,7 @@ public:
   bool matchReadIntegerNoSign(T& t, bool negate = false);
 
   /// Returns the next character or EOF. Does not skip whitespace.
-  int peek() {return mChar;}
+  int peek() const {return mChar;}
 
   /// Returns true if the next character is a digit. Does not skip
   /// whitespace.
@@ -129,6 +134,28 @@ public:
   /// Reads past any whitespace.
   inline void eatWhite();
 
+  /// Returns true if all of the input is in memory, which is the case
+  /// unless reading from a FILE* or std::istream. position(), inputEnd()
+  /// and skipTo() can only be used in that case.
+  bool inMemory() const {return mFile == 0 && mStream == 0;}
+
+  /// Returns a pointer to the next character, or inputEnd() if there
+  /// is no more input. Does not skip whitespace.
+  const char* position() const {
+    MATHICGB_ASSERT(inMemory());
+    return peek() == EOF ? mBufferEnd : mBufferPos - 1;
+  }
+
+  /// Returns a pointer to the end of the input.
+  const char* inputEnd() const {
+    MATHICGB_ASSERT(inMemory());
+    return mBufferEnd;
+  }
+
+  /// Skips past the input before pos, which must be in the range
+  /// [position(), inputEnd()]. The line count includes the lines skipped.
+  void skipTo(const char* pos);
+
   void reportError(std::string msg) const;
 
 private:
@@ -148,7 +175,12 @@ private:
   int mChar; // next character on stream
 
   std::vector<char> mBuffer;
-  std::vector<char>::iterator mBufferPos;
+
+  // The input from mBufferPos to mBufferEnd has not been read yet. This
+  // range is in mBuffer unless the input is a range of memory that
+  // was passed in.
+  const char* mBufferPos;
+  const char* mBufferEnd;
 };
 
 inline bool Scanner::matchEOF() {
@@ -188,7 +220,7 @@ inline int Scanner::get() {
   if (mChar == '\n')
     ++mLineCount;
   int oldChar = mChar;
-  if (mBufferPos == mBuffer.end() && !readBuffer(1))
+  if (mBufferPos == mBufferEnd && !readBuffer(1))
     mChar = EOF;
   else {
     mChar = *mBufferPos;
@@ -0,0 +1,302 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#include "stdinc.h"
+#include "SigMatrixReducer.hpp"
+
+#include "SigPolyBasis.hpp"
+#include "F4MatrixReducer.hpp"
+#include "MonoLookup.hpp"
+#include "Poly.hpp"
+#include "LogDomain.hpp"
+#include <mathic.h>
+#include <algorithm>
+#include <unordered_map>
+#include <limits>
+#include <stdexcept>
+
+MATHICGB_DEFINE_LOG_DOMAIN(
+  SigMatrixSizes,
+  "Displays row and column count for each signature matrix."
+);
+
+MATHICGB_NAMESPACE_BEGIN
+
+const size_t SigMatrixReducer::NoIndex;
+
+class SigMatrixReducer::ColumnMap {
+public:
+  ColumnMap(const Monoid& monoid): map(0, Hash(monoid), Equal(monoid)) {}
+
+  class Hash {
+  public:
+    Hash(const Monoid& monoid): mMonoid(&monoid) {}
+    size_t operator()(ConstMonoPtr mono) const {return mMonoid->hash(*mono);}
+  private:
+    const Monoid* mMonoid;
+  };
+
+  class Equal {
+  public:
+    Equal(const Monoid& monoid): mMonoid(&monoid) {}
+    bool operator()(ConstMonoPtr a, ConstMonoPtr b) const {
+      return mMonoid->equal(*a, *b);
+    }
+  private:
+    const Monoid* mMonoid;
+  };
+
+  std::unordered_map<ConstMonoPtr, ColIndex, Hash, Equal> map;
+};
+
+SigMatrixReducer::SigMatrixReducer(const PolyRing& ring):
+  mRing(ring),
+  mColumnMap(new ColumnMap(ring.monoid())),
+  mTmp(ring.monoid().alloc())
+{}
+
+SigMatrixReducer::~SigMatrixReducer() {
+  clear();
+}
+
+void SigMatrixReducer::reduce(
+  const std::vector<ConstMonoPtr>& sigs,
+  const std::vector<ConstMonoPtr>& multiples,
+  const std::vector<size_t>& basisElements,
+  const SigPolyBasis& basis,
+  std::vector<std::unique_ptr<Poly> >& reducedOut
+) {
+  MATHICGB_ASSERT(sigs.size() == multiples.size());
+  MATHICGB_ASSERT(sigs.size() == basisElements.size());
+  reducedOut.clear();
+  if (sigs.empty())
+    return;
+
+  clear();
+  for (size_t i = 0; i < sigs.size(); ++i) {
+    MATHICGB_ASSERT(i == 0 || monoid().lessThan(*sigs[i - 1], *sigs[i]));
+    addRow(*sigs[i], *multiples[i], basis.poly(basisElements[i]), i);
+  }
+  addReducerRows(*sigs.back(), basis);
+  sortColumns();
+  sortRows();
+
+  MATHICGB_LOG(SigMatrixSizes)
+    << "SigF4["
+    << mathic::ColumnPrinter::commafy(mRows.size())
+    << " by "
+    << mathic::ColumnPrinter::commafy(mColumns.size())
+    << "]" << std::endl;
+
+  reducedOut.resize(sigs.size());
+  reduceRows(reducedOut);
+  clear();
+}
+
+auto SigMatrixReducer::column(ConstMonoRef mono) -> ColIndex {
+  const auto it = mColumnMap->map.find(mono.ptr());
+  if (it != mColumnMap->map.end())
+    return it->second;
+
+  const auto col = mColumns.size();
+  mColumns.emplace_back(monoid().alloc());
+  monoid().copy(mono, *mColumns.back());
+  const auto& newMono = mColumns.back();
+  mColumnMap->map.emplace(newMono.ptr(), col);
+  mColumnsToDo.push_back(col);
+  return col;
+}
+
+void SigMatrixReducer::addRow(
+  ConstMonoRef sig,
+  ConstMonoRef multiple,
+  const Poly& poly,
+  const size_t input
+) {
+  mRows.emplace_back();
+  auto& row = mRows.back();
+  row.signature = monoid().alloc();
+  monoid().copy(sig, *row.signature);
+  row.input = input;
+  row.rank = 0;
+  row.cols.reserve(poly.termCount());
+  row.coefs.reserve(poly.termCount());
+  for (auto it = poly.begin(); it != poly.end(); ++it) {
+    monoid().multiply(multiple, it.mono(), *mTmp);
+    row.cols.push_back(column(*mTmp));
+    row.coefs.push_back(it.coef());
+  }
+}
+
+void SigMatrixReducer::addReducerRows(
+  ConstMonoRef maxSig,
+  const SigPolyBasis& basis
+) {
+  // Of the basis elements whose lead term divides a monomial, the one with
+  // the smallest sig/lead ratio gives the reducer of smallest signature.
+  // If that reducer is not regular for a row then no other basis element
+  // is either.
+  class MinRatio : public MonoLookup::EntryOutput {
+  public:
+    MinRatio(const SigPolyBasis& basis): mBasis(basis), mIndex(NoIndex) {}
+
+    virtual bool proceed(size_t index) {
+      if (mIndex != NoIndex) {
+        const auto cmp = mBasis.ratioCompare(index, mIndex);
+        if (cmp == GT || (cmp == EQ && index > mIndex))
+          return true;
+      }
+      mIndex = index;
+      return true;
+    }
+
+    size_t index() const {return mIndex;}
+
+  private:
+    const SigPolyBasis& mBasis;
+    size_t mIndex;
+  };
+
+  auto multiple = monoid().alloc();
+  auto sig = monoid().alloc();
+  while (!mColumnsToDo.empty()) {
+    const auto col = mColumnsToDo.back();
+    mColumnsToDo.pop_back();
+
+    MinRatio minRatio(basis);
+    basis.basis().monoLookup().divisors(*mColumns[col], minRatio);
+    const auto reducer = minRatio.index();
+    if (reducer == NoIndex)
+      continue;
+
+    monoid().divide(basis.leadMono(reducer), *mColumns[col], *multiple);
+    monoid().multiply(*multiple, basis.signature(reducer), *sig);
+    if (!monoid().lessThan(*sig, maxSig))
+      continue;
+    addRow(*sig, *multiple, basis.poly(reducer), NoIndex);
+  }
+}
+
+void SigMatrixReducer::sortColumns() {
+  const auto colCount = mColumns.size();
+  std::vector<ColIndex> order(colCount);
+  for (ColIndex col = 0; col < colCount; ++col)
+    order[col] = col;
+  const auto& monoid = this->monoid();
+  std::sort(order.begin(), order.end(), [&](ColIndex a, ColIndex b) {
+    return monoid.lessThan(*mColumns[b], *mColumns[a]);
+  });
+
+  std::vector<ColIndex> newIndex(colCount);
+  std::vector<Mono> sorted;
+  sorted.reserve(colCount);
+  for (ColIndex col = 0; col < colCount; ++col) {
+    newIndex[order[col]] = col;
+    sorted.emplace_back(std::move(mColumns[order[col]]));
+  }
+  mColumns.swap(sorted);
+  mColumnMap->map.clear();
+
+  for (auto& row : mRows) {
+    for (auto& col : row.cols)
+      col = newIndex[col];
+    MATHICGB_ASSERT(std::is_sorted(row.cols.begin(), row.cols.end()));
+  }
+}
+
+void SigMatrixReducer::sortRows() {
+  const auto rowCount = mRows.size();
+  std::vector<RowIndex> order(rowCount);
+  for (RowIndex row = 0; row < rowCount; ++row)
+    order[row] = row;
+  const auto& monoid = this->monoid();
+  std::stable_sort(order.begin(), order.end(), [&](RowIndex a, RowIndex b) {
+    return monoid.lessThan(*mRows[a].signature, *mRows[b].signature);
+  });
+
+  std::vector<Row> sorted;
+  sorted.reserve(rowCount);
+  for (RowIndex row = 0; row < rowCount; ++row) {
+    sorted.emplace_back(std::move(mRows[order[row]]));
+    auto& newRow = sorted.back();
+    if (row == 0)
+      newRow.rank = 0;
+    else {
+      const auto& prev = sorted[row - 1];
+      const bool sameSig = monoid.equal(*prev.signature, *newRow.signature);
+      newRow.rank = prev.rank + (sameSig ? 0 : 1);
+    }
+  }
+  mRows.swap(sorted);
+}
+
+void SigMatrixReducer::reduceRows(
+  std::vector<std::unique_ptr<Poly> >& reducedOut
+) {
+  const auto charac = ring().charac();
+  if (charac <= std::numeric_limits<uint8>::max())
+    reduceRows<uint8>(reducedOut);
+  else if (charac <= std::numeric_limits<uint16>::max())
+    reduceRows<uint16>(reducedOut);
+  else
+    reduceRows<uint32>(reducedOut);
+}
+
+template<class S>
+void SigMatrixReducer::reduceRows(
+  std::vector<std::unique_ptr<Poly> >& reducedOut
+) {
+  if (mColumns.size() > std::numeric_limits<SparseMatrix::ColIndex>::max())
+    throw std::overflow_error("Too many columns in signature matrix.");
+
+  const auto rowCount = mRows.size();
+  BasicSparseMatrix<S> matrix;
+  std::vector<size_t> ranks(rowCount);
+  std::vector<char> mustTopReduce(rowCount);
+  for (RowIndex r = 0; r < rowCount; ++r) {
+    const auto& row = mRows[r];
+    MATHICGB_ASSERT(!row.cols.empty());
+    for (size_t i = 0; i < row.cols.size(); ++i) {
+      MATHICGB_ASSERT(!ring().coefficientIsZero(row.coefs[i]));
+      matrix.appendEntry(
+        static_cast<SparseMatrix::ColIndex>(row.cols[i]),
+        static_cast<S>(row.coefs[i])
+      );
+    }
+    matrix.rowDone();
+    ranks[r] = row.rank;
+
+    // As for Reducer::regularReduce, a module term is singular if its
+    // lead term is not regular top reducible.
+    mustTopReduce[r] = row.input != NoIndex;
+  }
+
+  std::vector<char> singular;
+  const auto reduced = F4MatrixReducer(ring().charac())
+    .reduceByLowerRanks(matrix, ranks, mustTopReduce, singular);
+  MATHICGB_ASSERT(reduced.rowCount() == rowCount);
+
+  for (RowIndex r = 0; r < rowCount; ++r) {
+    const auto input = mRows[r].input;
+    if (input == NoIndex)
+      continue;
+    if (singular[r]) {
+      reducedOut[input] = nullptr;
+      continue;
+    }
+    auto poly = make_unique<Poly>(ring());
+    poly->reserve(reduced.entryCountInRow(r));
+    const auto end = reduced.rowEnd(r);
+    for (auto it = reduced.rowBegin(r); it != end; ++it)
+      poly->append(it.scalar(), *mColumns[it.index()]);
+    reducedOut[input] = std::move(poly);
+  }
+}
+
+void SigMatrixReducer::clear() {
+  mColumnMap->map.clear();
+  mColumns.clear();
+  mColumnsToDo.clear();
+  mRows.clear();
+}
+
+MATHICGB_NAMESPACE_END
@@ -0,0 +1,120 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#ifndef MATHICGB_SIG_MATRIX_REDUCER_GUARD
+#define MATHICGB_SIG_MATRIX_REDUCER_GUARD
+
+#include "PolyRing.hpp"
+#include <vector>
+#include <memory>
+
+MATHICGB_NAMESPACE_BEGIN
+
+class Poly;
+class SigPolyBasis;
+
+/// Regular reduces a set of module terms at once by putting them into one
+/// matrix, as in the matrix version of F5.
+///
+/// Each row of the matrix has a signature. There is a row for each module
+/// term to reduce and, for each column, a reducer row that is the multiple
+/// of a basis element with the smallest signature among those whose lead
+/// term divides the monomial of that column. The rows are reduced in
+/// increasing order of signature and a row is only ever reduced by rows
+/// with a strictly smaller signature, so every step is a regular
+/// reduction. The rows of module terms are also reduced by each other in
+/// this way, so the result for a signature takes into account the results
+/// for the smaller signatures in the set.
+class SigMatrixReducer {
+public:
+  typedef PolyRing::Monoid Monoid;
+  typedef Monoid::Mono Mono;
+  typedef Monoid::MonoRef MonoRef;
+  typedef Monoid::ConstMonoRef ConstMonoRef;
+  typedef Monoid::ConstMonoPtr ConstMonoPtr;
+
+  SigMatrixReducer(const PolyRing& ring);
+  ~SigMatrixReducer();
+
+  /// Implements Reducer::regularReduceSet. The results for the smaller
+  /// signatures are only used as reducers without a multiplier, since
+  /// they are not known when the matrix is built.
+  void reduce(
+    const std::vector<ConstMonoPtr>& sigs,
+    const std::vector<ConstMonoPtr>& multiples,
+    const std::vector<size_t>& basisElements,
+    const SigPolyBasis& basis,
+    std::vector<std::unique_ptr<Poly> >& reducedOut
+  );
+
+  const PolyRing& ring() const {return mRing;}
+  const Monoid& monoid() const {return mRing.monoid();}
+
+private:
+  typedef size_t ColIndex;
+  typedef size_t RowIndex;
+  static const size_t NoIndex = static_cast<size_t>(-1);
+
+  struct Row {
+    Mono signature;
+
+    /// The index of the module term of this row or NoIndex for a reducer
+    /// row.
+    size_t input;
+
+    /// Rows with the same rank have the same signature, and a row may only
+    /// be reduced by rows of a smaller rank.
+    size_t rank;
+
+    std::vector<ColIndex> cols;
+    std::vector<coefficient> coefs;
+  };
+
+  /// Returns the column of mono, making a new column if necessary.
+  ColIndex column(ConstMonoRef mono);
+
+  /// Appends a row for multiple * poly with signature sig.
+  void addRow(
+    ConstMonoRef sig,
+    ConstMonoRef multiple,
+    const Poly& poly,
+    size_t input
+  );
+
+  /// Adds a reducer row for each column that does not have one, including
+  /// the columns of the reducer rows added. Reducer rows whose signature
+  /// is not less than maxSig are left out since they cannot reduce any
+  /// of the module terms.
+  void addReducerRows(ConstMonoRef maxSig, const SigPolyBasis& basis);
+
+  /// Renumbers the columns in decreasing order of monomial, so that the
+  /// entries of each row are in increasing order of column.
+  void sortColumns();
+
+  /// Sorts the rows in increasing order of signature and sets their ranks.
+  void sortRows();
+
+  /// Reduces the rows in order and returns the results for the module
+  /// terms. The reduction is done by F4MatrixReducer::reduceByLowerRanks
+  /// with the ranks of the rows, using scalars of type S.
+  void reduceRows(std::vector<std::unique_ptr<Poly> >& reducedOut);
+  template<class S>
+  void reduceRows(std::vector<std::unique_ptr<Poly> >& reducedOut);
+
+  void clear();
+
+  const PolyRing& mRing;
+
+  std::vector<Mono> mColumns;
+  std::vector<ColIndex> mColumnsToDo;
+
+  /// Maps a monomial to its column. Hashing through the monoid keeps this
+  /// independent of the representation of the monomials.
+  class ColumnMap;
+  std::unique_ptr<ColumnMap> mColumnMap;
+
+  std::vector<Row> mRows;
+  Mono mTmp;
+};
+
+MATHICGB_NAMESPACE_END
+#endif
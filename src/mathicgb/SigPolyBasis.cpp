@@ -6,7 +6,6 @@
 #include "Poly.hpp"
 #include "MathicIO.hpp"
 #include <mathic.h>
-#include <limits>
 #include <iostream>
 #include <iomanip>
 
@@ -20,7 +19,7 @@ SigPolyBasis::SigPolyBasis(
 ):
   mMonoLookupFactory
     (MonoLookup::makeFactory(R0.monoid(), monoLookupType)),
-  mRatioSorted(RatioOrder(mSigLeadRatio, R0.monoid())),
+  mRatioRanks(mSigLeadRatio, R0.monoid()),
   mMinimalMonoLookup(mMonoLookupFactory->make(preferSparseReducers, true)),
   mBasis(R0, mMonoLookupFactory->make(preferSparseReducers, true)),
   mPreferSparseReducers(preferSparseReducers)
@@ -85,84 +84,8 @@ void SigPolyBasis::insert(Mono ownedSig, std::unique_ptr<Poly> f) {
     mBasis.minimalLeadCount() == mMinimalMonoLookup->size());
   MATHICGB_ASSERT(mSignatures.size() == index + 1);
   MATHICGB_ASSERT(mBasis.size() == index + 1);
-  if (!mUseRatioRank)
-    return;
-
-  // compute rank of the ratio
-  auto pos = mRatioSorted.insert(index);
-again:
-  Rank prevRank;
-  if (pos == mRatioSorted.begin())
-    prevRank = 0;
-  else {
-    auto prev = pos;
-    --prev;
-    prevRank = mRatioRanks[*prev];
-    if (monoid().equal(ratio, *mSigLeadRatio[*prev])) {
-      mRatioRanks.push_back(prevRank);
-      return;
-    }
-  }
-
-  Rank nextRank;
-  auto next = pos;
-  ++next;
-  if (next == mRatioSorted.end())
-    nextRank = std::numeric_limits<Rank>::max();
-  else {
-    nextRank = mRatioRanks[*next];
-    if (monoid().equal(ratio, *mSigLeadRatio[*next])) {
-      mRatioRanks.push_back(nextRank);
-      return;
-    }
-  }
-  MATHICGB_ASSERT(prevRank < nextRank);
-
-  // this formula avoids the overflow inherent in prevRank + nextRank;
-  Rank rank = prevRank + (nextRank - prevRank) / 2;
-
-  // must have at least 1 space between ranks to support
-  // queries for non-basis element rank
-  if (rank == 0 || // must leave space for smaller ratio
-    rank == std::numeric_limits<Rank>::max() || // shouldn't happen
-    nextRank - prevRank < 4) { // 4 as require: prev, gap, new, gap, next
-    // size plus 1 to account for the gaps at the beginning and end.
-    size_t increment = std::numeric_limits<Rank>::max() / (mSignatures.size() + 1);
-    if (increment == 0)
-      increment = 2;
-    MATHICGB_ASSERT(!mRatioSorted.empty());
-    size_t rankSum = increment; // leave a gap at beginning
-    Rank prevRank = *mRatioRanks.begin();
-    auto end = mRatioSorted.end();
-    for (auto it = mRatioSorted.begin(); it != end; ++it) {
-      if (it == pos)
-        continue;
-      if (mRatioRanks[*it] != prevRank)
-        rankSum += increment;
-      prevRank = mRatioRanks[*it];
-      mRatioRanks[*it] = rankSum;
-    }
-    goto again;
-  }
-  MATHICGB_ASSERT(rank > 0);
-  MATHICGB_ASSERT(rank < std::numeric_limits<Rank>::max());
-  MATHICGB_ASSERT(prevRank + 1 < rank && rank < nextRank - 1);
-  mRatioRanks.push_back(rank);
-  MATHICGB_ASSERT(mRatioRanks.size() == index + 1);
-
-#ifdef MATHICGB_DEBUG
-    // Check that at least one space has been left between every rank
-    MATHICGB_ASSERT(mRatioRanks[*mRatioSorted.begin()] > 0);
-    MATHICGB_ASSERT(mRatioRanks[*mRatioSorted.rbegin()] <
-      std::numeric_limits<Rank>::max());
-    auto it2 = mRatioSorted.begin();
-    for (++it2; it2 != mRatioSorted.end(); ++it2) {
-      auto prev = it2;
-      --prev;
-      MATHICGB_ASSERT(mRatioRanks[*it2] == mRatioRanks[*prev] ||
-        mRatioRanks[*it2] - 1 > mRatioRanks[*prev]);
-    }
-#endif
+  if (mUseRatioRank)
+    mRatioRanks.insert();
 }
 
 size_t SigPolyBasis::regularReducer(
@@ -188,6 +111,14 @@ size_t SigPolyBasis::regularReducer(
   return reducer;
 }
 
+size_t SigPolyBasis::regularReducer(
+  ConstMonoRef sig,
+  ConstMonoRef term,
+  Monoid::MonoPool& pool
+) const {
+  return monoLookup().regularReducer(sig, term, pool);
+}
+
 size_t SigPolyBasis::regularReducerSlow(
   ConstMonoRef sig,
   ConstMonoRef term
@@ -429,66 +360,28 @@ size_t SigPolyBasis::getMemoryUse() const
   total += mBasis.getMemoryUse();
   total += mSignatures.capacity() * sizeof(mSignatures.front());
   total += mSigLeadRatio.capacity() * sizeof(mSigLeadRatio.front());
-  total += mRatioRanks.capacity() * sizeof(mRatioRanks.front());
+  total += mRatioRanks.getMemoryUse();
   total += monoLookup().getMemoryUse();
   total += mMinimalMonoLookup->getMemoryUse();
 
-  // This is an estimate of how much memory mRatioSorted uses per item.
-  // It is based on assuming a tree representation with a left pointer,
-  // a right pointer and a data member for each node. This is probably
-  // an underestimate.
-  const size_t perItemOverhead =
-    2 * sizeof(void*) + sizeof(*mRatioSorted.begin());
-  total += mRatioSorted.size() * perItemOverhead;
-
   return total;
 }
 
-size_t SigPolyBasis::ratioRank(ConstMonoRef ratio) const {
-  MATHICGB_ASSERT(mUseRatioRank);
-  const size_t index = size();
-  if (index == 0)
-    return 0; // any value will do as there is nothing to compare to
-  auto& sigLeadRatioNonConst =
-    const_cast<std::vector<MonoPtr>&>(mSigLeadRatio);
-
-  sigLeadRatioNonConst.push_back(ratio.castAwayConst());
-  auto pos = mRatioSorted.lower_bound(index);
-  sigLeadRatioNonConst.pop_back();
-
-  if (pos == mRatioSorted.end()) {
-    MATHICGB_ASSERT
-      (ratioRank(*mRatioSorted.rbegin()) < std::numeric_limits<Rank>::max());
-    return std::numeric_limits<Rank>::max();
-  } else {
-    if (monoid().equal(ratio, sigLeadRatio(*pos)))
-      return ratioRank(*pos);
-    MATHICGB_ASSERT(ratioRank(*pos) > 0);
-#ifdef MATHICGB_DEBUG
-    if (pos != mRatioSorted.begin()) {
-      auto prev = pos;
-      --prev;
-      MATHICGB_ASSERT(ratioRank(*pos) - 1 > ratioRank(*prev));
-    }
-#endif
-    return ratioRank(*pos) - 1;
-  }
-}
-
 SigPolyBasis::StoredRatioCmp::StoredRatioCmp(
   ConstMonoRef numerator,
   ConstMonoRef denominator,
-  const SigPolyBasis& basis
+  const SigPolyBasis& basis,
+  Monoid::MonoPool* pool
 ):
   mBasis(basis),
-  mRatio(basis.monoid().alloc())
+  mRatio(pool == nullptr ? basis.monoid().alloc() : pool->alloc())
 {
   const auto& monoid = basis.ring().monoid();
   monoid.divideToNegative(denominator, numerator, mRatio);
-  if (SigPolyBasis::mUseRatioRank)
+  if (SigPolyBasis::mUseStoredRatioRank)
     mRatioRank = basis.ratioRank(*mRatio);
   else
-    mTmp = mBasis.monoid().alloc();
+    mTmp = pool == nullptr ? mBasis.monoid().alloc() : pool->alloc();
 }
 
 MATHICGB_NAMESPACE_END
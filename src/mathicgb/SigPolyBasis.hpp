@@ -8,8 +8,8 @@
 #include "MonoLookup.hpp"
 #include "PolyBasis.hpp"
 #include "MonoProcessor.hpp"
+#include "RatioRanks.hpp"
 #include <vector>
-#include <set>
 
 MATHICGB_NAMESPACE_BEGIN
 
@@ -84,6 +84,15 @@ public:
   // and (term / leadTerm(u)) * signature(u) < sig.
   size_t regularReducer(ConstMonoRef sig, ConstMonoRef term) const;
 
+  // As regularReducer(sig, term), but can be called on several threads at
+  // the same time as long as the basis does not change. Temporary monomials
+  // are taken from pool, which must belong to the calling thread.
+  size_t regularReducer(
+    ConstMonoRef sig,
+    ConstMonoRef term,
+    Monoid::MonoPool& pool
+  ) const;
+
   // Uses the functionality in the divisor finder for
   // computing up to maxDivisors low ratio base divisors.
   // The divisors are placed into divisors.
@@ -125,11 +134,14 @@ public:
   class StoredRatioCmp {
   public:
     // Stores the ratio numerator/denominator and prepares it for comparing
-    // to the sig/lead ratios in basis.
+    // to the sig/lead ratios in basis. If pool is not null, the monomials
+    // are taken from pool instead of from the monoid. That makes it safe to
+    // compare on several threads at the same time.
     StoredRatioCmp(
       ConstMonoRef numerator,
       ConstMonoRef denominator,
-      const SigPolyBasis& basis);
+      const SigPolyBasis& basis,
+      Monoid::MonoPool* pool = nullptr);
 
     // compares the stored ratio to the basis element with index be.
     inline int compare(size_t be) const;
@@ -139,7 +151,7 @@ public:
     void operator=(const StoredRatioCmp&); // not available
 
     const SigPolyBasis& mBasis;
-    size_t mRatioRank;
+    RatioRanks::Rank mRatioRank;
     Mono mRatio;
     mutable Mono mTmp;
   };
@@ -162,15 +174,17 @@ private:
   std::unique_ptr<MonoLookup::Factory const> const mMonoLookupFactory;
 
   /// The ratio rank can change at each insert!
-  size_t ratioRank(size_t index) const {
-    MATHICGB_ASSERT(index < size());
-    return mRatioRanks[index];
+  RatioRanks::Rank ratioRank(size_t index) const {
+    return mRatioRanks.rank(index);
   }
 
   // Only useful for comparing to basis elements. Two ratios might get the same
   // rank without being equal. All ranks can change when a new generator
   // is added.
-  size_t ratioRank(ConstMonoRef ratio) const;
+  RatioRanks::Rank ratioRank(ConstMonoRef ratio) const {
+    MATHICGB_ASSERT(mUseRatioRank);
+    return mRatioRanks.rank(ratio);
+  }
 
   std::vector<MonoPtr> mSignatures;
 
@@ -182,24 +196,7 @@ private:
   static const bool mUseRatioRank = MATHICGB_USE_RATIO_RANK;
   static const bool mUseStoredRatioRank = MATHICGB_USE_RATIO_RANK;
 
-  class RatioOrder {
-  public:
-    RatioOrder(std::vector<MonoPtr>& ratio, const Monoid& monoid):
-      mRatio(ratio), mMonoid(monoid) {}
-
-    bool operator()(size_t a, size_t b) const {
-      return mMonoid.lessThan(*mRatio[a], *mRatio[b]);
-    }
-
-  private:
-    std::vector<MonoPtr>& mRatio;
-    const Monoid& mMonoid;
-  };
-
-  typedef std::multiset<size_t, RatioOrder> RatioSorted;
-  typedef size_t Rank;
-  RatioSorted mRatioSorted;
-  std::vector<Rank> mRatioRanks;
+  RatioRanks mRatioRanks;
 
   std::vector<MonoLookup*> mSignatureLookup;
 
@@ -217,10 +214,10 @@ inline int SigPolyBasis::ratioCompare(size_t a, size_t b) const {
     int const value =
       monoid().compare(sigLeadRatio(a), sigLeadRatio(b));
 #endif
-    if (mRatioRanks[a] < mRatioRanks[b]) {
+    if (ratioRank(a) < ratioRank(b)) {
       MATHICGB_ASSERT_NO_ASSUME(value == LT);
       return LT;
-    } else if (mRatioRanks[a] > mRatioRanks[b]) {
+    } else if (ratioRank(a) > ratioRank(b)) {
       MATHICGB_ASSERT_NO_ASSUME(value == GT);
       return GT;
     } else {
@@ -245,7 +242,7 @@ inline int SigPolyBasis::StoredRatioCmp::compare(size_t be) const {
     const auto value =
       mBasis.monoid().compare(*mRatio, mBasis.sigLeadRatio(be));
 #endif
-    SigPolyBasis::Rank otherRank = mBasis.ratioRank(be);
+    const auto otherRank = mBasis.ratioRank(be);
     if (mRatioRank < otherRank) {
       MATHICGB_ASSERT_NO_ASSUME(value == LT);
       return LT;
@@ -55,21 +55,29 @@ namespace {
 class ConcreteSigSPairQueue : public SigSPairQueue {
 public:
   ConcreteSigSPairQueue(SigPolyBasis const& basis):
-  mPairQueue(Configuration(basis)) {}
+    mSigA(basis.ring().monoid().alloc()),
+    mSigB(basis.ring().monoid().alloc()),
+    mPairQueue(Configuration(basis, *mSigA, *mSigB)) {}
 
   virtual Mono popSignature(Pairs& pairs) {
     pairs.clear();
     if (mPairQueue.empty())
       return 0;
+    const auto& conf = mPairQueue.configuration();
     auto sig = monoid().alloc();
-    monoid().copy(*mPairQueue.topPairData(), *sig);
-    do {
-      pairs.push_back(mPairQueue.topPair());
+    const auto degree = mPairQueue.topPairData();
+    auto top = mPairQueue.topPair();
+    conf.signature(top.first, top.second, *sig);
+    while (true) {
+      pairs.push_back(top);
       mPairQueue.pop();
-    } while (
-      !mPairQueue.empty() &&
-      monoid().equal(*mPairQueue.topPairData(), *sig)
-    );
+      if (mPairQueue.empty() || mPairQueue.topPairData() != degree)
+        break;
+      top = mPairQueue.topPair();
+      conf.signature(top.first, top.second, *mSigA);
+      if (!monoid().equal(*mSigA, *sig))
+        break;
+    }
     return sig;
   }
 
@@ -79,8 +87,8 @@ public:
       auto tmp = monoid().alloc();
       for (size_t i = 0; i < pairs.size(); ++i) {
         MATHICGB_ASSERT(pairs[i].i < columnCount());
-        mPairQueue.configuration().computePairData
-          (columnCount(), pairs[i].i, tmp.ptr());
+        mPairQueue.configuration().signature
+          (columnCount(), pairs[i].i, *tmp);
         MATHICGB_ASSERT(monoid().equal(*tmp, *pairs[i].signature));
       }
     }
@@ -115,12 +123,27 @@ private:
   void operator=(const ConcreteSigSPairQueue&); // not available
 
   // Configuration of mathic::PairTriangle for use with signature queues.
+  //
+  // Only the degree of the signature of each S-pair is stored in the
+  // queue. The signatures are computed again when two S-pairs of the same
+  // degree have to be compared. This keeps the memory use of the queue
+  // independent of the number of variables.
   class Configuration {
   public:
-    Configuration(SigPolyBasis const& basis): mBasis(basis) {}
+    Configuration(SigPolyBasis const& basis, MonoRef sigA, MonoRef sigB):
+      mBasis(basis), mSigA(sigA.ptr()), mSigB(sigB.ptr()) {}
+
+    typedef Monoid::Exponent PairData;
+    void computePairData(size_t col, size_t row, PairData& degree) const {
+      if (monoid().gradingCount() == 0) {
+        degree = 0;
+        return;
+      }
+      signature(col, row, *mSigA);
+      degree = monoid().degree(*mSigA);
+    }
 
-    typedef MonoPtr PairData;
-    void computePairData(size_t col, size_t row, PairData sig) {
+    void signature(size_t col, size_t row, MonoRef sig) const {
       MATHICGB_ASSERT(mBasis.ratioCompare(col, row) != EQ);
       // ensure that ratio(col) > ratio(row)
       if (mBasis.ratioCompare(col, row) == LT)
@@ -129,14 +152,19 @@ private:
         mBasis.leadMono(col),
         mBasis.leadMono(row),
         mBasis.signature(col),
-        *sig
+        sig
       );
     }
 
     typedef bool CompareResult;
     bool compare(int colA, int rowA, PairData a,
                  int colB, int rowB, PairData b) const {
-      return mBasis.ring().monoid().lessThan(*b, *a);
+      const auto cmp = monoid().compareDegrees(a, b);
+      if (cmp != EQ)
+        return cmp == GT;
+      signature(colA, rowA, *mSigA);
+      signature(colB, rowB, *mSigB);
+      return monoid().lessThan(*mSigB, *mSigA);
     }
     bool cmpLessThan(bool v) const {return v;}
 
@@ -146,6 +174,10 @@ private:
 
   private:
     SigPolyBasis const& mBasis;
+
+    // Space to compute signatures in.
+    const MonoPtr mSigA;
+    const MonoPtr mSigB;
   };
 
   // the compiler should be able to resolve these accessors into a direct
@@ -157,6 +189,8 @@ private:
   const PolyRing& ring() const {return basis().ring();}
   const Monoid& monoid() const {return ring().monoid();}
 
+  Mono mSigA;
+  Mono mSigB;
   mathic::PairQueue<Configuration> mPairQueue;
   friend struct
   mathic::PairQueueNamespace::ConstructPairDataFunction<Configuration>;
@@ -187,8 +221,7 @@ namespace mathic {
         MATHICGB_ASSERT(memory != 0);
         MATHICGB_ASSERT(col > row);
         auto pd = new (memory)
-          mgb::ConcreteSigSPairQueue::Configuration::PairData
-          (conf.basis().ring().allocMonomial());
+          mgb::ConcreteSigSPairQueue::Configuration::PairData();
         conf.computePairData(col, row, *pd);
       }
     };
@@ -205,7 +238,6 @@ namespace mathic {
       ) {
         MATHICGB_ASSERT(pd != nullptr);
         MATHICGB_ASSERT(col > row);
-        conf.monoid().freeRaw(*pd);
       }
     };
   }
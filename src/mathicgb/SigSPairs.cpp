@@ -230,18 +230,19 @@ void SigSPairs::makePreSPairs(size_t newGen)
       monoid().colonMultiply(oldLead, newLead, oldSig, pairSig);
     }
 
+    // Nothing is inserted into Hsyz here if Koszul syzygies are
+    // postponed, so then the signatures of all the pairs are checked
+    // against Hsyz at once after this loop.
+    if (mPostponeKoszuls) {
+      result.signature = pairSig;
+      pairSig = R->allocMonomial();
+      result.i = static_cast<BigIndex>(oldGen);
+      mIndexSigs.push_back(result);
+      continue;
+    }
+
     if (Hsyz->member(pairSig)) {
-      ++mStats.syzygyModuleHits;
-#ifdef DEBUG
-      // Check if actually already elim. by low/high base divisor.
-      // Only check in DEBUG mode as otherwise we would have taken an early
-      // exit before getting here.
-      if ((mUseBaseDivisors || mUseHighBaseDivisors) &&
-        mKnownSyzygyTri.bit(newGen, oldGen))
-        --mStats.syzygyModuleHits;
-#endif
-      if (mUseBaseDivisors || mUseHighBaseDivisors)
-        mKnownSyzygyTri.setBit(newGen, oldGen, true);
+      syzygyModuleHit(newGen, oldGen);
       continue;
     }
     MATHICGB_ASSERT((!mUseBaseDivisors && !mUseHighBaseDivisors)
@@ -262,17 +263,8 @@ void SigSPairs::makePreSPairs(size_t newGen)
       }
     }
 
-    if (mUseSingularCriterionEarly) {
-      MATHICGB_ASSERT(cmp == GT || cmp == LT);
-      size_t const givesSig = (cmp == GT ? newGen : oldGen);    
-      if (
-        GB->ratioCompare(GB->minimalLeadInSig(pairSig), givesSig) == GT &&
-        !monoid().relativelyPrime(newLead, oldLead)
-      ) {
-        ++mStats.earlySingularCriterionPairs;
-        continue;
-      }
-    }
+    if (singularCriterionEarly(newGen, oldGen, pairSig))
+      continue;
 
     // construct the PreSPair
     result.signature = pairSig;
@@ -282,12 +274,80 @@ void SigSPairs::makePreSPairs(size_t newGen)
     ++mStats.queuedPairs;
   }
   R->freeMonomial(pairSig);
+  if (mPostponeKoszuls)
+    removeSyzygySignatures(newGen);
   if (mUseBaseDivisors && ! baseDivisorMonomial.isNull())
     R->freeMonomial(baseDivisorMonomial);
   if (!mPostponeKoszuls)
     R->freeMonomial(hsyz);
 }
 
+void SigSPairs::removeSyzygySignatures(size_t newGen) {
+  const auto pairCount = mIndexSigs.size();
+  std::vector<ConstMonoPtr> sigs(pairCount);
+  for (size_t i = 0; i < pairCount; ++i)
+    sigs[i] = mIndexSigs[i].signature;
+  std::vector<bool> isSyzygy;
+  Hsyz->memberSet(sigs, isSyzygy);
+
+  size_t kept = 0;
+  for (size_t i = 0; i < pairCount; ++i) {
+    const auto pair = mIndexSigs[i];
+    const size_t oldGen = pair.i;
+    if (isSyzygy[i]) {
+      syzygyModuleHit(newGen, oldGen);
+      monoid().freeRaw(pair.signature);
+      continue;
+    }
+    MATHICGB_ASSERT((!mUseBaseDivisors && !mUseHighBaseDivisors)
+      || !mKnownSyzygyTri.bit(newGen, oldGen));
+
+    if (singularCriterionEarly(newGen, oldGen, *pair.signature)) {
+      monoid().freeRaw(pair.signature);
+      continue;
+    }
+
+    mIndexSigs[kept] = pair;
+    ++kept;
+    ++mStats.queuedPairs;
+  }
+  mIndexSigs.resize(kept);
+}
+
+void SigSPairs::syzygyModuleHit(size_t newGen, size_t oldGen) {
+  ++mStats.syzygyModuleHits;
+#ifdef DEBUG
+  // Check if actually already elim. by low/high base divisor.
+  // Only check in DEBUG mode as otherwise we would have taken an early
+  // exit before getting here.
+  if ((mUseBaseDivisors || mUseHighBaseDivisors) &&
+    mKnownSyzygyTri.bit(newGen, oldGen))
+    --mStats.syzygyModuleHits;
+#endif
+  if (mUseBaseDivisors || mUseHighBaseDivisors)
+    mKnownSyzygyTri.setBit(newGen, oldGen, true);
+}
+
+bool SigSPairs::singularCriterionEarly(
+  size_t newGen,
+  size_t oldGen,
+  ConstMonoRef pairSig
+) {
+  if (!mUseSingularCriterionEarly)
+    return false;
+  const auto cmp = GB->ratioCompare(newGen, oldGen);
+  MATHICGB_ASSERT(cmp == GT || cmp == LT);
+  size_t const givesSig = (cmp == GT ? newGen : oldGen);
+  if (
+    GB->ratioCompare(GB->minimalLeadInSig(pairSig), givesSig) == GT &&
+    !monoid().relativelyPrime(GB->leadMono(newGen), GB->leadMono(oldGen))
+  ) {
+    ++mStats.earlySingularCriterionPairs;
+    return true;
+  }
+  return false;
+}
+
 void SigSPairs::setKnownSyzygies(std::vector<std::pair<size_t, size_t> >& pairs) {
   if (!mUseBaseDivisors && !mUseHighBaseDivisors)
     return;
@@ -94,6 +94,22 @@ public:
 private:
   void makePreSPairs(size_t newGen);
 
+  /// Removes the pairs in mIndexSigs whose signatures are in Hsyz, checking
+  /// all of them in one call to ModuleMonoSet::memberSet. Also applies the
+  /// early singular criterion to the remaining pairs.
+  void removeSyzygySignatures(size_t newGen);
+
+  /// Records that the signature of the pair (newGen, oldGen) is in Hsyz.
+  void syzygyModuleHit(size_t newGen, size_t oldGen);
+
+  /// Returns true if the early singular criterion is on and eliminates the
+  /// pair (newGen, oldGen) with signature pairSig.
+  bool singularCriterionEarly(
+    size_t newGen,
+    size_t oldGen,
+    ConstMonoRef pairSig
+  );
+
   struct BaseDivisor { // a low ratio base divisor
     size_t baseDivisor; // the index of the generator that is the base divisor
     size_t ratioLessThan; // consider generators with ratio less than this
@@ -39,6 +39,7 @@ SignatureGB::SignatureGB(
 ):
   mBreakAfter(0),
   mPrintInterval(0),
+  mSignatureSetSize(0),
   R(basis.getPolyRing()),
   mPostponeKoszul(postponeKoszul),
   mUseBaseDivisors(useBaseDivisors),
@@ -48,6 +49,7 @@ SignatureGB::SignatureGB(
   stats_SignatureCriterionLate(0),
   stats_relativelyPrimeEliminated(0),
   stats_pairsReduced(0),
+  stats_signaturesPutBack(0),
   stats_nsecs(0.0),
   GB(make_unique<SigPolyBasis>(*R, divlookup_type, montable_type, preferSparseReducers)),
   mKoszuls(R->monoid()),
@@ -90,7 +92,7 @@ void SignatureGB::computeGrobnerBasis()
   mTimer.reset();
   std::ostream& out = std::cout;
 
-  while (step()) {
+  while (signatureSetSize() > 1 ? stepSet() : step()) {
     if (mBreakAfter > 0 && GB->size() > mBreakAfter) {
       break;
       const size_t pairs = SP->pairCount();
@@ -158,6 +160,14 @@ bool SignatureGB::processSPair
 
   R->freeMonomial(multiple);
 
+  return reduced(std::move(sig), std::move(f), mSpairTmp);
+}
+
+bool SignatureGB::reduced(
+  Mono sig,
+  std::unique_ptr<Poly> f,
+  SigSPairs::PairContainer& pairs
+) {
   if (f == nullptr) { // singular reduction
     MATHICGB_LOG(SigSPairFinal) << "   eliminated by singular criterion.\n";
     return true;
@@ -167,7 +177,7 @@ bool SignatureGB::processSPair
     // todo: what are the correct ownership relations here?
     auto ptr = sig.release();
     Hsyz->insert(*ptr);
-    SP->setKnownSyzygies(mSpairTmp);
+    SP->setKnownSyzygies(pairs);
     MATHICGB_LOG(SigSPairFinal) << "   s-reduced to zero.\n";
     return false;
   }
@@ -190,7 +200,7 @@ bool SignatureGB::processSPair
 }
 
 bool SignatureGB::step() {
-  auto sig = SP->popSignature(mSpairTmp);
+  auto sig = popSignature(mSpairTmp);
   if (sig.isNull())
     return false;
   ++stats_sPairSignaturesDone;
@@ -202,30 +212,215 @@ bool SignatureGB::step() {
     stream << '\n';
   };
 
+  if (lateCriteria(sig, mSpairTmp))
+    return true;
+
+#ifdef DEBUG
+  for (auto it = mSpairTmp.begin(); it != mSpairTmp.end(); ++it) {
+    auto a = GB->leadMono(it->first);
+    auto b = GB->leadMono(it->second);
+    MATHICGB_ASSERT(!monoid().relativelyPrime(a, b));
+  }
+#endif
+
+  // Reduce the pair
+  ++stats_pairsReduced;
+  if (processSPair(std::move(sig), mSpairTmp))
+    queueKoszuls(mSpairTmp);
+  return true;
+}
+
+unsigned int SignatureGB::signatureSetSize() const {
+  return mSignatureSetSize != 0 ?
+    mSignatureSetSize : reducer->preferredSetSize();
+}
+
+bool SignatureGB::stepSet() {
+  const size_t maxSetSize = signatureSetSize();
+  const bool graded = monoid().gradingCount() > 0;
+
+  // Take the signatures of the next degree. The signature criterion is
+  // applied right away so that those signatures do not take up space in
+  // the matrix.
+  std::vector<PendingSignature> set;
+  bool empty = true;
+  while (set.size() < maxSetSize) {
+    auto sig = popSignature(mSpairTmp);
+    if (sig.isNull())
+      break;
+    empty = false;
+    if (
+      !set.empty() &&
+      graded &&
+      monoid().degree(*sig) != monoid().degree(*set.front().sig)
+    ) {
+      pushPending(std::move(sig), mSpairTmp);
+      break;
+    }
+    if (Hsyz->member(*sig)) {
+      ++stats_sPairSignaturesDone;
+      stats_sPairsDone += mSpairTmp.size();
+      lateCriteria(sig, mSpairTmp);
+      continue;
+    }
+    set.emplace_back();
+    set.back().sig = std::move(sig);
+    set.back().pairs.swap(mSpairTmp);
+  }
+  if (set.empty())
+    return !empty;
+
+  // Regular reduce the whole set at once.
+  std::vector<ConstMonoPtr> sigs;
+  std::vector<Mono> multiples;
+  std::vector<ConstMonoPtr> multiplePtrs;
+  std::vector<size_t> gens;
+  for (const auto& entry : set) {
+    const auto gen = GB->minimalLeadInSig(*entry.sig);
+    MATHICGB_ASSERT(gen != static_cast<size_t>(-1));
+    auto multiple = monoid().alloc();
+    monoid().divide(GB->signature(gen), *entry.sig, *multiple);
+    GB->basis().usedAsStart(gen);
+
+    sigs.push_back(entry.sig);
+    multiplePtrs.push_back(multiple);
+    multiples.emplace_back(std::move(multiple));
+    gens.push_back(gen);
+  }
+  std::vector<std::unique_ptr<Poly> > reducedSet;
+  reducer->regularReduceSet(sigs, multiplePtrs, gens, *GB, reducedSet);
+  MATHICGB_ASSERT(reducedSet.size() == set.size());
+
+  // Commit the results in order as long as they are what step() would get.
+  auto lead = monoid().alloc();
+  for (size_t i = 0; i < set.size(); ++i) {
+    auto& entry = set[i];
+    auto& f = reducedSet[i];
+
+    // S-pairs of the elements added so far can come before entry.sig. They
+    // can also have signature entry.sig, in which case they have to be
+    // processed together with the S-pairs of entry, as popSignature() does.
+    // A result can also be regular top reducible by a multiple of an
+    // element added so far, since the reducer does not have to take those
+    // into account.
+    bool putBack =
+      !mPending.empty() &&
+      !monoid().lessThan(*entry.sig, *mPending.back().sig);
+    if (!putBack && f == nullptr) {
+      monoid().multiply(*multiples[i], GB->leadMono(gens[i]), *lead);
+      putBack = GB->regularReducer(*entry.sig, *lead) !=
+        static_cast<size_t>(-1);
+    }
+    if (!putBack && f != nullptr && !f->isZero())
+      putBack = GB->regularReducer(*entry.sig, f->leadMono()) !=
+        static_cast<size_t>(-1);
+    if (putBack) {
+      for (size_t j = i; j < set.size(); ++j) {
+        ++stats_signaturesPutBack;
+        pushPending(std::move(set[j].sig), set[j].pairs);
+      }
+      break;
+    }
+
+    ++stats_sPairSignaturesDone;
+    stats_sPairsDone += entry.pairs.size();
+
+    MATHICGB_IF_STREAM_LOG(SigSPairFinal) {
+      stream << "Final processing of signature ";
+      R->monomialDisplay(stream, Monoid::toOld(*entry.sig));
+      stream << '\n';
+    };
+
+    if (lateCriteria(entry.sig, entry.pairs))
+      continue;
+
+    ++stats_pairsReduced;
+    const auto newElement = f != nullptr && !f->isZero();
+    if (!reduced(std::move(entry.sig), std::move(f), entry.pairs))
+      continue;
+    queueKoszuls(entry.pairs);
+
+    // Take out the smallest signature so that the check above can see if
+    // any of the new S-pairs come before the next signature of the set.
+    if (newElement) {
+      auto next = SP->popSignature(mSpairTmp);
+      if (!next.isNull())
+        pushPending(std::move(next), mSpairTmp);
+    }
+  }
+  return true;
+}
+
+auto SignatureGB::popSignature(SigSPairs::PairContainer& pairs) -> Mono {
+  auto sig = SP->popSignature(pairs);
+  if (mPending.empty())
+    return sig;
+  if (!sig.isNull()) {
+    const auto cmp = monoid().compare(*sig, *mPending.back().sig);
+    if (cmp == LT)
+      return sig;
+    if (cmp == EQ) {
+      const auto& more = mPending.back().pairs;
+      pairs.insert(pairs.end(), more.begin(), more.end());
+      mPending.pop_back();
+      return sig;
+    }
+    pushPending(std::move(sig), pairs);
+  }
+  sig = std::move(mPending.back().sig);
+  pairs.clear();
+  pairs.swap(mPending.back().pairs);
+  mPending.pop_back();
+  return sig;
+}
+
+void SignatureGB::pushPending(Mono sig, SigSPairs::PairContainer& pairs) {
+  auto it = mPending.begin();
+  for (; it != mPending.end(); ++it) {
+    const auto cmp = monoid().compare(*sig, *it->sig);
+    if (cmp == EQ) {
+      it->pairs.insert(it->pairs.end(), pairs.begin(), pairs.end());
+      pairs.clear();
+      return;
+    }
+    if (cmp == GT)
+      break;
+  }
+  PendingSignature pending;
+  pending.sig = std::move(sig);
+  pending.pairs.swap(pairs);
+  pairs.clear();
+  mPending.insert(it, std::move(pending));
+}
+
+bool SignatureGB::lateCriteria(
+  Mono& sig,
+  SigSPairs::PairContainer& pairs
+) {
   if (Hsyz->member(*sig)) {
     ++stats_SignatureCriterionLate;
-    SP->setKnownSyzygies(mSpairTmp);
+    SP->setKnownSyzygies(pairs);
     MATHICGB_LOG(SigSPairFinal) << "   eliminated by signature criterion.\n";
     return true;
   }
 
   while (!mKoszuls.empty() && R->monoid().lessThan(mKoszuls.top(), *sig))
     mKoszuls.pop();
-  
+
   if (!mKoszuls.empty() && R->monoid().equal(mKoszuls.top(), *sig)) {
     ++stats_koszulEliminated;
     // This signature is of a syzygy that is not in Hsyz, so add it
     // todo: what are the correct ownership relations here?
     auto ptr = sig.release();
     Hsyz->insert(*ptr);
-    SP->setKnownSyzygies(mSpairTmp);
+    SP->setKnownSyzygies(pairs);
     MATHICGB_LOG(SigSPairFinal) << "   eliminated by Koszul criterion.\n";
     return true;
   }
 
   if (mPostponeKoszul) {
     // Relatively prime check
-    for (auto it = mSpairTmp.begin(); it != mSpairTmp.end(); ++it) {
+    for (auto it = pairs.begin(); it != pairs.end(); ++it) {
       auto a = GB->leadMono(it->first);
       auto b = GB->leadMono(it->second);
       if (monoid().relativelyPrime(a, b)) {
@@ -233,32 +428,26 @@ bool SignatureGB::step() {
         // todo: what are the correct ownership relations here?
         auto ptr = sig.release();
         Hsyz->insert(*ptr);
-        SP->setKnownSyzygies(mSpairTmp);
+        SP->setKnownSyzygies(pairs);
         MATHICGB_LOG(SigSPairFinal) <<
           "   eliminated by relatively prime criterion.\n";
         return true;
       }
     }
   }
-#ifdef DEBUG
-  for (auto it = mSpairTmp.begin(); it != mSpairTmp.end(); ++it) {
-    auto a = GB->leadMono(it->first);
-    auto b = GB->leadMono(it->second);
-    MATHICGB_ASSERT(!monoid().relativelyPrime(a, b));
-  }
-#endif
+  return false;
+}
 
-  // Reduce the pair
-  ++stats_pairsReduced;
-  if (!processSPair(std::move(sig), mSpairTmp) || !mPostponeKoszul)
-    return true;
-  for (auto it = mSpairTmp.begin(); it != mSpairTmp.end(); ++it) {
+void SignatureGB::queueKoszuls(const SigSPairs::PairContainer& pairs) {
+  if (!mPostponeKoszul)
+    return;
+  for (auto it = pairs.begin(); it != pairs.end(); ++it) {
     std::pair<size_t, size_t> p = *it;
     if (GB->ratioCompare(p.first, p.second) == LT)
       std::swap(p.first, p.second);
 
     auto greaterSig = GB->signature(p.first);
-    auto smallerLead = GB->leadMono(p.second);   
+    auto smallerLead = GB->leadMono(p.second);
     monomial koszul = R->allocMonomial();
     monoid().multiply(greaterSig, smallerLead, koszul);
     if (Hsyz->member(koszul))
@@ -266,7 +455,6 @@ bool SignatureGB::step() {
     else
       mKoszuls.push(koszul);
   }
-  return true;
 }
 
 size_t SignatureGB::getMemoryUse() const {
@@ -559,6 +747,14 @@ void SignatureGB::displaySomeStats(std::ostream& out) const {
   extra << mic::ColumnPrinter::oneDecimal(perSig)
     << " spairs per signature\n";
 
+  if (stats_signaturesPutBack > 0) {
+    const size_t putBack = stats_signaturesPutBack;
+    name << "S pair sigs put back:\n";
+    value << mic::ColumnPrinter::commafy(putBack) << '\n';
+    extra << mic::ColumnPrinter::percentInteger(putBack, sigsDone)
+      << " of sigs done\n";
+  }
+
   //Reducer::Stats reducerStats = reducer->sigStats();
 
   /*const unsigned long long reductions = reducerStats.reductions;
@@ -59,11 +59,26 @@ public:
     mPrintInterval = reductions;
   }
 
+  /// Sets how many signatures of the same degree to regular reduce at one
+  /// time. With a reducer that is not matrix-based, the signatures of a set
+  /// are reduced in parallel. A value of 0 indicates to use
+  /// Reducer::preferredSetSize(), and a value of 1 processes one signature
+  /// at a time.
+  void setSignatureSetSize(unsigned int setSize) {
+    mSignatureSetSize = setSize;
+  }
+
+  /// Returns the number of distinct S-pair signatures processed so far.
+  size_t signaturesDone() const {return stats_sPairSignaturesDone;}
+
   const Monoid& monoid() const {return R->monoid();}
 
 private:
   unsigned int mBreakAfter;
   unsigned int mPrintInterval;
+  unsigned int mSignatureSetSize;
+
+  unsigned int signatureSetSize() const;
 
 
 
@@ -71,6 +86,38 @@ private:
   bool processSPair(Mono sig, const SigSPairs::PairContainer& pairs);
   bool step();
 
+  /// As step(), but regular reduces the signatures of the next degree
+  /// together through Reducer::regularReduceSet, up to
+  /// signatureSetSize() signatures at a time. The results are
+  /// committed in increasing order of signature. The first result that
+  /// would not be what step() gets, because a result before it can reduce
+  /// it or has S-pairs of a smaller or equal signature, is put back into
+  /// mPending along with all the signatures after it.
+  bool stepSet();
+
+  /// Returns the smallest signature of SP and mPending along with its
+  /// S-pairs in pairs. Returns null if both are empty.
+  Mono popSignature(SigSPairs::PairContainer& pairs);
+
+  /// Puts sig and its S-pairs into mPending. Clears pairs.
+  void pushPending(Mono sig, SigSPairs::PairContainer& pairs);
+
+  /// Applies the signature, Koszul and, if Koszul syzygies are postponed,
+  /// the relatively prime criterion to sig. Returns true if sig is
+  /// eliminated, in which case sig may have been moved into Hsyz.
+  bool lateCriteria(Mono& sig, SigSPairs::PairContainer& pairs);
+
+  /// Records f as the result of regular reducing sig, where null means a
+  /// singular reduction. Returns false if f is zero.
+  bool reduced(
+    Mono sig,
+    std::unique_ptr<Poly> f,
+    SigSPairs::PairContainer& pairs
+  );
+
+  /// Queues the Koszul syzygies of pairs, if Koszul syzygies are postponed.
+  void queueKoszuls(const SigSPairs::PairContainer& pairs);
+
   const PolyRing *R;
 
   bool const mPostponeKoszul;
@@ -80,6 +127,16 @@ private:
 
   SigSPairs::PairContainer mSpairTmp; // use only for getting S-pairs
 
+  struct PendingSignature {
+    Mono sig;
+    SigSPairs::PairContainer pairs;
+  };
+
+  /// Signatures taken out of SP that have not been processed yet, in
+  /// decreasing order so that the smallest one is at the back. Only
+  /// stepSet() puts signatures here.
+  std::vector<PendingSignature> mPending;
+
   // stats //////////
   size_t stats_sPairSignaturesDone; // distinct S-pair signatures done
   size_t stats_sPairsDone; // total S-pairs done
@@ -90,6 +147,7 @@ private:
   size_t stats_relativelyPrimeEliminated;
 
   size_t stats_pairsReduced; // # spairs actually sent for reduction
+  size_t stats_signaturesPutBack; // # signatures put back by stepSet()
 
   mic::Timer mTimer;
   double stats_nsecs;
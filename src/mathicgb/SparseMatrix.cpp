@@ -8,7 +8,8 @@
 
 MATHICGB_NAMESPACE_BEGIN
 
-void SparseMatrix::takeRowsFrom(SparseMatrix&& matrix) {
+template<class S>
+void BasicSparseMatrix<S>::takeRowsFrom(BasicSparseMatrix&& matrix) {
   if (matrix.mRows.empty())
     return;
 
@@ -31,7 +32,8 @@ void SparseMatrix::takeRowsFrom(SparseMatrix&& matrix) {
   matrix.clear();
 }
 
-void SparseMatrix::rowToPolynomial(
+template<class S>
+void BasicSparseMatrix<S>::rowToPolynomial(
   const RowIndex row,
   const std::vector<PolyRing::Monoid::ConstMonoPtr>& colMonomials,
   Poly& poly
@@ -47,8 +49,9 @@ void SparseMatrix::rowToPolynomial(
   MATHICGB_ASSERT(poly.termsAreInDescendingOrder());
 }
 
-void SparseMatrix::sortRowsByIncreasingPivots() {
-  SparseMatrix ordered;
+template<class S>
+void BasicSparseMatrix<S>::sortRowsByIncreasingPivots() {
+  BasicSparseMatrix ordered;
   const auto rowCount = this->rowCount();
 
   std::vector<RowIndex> rows(rowCount);
@@ -79,7 +82,35 @@ void SparseMatrix::sortRowsByIncreasingPivots() {
   *this = std::move(ordered);
 }
 
-void SparseMatrix::applyColumnMap(const std::vector<ColIndex>& colMap) {
+template<class S>
+void BasicSparseMatrix<S>::permuteRows(const std::vector<RowIndex>& order) {
+  MATHICGB_ASSERT(order.size() == rowCount());
+  if (mRows.empty())
+    return;
+  MATHICGB_ASSERT(mBlock.mHasNoRows ?
+    mBlock.mColIndices.empty() :
+    mRows.back().mIndicesEnd == mBlock.mColIndices.end());
+
+  std::vector<Row> permuted(order.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    MATHICGB_ASSERT(order[i] < rowCount());
+    permuted[i] = mRows[order[i]];
+  }
+  mRows.swap(permuted);
+
+  // rowDone() takes the start of a new row to be the end of the last row,
+  // which is no longer true if the last row moved. So we retire the current
+  // block and start new rows in a fresh one.
+  if (!mBlock.mHasNoRows) {
+    const auto oldBlock = new Block(std::move(mBlock));
+    mBlock.mPreviousBlock = oldBlock;
+  }
+}
+
+template<class S>
+void BasicSparseMatrix<S>::applyColumnMap(
+  const std::vector<ColIndex>& colMap
+) {
   MATHICGB_ASSERT(colMap.size() >= computeColCount());
   Block* block = &mBlock;
   for (; block != 0; block = block->mPreviousBlock) {
@@ -89,7 +120,8 @@ void SparseMatrix::applyColumnMap(const std::vector<ColIndex>& colMap) {
   }
 }
 
-void SparseMatrix::multiplyRow(
+template<class S>
+void BasicSparseMatrix<S>::multiplyRow(
   const RowIndex row,
   const Scalar multiplier,
   const Scalar modulus
@@ -100,19 +132,21 @@ void SparseMatrix::multiplyRow(
     it.setScalar(modularProduct(it.scalar(), multiplier, modulus));
 }
 
-void SparseMatrix::print(std::ostream& out) const {
+template<class S>
+void BasicSparseMatrix<S>::print(std::ostream& out) const {
   if (rowCount() == 0)
     out << "matrix with no rows\n";
   for (RowIndex row = 0; row < rowCount(); ++row) {
     out << row << ':';
     const auto end = rowEnd(row);
     for (auto it = rowBegin(row); it != end; ++it)
-      out << ' ' << it.index() << '#' << it.scalar();
+      out << ' ' << it.index() << '#' << static_cast<uint32>(it.scalar());
     out << '\n';
   }
 }
 
-void SparseMatrix::printStatistics(std::ostream& out) const {
+template<class S>
+void BasicSparseMatrix<S>::printStatistics(std::ostream& out) const {
   typedef mathic::ColumnPrinter ColPr;
 
   ColPr pr;
@@ -143,14 +177,16 @@ void SparseMatrix::printStatistics(std::ostream& out) const {
   out << '\n' << pr << "\n";
 }
 
-std::string SparseMatrix::toString() const {
+template<class S>
+std::string BasicSparseMatrix<S>::toString() const {
   std::ostringstream out;
   print(out);
   return out.str();
 }
 
-void SparseMatrix::appendRowAndNormalize(
-  const SparseMatrix& matrix,
+template<class S>
+void BasicSparseMatrix<S>::appendRowAndNormalize(
+  const BasicSparseMatrix& matrix,
   const RowIndex row,
   const Scalar modulus
 ) {
@@ -164,9 +200,7 @@ void SparseMatrix::appendRowAndNormalize(
     if (it != end) {
       const Scalar inverse = modularInverse(lead, modulus);
       do {
-        const uint32 prod = static_cast<uint32>(inverse) * it.scalar();
-        const uint16 prodMod = static_cast<uint16>(prod % modulus);
-        appendEntry(it.index(), prodMod);
+        appendEntry(it.index(), modularProduct(inverse, it.scalar(), modulus));
         ++it;
       } while (it != end);
     }
@@ -174,7 +208,11 @@ void SparseMatrix::appendRowAndNormalize(
   rowDone();
 }
 
-void SparseMatrix::appendRow(const SparseMatrix& matrix, const RowIndex row) {
+template<class S>
+void BasicSparseMatrix<S>::appendRow(
+  const BasicSparseMatrix& matrix,
+  const RowIndex row
+) {
   MATHICGB_ASSERT(row < matrix.rowCount()); 
 
   const auto size = matrix.entryCountInRow(row);
@@ -189,7 +227,10 @@ void SparseMatrix::appendRow(const SparseMatrix& matrix, const RowIndex row) {
   rowDone();
 }
   
-SparseMatrix& SparseMatrix::operator=(const SparseMatrix& matrix) {
+template<class S>
+auto BasicSparseMatrix<S>::operator=(
+  const BasicSparseMatrix& matrix
+) -> BasicSparseMatrix& {
   // todo: use copy-swap or copy-move.
   clear();
   mMemoryQuantum = matrix.mMemoryQuantum;
@@ -201,14 +242,16 @@ SparseMatrix& SparseMatrix::operator=(const SparseMatrix& matrix) {
   return *this;
 }
 
-void SparseMatrix::swap(SparseMatrix& matrix) {
+template<class S>
+void BasicSparseMatrix<S>::swap(BasicSparseMatrix& matrix) {
   mBlock.swap(matrix.mBlock);
   using std::swap;
   swap(mRows, matrix.mRows);
   swap(mMemoryQuantum, matrix.mMemoryQuantum);
 }
 
-bool SparseMatrix::operator==(const SparseMatrix& matrix) const {
+template<class S>
+bool BasicSparseMatrix<S>::operator==(const BasicSparseMatrix& matrix) const {
   const auto count = rowCount();
   if (count != matrix.rowCount())
     return false;
@@ -225,7 +268,8 @@ bool SparseMatrix::operator==(const SparseMatrix& matrix) const {
   return true;
 }
 
-SparseMatrix::ColIndex SparseMatrix::computeColCount() const {
+template<class S>
+auto BasicSparseMatrix<S>::computeColCount() const -> ColIndex {
   // Obviously this can be done faster, but there has not been a need for that
   // so far.
   ColIndex colCount = 0;
@@ -237,7 +281,8 @@ SparseMatrix::ColIndex SparseMatrix::computeColCount() const {
   return colCount;
 }
 
-void SparseMatrix::clear() {
+template<class S>
+void BasicSparseMatrix<S>::clear() {
   Block* block = &mBlock;
   while (block != 0) {
     delete[] block->mColIndices.releaseMemory();
@@ -252,7 +297,8 @@ void SparseMatrix::clear() {
   mRows.clear();
 }
 
-void SparseMatrix::appendRowWithModulus(
+template<class S>
+void BasicSparseMatrix<S>::appendRowWithModulus(
   std::vector<uint64> const& v,
   const Scalar modulus
 ) {
@@ -265,11 +311,12 @@ void SparseMatrix::appendRowWithModulus(
   rowDone();
 }
 
-void SparseMatrix::appendRowWithModulusNormalized(
+template<class S>
+void BasicSparseMatrix<S>::appendRowWithModulusNormalized(
   std::vector<uint64> const& v,
   const Scalar modulus
 ) {
-  uint16 multiply = 1; 
+  Scalar multiply = 1;
   bool first = true;
   const auto count = static_cast<ColIndex>(v.size());
   for (ColIndex col = 0; col < count; ++col) {
@@ -280,16 +327,15 @@ void SparseMatrix::appendRowWithModulusNormalized(
       multiply = modularInverse(scalar, modulus);
       scalar = 1;
       first = false;
-    } else {
-      uint32 prod = static_cast<uint32>(multiply) * scalar;
-      scalar = prod % modulus;
-    }
+    } else
+      scalar = modularProduct(multiply, scalar, modulus);
     appendEntry(col, scalar);
   }
   rowDone();
 }
 
-bool SparseMatrix::appendRowWithModulusIfNonZero(
+template<class S>
+bool BasicSparseMatrix<S>::appendRowWithModulusIfNonZero(
   std::vector<uint64> const& v,
   const Scalar modulus
 ) {
@@ -302,7 +348,10 @@ bool SparseMatrix::appendRowWithModulusIfNonZero(
     return true;
 }
 
-void SparseMatrix::trimLeadingZeroColumns(const ColIndex trimThisMany) {
+template<class S>
+void BasicSparseMatrix<S>::trimLeadingZeroColumns(
+  const ColIndex trimThisMany
+) {
   Block* block = &mBlock;
   for (; block != 0; block = block->mPreviousBlock) {
     const auto end = block->mColIndices.end();
@@ -313,7 +362,8 @@ void SparseMatrix::trimLeadingZeroColumns(const ColIndex trimThisMany) {
   }
 }
 
-void SparseMatrix::reserveFreeEntries(const size_t freeCount) {
+template<class S>
+void BasicSparseMatrix<S>::reserveFreeEntries(const size_t freeCount) {
   if (freeCount <= mBlock.mColIndices.capacity() - mBlock.mColIndices.size())
     return;
   // We need to copy over the pending entries, so we need space for those
@@ -350,7 +400,11 @@ void SparseMatrix::reserveFreeEntries(const size_t freeCount) {
       (oldBlock->mColIndices.begin(), oldBlock->mColIndices.end());
     mBlock.mScalars.rawAssign
       (oldBlock->mScalars.begin(), oldBlock->mScalars.end());
-    delete oldBlock; // no reason to keep it around
+    // no reason to keep it around, but keep the blocks before it.
+    mBlock.mPreviousBlock = oldBlock->mPreviousBlock;
+    delete[] oldBlock->mColIndices.releaseMemory();
+    delete[] oldBlock->mScalars.releaseMemory();
+    delete oldBlock;
   } else {
     mBlock.mColIndices.rawAssign
       (mRows.back().mIndicesEnd, oldBlock->mColIndices.end());
@@ -367,7 +421,8 @@ void SparseMatrix::reserveFreeEntries(const size_t freeCount) {
   }
 }
 
-void SparseMatrix::growEntryCapacity() {
+template<class S>
+void BasicSparseMatrix<S>::growEntryCapacity() {
   MATHICGB_ASSERT(mBlock.mColIndices.size() == mBlock.mScalars.size());
   MATHICGB_ASSERT(mBlock.mColIndices.capacity() == mBlock.mScalars.capacity());
   MATHICGB_ASSERT(mBlock.mColIndices.size() <= mBlock.mColIndices.capacity());
@@ -390,14 +445,16 @@ void SparseMatrix::growEntryCapacity() {
   MATHICGB_ASSERT(mBlock.mColIndices.size() == mBlock.mScalars.size());
 }
 
-float SparseMatrix::computeDensity() const {
+template<class S>
+float BasicSparseMatrix<S>::computeDensity() const {
   const auto rowCount = static_cast<float>(this->rowCount());
   const auto colCount = static_cast<float>(computeColCount());
   const auto entryCount = static_cast<float>(this->entryCount());
   return entryCount / (rowCount * colCount);
 }
 
-size_t SparseMatrix::entryCount() const {
+template<class S>
+size_t BasicSparseMatrix<S>::entryCount() const {
   size_t count = 0;
   const Block* block = &mBlock;
   for (; block != 0; block = block->mPreviousBlock)
@@ -405,33 +462,32 @@ size_t SparseMatrix::entryCount() const {
   return count;
 }
 
-size_t SparseMatrix::memoryUse() const {
+template<class S>
+size_t BasicSparseMatrix<S>::memoryUse() const {
   size_t count = 0;
   for (auto block = &mBlock; block != 0; block = block->mPreviousBlock)
     count += block->memoryUse() + sizeof(Block);
   return count;
 }
 
-size_t SparseMatrix::memoryUseTrimmed() const {
+template<class S>
+size_t BasicSparseMatrix<S>::memoryUseTrimmed() const {
   size_t count = 0;
   for (auto block = &mBlock; block != 0; block = block->mPreviousBlock)
     count += block->memoryUseTrimmed() + sizeof(Block);
   return count;
 }
 
-size_t SparseMatrix::Block::memoryUse() const {
+template<class S>
+size_t BasicSparseMatrix<S>::Block::memoryUse() const {
   return mColIndices.memoryUse() + mScalars.memoryUse();
 }
 
-size_t SparseMatrix::Block::memoryUseTrimmed() const {
+template<class S>
+size_t BasicSparseMatrix<S>::Block::memoryUseTrimmed() const {
   return mColIndices.memoryUseTrimmed() + mScalars.memoryUseTrimmed();
 }
 
-std::ostream& operator<<(std::ostream& out, const SparseMatrix& matrix) {
-  matrix.print(out);
-  return out;
-}
-
 namespace {
   template<class T>
   T readOne(FILE* file) {
@@ -463,9 +519,37 @@ namespace {
       mathic::reportError("error while reading file.");
   }
 
+  /// Scalars are stored in files as uint16 unless the modulus does not fit
+  /// in 16 bits, in which case they are stored as uint32. So the file format
+  /// does not depend on the scalar type of the matrix that wrote it.
+  bool fileScalarsAre32Bit(const uint32 modulus) {
+    return modulus > std::numeric_limits<uint16>::max();
+  }
+
+  template<class Stored, class Matrix>
+  void writeScalars(const Matrix& matrix, FILE* file) {
+    std::vector<Stored> scalars;
+    const auto rowCount = matrix.rowCount();
+    for (typename Matrix::RowIndex row = 0; row < rowCount; ++row) {
+      scalars.clear();
+      const auto end = matrix.rowEnd(row);
+      for (auto it = matrix.rowBegin(row); it != end; ++it)
+        scalars.push_back(static_cast<Stored>(it.scalar()));
+      writeMany(scalars, file);
+    }
+  }
+
+  template<class Stored, class Scalar>
+  void readScalars(FILE* file, const size_t count, Scalar* out) {
+    std::vector<Stored> scalars;
+    readMany(file, count, scalars);
+    for (auto it = scalars.begin(); it != scalars.end(); ++it, ++out)
+      *out = static_cast<Scalar>(*it);
+  }
 }
 
-void SparseMatrix::write(const Scalar modulus, FILE* file) const {
+template<class S>
+void BasicSparseMatrix<S>::write(const Scalar modulus, FILE* file) const {
   const auto storedRowCount = rowCount();
 
   writeOne(static_cast<uint32>(storedRowCount), file);
@@ -474,26 +558,26 @@ void SparseMatrix::write(const Scalar modulus, FILE* file) const {
   writeOne(static_cast<uint64>(entryCount()), file);
 
   // write scalars
-  for (SparseMatrix::RowIndex row = 0; row < storedRowCount; ++row) {
-    const auto count = entryCountInRow(row);
-    if (fwrite(&rowBegin(row).scalar(), sizeof(uint16), count, file) != count)
-      mathic::reportError("error while writing to file.");
-  }
+  if (fileScalarsAre32Bit(modulus))
+    writeScalars<uint32>(*this, file);
+  else
+    writeScalars<uint16>(*this, file);
 
   // write indices
-  for (SparseMatrix::RowIndex row = 0; row < storedRowCount; ++row) {
+  for (RowIndex row = 0; row < storedRowCount; ++row) {
     const auto count = entryCountInRow(row);
     if (fwrite(&rowBegin(row).index(), sizeof(uint32), count, file) != count)
       mathic::reportError("error while writing to file.");
   }
 
   std::vector<uint32> entryCounts;
-  for (SparseMatrix::RowIndex row = 0; row < storedRowCount; ++row)
+  for (RowIndex row = 0; row < storedRowCount; ++row)
     entryCounts.push_back(entryCountInRow(row));
   writeMany<uint32>(entryCounts, file);
 }
 
-SparseMatrix::Scalar SparseMatrix::read(FILE* file) {
+template<class S>
+auto BasicSparseMatrix<S>::read(FILE* file) -> Scalar {
   MATHICGB_ASSERT(file != 0);
 
   const auto rowCount = readOne<uint32>(file);
@@ -503,6 +587,8 @@ SparseMatrix::Scalar SparseMatrix::read(FILE* file) {
   if (entryCount64 > std::numeric_limits<size_t>::max())
     throw std::bad_alloc();
   const auto entryCount = static_cast<size_t>(entryCount64);
+  if (modulus > std::numeric_limits<Scalar>::max())
+    mathic::reportError("modulus in file is too large for this matrix type.");
 
   // Allocate memory to hold the matrix in one block.
   clear();
@@ -515,9 +601,10 @@ SparseMatrix::Scalar SparseMatrix::read(FILE* file) {
   // Read scalars.
   {
     mBlock.mScalars.resize(entryCount);
-    std::vector<uint16> scalars;
-    readMany(file, entryCount, scalars);
-    std::copy(scalars.begin(), scalars.end(), mBlock.mScalars.begin());
+    if (fileScalarsAre32Bit(modulus))
+      readScalars<uint32>(file, entryCount, mBlock.mScalars.begin());
+    else
+      readScalars<uint16>(file, entryCount, mBlock.mScalars.begin());
   }
 
   // Read column indices.
@@ -546,10 +633,11 @@ SparseMatrix::Scalar SparseMatrix::read(FILE* file) {
   }
 
   MATHICGB_ASSERT(mBlock.mPreviousBlock == 0); // still only one block
-  return modulus;
+  return static_cast<Scalar>(modulus);
 }
 
-void SparseMatrix::writePBM(FILE* file) {
+template<class S>
+void BasicSparseMatrix<S>::writePBM(FILE* file) {
   // See http://netpbm.sourceforge.net/doc/pbm.html
 
   const auto rowCount = this->rowCount();
@@ -590,7 +678,8 @@ void SparseMatrix::writePBM(FILE* file) {
   }
 }
 
-bool SparseMatrix::debugAssertValid() const {
+template<class S>
+bool BasicSparseMatrix<S>::debugAssertValid() const {
   for (RowIndex row = 0; row < rowCount(); ++row) {
     for (auto it = rowBegin(row); it != rowEnd(row); ++it) {
       // A scalar of 0 is not necessarily bad, it is just not expected
@@ -602,4 +691,8 @@ bool SparseMatrix::debugAssertValid() const {
   return true;
 }
 
+template class BasicSparseMatrix<uint8>;
+template class BasicSparseMatrix<uint16>;
+template class BasicSparseMatrix<uint32>;
+
 MATHICGB_NAMESPACE_END
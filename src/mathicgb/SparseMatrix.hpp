@@ -40,48 +40,51 @@ calling rowDone.
 There is no special treatment of entries whose scalar is zero. For
 example they still count as entries in relation to entryCount().
 
-Currently this is not a template class so you can get by without
-using the typedefs offered, for example using uint16 instead of
-SparseMatrix::Scalar. Please use the typedefs to make it easier to
-support a wider range of types of matrices in future.
+The scalar type S is a template parameter so that the scalars can be
+stored in the narrowest unsigned type that can hold every residue
+modulo the characteristic. Use BasicSparseMatrix<S>::Scalar rather
+than naming the type directly. SparseMatrix is the uint16 version that
+most of the code base uses. The member functions are instantiated
+explicitly in SparseMatrix.cpp for uint8, uint16 and uint32.
 */
-class SparseMatrix {
+template<class S>
+class BasicSparseMatrix {
 public:
   typedef uint32 RowIndex;
   typedef uint32 ColIndex;
-  typedef uint16 Scalar;
+  typedef S Scalar;
   class ConstRowIterator;
   class RowIterator;
 
   /// Construct a matrix with no rows.
-  SparseMatrix(const size_t memoryQuantum = 0):
+  BasicSparseMatrix(const size_t memoryQuantum = 0):
     mMemoryQuantum(memoryQuantum)
   {}
 
-  SparseMatrix(SparseMatrix&& matrix):
+  BasicSparseMatrix(BasicSparseMatrix&& matrix):
     mRows(std::move(matrix.mRows)),
     mBlock(std::move(matrix.mBlock)),
     mMemoryQuantum(matrix.mMemoryQuantum)
   {
   }
 
-  SparseMatrix& operator=(SparseMatrix&& matrix) {
-    this->~SparseMatrix();
-    new (this) SparseMatrix(std::move(matrix));
+  BasicSparseMatrix& operator=(BasicSparseMatrix&& matrix) {
+    this->~BasicSparseMatrix();
+    new (this) BasicSparseMatrix(std::move(matrix));
     return *this;
   }
 
-  SparseMatrix(const SparseMatrix& matrix) {
+  BasicSparseMatrix(const BasicSparseMatrix& matrix) {
     *this = matrix;
   }
 
-  ~SparseMatrix() {clear();}
+  ~BasicSparseMatrix() {clear();}
 
-  SparseMatrix& operator=(const SparseMatrix&);
-  void swap(SparseMatrix& matrix);
+  BasicSparseMatrix& operator=(const BasicSparseMatrix&);
+  void swap(BasicSparseMatrix& matrix);
 
-  bool operator==(const SparseMatrix& matrix) const;
-  bool operator!=(const SparseMatrix& matrix) const {
+  bool operator==(const BasicSparseMatrix& matrix) const;
+  bool operator!=(const BasicSparseMatrix& matrix) const {
     return !(*this == matrix);
   }
 
@@ -91,7 +94,7 @@ public:
   /// Appends the rows from matrix to this object. Avoids most of the copies
   /// that would otherwise be required for a big matrix insert by taking
   /// the memory out of matrix.
-  void takeRowsFrom(SparseMatrix&& matrix);
+  void takeRowsFrom(BasicSparseMatrix&& matrix);
 
   RowIndex rowCount() const {return static_cast<RowIndex>(mRows.size());}
   ColIndex computeColCount() const;
@@ -218,9 +221,13 @@ public:
     MATHICGB_ASSERT(mBlock.mColIndices.size() == mBlock.mScalars.size());
   }
 
-  void appendRowAndNormalize(const SparseMatrix& matrix, RowIndex row, Scalar modulus);
+  void appendRowAndNormalize(
+    const BasicSparseMatrix& matrix,
+    RowIndex row,
+    Scalar modulus
+  );
   
-  void appendRow(const SparseMatrix& matrix, RowIndex row);
+  void appendRow(const BasicSparseMatrix& matrix, RowIndex row);
 
   void appendRowWithModulus(const std::vector<uint64>& v, Scalar modulus);
   
@@ -249,6 +256,13 @@ public:
   /// slow and it makes a copy internally.
   void sortRowsByIncreasingPivots();
 
+  /// Reorders the rows so that row i becomes the row that had index
+  /// order[i] before the call. order must be a permutation of the row
+  /// indices. Only the bookkeeping for each row is moved around, not the
+  /// entries, so this is fast. There must be no pending entries that have
+  /// not been put into a row by rowDone().
+  void permuteRows(const std::vector<RowIndex>& order);
+
   /// Write *this and modulus to file.
   void write(Scalar modulus, FILE* file) const;
 
@@ -300,7 +314,7 @@ public:
     const ColIndex& index() const {return *mColIndexIt;}
 
   private:
-    friend class SparseMatrix;
+    friend class BasicSparseMatrix;
     ConstRowIterator(
       const ColIndex* const indicesIt,
       const Scalar* const scalarIt
@@ -358,7 +372,7 @@ public:
     void setIndex(const ColIndex index) {*mColIndexIt = index;}
 
   private:
-    friend class SparseMatrix;
+    friend class BasicSparseMatrix;
     RowIterator(
       ColIndex* const indicesIt,
       Scalar* const scalarIt
@@ -439,8 +453,9 @@ private:
   size_t mMemoryQuantum;
 };
 
+template<class S>
 template<class T>
-void SparseMatrix::appendRow(
+void BasicSparseMatrix<S>::appendRow(
   std::vector<T> const& v,
   const ColIndex leadCol
 ) {
@@ -460,11 +475,25 @@ void SparseMatrix::appendRow(
 }
 
 
-inline void swap(SparseMatrix& a, SparseMatrix& b) {
+template<class S>
+void swap(BasicSparseMatrix<S>& a, BasicSparseMatrix<S>& b) {
   a.swap(b);
 }
 
-std::ostream& operator<<(std::ostream& out, const SparseMatrix& matrix);
+template<class S>
+std::ostream& operator<<(
+  std::ostream& out,
+  const BasicSparseMatrix<S>& matrix
+) {
+  matrix.print(out);
+  return out;
+}
+
+extern template class BasicSparseMatrix<uint8>;
+extern template class BasicSparseMatrix<uint16>;
+extern template class BasicSparseMatrix<uint32>;
+
+typedef BasicSparseMatrix<uint16> SparseMatrix;
 
 MATHICGB_NAMESPACE_END
 #endif
@@ -166,9 +166,10 @@ public:
     ConstMonoRef sig,
     ConstMonoRef mono,
     const SigPolyBasis& sigBasis,
-    const bool preferSparseReducers
+    const bool preferSparseReducers,
+    Monoid::MonoPool* pool
   ) const {
-    SigPolyBasis::StoredRatioCmp ratioCmp(sig, mono, sigBasis);
+    SigPolyBasis::StoredRatioCmp ratioCmp(sig, mono, sigBasis, pool);
     const auto& basis = sigBasis.basis();
 
     auto reducer = size_t(-1);
@@ -6,10 +6,17 @@
 #include "SigPolyBasis.hpp"
 #include "PolyBasis.hpp"
 #include "MathicIO.hpp"
+#include "mtbb.hpp"
 #include <iostream>
 
 MATHICGB_NAMESPACE_BEGIN
 
+TypicalReducer::TypicalReducer(const PolyRing& ring):
+  mMonoPool(ring.monoid()),
+  mDeferUsedReducers(false),
+  mLookupLock(nullptr)
+{}
+
 unsigned int TypicalReducer::preferredSetSize() const {
   return 1;
 }
@@ -37,7 +44,7 @@ std::unique_ptr<Poly> TypicalReducer::regularReduce(
   monomial u = ring.allocMonomial(mArena);
   monoid.multiply(multiple, basis.leadMono(basisElement), tproduct);
 
-  auto reducer = basis.regularReducer(sig, tproduct);
+  auto reducer = regularReducer(basis, sig, tproduct);
   if (reducer == static_cast<size_t>(-1)) {
     mArena.freeAllAllocs();
     return nullptr; // singular reduction: no regular top reduction possible
@@ -52,20 +59,20 @@ std::unique_ptr<Poly> TypicalReducer::regularReduce(
   MATHICGB_ASSERT(ring.coefficientIsOne(basis.leadCoef(reducer)));
   ring.coefficientFromInt(coef, -1);
   insertTail(const_term(coef, u), &basis.poly(reducer));
-  basis.basis().usedAsReducer(reducer);
+  usedAsReducer(basis.basis(), reducer);
 
   auto result = make_unique<Poly>(ring);
 
   unsigned long long steps = 2; // number of steps in this reduction
   for (const_term v; leadTerm(v);) {
     MATHICGB_ASSERT(v.coeff != 0);
-    reducer = basis.regularReducer(sig, v.monom);
+    reducer = regularReducer(basis, sig, v.monom);
     if (reducer == static_cast<size_t>(-1)) { // no reducer found
       result->append(v.coeff, v.monom);
       removeLeadTerm();
     } else { // reduce by reducer
       ++steps;
-      basis.basis().usedAsReducer(reducer);
+      usedAsReducer(basis.basis(), reducer);
       monomial mon = ring.allocMonomial(mArena);
       monoid.divide(basis.leadMono(reducer), v.monom, mon);
       ring.coefficientDivide(v.coeff, basis.leadCoef(reducer), coef);
@@ -112,40 +119,43 @@ std::unique_ptr<Poly> TypicalReducer::classicReduceSPoly(
   const auto& ring = basis.ring();
   const auto& monoid = basis.ring().monoid();
 
-  monomial lcm = ring.allocMonomial();
-  monoid.lcm(a.leadMono(), b.leadMono(), lcm);
+  auto lcm = mMonoPool.alloc();
+  monoid.lcm(a.leadMono(), b.leadMono(), *lcm);
 
   // insert tail of multiple of a
-  monomial multiple1 = ring.allocMonomial();
-  monoid.divide(a.leadMono(), lcm, multiple1);
+  auto multiple1 = mMonoPool.alloc();
+  monoid.divide(a.leadMono(), *lcm, *multiple1);
   coefficient plusOne;
   ring.coefficientSet(plusOne, 1);
-  insertTail(const_term(plusOne, multiple1), &a);
+  insertTail(const_term(plusOne, Monoid::toOld(*multiple1)), &a);
 
   // insert tail of multiple of b
-  monomial multiple2 = ring.allocMonomial();
-  monoid.divide(b.leadMono(), lcm, multiple2);
+  auto multiple2 = mMonoPool.alloc();
+  monoid.divide(b.leadMono(), *lcm, *multiple2);
   coefficient minusOne = plusOne;
   ring.coefficientNegateTo(minusOne);
-  insertTail(const_term(minusOne, multiple2), &b);
+  insertTail(const_term(minusOne, Monoid::toOld(*multiple2)), &b);
 
-  std::unique_ptr<Poly> reduced = classicReduce(basis);
-  ring.freeMonomial(lcm);
-  ring.freeMonomial(multiple1);
-  ring.freeMonomial(multiple2);
-  return std::move(reduced);
+  return classicReduce(basis);
 }
 
 void TypicalReducer::classicReduceSPolySet
 (std::vector<std::pair<size_t, size_t> >& spairs,
  const PolyBasis& basis,
  std::vector<std::unique_ptr<Poly> >& reducedOut) {
-  for (auto it = spairs.begin(); it != spairs.end(); ++it) {
-    auto reducedSPoly =
-      classicReduceSPoly(basis.poly(it->first), basis.poly(it->second), basis);
-    if (!reducedSPoly->isZero())
-      reducedOut.push_back(std::move(reducedSPoly));
-  }
+  const auto reduce = [&](TypicalReducer& reducer, size_t i) {
+    const auto& spair = spairs[i];
+    return reducer.classicReduceSPoly
+      (basis.poly(spair.first), basis.poly(spair.second), basis);
+  };
+  std::vector<std::unique_ptr<Poly>> reduced(spairs.size());
+  reduceInParallel(spairs.size(), basis, reduce, reduced);
+
+  // The results are in the same order as without parallelism, so the
+  // output does not depend on how the work was split between threads.
+  for (auto& poly : reduced)
+    if (!poly->isZero())
+      reducedOut.push_back(std::move(poly));
 }
 
 void TypicalReducer::classicReducePolySet
@@ -153,11 +163,94 @@ void TypicalReducer::classicReducePolySet
  const PolyBasis& basis,
  std::vector<std::unique_ptr<Poly> >& reducedOut)
 {
-  for (auto it = polys.begin(); it != polys.end(); ++it) {
-    auto reducedPoly = classicReduce(**it, basis);
-    if (!reducedPoly->isZero())
-      reducedOut.push_back(std::move(reducedPoly));
-  }  
+  const auto reduce = [&](TypicalReducer& reducer, size_t i) {
+    return reducer.classicReduce(*polys[i], basis);
+  };
+  std::vector<std::unique_ptr<Poly>> reduced(polys.size());
+  reduceInParallel(polys.size(), basis, reduce, reduced);
+  for (auto& poly : reduced)
+    if (!poly->isZero())
+      reducedOut.push_back(std::move(poly));
+}
+
+void TypicalReducer::regularReduceSet(
+  const std::vector<ConstMonoPtr>& sigs,
+  const std::vector<ConstMonoPtr>& multiples,
+  const std::vector<size_t>& basisElements,
+  const SigPolyBasis& basis,
+  std::vector<std::unique_ptr<Poly> >& reducedOut
+) {
+  MATHICGB_ASSERT(sigs.size() == multiples.size());
+  MATHICGB_ASSERT(sigs.size() == basisElements.size());
+  const auto reduce = [&](TypicalReducer& reducer, size_t i) {
+    return reducer.regularReduce
+      (*sigs[i], *multiples[i], basisElements[i], basis);
+  };
+  reducedOut.clear();
+  reducedOut.resize(sigs.size());
+  reduceInParallel(sigs.size(), basis.basis(), reduce, reducedOut);
+}
+
+template<class Reduce>
+void TypicalReducer::reduceInParallel(
+  const size_t count,
+  const PolyBasis& basis,
+  const Reduce& reduce,
+  std::vector<std::unique_ptr<Poly> >& reduced
+) {
+  MATHICGB_ASSERT(reduced.size() == count);
+  if (count == 1)
+    reduced.front() = reduce(*this, 0);
+  else if (count > 1) {
+    // enumerable_thread_specific needs a copyable type, so each thread gets
+    // a pointer to its copy of this reducer and the vector owns the copies.
+    std::vector<std::unique_ptr<TypicalReducer>> copies;
+    mtbb::mutex copiesLock;
+    mtbb::mutex lookupLock;
+    mtbb::enumerable_thread_specific<TypicalReducer*> threadReducer([&]() {
+      mtbb::mutex::scoped_lock guard(copiesLock);
+      copies.push_back(makeEmptyCopy());
+      copies.back()->mDeferUsedReducers = true;
+      copies.back()->mLookupLock = &lookupLock;
+      return copies.back().get();
+    });
+
+    mtbb::parallel_for(size_t(0), count, size_t(1), [&](const size_t i) {
+      reduced[i] = reduce(*threadReducer.local(), i);
+    });
+
+    for (const auto& copy : copies)
+      for (const auto index : copy->mUsedReducers)
+        basis.usedAsReducer(index);
+  }
+}
+
+void TypicalReducer::usedAsReducer(const PolyBasis& basis, size_t index) {
+  if (mDeferUsedReducers)
+    mUsedReducers.push_back(index);
+  else
+    basis.usedAsReducer(index);
+}
+
+size_t TypicalReducer::classicReducer(
+  const PolyBasis& basis,
+  ConstMonoRef mono
+) {
+  if (mLookupLock == nullptr)
+    return basis.classicReducer(mono);
+  mtbb::mutex::scoped_lock guard(*mLookupLock);
+  return basis.classicReducer(mono);
+}
+
+size_t TypicalReducer::regularReducer(
+  const SigPolyBasis& basis,
+  ConstMonoRef sig,
+  ConstMonoRef mono
+) {
+  if (mLookupLock == nullptr)
+    return basis.regularReducer(sig, mono);
+  mtbb::mutex::scoped_lock guard(*mLookupLock);
+  return basis.regularReducer(sig, mono, mMonoPool);
 }
 
 void TypicalReducer::setMemoryQuantum(size_t quantum) {
@@ -181,7 +274,7 @@ std::unique_ptr<Poly> TypicalReducer::classicReduce
       std::cerr << std::endl;
     }
 
-    size_t reducer = basis.classicReducer(v.monom);
+    size_t reducer = classicReducer(basis, v.monom);
     if (reducer == static_cast<size_t>(-1)) { // no reducer found
       MATHICGB_ASSERT(
         result->isZero() ||
@@ -191,7 +284,7 @@ std::unique_ptr<Poly> TypicalReducer::classicReduce
       removeLeadTerm();
     } else { // reduce by reducer
       ++steps;
-      basis.usedAsReducer(reducer);
+      usedAsReducer(basis, reducer);
       monomial mon = ring.allocMonomial(mArena);
       monoid.divide(basis.leadMono(reducer), v.monom, mon);
       ring.coefficientDivide(v.coeff, basis.leadCoef(reducer), coef);
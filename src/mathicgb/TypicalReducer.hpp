@@ -6,6 +6,7 @@
 #include "Reducer.hpp"
 #include "Poly.hpp"
 #include "PolyRing.hpp"
+#include "mtbb.hpp"
 
 MATHICGB_NAMESPACE_BEGIN
 
@@ -23,6 +24,8 @@ class PolyBasis;
 */
 class TypicalReducer : public Reducer {
 public:
+  TypicalReducer(const PolyRing& ring);
+
   virtual unsigned int preferredSetSize() const;
 
   virtual std::unique_ptr<Poly> regularReduce(
@@ -41,18 +44,33 @@ public:
   virtual std::unique_ptr<Poly> classicReduceSPoly
     (const Poly& a, const Poly& b, const PolyBasis& basis);
 
+  /// Reduces the S-pairs at the same time on as many threads as are
+  /// available, with a copy of this reducer for each thread. The output is
+  /// the same as when reducing the S-pairs one after another.
   virtual void classicReduceSPolySet(
     std::vector<std::pair<size_t, size_t> >& spairs,
     const PolyBasis& basis,
     std::vector<std::unique_ptr<Poly> >& reducedOut
   );
 
+  /// Reduces the polynomials in parallel as classicReduceSPolySet does.
   virtual void classicReducePolySet(
     const std::vector<std::unique_ptr<Poly> >& polys,
     const PolyBasis& basis,
     std::vector<std::unique_ptr<Poly> >& reducedOut
   );
 
+  /// Regular reduces the module terms in parallel as classicReduceSPolySet
+  /// does. The reduction of each module term is the same as that of
+  /// regularReduce, so the results for the other signatures are not used.
+  virtual void regularReduceSet(
+    const std::vector<ConstMonoPtr>& sigs,
+    const std::vector<ConstMonoPtr>& multiples,
+    const std::vector<size_t>& basisElements,
+    const SigPolyBasis& basis,
+    std::vector<std::unique_ptr<Poly> >& reducedOut
+  );
+
   virtual void setMemoryQuantum(size_t quantum);
 
 protected:
@@ -89,11 +107,58 @@ protected:
 
   virtual size_t getMemoryUse() const;
 
+  /// Returns a new reducer of the same kind as this one for the same ring.
+  /// The new reducer does not share any state with this one, so the two
+  /// can be used at the same time on different threads.
+  virtual std::unique_ptr<TypicalReducer> makeEmptyCopy() const = 0;
+
   // Sub-classes can use this
   memt::Arena mArena;
 
+  /// Sub-classes allocate the monomials that they keep from this pool
+  /// rather than from the pool of the monoid, since the pool of the monoid
+  /// is shared between threads and is not synchronized.
+  Monoid::MonoPool mMonoPool;
+
 private:
   void reset();
+
+  /// Records that the basis element at index was used as a reducer.
+  void usedAsReducer(const PolyBasis& basis, size_t index);
+
+  /// Returns PolyBasis::classicReducer(mono), looked up in a way that is
+  /// safe for a copy made by reduceInParallel.
+  size_t classicReducer(const PolyBasis& basis, ConstMonoRef mono);
+
+  /// Returns SigPolyBasis::regularReducer(sig, mono), looked up in a way
+  /// that is safe for a copy made by reduceInParallel.
+  size_t regularReducer(
+    const SigPolyBasis& basis,
+    ConstMonoRef sig,
+    ConstMonoRef mono
+  );
+
+  /// Sets reduced[i] to reduce(reducer, i) for i in [0, count), in
+  /// parallel. reduced must have size count.
+  template<class Reduce>
+  void reduceInParallel(
+    size_t count,
+    const PolyBasis& basis,
+    const Reduce& reduce,
+    std::vector<std::unique_ptr<Poly> >& reduced
+  );
+
+  /// The usage counts of the basis are not synchronized, so a copy made by
+  /// reduceInParallel records the reducers that it uses in mUsedReducers
+  /// instead of counting them in the basis right away. Such a copy also
+  /// looks up regular reducers through mMonoPool.
+  bool mDeferUsedReducers;
+  std::vector<size_t> mUsedReducers;
+
+  /// The divisor lookups of the basis give no guarantee that concurrent
+  /// queries are safe, so the copies made by reduceInParallel share this
+  /// lock and hold it while looking up a reducer. It is null otherwise.
+  mtbb::mutex* mLookupLock;
   std::unique_ptr<Poly> classicReduce(const PolyBasis& basis);
   std::unique_ptr<Poly> classicReduce
     (std::unique_ptr<Poly> partialResult, const PolyBasis& basis);
@@ -47,6 +47,11 @@
 /// does not alias any other pointer that is used in the current scope.
 #define MATHICGB_RESTRICT __restrict
 
+/// Compiles the following function for the given instruction set
+/// extension. Not supported on MSVC, which never defines
+/// MATHICGB_USE_SIMD_X86.
+#define MATHICGB_TARGET(X)
+
 #pragma warning (disable: 4996) // don't warn about e.g. std::fill on pointers
 #pragma warning (disable: 4290) // VC++ ignores throw () specification.
 #pragma warning (disable: 4127) // Warns about using "while (true)".
@@ -99,6 +104,20 @@
 #endif
 #endif
 
+// Compile x64 SIMD kernels that are selected at run time based on what the
+// CPU supports. Define MATHICGB_NO_SIMD to use only the portable code. This
+// requires support for per-function target attributes, which older GCCs
+// do not have when the intrinsics headers are used.
+#ifndef MATHICGB_NO_SIMD
+#if defined(__x86_64__) && (__GNUC__ >= 5 || defined(__clang__))
+#define MATHICGB_USE_SIMD_X86
+#endif
+#endif
+
+/// Compiles the following function for the given instruction set
+/// extension, such as "avx2", even if the rest of the program is not.
+#define MATHICGB_TARGET(X) __attribute__((target(X)))
+
 #else
 
 #define MATHICGB_NO_INLINE
@@ -111,6 +130,7 @@
 #define MATHICGB_MUST_CHECK_RETURN_VALUE
 #define MATHICGB_UNREACHABLE
 #define MATHICGB_RESTRICT
+#define MATHICGB_TARGET(X)
 
 #endif
 
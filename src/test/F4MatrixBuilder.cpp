@@ -5,6 +5,7 @@
 #include "mathicgb/Poly.hpp"
 #include "mathicgb/PolyRing.hpp"
 #include "mathicgb/F4MatrixBuilder.hpp"
+#include "mathicgb/F4MatrixBuilder2.hpp"
 #include "mathicgb/Basis.hpp"
 #include "mathicgb/PolyBasis.hpp"
 #include "mathicgb/io-util.hpp"
@@ -47,6 +48,7 @@ namespace {
     }
 
     const PolyRing& ring() const {return *mRing;}
+    const PolyBasis& basis() const {return mBasis;}
      
   private:
     std::unique_ptr<PolyRing> mRing;
@@ -186,3 +188,59 @@ TEST(F4MatrixBuilder, IteratedReducer) {
     ASSERT_EQ(str, qm.toCanonical().toString()) << "** qm:\n" << qm;
   }
 }
+
+TEST(F4MatrixBuilder2, SharedColumns) {
+  // The rows have many monomials in common, so with several threads the
+  // same column is often created by more than one thread at the same time.
+  // Exactly one of them may schedule a reducer row for a left column, so
+  // there has to be one top row per left column and the columns must not
+  // depend on the number of threads.
+  std::string columns;
+  for (int threadCount = 1; threadCount < 5; ++threadCount) {
+    mgb::mtbb::task_scheduler_init scheduler(threadCount);
+    BuilderMaker maker;
+    maker.addBasisElement("a2+ab+b2+c");
+    maker.addBasisElement("b3+bc+c2+d");
+    maker.addBasisElement("c2d+cd+e");
+    F4MatrixBuilder2 builder(maker.basis());
+
+    std::vector<Poly> polys;
+    for (const char* str : {"a2+b2+c2+d2+e2+f2", "ab+bc+cd+de+ef+f"}) {
+      std::istringstream in(str);
+      Scanner scanner(in);
+      polys.emplace_back(MathicIO<>().readPoly(maker.ring(), false, scanner));
+    }
+    const auto& monoid = maker.ring().monoid();
+    auto multiple = monoid.alloc();
+    for (PolyRing::Monoid::Exponent a = 0; a < 4; ++a) {
+      for (PolyRing::Monoid::Exponent b = 0; b < 4; ++b) {
+        for (PolyRing::Monoid::Exponent c = 0; c < 4; ++c) {
+          monoid.setExponent(0, a, *multiple);
+          monoid.setExponent(1, b, *multiple);
+          monoid.setExponent(2, c, *multiple);
+          for (const auto& poly : polys)
+            builder.addPolynomialToMatrix(*multiple, poly);
+        }
+      }
+    }
+
+    QuadMatrix qm(builder.ring());
+    builder.buildMatrixAndClear(qm);
+    ASSERT_EQ(qm.leftColumnMonomials.size(), qm.topLeft.rowCount());
+    for (SparseMatrix::RowIndex row = 0; row < qm.topLeft.rowCount(); ++row)
+      ASSERT_EQ(row, qm.topLeft.leadCol(row));
+    for (const auto& mono : qm.leftColumnMonomials)
+      ASSERT_NE(static_cast<size_t>(-1), maker.basis().classicReducer(*mono));
+    for (const auto& mono : qm.rightColumnMonomials)
+      ASSERT_EQ(static_cast<size_t>(-1), maker.basis().classicReducer(*mono));
+
+    // The first two lines list the left and right column monomials in an
+    // order that only depends on the monomials.
+    const auto str = qm.toString();
+    const auto end = str.find('\n', str.find('\n') + 1);
+    if (threadCount == 1)
+      columns = str.substr(0, end);
+    else
+      ASSERT_EQ(columns, str.substr(0, end));
+  }
+}
@@ -13,6 +13,51 @@
 
 using namespace mgb;
 
+namespace {
+  /// A fixed sequence of pseudo-random numbers, so that the tests that use
+  /// it always see the same matrices.
+  class PseudoRandom {
+  public:
+    PseudoRandom(unsigned int seed): mState(seed) {}
+
+    /// Returns a number in [0, bound).
+    unsigned int next(unsigned int bound) {
+      mState = mState * 1103515245 + 12345;
+      return ((mState >> 16) | (mState << 16)) % bound;
+    }
+
+  private:
+    unsigned int mState;
+  };
+
+  /// Returns a pseudo-random matrix with rowCount rows and entries in
+  /// columns less than colCount. About density of the entries of each row
+  /// are non-zero and the non-zero entries are in [1, modulus).
+  template<class S>
+  BasicSparseMatrix<S> randomMatrix(
+    const SparseMatrix::RowIndex rowCount,
+    const SparseMatrix::ColIndex colCount,
+    const double density,
+    const S modulus,
+    const unsigned int seed
+  ) {
+    MATHICGB_ASSERT(0 < density && density <= 1);
+    PseudoRandom random(seed);
+    const auto gap = static_cast<unsigned int>(1 / density);
+    BasicSparseMatrix<S> m;
+    for (SparseMatrix::RowIndex row = 0; row < rowCount; ++row) {
+      for (
+        auto col = random.next(gap);
+        col < colCount;
+        col += 1 + random.next(2 * gap - 1)
+      )
+        m.appendEntry(col, static_cast<S>(1 + random.next(modulus - 1)));
+      m.rowDone();
+    }
+    return std::move(m);
+  }
+}
+
 TEST(F4MatrixReducer, Reduce) {
   auto ring = ringFromString("101 6 1\n10 1 1 1 1 1");
   QuadMatrix m(*ring);
@@ -125,4 +170,237 @@ TEST(F4MatrixReducer, Reduce) {
     "1: 1#1 3#66 4#34\n";
   reduced.sortRowsByIncreasingPivots();
   ASSERT_EQ(redStr, reduced.toString()) << "Printed reduced:\n" << reduced;
+
+  F4MatrixReducer flReducer(ring->charac());
+  flReducer.setFaugereLachartre(true);
+  SparseMatrix flReduced(flReducer.reducedRowEchelonFormBottomRight(m));
+  flReduced.sortRowsByIncreasingPivots();
+  ASSERT_EQ(redStr, flReduced.toString()) << "Printed reduced:\n" << flReduced;
+
+  // Only bottom rows 1 and 3 contribute to the reduced matrix.
+  const auto pivotRows = F4MatrixReducer(ring->charac()).pivotBottomRows(m);
+  ASSERT_EQ(2u, pivotRows.size());
+  ASSERT_EQ(1u, pivotRows[0]);
+  ASSERT_EQ(3u, pivotRows[1]);
+}
+
+TEST(F4MatrixReducer, FaugereLachartreSeveralBlocks) {
+  // The right columns span three column blocks of the Faugere-Lachartre
+  // reduction and every pivot row depends on the next one, so the rows of
+  // A^-1 B have to be computed one level at a time in every block. Every
+  // top right row also has entries on both sides of each block boundary.
+  const SparseMatrix::Scalar modulus = 101;
+  const SparseMatrix::ColIndex pivotCount = 30;
+  const SparseMatrix::ColIndex rightColCount = 20000;
+  const SparseMatrix::ColIndex boundaries[] = {8191, 8192, 16383, 16384};
+  PseudoRandom random(3);
+  auto ring = ringFromString("101 6 1\n10 1 1 1 1 1");
+  QuadMatrix m(*ring);
+
+  const auto topRight =
+    randomMatrix(pivotCount, rightColCount, 0.002, modulus, 1);
+  m.topLeft.clear();
+  m.topRight.clear();
+  for (SparseMatrix::RowIndex pivot = 0; pivot < pivotCount; ++pivot) {
+    m.topLeft.appendEntry(pivot, 1);
+    for (auto col = pivot + 1; col < pivotCount && col < pivot + 3; ++col)
+      m.topLeft.appendEntry(col, 1 + random.next(modulus - 1));
+    m.topLeft.rowDone();
+
+    // Merge the boundary entries into the random row in column order.
+    auto it = topRight.rowBegin(pivot);
+    const auto end = topRight.rowEnd(pivot);
+    for (const auto boundary : boundaries) {
+      for (; it != end && it.index() < boundary; ++it)
+        m.topRight.appendEntry(it.index(), it.scalar());
+      if (it != end && it.index() == boundary)
+        ++it;
+      m.topRight.appendEntry(boundary, 1 + random.next(modulus - 1));
+    }
+    for (; it != end; ++it)
+      m.topRight.appendEntry(it.index(), it.scalar());
+    m.topRight.rowDone();
+  }
+
+  m.bottomLeft = randomMatrix(60, pivotCount, 0.2, modulus, 2);
+  m.bottomRight = randomMatrix(60, rightColCount, 0.001, modulus, 3);
+  MATHICGB_ASSERT(m.debugAssertValid());
+
+  F4MatrixReducer reducer(modulus);
+  auto reduced = reducer.reducedRowEchelonFormBottomRight(m);
+  reducer.setFaugereLachartre(true);
+  auto flReduced = reducer.reducedRowEchelonFormBottomRight(m);
+  reduced.sortRowsByIncreasingPivots();
+  flReduced.sortRowsByIncreasingPivots();
+  ASSERT_LT(0u, reduced.rowCount());
+  ASSERT_LT(2u * 8192, reduced.computeColCount()); // reaches third block
+  ASSERT_EQ(reduced.toString(), flReduced.toString());
+}
+
+TEST(F4MatrixReducer, ParallelSparseSameAsSequential) {
+  // A sparse matrix with enough rows for the parallel method to use
+  // several batches. The rows are pseudo-random but fixed and there are
+  // more rows than columns, so many rows reduce to zero.
+  const SparseMatrix::Scalar modulus = 101;
+  const SparseMatrix::ColIndex colCount = 500;
+  auto m = randomMatrix(1000, colCount, 1.0 / 75, modulus, 1);
+  m.appendEntry(colCount - 1, 1);
+  m.rowDone();
+  ASSERT_LT(m.computeDensity(), 0.02);
+
+  F4MatrixReducer reducer(modulus);
+  reducer.setParallelSparseReduction(false);
+  const auto sequential = reducer.reducedRowEchelonForm(m);
+  reducer.setParallelSparseReduction(true);
+  const auto parallel = reducer.reducedRowEchelonForm(m);
+
+  ASSERT_LT(0u, sequential.rowCount());
+  ASSERT_EQ(sequential.toString(), parallel.toString());
+}
+
+TEST(F4MatrixReducer, ScalarWidthsGiveSameResult) {
+  const uint8 modulus = 251;
+  F4MatrixReducer reducer(modulus);
+  const auto narrow = reducer.reducedRowEchelonForm
+    (randomMatrix<uint8>(200, 100, 0.1, modulus, 1));
+  const auto normal = reducer.reducedRowEchelonForm
+    (randomMatrix<uint16>(200, 100, 0.1, modulus, 1));
+  const auto wide = reducer.reducedRowEchelonForm
+    (randomMatrix<uint32>(200, 100, 0.1, modulus, 1));
+  ASSERT_LT(0u, narrow.rowCount());
+  ASSERT_EQ(normal.toString(), narrow.toString());
+  ASSERT_EQ(normal.toString(), wide.toString());
+}
+
+TEST(F4MatrixReducer, LargeModulus) {
+  // 2^31 - 1 does not fit in 16 bits so this needs 32 bit scalars.
+  const uint32 modulus = 2147483647u;
+  BasicSparseMatrix<uint32> m;
+  m.appendEntry(0, 2);
+  m.appendEntry(1, 3);
+  m.appendEntry(2, 5);
+  m.rowDone();
+  m.appendEntry(0, 4);
+  m.appendEntry(1, 6);
+  m.appendEntry(2, 1);
+  m.rowDone();
+  m.appendEntry(1, modulus - 1);
+  m.appendEntry(2, modulus - 1);
+  m.rowDone();
+
+  auto reduced = F4MatrixReducer(modulus).reducedRowEchelonForm(m);
+  reduced.sortRowsByIncreasingPivots();
+  ASSERT_EQ("0: 0#1\n1: 1#1\n2: 2#1\n", reduced.toString());
+
+  // Normalizing multiplies by 1/2 = (p + 1) / 2, so the product does
+  // not fit in 32 bits.
+  BasicSparseMatrix<uint32> m2;
+  m2.appendEntry(0, 2);
+  m2.appendEntry(1, 3);
+  m2.rowDone();
+  auto reduced2 = F4MatrixReducer(modulus).reducedRowEchelonForm(m2);
+  // 3/2 = (p + 3) / 2 mod p.
+  ASSERT_EQ("0: 0#1 1#1073741825\n", reduced2.toString());
+}
+
+TEST(F4MatrixReducer, SparseAccumulatorDensity) {
+  // A density of 0 never uses the sparse accumulator and a density
+  // above 1 always uses it. The matrix has to be sparse for either to be
+  // used and needs enough rows for the parallel method to use several
+  // batches.
+  const SparseMatrix::Scalar modulus = 101;
+  const auto m = randomMatrix(1000, 500, 1.0 / 75, modulus, 1);
+  ASSERT_LT(m.computeDensity(), 0.02);
+
+  F4MatrixReducer reducer(modulus);
+  ASSERT_EQ(0.002f, F4MatrixReducer::DefaultSparseAccumulatorDensity);
+  for (int parallel = 0; parallel < 2; ++parallel) {
+    reducer.setParallelSparseReduction(parallel != 0);
+    reducer.setSparseAccumulatorDensity(0);
+    const auto dense = reducer.reducedRowEchelonForm(m);
+    reducer.setSparseAccumulatorDensity(2);
+    const auto sparse = reducer.reducedRowEchelonForm(m);
+    ASSERT_LT(0u, dense.rowCount());
+    ASSERT_EQ(dense.toString(), sparse.toString());
+  }
+}
+
+TEST(F4MatrixReducer, LargeModulusManyRows) {
+  // With a modulus this large only a few products can be added to an entry
+  // before the entries have to be reduced. The rows are combinations of a
+  // few sparse base rows, so the answer is not just the identity matrix.
+  const uint32 modulus = 2147483647u;
+  const SparseMatrix::ColIndex colCount = 2000;
+  const auto baseMatrix = randomMatrix(40, colCount, 0.005, modulus, 1);
+  std::vector<std::vector<uint64>> baseRows(baseMatrix.rowCount());
+  for (SparseMatrix::RowIndex row = 0; row < baseMatrix.rowCount(); ++row) {
+    baseRows[row].resize(colCount);
+    const auto end = baseMatrix.rowEnd(row);
+    for (auto it = baseMatrix.rowBegin(row); it != end; ++it)
+      baseRows[row][it.index()] = it.scalar();
+  }
+  PseudoRandom random(2);
+  std::vector<std::vector<uint64>> rows(300);
+  BasicSparseMatrix<uint32> m;
+  for (auto& row : rows) {
+    row.resize(colCount);
+    for (size_t i = 0; i < 3; ++i) {
+      const auto& base = baseRows[random.next(baseRows.size())];
+      const uint64 multiple = 1 + random.next(modulus - 1);
+      for (SparseMatrix::ColIndex col = 0; col < colCount; ++col)
+        row[col] = (row[col] + base[col] * multiple) % modulus;
+    }
+    for (SparseMatrix::ColIndex col = 0; col < colCount; ++col)
+      if (row[col] != 0)
+        m.appendEntry(col, static_cast<uint32>(row[col]));
+    m.rowDone();
+  }
+  ASSERT_LT(m.computeDensity(), 0.02);
+
+  // Compute the reduced row echelon form the slow way.
+  const auto power = [&](uint64 base, uint64 exponent) {
+    uint64 result = 1;
+    for (; exponent != 0; exponent /= 2, base = base * base % modulus)
+      if (exponent % 2 == 1)
+        result = result * base % modulus;
+    return result;
+  };
+  size_t pivotCount = 0;
+  for (SparseMatrix::ColIndex col = 0; col < colCount; ++col) {
+    size_t pivot = pivotCount;
+    while (pivot < rows.size() && rows[pivot][col] == 0)
+      ++pivot;
+    if (pivot == rows.size())
+      continue;
+    std::swap(rows[pivot], rows[pivotCount]);
+    auto& pivotRow = rows[pivotCount];
+    const auto inverse = power(pivotRow[col], modulus - 2);
+    for (auto& entry : pivotRow)
+      entry = entry * inverse % modulus;
+    for (size_t r = 0; r < rows.size(); ++r) {
+      if (r == pivotCount || rows[r][col] == 0)
+        continue;
+      const auto multiple = modulus - rows[r][col];
+      for (SparseMatrix::ColIndex c = 0; c < colCount; ++c)
+        rows[r][c] = (rows[r][c] + pivotRow[c] * multiple) % modulus;
+    }
+    ++pivotCount;
+  }
+  ASSERT_LT(0u, pivotCount);
+  ASSERT_GT(baseRows.size() + 1, pivotCount);
+  BasicSparseMatrix<uint32> correct;
+  for (size_t row = 0; row < pivotCount; ++row) {
+    for (SparseMatrix::ColIndex col = 0; col < colCount; ++col)
+      if (rows[row][col] != 0)
+        correct.appendEntry(col, static_cast<uint32>(rows[row][col]));
+    correct.rowDone();
+  }
+
+  F4MatrixReducer reducer(modulus);
+  for (int sparse = 0; sparse < 2; ++sparse) {
+    reducer.setSparseAccumulatorDensity(sparse == 0 ? 0.0f : 2.0f);
+    auto reduced = reducer.reducedRowEchelonForm(m);
+    reduced.sortRowsByIncreasingPivots();
+    ASSERT_EQ(correct.toString(), reduced.toString());
+  }
 }
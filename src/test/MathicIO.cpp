@@ -159,6 +159,44 @@ TEST(MathicIO, ReadWriteBasis) {
   check("2 a b", "2\n a\n b\n", false);
 }
 
+TEST(MathicIO, ReadBasisParallel) {
+  typedef PolyRing::Monoid Monoid;
+  typedef PolyRing::Field Field;
+  PolyRing ring(Field(101), Monoid(28));
+
+  // Reads str both in parallel and one polynomial at a time and checks
+  // that the results are the same and that both stop at the same place.
+  auto check = [&](const std::string& str, const bool doComponent) {
+    for (size_t chunkSize = 1; chunkSize < 10; ++chunkSize) {
+      Scanner serialIn(str);
+      const auto serial = MathicIO<>().readBasis(ring, doComponent, serialIn);
+      std::ostringstream serialOut;
+      MathicIO<>().writeBasis(serial, doComponent, serialOut);
+
+      Scanner in(str.data(), str.data() + str.size());
+      const auto basis =
+        MathicIO<>().readBasisParallel(ring, doComponent, in, chunkSize);
+      std::ostringstream out;
+      MathicIO<>().writeBasis(basis, doComponent, out);
+
+      ASSERT_EQ(serialOut.str(), out.str());
+      ASSERT_EQ(serialIn.lineCount(), in.lineCount());
+      ASSERT_EQ(serialIn.peek(), in.peek());
+    }
+  };
+
+  check("0", false);
+  check("3\n a+b\n 0\n c2+2a\n", false);
+  check("3\n\n\n  a+b\n\n 0 c2+2a\n", false);
+  check("2\n a+b\n b\n\n\n c\n", false);
+  check("2 a<1>+b<0> b\n<2>\nc<1>", true);
+
+  std::string many = "200\n";
+  for (int i = 0; i < 200; ++i)
+    many += i % 3 == 0 ? " ab2+3c\n" : i % 3 == 1 ? " 0\n\n" : "d e";
+  check(many, false);
+}
+
 TEST(MathicIO, ReadWritePoly) {
   typedef PolyRing::Monoid Monoid;
   typedef PolyRing::Field Field;
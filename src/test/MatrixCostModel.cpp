@@ -0,0 +1,103 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#include "mathicgb/stdinc.h"
+#include "mathicgb/MatrixCostModel.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace mgb;
+
+namespace {
+  MatrixCostModel::Matrix makeMatrix(
+    const size_t sPairCount,
+    const double secondsPerEntry
+  ) {
+    MatrixCostModel::Matrix matrix;
+    matrix.sPairCount = sPairCount;
+    matrix.rowCount = 3 * sPairCount;
+    matrix.columnCount = 2 * sPairCount;
+    matrix.entryCount = 10 * matrix.rowCount;
+    matrix.memoryUse = 8 * matrix.entryCount;
+    matrix.seconds = secondsPerEntry * matrix.entryCount;
+    return matrix;
+  }
+}
+
+TEST(MatrixCostModel, GrowsWhileFaster) {
+  MatrixCostModel model;
+  ASSERT_EQ(MatrixCostModel::InitialGroupSize, model.groupSize());
+
+  auto size = model.groupSize();
+  model.addMatrix(makeMatrix(size, 1e-6));
+  ASSERT_EQ(2 * size, model.groupSize());
+
+  size = model.groupSize();
+  model.addMatrix(makeMatrix(size, 0.9e-6));
+  ASSERT_EQ(2 * size, model.groupSize());
+
+  // Slightly slower is not enough to change direction.
+  size = model.groupSize();
+  model.addMatrix(makeMatrix(size, 0.95e-6));
+  ASSERT_EQ(2 * size, model.groupSize());
+
+  // Much slower is.
+  size = model.groupSize();
+  model.addMatrix(makeMatrix(size, 2e-6));
+  ASSERT_EQ(size / 2, model.groupSize());
+}
+
+TEST(MatrixCostModel, IgnoresSmallMatrices) {
+  MatrixCostModel model;
+  const auto size = model.groupSize();
+  model.addMatrix(makeMatrix(size / 4, 1e-6));
+  ASSERT_EQ(size, model.groupSize());
+  model.addMatrix(makeMatrix(0, 1e-6));
+  ASSERT_EQ(size, model.groupSize());
+}
+
+TEST(MatrixCostModel, Predictions) {
+  MatrixCostModel model;
+  model.addMatrix(makeMatrix(100, 1e-6));
+  ASSERT_EQ(300u, model.predictedRowCount(100));
+  ASSERT_EQ(3000u, model.predictedEntryCount(100));
+  ASSERT_EQ(24000u, model.predictedMemoryUse(100));
+  ASSERT_EQ(48000u, model.predictedMemoryUse(200));
+}
+
+TEST(MatrixCostModel, MemoryBudget) {
+  MatrixCostModel model;
+  model.setMemoryBudget(240 * 64);
+  ASSERT_EQ(240u * 64, model.memoryBudget());
+
+  // There is nothing to predict from before the first matrix.
+  ASSERT_EQ(MatrixCostModel::InitialGroupSize, model.groupSize());
+
+  // Each S-pair takes 240 bytes.
+  model.addMatrix(makeMatrix(MatrixCostModel::InitialGroupSize, 1e-6));
+  ASSERT_EQ(64u, model.groupSize());
+
+  model.setMemoryBudget(0);
+  ASSERT_EQ(2 * MatrixCostModel::InitialGroupSize, model.groupSize());
+
+  model.setMemoryBudget(1);
+  ASSERT_EQ(MatrixCostModel::MinGroupSize, model.groupSize());
+}
+
+TEST(MatrixCostModel, NotAdaptive) {
+  MatrixCostModel model;
+  model.setAdaptive(false);
+  ASSERT_FALSE(model.adaptive());
+  ASSERT_EQ(MatrixCostModel::FixedGroupSize, model.groupSize());
+
+  model.addMatrix(makeMatrix(MatrixCostModel::FixedGroupSize, 1e-6));
+  model.addMatrix(makeMatrix(MatrixCostModel::FixedGroupSize, 0.5e-6));
+  ASSERT_EQ(MatrixCostModel::FixedGroupSize, model.groupSize());
+
+  // The memory budget still applies. Each S-pair takes 240 bytes.
+  model.setMemoryBudget(240 * 64);
+  ASSERT_TRUE(model.groupSize() <= 64);
+
+  model.setAdaptive(true);
+  model.setMemoryBudget(0);
+  ASSERT_NE(MatrixCostModel::FixedGroupSize, model.groupSize());
+}
@@ -23,7 +23,10 @@ typedef ::testing::Types<
   MonoMonoid<int16,0,0,0>,
   MonoMonoid<int8,1,0,1>,
   MonoMonoid<int8,0,1,0>,
-  MonoMonoid<int32,1,1,0>
+  MonoMonoid<int32,1,1,0>,
+  MonoMonoid<int32,1,1,1,1>,
+  MonoMonoid<int16,0,0,0,1>,
+  MonoMonoid<int8,1,0,1,1>
 > MonoidTypes;
 
 template <typename T>
@@ -467,6 +470,10 @@ TYPED_TEST(Monoids, MultiplyDivide) {
     ASSERT_TRUE(m.compare(c, mono) == Monoid::EqualTo);
     ASSERT_EQ(m.hash(c), m.hash(mono));
 
+    // divisibility masks
+    ASSERT_EQ(m.divMask(c), m.divMask(a) | m.divMask(b));
+    ASSERT_TRUE((m.divMask(a) & ~m.divMask(c)) == 0);
+
     // divides, check properties that mono=a*b should have
     ASSERT_TRUE(m.divides(mono, c));
     ASSERT_TRUE(m.divides(c, mono));
@@ -646,6 +653,15 @@ TYPED_TEST(Monoids, Order) {
         ASSERT_FALSE(m.lessThan(*greater, *lesser));
         ASSERT_EQ(m.compare(*lesser, *greater), Monoid::LessThan);
         ASSERT_EQ(m.compare(*greater, *lesser), Monoid::GreaterThan);
+        if (m.gradingCount() > 0) {
+          const auto byDegree =
+            m.compareDegrees(m.degree(*lesser), m.degree(*greater));
+          ASSERT_NE(Monoid::GreaterThan, byDegree);
+          ASSERT_EQ(
+            byDegree == Monoid::LessThan ? Monoid::GreaterThan : byDegree,
+            m.compareDegrees(m.degree(*greater), m.degree(*lesser))
+          );
+        }
       }
     }
   };
@@ -960,3 +976,42 @@ TYPED_TEST(Monoids, CopyEqualConversion) {
   }
 }
 
+TYPED_TEST(Monoids, AllVarCounts) {
+  typedef TypeParam Monoid;
+  typedef typename Monoid::Exponent Exponent;
+  typedef typename Monoid::VarIndex VarIndex;
+
+  // The loops over the entries of a monomial are specialized for some
+  // lengths, so check that all lengths around those work.
+  for (VarIndex varCount = 1; varCount < 40; ++varCount) {
+    Monoid m(varCount);
+    auto aOwner = m.alloc();
+    auto bOwner = m.alloc();
+    auto prodOwner = m.alloc();
+    auto a = *aOwner;
+    auto b = *bOwner;
+    auto prod = *prodOwner;
+    for (VarIndex var = 0; var < varCount; ++var) {
+      m.setExponent(var, static_cast<Exponent>(var % 3), a);
+      m.setExponent(var, static_cast<Exponent>(var % 2), b);
+    }
+    if (Monoid::HasComponent)
+      m.setComponent(2, a);
+
+    m.multiply(a, b, prod);
+    for (VarIndex var = 0; var < varCount; ++var)
+      ASSERT_EQ(m.exponent(a, var) + m.exponent(b, var), m.exponent(prod, var));
+    ASSERT_TRUE(m.isProductOf(a, b, prod));
+    ASSERT_TRUE(m.divides(a, prod));
+    ASSERT_TRUE(m.divides(b, prod));
+    ASSERT_EQ(varCount == 1, m.divides(prod, a));
+    ASSERT_TRUE(m.equal(prod, prod));
+    ASSERT_TRUE(m.equalHintTrue(prod, prod));
+    ASSERT_EQ(varCount == 1, m.equal(a, prod));
+    ASSERT_EQ(varCount == 1, m.equalHintTrue(a, prod));
+
+    m.multiplyInPlace(b, a);
+    ASSERT_TRUE(m.equal(a, prod));
+    ASSERT_EQ(m.hash(a), m.hash(prod));
+  }
+}
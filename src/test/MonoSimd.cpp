@@ -0,0 +1,139 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#include "mathicgb/stdinc.h"
+#include "mathicgb/MonoSimd.hpp"
+
+#include "mathicgb/MonoMonoid.hpp"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace mgb;
+
+namespace {
+  std::vector<int32> randomEntries(const size_t count, const int32 max) {
+    std::vector<int32> entries(count);
+    for (auto& e : entries)
+      e = std::rand() % (max + 1);
+    return entries;
+  }
+}
+
+TEST(MonoSimd, MatchesScalar) {
+  const auto& simd = monoKernels();
+  const auto& scalar = scalarMonoKernels();
+  std::srand(0);
+  for (size_t count = 0; count < 70; ++count) {
+    for (size_t rep = 0; rep < 20; ++rep) {
+      const auto a = randomEntries(count, 3);
+      auto b = randomEntries(count, 3);
+
+      std::vector<int32> simdOut(count);
+      std::vector<int32> scalarOut(count);
+      simd.add(a.data(), b.data(), simdOut.data(), count);
+      scalar.add(a.data(), b.data(), scalarOut.data(), count);
+      ASSERT_EQ(scalarOut, simdOut) << simd.name;
+
+      simd.max(a.data(), b.data(), simdOut.data(), count);
+      scalar.max(a.data(), b.data(), scalarOut.data(), count);
+      ASSERT_EQ(scalarOut, simdOut) << simd.name;
+
+      ASSERT_EQ(
+        scalar.lessOrEqual(a.data(), b.data(), count),
+        simd.lessOrEqual(a.data(), b.data(), count)
+      ) << simd.name;
+      ASSERT_TRUE(simd.lessOrEqual(a.data(), scalarOut.data(), count));
+
+      ASSERT_EQ(
+        scalar.lastDifference(a.data(), b.data(), count),
+        simd.lastDifference(a.data(), b.data(), count)
+      ) << simd.name;
+      ASSERT_EQ(0u, simd.lastDifference(a.data(), a.data(), count));
+
+      // a single difference at each position, including the tails that
+      // do not fill a vector register.
+      for (size_t i = 0; i < count; ++i) {
+        b = a;
+        ++b[i];
+        ASSERT_EQ(i + 1, simd.lastDifference(a.data(), b.data(), count));
+        ASSERT_TRUE(simd.lessOrEqual(a.data(), b.data(), count));
+        ASSERT_FALSE(simd.lessOrEqual(b.data(), a.data(), count));
+      }
+    }
+  }
+}
+
+TEST(MonoSimd, InPlace) {
+  const auto& simd = monoKernels();
+  std::srand(1);
+  for (size_t count = 0; count < 40; ++count) {
+    const auto a = randomEntries(count, 1000);
+    const auto b = randomEntries(count, 1000);
+
+    auto sum = a;
+    simd.add(sum.data(), b.data(), sum.data(), count);
+    auto max = b;
+    simd.max(a.data(), max.data(), max.data(), count);
+    for (size_t i = 0; i < count; ++i) {
+      ASSERT_EQ(a[i] + b[i], sum[i]);
+      ASSERT_EQ(std::max(a[i], b[i]), max[i]);
+    }
+  }
+}
+
+// Times the kernels for this CPU against the scalar kernels on arrays the
+// size of the monomials of monoids with more and more variables. This is a
+// benchmark rather than a test, so it only runs when asked for with
+// --gtest_also_run_disabled_tests.
+TEST(MonoSimd, DISABLED_Benchmark) {
+  typedef MonoMonoid<int32> Monoid;
+  typedef Monoid::Order Order;
+  typedef std::chrono::steady_clock Clock;
+
+  const size_t monoCount = 1000;
+  const size_t repeats = 200;
+  const auto& simd = monoKernels();
+  const auto& scalar = scalarMonoKernels();
+  std::srand(2);
+  for (Monoid::VarIndex varCount = 8; varCount <= 128; varCount *= 2) {
+    const Order order(
+      varCount,
+      std::vector<int32>(varCount, 1),
+      Order::RevLexBaseOrderFromRight
+    );
+    const Monoid monoid(order);
+    const size_t entryCount = monoid.entryCount();
+
+    std::vector<int32> monos;
+    for (size_t i = 0; i < monoCount; ++i) {
+      const auto entries = randomEntries(entryCount, 10);
+      monos.insert(monos.end(), entries.begin(), entries.end());
+    }
+    std::vector<int32> out(entryCount);
+
+    const auto time = [&](const MonoKernels& kernels) {
+      const auto before = Clock::now();
+      size_t count = 0;
+      for (size_t rep = 0; rep < repeats; ++rep) {
+        for (size_t i = 0; i + 1 < monoCount; ++i) {
+          const auto a = monos.data() + i * entryCount;
+          const auto b = a + entryCount;
+          kernels.add(a, b, out.data(), entryCount);
+          kernels.max(a, b, out.data(), entryCount);
+          count += kernels.lessOrEqual(a, out.data(), entryCount);
+          count += kernels.lastDifference(a, b, entryCount);
+        }
+      }
+      const auto after = Clock::now();
+      EXPECT_NE(0u, count);
+      return std::chrono::duration<double, std::milli>(after - before).count();
+    };
+
+    const auto scalarTime = time(scalar);
+    const auto simdTime = time(simd);
+    std::cerr << "varCount " << varCount << ": scalar " << scalarTime
+      << "ms, " << simd.name << ' ' << simdTime << "ms\n";
+  }
+}
@@ -0,0 +1,196 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#include "mathicgb/stdinc.h"
+#include "mathicgb/MonomialMap.hpp"
+
+#include "mathicgb/mtbb.hpp"
+#include <gtest/gtest.h>
+
+using namespace mgb;
+
+namespace {
+  typedef PolyRing::Monoid Monoid;
+
+  /// Returns keyCount different monomials.
+  std::vector<Monoid::Mono> makeKeys(const Monoid& monoid, size_t keyCount) {
+    std::vector<Monoid::Mono> keys;
+    for (size_t i = 0; i < keyCount; ++i) {
+      auto mono = monoid.alloc();
+      monoid.setExponent(0, static_cast<Monoid::Exponent>(i % 10), *mono);
+      monoid.setExponent(1, static_cast<Monoid::Exponent>(i / 10 % 10), *mono);
+      monoid.setExponent(2, static_cast<Monoid::Exponent>(i / 100), *mono);
+      keys.emplace_back(std::move(mono));
+    }
+    return keys;
+  }
+}
+
+TEST(MonomialMap, ConcurrentInsert) {
+  // Each task inserts every key with its own value, starting at a different
+  // key, so the same key is inserted by several tasks at once while other
+  // keys are inserted too. Exactly one task has to win each key and every
+  // task has to get the value of the winner back.
+  const size_t keyCount = 1000;
+  const size_t taskCount = 8;
+  PolyRing ring(PolyRing::Field(101), Monoid(3));
+  const auto keys = makeKeys(ring.monoid(), keyCount);
+  for (int threadCount = 1; threadCount < 5; ++threadCount) {
+    mgb::mtbb::task_scheduler_init scheduler(threadCount);
+    MonomialMap<size_t> map(ring);
+    std::vector<char> won(taskCount * keyCount);
+    std::vector<size_t> got(taskCount * keyCount);
+    mgb::mtbb::parallel_for(size_t(0), taskCount, size_t(1),
+      [&](const size_t task) {
+        for (size_t i = 0; i < keyCount; ++i) {
+          const auto key = (i + task * (keyCount / taskCount)) % keyCount;
+          const auto value = task * keyCount + key;
+          const auto p = map.insert(std::make_pair(keys[key].ptr(), value));
+          won[task * keyCount + key] = p.second;
+          got[task * keyCount + key] = *p.first.first;
+          MATHICGB_ASSERT(ring.monoid().equal(*p.first.second, *keys[key]));
+        }
+      }
+    );
+
+    ASSERT_EQ(keyCount, map.entryCount());
+    const MonomialMap<size_t>::Reader reader(map);
+    for (size_t key = 0; key < keyCount; ++key) {
+      size_t winnerCount = 0;
+      size_t winnerValue = 0;
+      for (size_t task = 0; task < taskCount; ++task) {
+        if (won[task * keyCount + key]) {
+          ++winnerCount;
+          winnerValue = task * keyCount + key;
+        }
+      }
+      ASSERT_EQ(1u, winnerCount);
+      for (size_t task = 0; task < taskCount; ++task)
+        ASSERT_EQ(winnerValue, got[task * keyCount + key]);
+      const auto found = reader.find(*keys[key]);
+      ASSERT_TRUE(found.first != nullptr);
+      ASSERT_EQ(winnerValue, *found.first);
+    }
+  }
+}
+
+TEST(MonomialMap, ResizeWhileReading) {
+  // The map starts out small, so it is resized many times while the tasks
+  // insert and look up keys. A reader may miss a key whose bucket is moved
+  // to a new table after the reader was made, but it must never find a
+  // wrong value. Inserting a key again must always find the entry that is
+  // already there, whether its bucket has been moved yet or not.
+  const size_t keyCount = 1000;
+  const size_t taskCount = 8;
+  PolyRing ring(PolyRing::Field(101), Monoid(3));
+  const auto keys = makeKeys(ring.monoid(), keyCount);
+  for (int threadCount = 1; threadCount < 5; ++threadCount) {
+    mgb::mtbb::task_scheduler_init scheduler(threadCount);
+    MonomialMap<size_t> map(ring);
+    std::vector<char> correct(taskCount);
+    mgb::mtbb::parallel_for(size_t(0), taskCount, size_t(1),
+      [&](const size_t task) {
+        MonomialMap<size_t>::Pin pin(map);
+        bool ok = true;
+        for (size_t key = task; key < keyCount; key += taskCount) {
+          const auto p = map.insert(std::make_pair(keys[key].ptr(), key), pin);
+          ok = ok && p.second;
+          const MonomialMap<size_t>::Reader reader(pin);
+          for (size_t earlier = task; earlier <= key; earlier += taskCount) {
+            const auto found = reader.find(*keys[earlier]);
+            ok = ok && (found.first == nullptr || *found.first == earlier);
+          }
+          const auto earlier = task + (key / taskCount / 2) * taskCount;
+          const auto again =
+            map.insert(std::make_pair(keys[earlier].ptr(), keyCount), pin);
+          ok = ok && !again.second && *again.first.first == earlier;
+        }
+        correct[task] = ok;
+      }
+    );
+
+    for (size_t task = 0; task < taskCount; ++task)
+      ASSERT_TRUE(correct[task] != 0);
+    ASSERT_EQ(keyCount, map.entryCount());
+    const MonomialMap<size_t>::Reader reader(map);
+    for (size_t key = 0; key < keyCount; ++key) {
+      const auto found = reader.find(*keys[key]);
+      ASSERT_TRUE(found.first != nullptr);
+      ASSERT_EQ(key, *found.first);
+    }
+  }
+}
+
+TEST(MonomialMap, PinnedInsert) {
+  // Insertions through a Pin are added to the entry count in batches, so
+  // the count need not be up to date while the pins exist. It has to be
+  // right once they are gone and the table must have grown to fit all the
+  // keys anyway.
+  const size_t keyCount = 1000;
+  const size_t taskCount = 4;
+  PolyRing ring(PolyRing::Field(101), Monoid(3));
+  const auto keys = makeKeys(ring.monoid(), keyCount);
+  for (int threadCount = 1; threadCount < 5; ++threadCount) {
+    mgb::mtbb::task_scheduler_init scheduler(threadCount);
+    MonomialMap<size_t> map(ring);
+    std::vector<size_t> wonCount(taskCount);
+    mgb::mtbb::parallel_for(size_t(0), taskCount, size_t(1),
+      [&](const size_t task) {
+        // Each task inserts all keys, so every key is inserted by several
+        // tasks, but it is only counted for the winner.
+        MonomialMap<size_t>::Pin pin(map);
+        for (size_t i = 0; i < keyCount; ++i) {
+          const auto key = (i + task * (keyCount / taskCount)) % keyCount;
+          if (map.insert(std::make_pair(keys[key].ptr(), key), pin).second)
+            ++wonCount[task];
+        }
+      }
+    );
+
+    size_t totalWonCount = 0;
+    for (size_t task = 0; task < taskCount; ++task)
+      totalWonCount += wonCount[task];
+    ASSERT_EQ(keyCount, totalWonCount);
+    ASSERT_EQ(keyCount, map.entryCount());
+    const MonomialMap<size_t>::Reader reader(map);
+    size_t entryCount = 0;
+    for (auto it = reader.begin(); it != reader.end(); ++it)
+      ++entryCount;
+    ASSERT_EQ(keyCount, entryCount);
+    for (size_t key = 0; key < keyCount; ++key) {
+      const auto found = reader.find(*keys[key]);
+      ASSERT_TRUE(found.first != nullptr);
+      ASSERT_EQ(key, *found.first);
+    }
+  }
+}
+
+TEST(MonomialMap, DeleteRetiredMaps) {
+  // A table that has been moved away from must not be deleted while a
+  // reader that might be looking at it exists, but it has to be deleted
+  // once there are no more readers.
+  const size_t keyCount = 1000;
+  PolyRing ring(PolyRing::Field(101), Monoid(3));
+  const auto keys = makeKeys(ring.monoid(), keyCount);
+  MonomialMap<size_t> map(ring);
+  {
+    // The reader pins the map from before the first resize, so the tables
+    // from all the resizes have to be kept.
+    const MonomialMap<size_t>::Reader reader(map);
+    for (size_t key = 0; key < keyCount; ++key)
+      map.insert(std::make_pair(keys[key].ptr(), key));
+    ASSERT_NE(0u, map.retiredMapCount());
+  }
+
+  // Each insertion deletes the tables that can be deleted and advances the
+  // epoch. So it takes two insertions to get past the epoch of the reader.
+  map.insert(std::make_pair(keys.front().ptr(), size_t(0)));
+  map.insert(std::make_pair(keys.front().ptr(), size_t(0)));
+  ASSERT_EQ(0u, map.retiredMapCount());
+
+  const MonomialMap<size_t>::Reader reader(map);
+  for (size_t key = 0; key < keyCount; ++key) {
+    const auto found = reader.find(*keys[key]);
+    ASSERT_TRUE(found.first != nullptr);
+    ASSERT_EQ(key, *found.first);
+  }
+}
@@ -226,3 +226,25 @@ TEST(PrimeField, PlusOne) {
   ASSERT_EQ
     (pf32.toElement(3015615332u), pf32.plusOne(pf32.toElement(3015615331u)));
 }
+
+TEST(PrimeField, BarrettModulus) {
+  const auto max32BitUnsignedPrime = 4294967291u;
+  const uint32 moduli[] = {2, 3, 11, 251, 65521, 2147483647u,
+    max32BitUnsignedPrime};
+  const uint64 max = std::numeric_limits<uint64>::max();
+  const uint64 xs[] = {0, 1, 2, 10, 11, 12, 65535, 65536, 4294967295u,
+    4294967296u, 0x123456789ABCDEFull, max - 1, max};
+  for (const auto modulus : moduli) {
+    const BarrettModulus<uint32> barrett(modulus);
+    ASSERT_EQ(modulus, barrett.modulus());
+    for (const auto x : xs)
+      ASSERT_EQ(x % modulus, barrett.reduce(x)) << x << " mod " << modulus;
+    const auto big = modulus - 1;
+    ASSERT_EQ((static_cast<uint64>(big) * big) % modulus,
+      barrett.product(big, big));
+  }
+
+  const BarrettModulus<uint8> barrett8(251);
+  ASSERT_EQ(250 * 250 % 251, barrett8.product(250, 250));
+  ASSERT_EQ(max % 251, barrett8.reduce(max));
+}
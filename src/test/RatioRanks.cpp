@@ -0,0 +1,100 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#include "mathicgb/stdinc.h"
+#include "mathicgb/RatioRanks.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace mgb;
+
+namespace {
+  typedef PolyRing::Monoid Monoid;
+
+  int rankCompare(RatioRanks::Rank a, RatioRanks::Rank b) {
+    return a < b ? LT : a > b ? GT : EQ;
+  }
+
+  class RatioRanksTest {
+  public:
+    RatioRanksTest(): mMonoid(3), mRanks(mPtrs, mMonoid) {}
+
+    void insert(Monoid::Exponent a, Monoid::Exponent b, Monoid::Exponent c) {
+      mMonos.emplace_back(make(a, b, c));
+      mPtrs.push_back(mMonos.back().ptr());
+      mRanks.insert();
+    }
+
+    Monoid::Mono make(
+      Monoid::Exponent a,
+      Monoid::Exponent b,
+      Monoid::Exponent c
+    ) {
+      auto mono = mMonoid.alloc();
+      mMonoid.setExponent(0, a, *mono);
+      mMonoid.setExponent(1, b, *mono);
+      mMonoid.setExponent(2, c, *mono);
+      return mono;
+    }
+
+    // Checks that the ranks of the ratios and of mono are in the same
+    // order as the ratios and mono themselves.
+    void check(Monoid::ConstMonoRef mono) {
+      ASSERT_EQ(mPtrs.size(), mRanks.size());
+      const auto rank = mRanks.rank(mono);
+      for (size_t i = 0; i < mPtrs.size(); ++i) {
+        ASSERT_EQ(
+          mMonoid.compare(mono, *mPtrs[i]),
+          rankCompare(rank, mRanks.rank(i))
+        );
+      }
+    }
+
+    void checkAll() {
+      for (size_t i = 0; i < mPtrs.size(); ++i) {
+        ASSERT_EQ(mRanks.rank(i), mRanks.rank(*mPtrs[i]));
+        check(*mPtrs[i]);
+      }
+    }
+
+  private:
+    Monoid mMonoid;
+    std::vector<Monoid::Mono> mMonos;
+    std::vector<Monoid::MonoPtr> mPtrs;
+    RatioRanks mRanks;
+  };
+}
+
+TEST(RatioRanks, Small) {
+  RatioRanksTest test;
+  test.check(*test.make(1, 2, 3));
+  test.insert(1, 0, 0);
+  test.insert(0, 1, 0);
+  test.insert(1, 0, 0);
+  test.insert(2, 0, 0);
+  test.insert(0, 0, 0);
+  test.checkAll();
+  test.check(*test.make(0, 0, 1));
+  test.check(*test.make(3, 0, 0));
+}
+
+TEST(RatioRanks, Many) {
+  // Inserting at the same end over and over is what uses up the room
+  // between the labels the quickest.
+  RatioRanksTest test;
+  const Monoid::Exponent count = 2000;
+  for (Monoid::Exponent i = 0; i < count; ++i)
+    test.insert(i, 0, 0);
+  for (Monoid::Exponent i = 0; i < count; ++i)
+    test.insert(0, count - i, 0);
+
+  unsigned int seed = 1;
+  const auto random = [&]() -> Monoid::Exponent {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) % 20;
+  };
+  for (size_t i = 0; i < count; ++i)
+    test.insert(random(), random(), random());
+  test.checkAll();
+  for (size_t i = 0; i < 100; ++i)
+    test.check(*test.make(random(), random(), random()));
+}
@@ -0,0 +1,186 @@
+// MathicGB copyright 2012 all rights reserved. MathicGB comes with ABSOLUTELY
+// NO WARRANTY and is licensed as GPL v2.0 or later - see LICENSE.txt.
+#include "mathicgb/stdinc.h"
+#include "mathicgb/SPairs.hpp"
+
+#include "mathicgb/Poly.hpp"
+#include "mathicgb/PolyRing.hpp"
+#include "mathicgb/PolyBasis.hpp"
+#include "mathicgb/io-util.hpp"
+#include "mathicgb/MathicIO.hpp"
+#include <gtest/gtest.h>
+#include <memory>
+
+using namespace mgb;
+
+namespace {
+  typedef std::pair<size_t, size_t> Pair;
+
+  // Keeps a basis alive together with its S-pairs.
+  struct PairsMaker {
+    PairsMaker(const PolyRing& ring):
+      mBasis(
+        ring,
+        MonoLookup::makeFactory(ring.monoid(), 1)->make(false, true)
+      ),
+      mPairs(mBasis, false)
+    {}
+
+    /// Adds each of polys to the basis along with its S-pairs.
+    void add(const std::vector<std::string>& polys) {
+      for (const auto& poly : polys) {
+        std::istringstream in(poly);
+        Scanner scanner(in);
+        mBasis.insert(make_unique<Poly>
+          (MathicIO<>().readPoly(mBasis.ring(), false, scanner)));
+        mPairs.addPairs(mBasis.size() - 1);
+      }
+    }
+
+    /// Pops all the remaining S-pairs in order.
+    std::vector<Pair> popAll() {
+      std::vector<Pair> pairs;
+      auto p = mPairs.pop();
+      for (; p.first != static_cast<size_t>(-1); p = mPairs.pop())
+        pairs.push_back(p);
+      return pairs;
+    }
+
+    PolyBasis mBasis;
+    SPairs mPairs;
+  };
+}
+
+TEST(SPairs, BuchbergerLcmCriterionLookup) {
+  // The S-pair (bd, bc) is useless because b divides bcd. The hit cache
+  // starts out pointing at a5, which does not divide bcd, so b has to be
+  // found by a lookup in the basis.
+  const auto ring = ringFromString("101 4 1\n1 1 1 1");
+  PairsMaker maker(*ring);
+  maker.add({"a5", "b", "bc", "bd"});
+  ASSERT_TRUE(maker.mPairs.eliminated(3, 2));
+  ASSERT_FALSE(maker.mPairs.eliminated(2, 1));
+  ASSERT_FALSE(maker.mPairs.eliminated(3, 1));
+
+  const auto pairs = maker.popAll();
+  ASSERT_EQ(2u, pairs.size());
+  ASSERT_EQ(Pair(3, 1), pairs[0]); // bd is less than bc
+  ASSERT_EQ(Pair(2, 1), pairs[1]);
+}
+
+TEST(SPairs, RetireWithinDegree) {
+  // The basis elements all have lead monomials of degree 3, so there are
+  // many S-pairs of each degree and their order depends on comparing lcm's.
+  // Retiring a basis element while those S-pairs are in the queue must not
+  // change the order of the other S-pairs.
+  const std::vector<std::string> polys = {
+    "a2b", "a2c", "a2d", "ab2", "b2c", "b2d",
+    "ac2", "bc2", "c2d", "ad2", "bd2", "cd2"
+  };
+  const auto ring = ringFromString("101 4 1\n1 1 1 1");
+  const auto& monoid = ring->monoid();
+
+  PairsMaker expectedMaker(*ring);
+  expectedMaker.add(polys);
+  const auto& basis = expectedMaker.mBasis;
+  const auto expected = expectedMaker.popAll();
+
+  for (size_t retire = 0; retire < polys.size(); ++retire) {
+    for (size_t popCount = 0; popCount < 6; ++popCount) {
+      PairsMaker maker(*ring);
+      maker.add(polys);
+      std::vector<Pair> pairs;
+      for (size_t i = 0; i < popCount; ++i)
+        pairs.push_back(maker.mPairs.pop());
+      maker.mBasis.retire(retire);
+      const auto rest = maker.popAll();
+      pairs.insert(pairs.end(), rest.begin(), rest.end());
+
+      // The S-pairs come in order of lcm.
+      auto previous = monoid.alloc();
+      auto current = monoid.alloc();
+      for (size_t i = 0; i < pairs.size(); ++i) {
+        monoid.lcm(
+          basis.leadMono(pairs[i].first),
+          basis.leadMono(pairs[i].second),
+          *current
+        );
+        if (i > 0)
+          ASSERT_FALSE(monoid.lessThan(*current, *previous));
+        monoid.copy(*current, *previous);
+      }
+
+      // After the retirement, the S-pairs of the retired element are gone
+      // and the other S-pairs come in the same order as without the
+      // retirement. Retiring an element can only make the Buchberger
+      // criteria apply less often, so there can be extra S-pairs in between.
+      const auto involvesRetired = [&](const Pair p) {
+        return p.first == retire || p.second == retire;
+      };
+      for (size_t i = popCount; i < pairs.size(); ++i)
+        ASSERT_FALSE(involvesRetired(pairs[i]));
+      size_t found = 0;
+      for (const auto p : expected) {
+        if (involvesRetired(p))
+          continue;
+        while (found < pairs.size() && pairs[found] != p)
+          ++found;
+        ASSERT_TRUE(found < pairs.size());
+        ++found;
+      }
+    }
+  }
+}
+
+TEST(SPairs, ParallelPairStatus) {
+  // addPairs looks at the S-pairs of a new basis element in parallel once
+  // there are enough of them. That has to give the same S-pairs in the same
+  // order and the same statistics as looking at them serially.
+  const auto ring = ringFromString("101 4 1\n1 1 1 1");
+  const int degree = 12;
+  std::vector<std::string> monomials;
+  for (int a = 0; a <= degree; ++a) {
+    for (int b = 0; a + b <= degree; ++b) {
+      for (int c = 0; a + b + c <= degree; ++c) {
+        std::ostringstream out;
+        out << 'a' << a << 'b' << b << 'c' << c << 'd' << degree - a - b - c;
+        monomials.push_back(out.str());
+      }
+    }
+  }
+  // Add the monomials in a scrambled order so that the S-pair criteria
+  // apply in many different ways. This is a permutation since 97 is prime.
+  std::vector<std::string> polys;
+  for (size_t i = 0; i < monomials.size(); ++i)
+    polys.push_back(monomials[(i * 97) % monomials.size()]);
+  ASSERT_NE(0u, monomials.size() % 97);
+
+  PairsMaker serialMaker(*ring);
+  serialMaker.mPairs.setParallelThreshold(static_cast<size_t>(-1));
+  serialMaker.add(polys);
+  const auto serialEarly = serialMaker.mPairs.stats();
+  const auto serialPairs = serialMaker.popAll();
+  const auto serialLate = serialMaker.mPairs.stats();
+
+  for (int threadCount = 1; threadCount < 5; ++threadCount) {
+    mgb::mtbb::task_scheduler_init scheduler(threadCount);
+    PairsMaker maker(*ring);
+    maker.mPairs.setParallelThreshold(0);
+    maker.add(polys);
+    const auto early = maker.mPairs.stats();
+    ASSERT_EQ(serialPairs, maker.popAll());
+    const auto late = maker.mPairs.stats();
+
+    for (int i = 0; i < 2; ++i) {
+      const auto& a = i == 0 ? serialEarly : serialLate;
+      const auto& b = i == 0 ? early : late;
+      ASSERT_EQ(a.sPairsConsidered, b.sPairsConsidered);
+      ASSERT_EQ(a.relativelyPrimeHits, b.relativelyPrimeHits);
+      ASSERT_EQ(a.buchbergerLcmSimpleHits, b.buchbergerLcmSimpleHits);
+      ASSERT_EQ(a.buchbergerLcmAdvancedHits, b.buchbergerLcmAdvancedHits);
+      ASSERT_EQ(a.buchbergerLcmCacheHits, b.buchbergerLcmCacheHits);
+      ASSERT_EQ(a.buchbergerLcmSimpleHitsLate, b.buchbergerLcmSimpleHitsLate);
+      ASSERT_EQ(a.buchbergerLcmCacheHitsLate, b.buchbergerLcmCacheHitsLate);
+    }
+  }
+}
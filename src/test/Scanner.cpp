@@ -122,3 +122,32 @@ TEST(Scanner, WhiteAndLineCount) {
   in.expectEOF();
   ASSERT_EQ(5, in.lineCount());
 }
+
+TEST(Scanner, PositionAndSkipTo) {
+  const std::string str = "ab\ncd\n\nef";
+  const auto begin = str.data();
+  Scanner in(begin, begin + str.size());
+  ASSERT_TRUE(in.inMemory());
+  ASSERT_EQ(begin, in.position());
+  ASSERT_EQ(begin + str.size(), in.inputEnd());
+
+  in.skipTo(begin + 1);
+  ASSERT_EQ('b', in.peek());
+  ASSERT_EQ(1, in.lineCount());
+
+  in.skipTo(begin + 4);
+  ASSERT_EQ('d', in.peek());
+  ASSERT_EQ(2, in.lineCount());
+
+  in.expect('d');
+  in.skipTo(begin + 7);
+  ASSERT_EQ('e', in.peek());
+  ASSERT_EQ(4, in.lineCount());
+
+  in.skipTo(in.inputEnd());
+  ASSERT_TRUE(in.matchEOF());
+  ASSERT_EQ(in.inputEnd(), in.position());
+
+  std::istringstream s(str);
+  ASSERT_FALSE(Scanner(s).inMemory());
+}
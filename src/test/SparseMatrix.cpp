@@ -63,6 +63,30 @@ TEST(SparseMatrix, Simple) {
   ASSERT_FALSE(mat.emptyRow(2));
 }
 
+TEST(SparseMatrix, PermuteRows) {
+  SparseMatrix mat;
+  mat.appendEntry(1, 10);
+  mat.rowDone();
+  mat.rowDone();
+  mat.appendEntry(0, 20);
+  mat.appendEntry(3, 30);
+  mat.rowDone();
+
+  std::vector<SparseMatrix::RowIndex> order;
+  order.push_back(2);
+  order.push_back(0);
+  order.push_back(1);
+  mat.permuteRows(order);
+  ASSERT_EQ("0: 0#20 3#30\n1: 1#10\n2:\n", mat.toString());
+  ASSERT_EQ(3, mat.entryCount());
+
+  // rows appended after a permutation must not overlap the old rows.
+  mat.appendEntry(2, 40);
+  mat.rowDone();
+  ASSERT_EQ("0: 0#20 3#30\n1: 1#10\n2:\n3: 2#40\n", mat.toString());
+  ASSERT_EQ(4, mat.entryCount());
+}
+
 TEST(SparseMatrix, toRow) {
   auto ring = ringFromString("32003 6 1\n1 1 1 1 1 1");
   auto polyForMonomials = parsePoly(*ring, "a5+a4+a3+a2+a1+a0");
@@ -9,6 +9,7 @@
 #include "mathicgb/SigPolyBasis.hpp"
 #include "mathicgb/SignatureGB.hpp"
 #include "mathicgb/ClassicGBAlg.hpp"
+#include "mathicgb/F4Trace.hpp"
 #include "mathicgb/mtbb.hpp"
 #include "mathicgb/MathicIO.hpp"
 #include "mathicgb/Scanner.hpp"
@@ -152,6 +153,9 @@ spairQueue	reducerType	divLookup	monTable	buchberger	postponeKoszul	useBaseDivis
 2	18	1	1	1	0	0	0	1	0	0	10	1
 3	16	2	3	1	0	0	1	1	1	0	10	8
 2	20	4	1	0	1	1	0	0	0	1	10	8
+1	28	2	3	1	0	0	1	1	0	0	1	2
+2	28	3	2	0	1	1	0	0	1	1	0	1
+0	28	4	1	1	0	0	0	0	1	0	10	8
 );
   std::istringstream tests(allPairsTests);
   // skip the initial line with the parameter names.
@@ -279,6 +283,9 @@ spairQueue	reducerType	divLookup	monTable	buchberger	postponeKoszul	useBaseDivis
       params.useAutoTopReduction = autoTopReduce;
       params.useAutoTailReduction = autoTailReduce;
       params.callback = nullptr;
+      params.trace = nullptr;
+      params.replayTrace = false;
+      params.pipeline = false;
 
       auto gb = computeGBClassicAlg(std::move(basis), params);
 
@@ -380,3 +387,185 @@ TEST(GB, gerdt93_0_7) {
   testGB(gerdt93IdealComponentFirst(false), gerdt93_gb_strat0_free7,
          gerdt93_syzygies_strat0_free7, gerdt93_initial_strat0_free7, 9);
 }
+
+namespace {
+  std::string initialIdealByF4(
+    const std::string& idealStr,
+    unsigned int sPairGroupSize,
+    F4Trace* trace,
+    bool replayTrace,
+    bool pipeline
+  ) {
+    std::istringstream inStream(idealStr);
+    Scanner in(inStream);
+    auto p = MathicIO<>().readRing(true, in);
+    auto& ring = *p.first;
+    auto basis = MathicIO<>().readBasis(ring, false, in);
+    const auto reducer =
+      Reducer::makeReducer(Reducer::Reducer_F4_New, ring);
+
+    ClassicGBAlgParams params;
+    params.reducer = reducer.get();
+    params.monoLookupType = 1;
+    params.preferSparseReducers = true;
+    params.sPairQueueType = 0;
+    params.breakAfter = 0;
+    params.printInterval = 0;
+    params.sPairGroupSize = sPairGroupSize;
+    params.reducerMemoryQuantum = 100 * 1024;
+    params.useAutoTopReduction = true;
+    params.useAutoTailReduction = false;
+    params.callback = nullptr;
+    params.trace = trace;
+    params.replayTrace = replayTrace;
+    params.pipeline = pipeline;
+    auto gb = computeGBClassicAlg(std::move(basis), params);
+
+    Basis initialIdeal(gb.ring());
+    for (size_t i = 0; i < gb.size(); ++i) {
+      auto poly = make_unique<Poly>(gb.ring());
+      auto leadTerm = gb.getPoly(i)->leadTerm();
+      leadTerm.coef = gb.ring().field().one();
+      poly->append(leadTerm);
+      initialIdeal.insert(std::move(poly));
+    }
+    initialIdeal.sort();
+    return toString(&initialIdeal);
+  }
+}
+
+TEST(GB, f4TraceReplay) {
+  // Record a trace modulo 32003 and replay it modulo 101.
+  const auto idealStr = smallIdealComponentLastDescending();
+  F4Trace trace;
+  const auto recorded = initialIdealByF4(idealStr, 0, &trace, false, false);
+  ASSERT_LT(0u, trace.stepCount());
+
+  std::ostringstream out;
+  trace.write(out);
+  std::istringstream traceIn(out.str());
+  Scanner traceScanner(traceIn);
+  F4Trace readTrace;
+  readTrace.read(traceScanner);
+  ASSERT_EQ(trace.stepCount(), readTrace.stepCount());
+
+  auto otherPrime = idealStr;
+  ASSERT_EQ("32003", otherPrime.substr(0, 5));
+  otherPrime.replace(0, 5, "101");
+  const auto replayed = initialIdealByF4(otherPrime, 0, &readTrace, true, false);
+  ASSERT_EQ(recorded, replayed);
+
+  // The trace does not fit a different input.
+  ASSERT_THROW(
+    initialIdealByF4
+      (liuIdealComponentLastDescending(), 0, &readTrace, true, false),
+    F4TraceMismatch
+  );
+}
+
+TEST(GB, f4Pipeline) {
+  // Small groups give many steps, so many matrices are built ahead of
+  // time.
+  const auto check = [](const std::string& idealStr) {
+    for (unsigned int groupSize = 1; groupSize <= 4; ++groupSize) {
+      EXPECT_EQ(
+        initialIdealByF4(idealStr, groupSize, nullptr, false, false),
+        initialIdealByF4(idealStr, groupSize, nullptr, false, true)
+      ) << groupSize;
+    }
+  };
+  check(smallIdealComponentLastDescending());
+  check(liuIdealComponentLastDescending());
+  check(weispfennig97IdealComponentLast(true));
+}
+
+namespace {
+  /// Returns the signature and lead term of each element of the signature
+  /// basis followed by the minimal syzygies and the number of signatures
+  /// processed. These do not depend on which reducer is used, unlike the
+  /// tails of the basis elements.
+  std::string signatureGBLeads(
+    const std::string& idealStr,
+    Reducer::ReducerType reducerType,
+    unsigned int signatureSetSize = 0
+  ) {
+    std::istringstream inStream(idealStr);
+    Scanner in(inStream);
+    auto p = MathicIO<>().readRing(true, in);
+    auto& ring = *p.first;
+    auto& processor = p.second;
+    auto basis = MathicIO<>().readBasis(ring, false, in);
+    if (processor.schreyering())
+      processor.setSchreyerMultipliers(basis);
+
+    SignatureGB alg(
+      std::move(basis),
+      std::move(processor),
+      reducerType,
+      2,
+      2,
+      false,
+      false,
+      false,
+      false,
+      1
+    );
+    alg.setSignatureSetSize(signatureSetSize);
+    alg.computeGrobnerBasis();
+
+    std::ostringstream out;
+    const auto& gb = *alg.getGB();
+    for (size_t i = 0; i < gb.size(); ++i) {
+      MathicIO<>().writeMonomial(gb.monoid(), true, gb.signature(i), out);
+      out << ' ';
+      MathicIO<>().writeMonomial(gb.monoid(), false, gb.leadMono(i), out);
+      out << '\n';
+    }
+    out << toString(alg.getSyzTable());
+    out << "signatures done: " << alg.signaturesDone() << '\n';
+    return out.str();
+  }
+}
+
+TEST(GB, signatureF4) {
+  // The F4 reducer reduces the signatures of a degree in one matrix,
+  // which has to give the same basis as reducing them one at a time.
+  const auto check = [](const std::string& idealStr) {
+    EXPECT_EQ(
+      signatureGBLeads(idealStr, Reducer::Reducer_Geobucket_Hashed),
+      signatureGBLeads(idealStr, Reducer::Reducer_F4_New)
+    );
+  };
+  check(smallIdealComponentLastDescending());
+  check(liuIdealComponentLastDescending());
+  check(gerdt93IdealComponentLast(false, false));
+}
+
+TEST(GB, signatureParallel) {
+  const auto check = [](const std::string& idealStr) {
+    const auto type = Reducer::Reducer_Geobucket_Hashed;
+    EXPECT_EQ(
+      signatureGBLeads(idealStr, type, 1),
+      signatureGBLeads(idealStr, type, 16)
+    );
+  };
+  check(smallIdealComponentLastDescending());
+  check(liuIdealComponentLastDescending());
+  check(gerdt93IdealComponentLast(false, false));
+}
+
+TEST(GB, signatureSetEqualSignature) {
+  // For this ideal, a basis element found from a set of signatures has new
+  // S-pairs whose signature is a later signature of the same set. Those
+  // S-pairs have to be processed together with the S-pairs of that
+  // signature in the set, so each signature is still processed only once.
+  const auto idealStr = weispfennig97IdealComponentLast(true);
+  const auto expected =
+    signatureGBLeads(idealStr, Reducer::Reducer_Geobucket_Hashed, 1);
+  for (unsigned int setSize = 2; setSize < 9; ++setSize) {
+    EXPECT_EQ(
+      expected,
+      signatureGBLeads(idealStr, Reducer::Reducer_F4_New, setSize)
+    ) << "set size " << setSize;
+  }
+}
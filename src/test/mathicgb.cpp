@@ -675,6 +675,44 @@ TEST(MathicGBLib, EasyReGB) {
     << "\nDisplayed computed:\n" << computedStr.str();
 }
 
+TEST(MathicGBLib, LargeModulusGB) {
+  // 2^31 - 1 is the largest supported modulus. It does not fit in 16 bits,
+  // so F4 has to use 32 bit scalars.
+  const mgb::GroebnerConfiguration::Coefficient modulus = 2147483647u;
+  for (int i = 0; i < 2; ++i) {
+    mgb::GroebnerConfiguration configuration(modulus, 3, 1);
+    const auto reducer = i == 0 ?
+      mgb::GroebnerConfiguration::ClassicReducer :
+      mgb::GroebnerConfiguration::MatrixReducer;
+    configuration.setReducer(reducer);
+    mgb::GroebnerInputIdealStream input(configuration);
+    std::ostringstream computedStr;
+    mgb::IdealStreamLog<> computed(computedStr, modulus, 3, 1);
+    mgb::IdealStreamChecker<decltype(computed)> checked(computed);
+
+    makeBasis(input);
+    mgb::computeGroebnerBasis(input, checked);
+
+    std::ostringstream correctStr;
+    mgb::IdealStreamLog<> correct(correctStr, modulus, 3, 1);
+    mgb::IdealStreamChecker<decltype(correct)> correctChecked(correct);
+    makeGroebnerBasis(correctChecked);
+
+    EXPECT_EQ(correctStr.str(), computedStr.str())
+      << "\nDisplayed expected:\n" << correctStr.str()
+      << "\nDisplayed computed:\n" << computedStr.str();
+  }
+
+  // This input is large enough that F4 reduces several S-pairs at a time.
+  mgb::GroebnerConfiguration configuration(modulus, 5, 1);
+  configuration.setReducer(mgb::GroebnerConfiguration::MatrixReducer);
+  mgb::GroebnerInputIdealStream input(configuration);
+  makeCyclic5Basis(input);
+  mgb::NullIdealStream computed
+    (input.modulus(), input.varCount(), input.comCount());
+  mgb::computeGroebnerBasis(input, computed);
+}
+
 TEST(MathicGBLib, Cyclic5) {
   for (int i = 0; i < 2; ++i) {
     mgb::GroebnerConfiguration configuration(101, 5, 1);
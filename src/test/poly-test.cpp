@@ -536,6 +536,72 @@ TEST(MTArray,KDTree1) {
   EXPECT_FALSE(M->member(monomialParseFromString(R.get(), "ad<1>")));
 }
 
+TEST(MTArray,DivMaskTrie1) {
+  std::unique_ptr<PolyRing> R(ringFromString("32003 6 1\n1 1 1 1 1 1"));
+  std::unique_ptr<ModuleMonoSet> M(ModuleMonoSet::make(R->monoid(), 5, 6, false));
+  M->insert(monomialParseFromString(R.get(), "abc<1>"));
+  M->insert(monomialParseFromString(R.get(), "a2d<1>"));
+  EXPECT_EQ(2, M->elementCount());
+
+  std::vector<PolyRing::Monoid::ConstMonoPtr> monos;
+  monos.push_back(monomialParseFromString(R.get(), "abc4d<1>"));
+  monos.push_back(monomialParseFromString(R.get(), "a2d<2>"));
+  monos.push_back(monomialParseFromString(R.get(), "a2d2<1>"));
+  monos.push_back(monomialParseFromString(R.get(), "ad<1>"));
+  monos.push_back(monomialParseFromString(R.get(), "abc<1>"));
+  std::vector<bool> isMember;
+  M->memberSet(monos, isMember);
+  ASSERT_EQ(5, isMember.size());
+  EXPECT_TRUE(isMember[0]);
+  EXPECT_FALSE(isMember[1]);
+  EXPECT_TRUE(isMember[2]);
+  EXPECT_FALSE(isMember[3]);
+  EXPECT_TRUE(isMember[4]);
+  for (size_t i = 0; i < monos.size(); ++i)
+    EXPECT_EQ(M->member(*monos[i]), isMember[i]);
+}
+
+TEST(MTArray,DivMaskTrieManyMonomials) {
+  // Enough monomials that the trie has to split its leaves. The answers
+  // are checked against the KD-tree.
+  std::unique_ptr<PolyRing> R(ringFromString("32003 12 1\n1 1 1 1 1 1 1 1 1 1 1 1"));
+  const auto& monoid = R->monoid();
+  for (int allowRemovals = 0; allowRemovals < 2; ++allowRemovals) {
+    auto trie = ModuleMonoSet::make(monoid, 5, 3, allowRemovals != 0);
+    auto kdTree = ModuleMonoSet::make(monoid, 2, 3, allowRemovals != 0);
+
+    std::vector<PolyRing::Monoid::Mono> monos;
+    std::vector<PolyRing::Monoid::ConstMonoPtr> monoPtrs;
+    unsigned int seed = 1;
+    const auto random = [&](unsigned int bound) {
+      seed = seed * 1103515245 + 12345;
+      return (seed >> 16) % bound;
+    };
+    for (size_t i = 0; i < 2000; ++i) {
+      monos.emplace_back(monoid.alloc());
+      auto& mono = monos.back();
+      for (PolyRing::Monoid::VarIndex var = 0; var < monoid.varCount(); ++var)
+        if (random(4) == 0)
+          monoid.setExponent(var, 1 + random(3), *mono);
+      monoid.setExponent(random(monoid.varCount()), 1 + random(2), *mono);
+      monoid.setComponent(random(3), *mono);
+      monoPtrs.push_back(mono.ptr());
+    }
+
+    for (size_t i = 0; i < 1000; ++i)
+      EXPECT_EQ(kdTree->insert(*monoPtrs[i]), trie->insert(*monoPtrs[i]));
+    EXPECT_EQ(kdTree->elementCount(), trie->elementCount());
+
+    std::vector<bool> isMember;
+    trie->memberSet(monoPtrs, isMember);
+    ASSERT_EQ(monoPtrs.size(), isMember.size());
+    for (size_t i = 0; i < monoPtrs.size(); ++i) {
+      EXPECT_EQ(kdTree->member(*monoPtrs[i]), isMember[i]);
+      EXPECT_EQ(isMember[i], trie->member(*monoPtrs[i]));
+    }
+  }
+}
+
 //#warning "remove this code"
 #if 0
 bool test_find_signatures(const PolyRing *R, 